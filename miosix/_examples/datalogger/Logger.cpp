@@ -28,10 +28,12 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/ioctl.h>
 #include <stdexcept>
 #include <chrono>
 #include <thread>
 #include <interfaces/atomic_ops.h>
+#include <filesystem/ioctl.h>
 #include <tscpp/buffer.h>
 #include "Logger.h"
 
@@ -72,6 +74,16 @@ void Logger::start()
         throw runtime_error("Error opening log file");
     setbuf(file, NULL);
 
+    // Reserve contiguous space past the end of the log file, so that the
+    // writer thread does not have to allocate clusters while logging. This is
+    // only an optimization, if it fails logging works anyway
+    struct stat st;
+    if (fstat(fileno(file), &st) == 0)
+    {
+        off_t reserve = st.st_size + reserveSize;
+        ioctl(fileno(file), IOCTL_RESERVE, &reserve);
+    }
+
     // The boring part, start threads one by one and if they fail, undo
     // Perhaps excessive defensive programming as thread creation failure is
     // highly unlikely (only if ram is full)
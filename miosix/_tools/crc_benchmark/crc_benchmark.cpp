@@ -0,0 +1,135 @@
+/**
+ * This program checks the software crc16(), crc32() and crc32c() against
+ * reference vectors and a bitwise implementation of the same crc, and then
+ * measures their throughput. It runs on the host, build it from this
+ * directory with
+ * 
+ * g++ -O2 -std=c++14 -I../.. crc_benchmark.cpp ../../util/crc16.cpp \
+ *     ../../util/crc32.cpp ../../util/crc32c.cpp -o crc_benchmark
+ * 
+ * Add -DCRC32_SLICE_BYTES=8 to measure slicing by 8 instead of by 4.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include "util/crc16.h"
+#include "util/crc32.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace miosix;
+
+/**
+ * Bitwise crc with reflected input and output, as crc32() and crc32c()
+ */
+static unsigned int bitwiseCrc32(unsigned int poly, const unsigned char *m,
+                                 unsigned int length)
+{
+    unsigned int crc=0xffffffff;
+    for(unsigned int i=0;i<length;i++)
+    {
+        crc^=m[i];
+        for(int j=0;j<8;j++) crc=crc & 1 ? (crc>>1) ^ poly : crc>>1;
+    }
+    return ~crc;
+}
+
+/**
+ * Bitwise ccitt crc16, as crc16()
+ */
+static unsigned short bitwiseCrc16(const unsigned char *m, unsigned int length)
+{
+    unsigned short crc=0xffff;
+    for(unsigned int i=0;i<length;i++)
+    {
+        crc^=m[i]<<8;
+        for(int j=0;j<8;j++) crc=crc & 0x8000 ? (crc<<1) ^ 0x1021 : crc<<1;
+    }
+    return crc;
+}
+
+static int failures=0;
+
+static void check(bool condition, const char *what, unsigned int offset,
+                  unsigned int length)
+{
+    if(condition) return;
+    printf("FAIL: %s (offset %u, length %u)\n",what,offset,length);
+    failures++;
+}
+
+static void correctness()
+{
+    //Reference vectors
+    const char msg[]="123456789";
+    check(crc16(msg,9)==0x29b1,"crc16 reference",0,9);
+    check(crc32(msg,9)==0xcbf43926,"crc32 reference",0,9);
+    check(crc32c(msg,9)==0xe3069283,"crc32c reference",0,9);
+    check(crc32(msg,0)==0 && crc32c(msg,0)==0 && crc16(msg,0)==0xffff,
+          "empty message",0,0);
+    
+    //All alignments and lengths around the slicing loop, both in one call and
+    //split in two parts
+    vector<unsigned char> buf(256+8);
+    for(unsigned int i=0;i<buf.size();i++) buf[i]=rand();
+    for(unsigned int off=0;off<8;off++)
+    {
+        for(unsigned int len=0;len<=256;len++)
+        {
+            const unsigned char *m=buf.data()+off;
+            unsigned int c32=crc32(m,len);
+            unsigned int c32c=crc32c(m,len);
+            unsigned short c16=crc16(m,len);
+            check(c32==bitwiseCrc32(0xedb88320,m,len),"crc32",off,len);
+            check(c32c==bitwiseCrc32(0x82f63b78,m,len),"crc32c",off,len);
+            check(c16==bitwiseCrc16(m,len),"crc16",off,len);
+            for(unsigned int s=0;s<=len;s+=len/4+1)
+            {
+                check(crc32(m+s,len-s,crc32(m,s))==c32,"crc32 split",off,len);
+                check(crc32c(m+s,len-s,crc32c(m,s))==c32c,"crc32c split",
+                      off,len);
+                check(crc16(m+s,len-s,crc16(m,s))==c16,"crc16 split",off,len);
+            }
+        }
+    }
+}
+
+template<typename F>
+static void benchmark(const char *name, F f)
+{
+    const unsigned int size=64*1024;
+    const int iterations=1000;
+    vector<unsigned char> buf(size);
+    for(unsigned int i=0;i<size;i++) buf[i]=rand();
+    volatile unsigned int sink=0;
+    auto start=steady_clock::now();
+    for(int i=0;i<iterations;i++) sink=sink+f(buf.data(),size);
+    auto end=steady_clock::now();
+    double s=duration_cast<nanoseconds>(end-start).count()/1e9;
+    printf("%-16s %8.1f MB/s\n",name,size*double(iterations)/s/1e6);
+}
+
+int main()
+{
+    correctness();
+    if(failures)
+    {
+        printf("%d failures\n",failures);
+        return 1;
+    }
+    puts("All tests passed");
+    benchmark("crc32 bitwise",[](const unsigned char *m, unsigned int len) {
+        return bitwiseCrc32(0xedb88320,m,len);
+    });
+    benchmark("crc32",[](const unsigned char *m, unsigned int len) {
+        return crc32(m,len);
+    });
+    benchmark("crc32c",[](const unsigned char *m, unsigned int len) {
+        return crc32c(m,len);
+    });
+    benchmark("crc16",[](const unsigned char *m, unsigned int len) {
+        return static_cast<unsigned int>(crc16(m,len));
+    });
+}
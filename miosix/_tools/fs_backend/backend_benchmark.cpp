@@ -9,6 +9,10 @@
  * 
  * NOTE: this program assumes the SD is larger than 1GByte, and you have
  * 32KByte available in your microcontroller for the disk buffer.
+ * 
+ * The seek test instead goes through the filesystem, and measures the time
+ * taken by random seeks followed by a small read in a large file. It needs a
+ * formatted SD card with at least 64MByte of free space.
  */
 
 #include <cstdio>
@@ -16,6 +20,8 @@
 #include <cassert>
 #include <chrono>
 #include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <miosix.h>
 
 using namespace std;
@@ -65,6 +71,57 @@ void testThread(void *)
     delete[] data;
 }
 
+void seekTest()
+{
+    const char filename[]="/sd/seekbench.dat";
+    const int fileSize=64*1024*1024; ///< Large enough to have a long FAT chain
+    const int blockSize=32*1024;
+    const int numSeeks=100;
+    struct stat st;
+    if(stat(filename,&st)!=0 || st.st_size!=fileSize)
+    {
+        puts("Creating test file...");
+        int fd=open(filename,O_WRONLY|O_CREAT|O_TRUNC,0644);
+        if(fd<0)
+        {
+            perror("open");
+            return;
+        }
+        char *data=new char[blockSize];
+        memset(data,0xaa,blockSize);
+        for(int i=0;i<fileSize/blockSize;i++)
+            if(write(fd,data,blockSize)!=blockSize) assert(false);
+        delete[] data;
+        close(fd);
+    }
+    for(int i=0;i<4;i++)
+    {
+        int fd=open(filename,O_RDONLY,0);
+        if(fd<0)
+        {
+            perror("open");
+            return;
+        }
+        char data[512];
+        //The first seek in a freshly opened file also pays for building the
+        //cluster link map, so it is reported separately
+        auto t=system_clock::now();
+        lseek(fd,fileSize-sizeof(data),SEEK_SET);
+        if(read(fd,data,sizeof(data))!=sizeof(data)) assert(false);
+        duration<float> first=system_clock::now()-t;
+        t=system_clock::now();
+        for(int j=0;j<numSeeks;j++)
+        {
+            lseek(fd,rand() % (fileSize-sizeof(data)),SEEK_SET);
+            if(read(fd,data,sizeof(data))!=sizeof(data)) assert(false);
+        }
+        duration<float> d=system_clock::now()-t;
+        printf("first seek:%0.1fms average seek+read:%0.2fms\n",
+               first.count()*1000.f,d.count()*1000.f/numSeeks);
+        close(fd);
+    }
+}
+
 int main()
 {
     puts("\n====================");
@@ -76,13 +133,18 @@ int main()
         randomAccess=false;
         for(;;)
         {
-            puts("Read or write access, or quit (r/w/q)?");
+            puts("Read or write access, seek test, or quit (r/w/s/q)?");
             char line[64];
             fgets(line,sizeof(line),stdin);
             if(line[0]=='q') goto quit;
+            if(line[0]=='s')
+            {
+                seekTest();
+                continue;
+            }
             if(line[0]=='w') writeAccess=true;
             if(line[0]=='w' || line[0]=='r') break;
-            puts("Error: insert 'r' or 'w' or 'q'");
+            puts("Error: insert 'r' or 'w' or 's' or 'q'");
         }
         for(;;)
         {
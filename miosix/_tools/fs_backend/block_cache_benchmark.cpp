@@ -0,0 +1,107 @@
+/**
+ * This program measures how many SD card transactions are saved by the block
+ * cache interposed between Fat32Fs and the SD card, using a metadata-heavy
+ * workload: creating, stat-ing, listing and deleting many small files.
+ * 
+ * The filesystem mounted as /sd is umounted, and then remounted over block
+ * caches of different sizes, including a zero-sized one that passes every
+ * access through to the card and is used as the baseline.
+ * 
+ * NOTE: the test creates and then deletes the /sd/cachebench directory, it
+ * does not touch other files in the SD card.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <miosix.h>
+#include "filesystem/file_access.h"
+#include "filesystem/devfs/devfs.h"
+#include "filesystem/fat32/fat32.h"
+#include "filesystem/block_cache/block_cache.h"
+#include "filesystem/stringpart.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace miosix;
+
+const int numFiles=32; ///< Number of files created by the workload
+
+static void workload()
+{
+    char name[64];
+    if(mkdir("/sd/cachebench",0755)!=0) perror("mkdir");
+    for(int i=0;i<numFiles;i++)
+    {
+        sprintf(name,"/sd/cachebench/file%02d.txt",i);
+        int fd=open(name,O_WRONLY|O_CREAT|O_TRUNC,0644);
+        if(fd<0) { perror("open"); continue; }
+        write(fd,name,strlen(name));
+        close(fd);
+    }
+    for(int i=0;i<numFiles;i++)
+    {
+        struct stat st;
+        sprintf(name,"/sd/cachebench/file%02d.txt",i);
+        if(stat(name,&st)!=0) perror("stat");
+    }
+    if(DIR *d=opendir("/sd/cachebench"))
+    {
+        while(readdir(d)) ;
+        closedir(d);
+    }
+    for(int i=0;i<numFiles;i++)
+    {
+        sprintf(name,"/sd/cachebench/file%02d.txt",i);
+        if(unlink(name)!=0) perror("unlink");
+    }
+    if(rmdir("/sd/cachebench")!=0) perror("rmdir");
+}
+
+static void runTest(intrusive_ref_ptr<FileBase> disk, unsigned int cacheSize)
+{
+    FilesystemManager& fsm=FilesystemManager::instance();
+    intrusive_ref_ptr<BlockCache> cache(new BlockCache(disk,cacheSize));
+    intrusive_ref_ptr<Fat32Fs> fat32(new Fat32Fs(cache));
+    if(fat32->mountFailed() || fsm.kmount("/sd",fat32)!=0)
+    {
+        puts("Error: mount failed");
+        return;
+    }
+    fat32.reset();
+    auto t=system_clock::now();
+    workload();
+    fsm.umount("/sd"); //Also deletes the filesystem, which syncs
+    duration<float> d=system_clock::now()-t;
+    printf("cache %2u blocks: time:%0.3fs reads:%u writes:%u hits:%u misses:%u\n",
+        cacheSize,d.count(),cache->getDiskReads(),cache->getDiskWrites(),
+        cache->getHits(),cache->getMisses());
+}
+
+int main()
+{
+    FilesystemManager& fsm=FilesystemManager::instance();
+    intrusive_ref_ptr<DevFs> devfs=fsm.getDevFs();
+    intrusive_ref_ptr<FileBase> disk;
+    StringPart sda("sda");
+    if(!devfs || devfs->open(disk,sda,O_RDWR,0)<0)
+    {
+        puts("Error: can't open /dev/sda");
+        return 1;
+    }
+    if(fsm.umount("/sd")!=0)
+    {
+        puts("Error: can't umount /sd");
+        return 1;
+    }
+    const unsigned int sizes[]={0,4,8,16,32};
+    for(auto size : sizes) runTest(disk,size);
+    //Leave the system as we found it
+    intrusive_ref_ptr<BlockCache> cache(new BlockCache(disk,BLOCK_CACHE_SIZE));
+    fsm.kmount("/sd",intrusive_ref_ptr<FilesystemBase>(new Fat32Fs(cache)));
+    printf("Bye\n");
+}
@@ -0,0 +1,148 @@
+/**
+ * This program measures how Fat32Fs throughput scales with multiple threads
+ * accessing different files at the same time.
+ * 
+ * The first test runs an increasing number of reader threads, each reading
+ * its own file, and prints the aggregate throughput.
+ * The second test measures the latency of small reads from a file while
+ * another thread does a large streaming write to a different file, which
+ * shows whether a slow write blocks unrelated files.
+ * 
+ * NOTE: the test creates and then deletes the /sd/parbench directory, it
+ * does not touch other files in the SD card.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <miosix.h>
+
+using namespace std;
+using namespace std::chrono;
+using namespace miosix;
+
+const int maxThreads=4;          ///< Max number of concurrent readers
+const int fileSize=128*1024;     ///< Size of each test file
+const int bufferSize=4096;       ///< Read/write buffer size
+const int smallReadSize=64;      ///< Size of reads in the latency test
+
+static char *buffers[maxThreads+1];
+static volatile bool writerDone;
+
+static void fileName(char *name, int i)
+{
+    sprintf(name,"/sd/parbench/file%d.dat",i);
+}
+
+static bool createFiles()
+{
+    if(mkdir("/sd/parbench",0755)!=0) { perror("mkdir"); return false; }
+    char name[64];
+    memset(buffers[0],0x55,bufferSize);
+    for(int i=0;i<maxThreads;i++)
+    {
+        fileName(name,i);
+        int fd=open(name,O_WRONLY|O_CREAT|O_TRUNC,0644);
+        if(fd<0) { perror("open"); return false; }
+        for(int j=0;j<fileSize;j+=bufferSize) write(fd,buffers[0],bufferSize);
+        close(fd);
+    }
+    return true;
+}
+
+static void deleteFiles()
+{
+    char name[64];
+    for(int i=0;i<=maxThreads;i++)
+    {
+        fileName(name,i);
+        unlink(name);
+    }
+    rmdir("/sd/parbench");
+}
+
+static void *reader(void *arg)
+{
+    int i=reinterpret_cast<int>(arg);
+    char name[64];
+    fileName(name,i);
+    int fd=open(name,O_RDONLY);
+    if(fd<0) { perror("open"); return 0; }
+    while(read(fd,buffers[i],bufferSize)>0) ;
+    close(fd);
+    return 0;
+}
+
+static void *writer(void *)
+{
+    char name[64];
+    fileName(name,maxThreads);
+    int fd=open(name,O_WRONLY|O_CREAT|O_TRUNC,0644);
+    if(fd<0) { perror("open"); writerDone=true; return 0; }
+    for(int j=0;j<4*fileSize;j+=bufferSize)
+        write(fd,buffers[maxThreads],bufferSize);
+    close(fd);
+    writerDone=true;
+    return 0;
+}
+
+static void readersTest()
+{
+    puts("Parallel readers");
+    for(int n=1;n<=maxThreads;n++)
+    {
+        pthread_t threads[maxThreads];
+        auto t=system_clock::now();
+        for(int i=0;i<n;i++)
+            pthread_create(&threads[i],0,reader,reinterpret_cast<void*>(i));
+        for(int i=0;i<n;i++) pthread_join(threads[i],0);
+        duration<float> d=system_clock::now()-t;
+        float speed=n*fileSize/1024/d.count();
+        printf("threads:%d time:%0.3fs speed:%0.1fKB/s\n",n,d.count(),speed);
+    }
+}
+
+static void latencyTest()
+{
+    puts("Small read latency while streaming a write to another file");
+    char name[64];
+    fileName(name,0);
+    int fd=open(name,O_RDONLY);
+    if(fd<0) { perror("open"); return; }
+    writerDone=false;
+    pthread_t thread;
+    pthread_create(&thread,0,writer,0);
+    float worst=0, sum=0;
+    int count=0;
+    while(!writerDone)
+    {
+        if(lseek(fd,(count*smallReadSize) % fileSize,SEEK_SET)<0) break;
+        auto t=system_clock::now();
+        read(fd,buffers[0],smallReadSize);
+        duration<float> d=system_clock::now()-t;
+        worst=max(worst,d.count());
+        sum+=d.count();
+        count++;
+        Thread::sleep(1);
+    }
+    pthread_join(thread,0);
+    close(fd);
+    if(count) printf("reads:%d average:%0.3fms worst:%0.3fms\n",
+        count,sum/count*1000,worst*1000);
+}
+
+int main()
+{
+    for(int i=0;i<=maxThreads;i++) buffers[i]=new char[bufferSize];
+    if(createFiles())
+    {
+        readersTest();
+        latencyTest();
+    }
+    deleteFiles();
+    for(int i=0;i<=maxThreads;i++) delete[] buffers[i];
+    printf("Bye\n");
+}
@@ -0,0 +1,238 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "filesystem/romfs/romfs_types.h"
+
+using namespace std;
+using namespace miosix;
+
+/**
+ * A file or directory to put in the image
+ */
+struct Node
+{
+    string name;
+    bool directory;
+    vector<unsigned char> content; ///< File content
+    vector<Node> children;         ///< Directory content, sorted by name
+    unsigned int nameOffset;
+    unsigned int dataOffset;
+};
+
+/**
+ * Recursively read a directory tree from disk
+ * \param path directory path
+ * \param node the directory content is stored here
+ * \return true on success
+ */
+static bool scan(const string& path, Node& node)
+{
+    DIR *d=opendir(path.c_str());
+    if(d==nullptr)
+    {
+        cerr<<"can't open "<<path<<endl;
+        return false;
+    }
+    while(struct dirent *de=readdir(d))
+    {
+        string name(de->d_name);
+        if(name=="." || name=="..") continue;
+        string childPath=path+"/"+name;
+        struct stat st;
+        if(stat(childPath.c_str(),&st)!=0)
+        {
+            cerr<<"can't stat "<<childPath<<endl;
+            closedir(d);
+            return false;
+        }
+        Node child;
+        child.name=name;
+        child.directory=S_ISDIR(st.st_mode);
+        if(child.directory)
+        {
+            if(scan(childPath,child)==false)
+            {
+                closedir(d);
+                return false;
+            }
+        } else if(S_ISREG(st.st_mode)) {
+            ifstream in(childPath,ios::binary);
+            stringstream ss;
+            ss<<in.rdbuf();
+            string s=ss.str();
+            child.content.assign(s.begin(),s.end());
+        } else {
+            cerr<<"skipping "<<childPath<<", not a file or directory"<<endl;
+            continue;
+        }
+        node.children.push_back(child);
+    }
+    closedir(d);
+    //The kernel looks up names with a binary search using strcmp
+    sort(node.children.begin(),node.children.end(),
+         [](const Node& a, const Node& b){ return a.name<b.name; });
+    return true;
+}
+
+static unsigned int align(unsigned int x)
+{
+    return (x+romFsDataAlignment-1)/romFsDataAlignment*romFsDataAlignment;
+}
+
+/**
+ * Assign the offset of all directory tables
+ */
+static void layoutTables(Node& node, unsigned int& offset)
+{
+    node.dataOffset=offset;
+    offset+=node.children.size()*sizeof(RomFsEntry);
+    for(auto& c : node.children) if(c.directory) layoutTables(c,offset);
+}
+
+/**
+ * Assign the offset of all names
+ */
+static void layoutNames(Node& node, unsigned int& offset)
+{
+    for(auto& c : node.children)
+    {
+        c.nameOffset=offset;
+        offset+=c.name.length()+1;
+    }
+    for(auto& c : node.children) if(c.directory) layoutNames(c,offset);
+}
+
+/**
+ * Assign the offset of all file content
+ */
+static void layoutData(Node& node, unsigned int& offset)
+{
+    for(auto& c : node.children)
+    {
+        if(c.directory) layoutData(c,offset);
+        else {
+            offset=align(offset);
+            c.dataOffset=offset;
+            offset+=c.content.size();
+        }
+    }
+}
+
+static void put32(vector<unsigned char>& image, unsigned int offset,
+                  unsigned int x)
+{
+    for(int i=0;i<4;i++) image.at(offset+i)=(x>>(8*i)) & 0xff;
+}
+
+/**
+ * Write the content of a directory, and recursively of its children
+ */
+static void emit(vector<unsigned char>& image, const Node& node)
+{
+    unsigned int entry=node.dataOffset;
+    for(auto& c : node.children)
+    {
+        put32(image,entry+0,c.nameOffset);
+        put32(image,entry+4,c.dataOffset);
+        put32(image,entry+8,c.directory ? c.children.size() : c.content.size());
+        put32(image,entry+12,c.directory ? RomFsEntry::directory : 0);
+        entry+=sizeof(RomFsEntry);
+        copy(c.name.begin(),c.name.end(),image.begin()+c.nameOffset);
+        if(c.directory) emit(image,c);
+        else copy(c.content.begin(),c.content.end(),
+                  image.begin()+c.dataOffset);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    string inName, outName, arrayName;
+    for(int i=1;i<argc;i++)
+    {
+        string opt(argv[i]);
+        if(opt=="--array" && i+1<argc) arrayName=argv[++i];
+        else if(inName.empty()) inName=opt;
+        else outName=opt;
+    }
+    if(inName.empty() || outName.empty())
+    {
+        cerr<<"usage:"<<endl<<"mx-buildromfs directory image.bin"<<endl
+            <<"mx-buildromfs directory image.cpp --array name"<<endl;
+        return 1;
+    }
+    
+    Node root;
+    root.directory=true;
+    if(scan(inName,root)==false) return 1;
+    
+    unsigned int offset=sizeof(RomFsHeader);
+    layoutTables(root,offset);
+    layoutNames(root,offset);
+    layoutData(root,offset);
+    unsigned int imageSize=align(offset);
+    
+    vector<unsigned char> image(imageSize,0);
+    put32(image,0,RomFsHeader::romFsMagic);
+    put32(image,4,imageSize);
+    put32(image,8,root.dataOffset);
+    put32(image,12,root.children.size());
+    emit(image,root);
+    
+    ofstream out(outName,ios::binary);
+    if(arrayName.empty())
+    {
+        out.write(reinterpret_cast<const char*>(image.data()),image.size());
+    } else {
+        //Const, so that it is placed in flash
+        out<<"//Generated by mx-buildromfs from "<<inName<<", do not edit"<<endl
+           <<endl<<"extern const unsigned char "<<arrayName<<"[];"<<endl
+           <<"const unsigned char __attribute__((aligned("<<romFsDataAlignment
+           <<"))) "<<arrayName<<"[]="<<endl<<"{";
+        for(unsigned int i=0;i<image.size();i++)
+        {
+            if(i % 16==0) out<<endl<<"   ";
+            out<<" 0x"<<hex<<setw(2)<<setfill('0')<<int(image[i])<<",";
+        }
+        out<<endl<<"};"<<endl;
+    }
+    if(!out)
+    {
+        cerr<<"can't write "<<outName<<endl;
+        return 1;
+    }
+    cout<<inName<<": "<<imageSize<<" bytes"<<endl;
+    return 0;
+}
@@ -0,0 +1,196 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include "util/lz4.h"
+#include "kernel/elf_pack.h"
+
+using namespace std;
+using namespace miosix;
+
+/**
+ * Compress a buffer in the LZ4 block format, using a greedy parser with a
+ * single entry hash table. The compression ratio is a bit worse than the one
+ * of the reference implementation, but there is no dependency on liblz4 and
+ * the output can be decompressed by any LZ4 block decoder.
+ * \param in data to compress
+ * \return the compressed data
+ */
+static vector<unsigned char> lz4Compress(const vector<unsigned char>& in)
+{
+    //Constraints of the LZ4 block format: the last 5 bytes are always
+    //literals, and the last match must start at least 12 bytes before the end
+    const int minMatch=4, lastLiterals=5, mfLimit=12, hashBits=14;
+    const int n=in.size();
+    vector<unsigned char> out;
+    vector<int> table(1<<hashBits,-1);
+    auto read32=[&](int i) {
+        unsigned int x;
+        memcpy(&x,&in[i],4);
+        return x;
+    };
+    auto hash=[&](unsigned int x) { return (x*2654435761u)>>(32-hashBits); };
+    auto writeLength=[&](int len) {
+        for(;len>=255;len-=255) out.push_back(255);
+        out.push_back(len);
+    };
+    auto emit=[&](int anchor, int literals, int offset, int matchLen) {
+        int litToken=literals<15 ? literals : 15;
+        int matchToken=0;
+        if(matchLen) matchToken=matchLen-minMatch<15 ? matchLen-minMatch : 15;
+        out.push_back(litToken<<4 | matchToken);
+        if(literals>=15) writeLength(literals-15);
+        out.insert(out.end(),in.begin()+anchor,in.begin()+anchor+literals);
+        if(matchLen==0) return;
+        out.push_back(offset & 0xff);
+        out.push_back(offset>>8);
+        if(matchLen-minMatch>=15) writeLength(matchLen-minMatch-15);
+    };
+    int anchor=0;
+    int i=0;
+    while(i+mfLimit<=n)
+    {
+        unsigned int seq=read32(i);
+        unsigned int h=hash(seq);
+        int ref=table[h];
+        table[h]=i;
+        if(ref<0 || i-ref>65535 || read32(ref)!=seq)
+        {
+            i++;
+            continue;
+        }
+        int len=minMatch;
+        while(i+len<n-lastLiterals && in[ref+len]==in[i+len]) len++;
+        while(i>anchor && ref>0 && in[i-1]==in[ref-1])
+        {
+            i--;
+            ref--;
+            len++;
+        }
+        emit(anchor,i-anchor,i-ref,len);
+        i+=len;
+        anchor=i;
+    }
+    emit(anchor,n-anchor,0,0);
+    return out;
+}
+
+/**
+ * Measure the decompression speed on the host, to get a rough idea of the
+ * ratio between the time spent decompressing and the one spent copying
+ * \param packed compressed data
+ * \param elf uncompressed data
+ */
+static void benchmark(const vector<unsigned char>& packed,
+                      const vector<unsigned char>& elf)
+{
+    using namespace std::chrono;
+    vector<unsigned char> buffer(elf.size());
+    const int iterations=1000;
+    auto t0=steady_clock::now();
+    for(int i=0;i<iterations;i++)
+        lz4Decompress(packed.data(),packed.size(),buffer.data(),buffer.size());
+    auto t1=steady_clock::now();
+    for(int i=0;i<iterations;i++)
+        memcpy(buffer.data(),elf.data(),elf.size());
+    auto t2=steady_clock::now();
+    double decompress=duration_cast<nanoseconds>(t1-t0).count()/iterations;
+    double copy=duration_cast<nanoseconds>(t2-t1).count()/iterations;
+    cout<<"decompression "<<decompress/1000<<"us, memcpy "<<copy/1000<<"us, "
+        <<"ratio "<<decompress/copy<<endl;
+}
+
+int main(int argc, char *argv[])
+{
+    string inName, outName;
+    bool bench=false;
+    for(int i=1;i<argc;i++)
+    {
+        string opt(argv[i]);
+        if(opt=="--benchmark") bench=true;
+        else if(inName.empty()) inName=opt;
+        else outName=opt;
+    }
+    if(inName.empty() || outName.empty())
+    {
+        cerr<<"usage:"<<endl<<"mx-elfpack prog.elf prog.elf.lz4 [--benchmark]"
+            <<endl;
+        return 1;
+    }
+    ifstream in(inName,ios::binary);
+    if(!in)
+    {
+        cerr<<"can't open "<<inName<<endl;
+        return 1;
+    }
+    stringstream ss;
+    ss<<in.rdbuf();
+    string s=ss.str();
+    vector<unsigned char> elf(s.begin(),s.end());
+    if(elf.size()<4 || memcmp(elf.data(),"\x7f" "ELF",4))
+    {
+        cerr<<inName<<" is not an elf file"<<endl;
+        return 1;
+    }
+    vector<unsigned char> packed=lz4Compress(elf);
+    
+    //Verify using the same decompressor the kernel uses
+    vector<unsigned char> check(elf.size());
+    int result=lz4Decompress(packed.data(),packed.size(),
+                             check.data(),check.size());
+    if(result!=static_cast<int>(elf.size()) || check!=elf)
+    {
+        cerr<<"internal error, verification failed"<<endl;
+        return 1;
+    }
+    
+    PackedElfHeader header;
+    header.magic=PackedElfHeader::lz4Magic;
+    header.elfSize=elf.size();
+    header.packedSize=packed.size();
+    header.reserved=0;
+    ofstream out(outName,ios::binary);
+    out.write(reinterpret_cast<const char*>(&header),sizeof(header));
+    out.write(reinterpret_cast<const char*>(packed.data()),packed.size());
+    if(!out)
+    {
+        cerr<<"can't write "<<outName<<endl;
+        return 1;
+    }
+    
+    unsigned int total=sizeof(header)+packed.size();
+    cout<<inName<<": "<<elf.size()<<" -> "<<total<<" bytes ("
+        <<100*total/elf.size()<<"%)"<<endl;
+    if(bench) benchmark(packed,elf);
+    return 0;
+}
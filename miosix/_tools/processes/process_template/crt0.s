@@ -188,6 +188,22 @@ lseek:
 	blt  syscallfailed
 	bx   lr
 
+/**
+ * fsync, write buffered data of a file to the underlying device
+ * \param fd file descriptor
+ * \return 0 on success or -1 if errors
+ */
+.section .text.fsync
+.global fsync
+.type fsync, %function
+fsync:
+	movs r1, #100
+	movs r3, #15
+	svc  0
+	cmp  r0, #0
+	blt  syscallfailed
+	bx   lr
+
 /**
  * system, fork and execture a program, blocking
  * \param program to execute
@@ -202,6 +218,135 @@ system:
 	blt  syscallfailed
 	bx   lr
 
+/**
+ * shm_map, map a shared memory object in the process
+ * \param name name of the shared memory object
+ * \param size size of the shared memory object
+ * \param flags O_CREAT and O_EXCL are supported
+ * \return the address of the shared memory or (void*)-1 if errors
+ */
+.section .text.shm_map
+.global shm_map
+.type shm_map, %function
+shm_map:
+	movs r3, #23
+	svc  0
+	/* addresses can have the msb set, errors are in the -1..-4095 range */
+	cmn  r0, #4096
+	bhi  syscallfailed
+	bx   lr
+
+/**
+ * shm_unmap, unmap the shared memory object mapped in the process
+ * \return 0 on success or -1 if errors
+ */
+.section .text.shm_unmap
+.global shm_unmap
+.type shm_unmap, %function
+shm_unmap:
+	movs r3, #24
+	svc  0
+	cmp  r0, #0
+	blt  syscallfailed
+	bx   lr
+
+/**
+ * shm_unlink, remove the name of a shared memory object
+ * \param name name of the shared memory object
+ * \return 0 on success or -1 if errors
+ */
+.section .text.shm_unlink
+.global shm_unlink
+.type shm_unlink, %function
+shm_unlink:
+	movs r3, #25
+	svc  0
+	cmp  r0, #0
+	blt  syscallfailed
+	bx   lr
+
+/**
+ * getprocusage, get the resource usage of a process
+ * \param pid process id, 0 for the calling process
+ * \param usage pointer to a struct ProcessUsage, see kernel/process_usage.h
+ * \param children if nonzero, get the usage of waited for child processes
+ * \return 0 on success or -1 if errors
+ */
+.section .text.getprocusage
+.global getprocusage
+.type getprocusage, %function
+getprocusage:
+	movs r3, #26
+	svc  0
+	cmp  r0, #0
+	blt  syscallfailed
+	bx   lr
+
+/**
+ * poll, wait for one or more file descriptors to become ready for I/O
+ * \param fds array of struct pollfd
+ * \param nfds number of elements in fds
+ * \param timeout timeout in milliseconds, negative to wait indefinitely
+ * \return the number of ready file descriptors, 0 on timeout or -1 if errors
+ */
+.section .text.poll
+.global poll
+.type poll, %function
+poll:
+	movs r3, #27
+	svc  0
+	cmp  r0, #0
+	blt  syscallfailed
+	bx   lr
+
+/**
+ * pipe, create an anonymous pipe
+ * \param fds the read end is stored in fds[0], the write end in fds[1]
+ * \return 0 on success or -1 if errors
+ */
+.section .text.pipe
+.global pipe
+.type pipe, %function
+pipe:
+	movs r3, #28
+	svc  0
+	cmp  r0, #0
+	blt  syscallfailed
+	bx   lr
+
+/**
+ * mkfifo, create a FIFO special file
+ * \param path FIFO name
+ * \param mode FIFO permissions
+ * \return 0 on success or -1 if errors
+ */
+.section .text.mkfifo
+.global mkfifo
+.type mkfifo, %function
+mkfifo:
+	movs r3, #29
+	svc  0
+	cmp  r0, #0
+	blt  syscallfailed
+	bx   lr
+
+/**
+ * splice, move data between two file descriptors without a user buffer
+ * \param fdIn file descriptor where data is read
+ * \param fdOut file descriptor where data is written
+ * \param len maximum number of bytes to move
+ * \return the number of moved bytes or -1 if errors
+ */
+.section .text.splice
+.global splice
+.type splice, %function
+splice:
+	movs r3, #30
+	svc  0
+	cmp  r0, #0
+	blt  syscallfailed
+	bx   lr
+
 .section .text.__seterrno
 /* common jump target for all failing syscalls */
 syscallfailed:
@@ -0,0 +1,84 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+/*
+ * Compares the time to spawn a process from an elf in FLASH and from the
+ * same elf compressed with mx-elfpack. Build the process with
+ * "make packed" in process_template, then use this file as main.cpp
+ */
+
+#include <cstdio>
+#include <sys/wait.h>
+#include "miosix.h"
+#include "kernel/process.h"
+#include "kernel/SystemMap.h"
+
+#include "process_template/proc.h"
+#include "process_template/proc_lz4.h"
+
+using namespace std;
+using namespace miosix;
+
+/**
+ * \param name program name in the SystemMap
+ * \return the average time in microseconds to spawn the program and wait for
+ * its termination
+ */
+static long long spawnTime(const char *name)
+{
+    const int iterations=20;
+    long long total=0;
+    for(int i=0;i<iterations;i++)
+    {
+        pair<const unsigned int*,unsigned int> res;
+        res=SystemMap::instance().getElfProgram(name);
+        long long start=getTick();
+        ElfProgram program(res.first,res.second);
+        pid_t child=Process::create(program);
+        int ec;
+        Process::waitpid(child,&ec,0);
+        total+=getTick()-start;
+    }
+    return total*1000000/TICK_FREQ/iterations;
+}
+
+int main()
+{
+    SystemMap::instance().addElfProgram("plain",
+        reinterpret_cast<const unsigned int*>(main_elf),main_elf_len);
+    SystemMap::instance().addElfProgram("packed",
+        reinterpret_cast<const unsigned int*>(main_elf_lz4),main_elf_lz4_len);
+    for(;;)
+    {
+        getchar();
+        iprintf("flash footprint: plain %u bytes, packed %u bytes\n",
+                main_elf_len,main_elf_lz4_len);
+        long long plain=spawnTime("plain");
+        long long packed=spawnTime("packed");
+        iprintf("spawn+exit time: plain %lldus, packed %lldus\n",plain,packed);
+    }
+}
@@ -0,0 +1,14 @@
+//Generated by mx-buildromfs from romfs_test, do not edit
+
+extern const unsigned char romfsImage[];
+const unsigned char __attribute__((aligned(8))) romfsImage[]=
+{
+    0x4d, 0x58, 0x52, 0x46, 0x78, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+    0x40, 0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+    0x44, 0x00, 0x00, 0x00, 0x68, 0x00, 0x00, 0x00, 0x0d, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x4e, 0x00, 0x00, 0x00, 0x58, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x64, 0x69, 0x72, 0x00, 0x68, 0x65, 0x6c, 0x6c, 0x6f, 0x2e, 0x74, 0x78, 0x74, 0x00, 0x64, 0x61,
+    0x74, 0x61, 0x2e, 0x62, 0x69, 0x6e, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x48, 0x65, 0x6c, 0x6c, 0x6f, 0x2c, 0x20, 0x52,
+    0x6f, 0x6d, 0x46, 0x73, 0x0a, 0x00, 0x00, 0x00,
+};
@@ -37,12 +37,15 @@
 #include <stdexcept>
 #include <algorithm>
 #include <vector>
+#include <list>
 #include <set>
 #include <cassert>
 #include <functional>
 #include <fcntl.h>
+#include <malloc.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/ioctl.h>
 #include <signal.h>
 #include <pthread.h>
 #include <errno.h>
@@ -64,13 +67,36 @@
 #include "interfaces/endianness.h"
 #include "e20/e20.h"
 #include "kernel/intrusive.h"
+#include "kernel/object_pool.h"
+#ifdef WITH_SMALL_HEAP
+#include "kernel/small_heap.h"
+#endif //WITH_SMALL_HEAP
 #include "util/crc16.h"
+#include "util/crc32.h"
+#if defined(_ARCH_CORTEXM0_STM32)   || defined(_ARCH_CORTEXM4_STM32F3) \
+ || defined(_ARCH_CORTEXM4_STM32L4) || defined(_ARCH_CORTEXM7_STM32F7) \
+ || defined(_ARCH_CORTEXM7_STM32H7)
+#define WITH_HARDWARE_CRC_TEST
+#include "drivers/stm32_hardware_crc.h"
+#endif
+#ifdef WITH_FILESYSTEM
+#include "filesystem/file_access.h"
+#include "filesystem/tmpfs/tmpfs.h"
+#include "filesystem/romfs/romfs.h"
+#include "filesystem/ioctl.h"
+#include "filesystem/splice.h"
+#include "filesystem/block_cache/block_cache.h"
+#include "romfs_testsuite/romfs_image.h"
+#endif //WITH_FILESYSTEM
 
 #ifdef WITH_PROCESSES
 #include "kernel/elf_program.h"
 #include "kernel/process.h"
 #include "kernel/process_pool.h"
 #include "kernel/SystemMap.h"
+#include "kernel/elf_loader.h"
+#include "kernel/shared_memory.h"
+#include "kernel/shm_channel.h"
 
 #include "syscall_testsuite/includes.h"
 #include "elf_testsuite/includes.h"
@@ -131,6 +157,11 @@ static void test_24();
 static void test_25();
 #endif //_MIOSIX_GCC_PATCH_MAJOR
 static void test_26();
+static void test_27();
+static void test_28();
+static void test_29();
+static void test_30();
+static void test_31();
 #if defined(_ARCH_CORTEXM7_STM32F7) || defined(_ARCH_CORTEXM7_STM32H7)
 void testCacheAndDMA();
 #endif //_ARCH_CORTEXM7_STM32F7/H7
@@ -140,12 +171,25 @@ static void fs_test_1();
 static void fs_test_2();
 static void fs_test_3();
 static void fs_test_4();
+static void fs_test_5();
+static void fs_test_6();
+static void fs_test_7();
+static void fs_test_8();
+static void fs_test_9();
+static void fs_test_10();
+static void fs_test_11();
+static void fs_test_12();
+static void fs_test_13();
+static void fs_test_14();
+static void fs_test_15();
+static void fs_test_16();
 #endif //WITH_FILESYSTEM
 //Benchmark functions
 static void benchmark_1();
 static void benchmark_2();
 static void benchmark_3();
 static void benchmark_4();
+static void benchmark_5();
 //Exception thread safety test
 #ifndef __NO_EXCEPTIONS
 static void exception_test();
@@ -154,10 +198,13 @@ static void exception_test();
 #ifdef WITH_PROCESSES
 void syscall_test_sleep();
 void process_test_process_ret();
+void process_test_usage();
+void process_test_shared_memory();
 void syscall_test_system();
 #ifdef WITH_FILESYSTEM
 void syscall_test_files();
 void process_test_file_concurrency();
+void process_test_elf_loader();
 void syscall_test_mpu_open();
 void syscall_test_mpu_read();
 void syscall_test_mpu_write();
@@ -240,6 +287,11 @@ int main()
                 test_25();
                 #endif //_MIOSIX_GCC_PATCH_MAJOR
                 test_26();
+                test_27();
+                test_28();
+                test_29();
+                test_30();
+                test_31();
                 #if defined(_ARCH_CORTEXM7_STM32F7) || defined(_ARCH_CORTEXM7_STM32H7)
                 testCacheAndDMA();
                 #endif //_ARCH_CORTEXM7_STM32F7/H7
@@ -256,6 +308,18 @@ int main()
                 fs_test_2();
                 fs_test_3();
                 fs_test_4();
+                fs_test_5();
+                fs_test_6();
+                fs_test_7();
+                fs_test_8();
+                fs_test_9();
+                fs_test_10();
+                fs_test_11();
+                fs_test_12();
+                fs_test_13();
+                fs_test_14();
+                fs_test_15();
+                fs_test_16();
                 #else //WITH_FILESYSTEM
                 iprintf("Error, filesystem support is disabled\n");
                 #endif //WITH_FILESYSTEM
@@ -276,6 +340,7 @@ int main()
                 benchmark_2();
                 benchmark_3();
                 benchmark_4();
+                benchmark_5();
 
                 ledOff();
                 Thread::sleep(500);//Ensure all threads are deleted.
@@ -284,7 +349,12 @@ int main()
                 #ifdef WITH_PROCESSES
                 ledOn();
                 process_test_process_ret();
+                process_test_usage();
+                process_test_shared_memory();
+                #ifdef WITH_FILESYSTEM
                 process_test_file_concurrency();
+                process_test_elf_loader();
+                #endif //WITH_FILESYSTEM
                 ledOff();
                 #else //#ifdef WITH_PROCESSES
                 iprintf("Error, process support is disabled\n");
@@ -451,6 +521,38 @@ void process_test_file_concurrency()
     pass();
 }
 
+void process_test_elf_loader()
+{
+    test_name("Loading processes from files");
+    FILE *f=fopen("/simple.elf","wb");
+    if(!f) fail("Unable to create file");
+    if(fwrite(testsuite_simple_elf,1,testsuite_simple_elf_len,f)!=
+        testsuite_simple_elf_len) fail("Unable to write file");
+    fclose(f);
+    ElfLoader& loader=ElfLoader::instance();
+    loader.invalidate();
+    unsigned int hits=loader.getHits();
+    unsigned int misses=loader.getMisses();
+    for(int i=0;i<2;i++)
+    {
+        intrusive_ref_ptr<ElfRamImage> ram;
+        if(loader.load(getFileDescriptorTable(),"/simple.elf",ram)!=0)
+            fail("load");
+        int ret=0;
+        pid_t p=Process::create(ElfProgram(ram));
+        Process::waitpid(p,&ret,0);
+        if(WEXITSTATUS(ret)!=42) fail("Wrong returned value");
+    }
+    if(loader.getMisses()!=misses+1 || loader.getHits()!=hits+1)
+        fail("Program cache");
+    intrusive_ref_ptr<ElfRamImage> ram;
+    if(loader.load(getFileDescriptorTable(),"/nonexistent.elf",ram)!=-ENOENT)
+        fail("Nonexistent file");
+    remove("/simple.elf");
+    loader.invalidate();
+    pass();
+}
+
 void process_test_process_ret()
 {
     test_name("Process return value");
@@ -463,6 +565,76 @@ void process_test_process_ret()
     pass();
 }
 
+static void *shm_t1(void *argv)
+{
+    ShmChannel c(argv,ProcessPool::blockSize);
+    for(unsigned int i=0;i<1000;i++)
+    {
+        unsigned int msg[8];
+        for(unsigned int j=0;j<i%8+1;j++) msg[j]=i+j;
+        while(c.send(msg,(i%8+1)*sizeof(unsigned int))==false) Thread::yield();
+    }
+    return 0;
+}
+
+void process_test_shared_memory()
+{
+    test_name("Shared memory");
+    SharedMemoryManager& m=SharedMemoryManager::instance();
+    intrusive_ref_ptr<SharedMemory> a,b;
+    if(m.open("/shm_test",100,0,a)!=-ENOENT) fail("open without O_CREAT");
+    if(m.open("/shm_test",100,O_CREAT,a)!=0) fail("create");
+    if(a->getSize()!=ProcessPool::blockSize) fail("size");
+    if(reinterpret_cast<unsigned int>(a->getBase()) & (a->getSize()-1))
+        fail("alignment");
+    if(m.open("/shm_test",0,O_CREAT | O_EXCL,b)!=-EEXIST) fail("O_EXCL");
+    if(m.open("/shm_test",a->getSize()+1,0,b)!=-EINVAL) fail("size check");
+    if(m.open("/shm_test",0,0,b)!=0 || a!=b) fail("open existing");
+    b.reset();
+    //Exchange messages through the shared memory
+    ShmChannel c(a->getBase(),a->getSize());
+    c.init();
+    if(c.valid()==false || c.empty()==false) fail("channel init");
+    Thread *t=Thread::create(shm_t1,STACK_SMALL,0,a->getBase(),Thread::JOINABLE);
+    for(unsigned int i=0;i<1000;i++)
+    {
+        unsigned int len;
+        const unsigned int *msg;
+        while((msg=reinterpret_cast<const unsigned int*>(c.beginRead(len)))==0)
+            Thread::yield();
+        if(len!=(i%8+1)*sizeof(unsigned int)) fail("channel length");
+        for(unsigned int j=0;j<i%8+1;j++) if(msg[j]!=i+j) fail("channel data");
+        c.commitRead();
+    }
+    t->join();
+    if(c.empty()==false) fail("channel not empty");
+    //Unlinking removes the name, but not the object while still referenced
+    if(m.unlink("/shm_test")!=0) fail("unlink");
+    if(m.open("/shm_test",0,0,b)!=-ENOENT) fail("open after unlink");
+    if(m.unlink("/shm_test")!=-ENOENT) fail("unlink twice");
+    if(c.valid()==false) fail("object freed while in use");
+    a.reset();
+    pass();
+}
+
+void process_test_usage()
+{
+    test_name("Process resource usage");
+    ElfProgram prog(reinterpret_cast<const unsigned int*>(testsuite_simple_elf),testsuite_simple_elf_len);
+    ProcessUsage before,after,usage;
+    if(Process::getUsage(0,before,true)!=0) fail("getUsage");
+    pid_t p=Process::create(prog);
+    int ret=0;
+    if(Process::waitpid(p,&ret,0,&usage)!=p) fail("waitpid");
+    //The process has at least called exit, and used its .data and stack
+    if(usage.syscalls<1) fail("syscall count");
+    if(usage.maxImageUsage==0) fail("image usage");
+    if(Process::getUsage(0,after,true)!=0) fail("getUsage");
+    if(after.syscalls!=before.syscalls+usage.syscalls) fail("child usage");
+    if(Process::getUsage(p,usage)!=-ESRCH) fail("getUsage after wait");
+    pass();
+}
+
 void syscall_test_mpu_open()
 {
     test_name("open and MPU");
@@ -2980,6 +3152,10 @@ tests:
 class Callback
 class EventQueue
 class FixedEventQueue
+class UniqueCallback
+class BoundedEventQueue
+class TimedEvent
+class EventDispatcher
 */
 
 int t20_v1;
@@ -3014,6 +3190,29 @@ private:
     int x;
 };
 
+/**
+ * A function object that can only be moved, for testing UniqueCallback
+ */
+class T20_c2
+{
+public:
+    T20_c2(int *p) : p(p) {}
+    T20_c2(T20_c2&& rhs) : p(rhs.p) { rhs.p=nullptr; }
+    T20_c2(const T20_c2&)=delete;
+    T20_c2& operator= (const T20_c2&)=delete;
+
+    void operator() () { if(p) *p+=1; else fail("Moved from"); }
+private:
+    int *p;
+};
+
+void t20_f4()
+{
+    Thread::sleep(20);
+}
+
+static EventDispatcher<2,4> t20_disp; //Worker threads are never terminated
+
 #ifndef __NO_EXCEPTIONS
 
 void thrower()
@@ -3056,6 +3255,11 @@ void t20_t2(void* arg)
     Thread::sleep(10);
     eq->post(thrower);
 }
+
+void t20_f3()
+{
+    if(++t20_v1>=5) throw 6;
+}
 #endif //__NO_EXCEPTIONS
 
 static void test_20()
@@ -3191,6 +3395,145 @@ static void test_20()
     if(feq.empty()==false || feq.size()!=0) fail("Empty EventQueue");
     #endif //__NO_EXCEPTIONS
     
+    //
+    // Testing TimedEvent
+    //
+    {
+        TimedEvent<> te;
+        if(te.isPending()) fail("Not pending");
+        t20_v1=0;
+        feq.postAt(te,t20_f1,getTick()+static_cast<long long>(TICK_FREQ*0.02));
+        if(te.isPending()==false) fail("Pending");
+        feq.runOne();
+        if(t20_v1!=0) fail("Too early");
+        Thread::sleep(30);
+        feq.runOne();
+        if(t20_v1!=1234) fail("Not called");
+        if(te.isPending()) fail("Not pending");
+        
+        feq.postAt(te,t20_f1,getTick()+static_cast<long long>(TICK_FREQ*0.01));
+        if(feq.cancel(te)==false || te.isPending()) fail("cancel");
+        if(feq.cancel(te)==true) fail("cancel");
+        t20_v1=0;
+        Thread::sleep(20);
+        feq.runOne();
+        if(t20_v1!=0) fail("Cancelled event called");
+        
+        #ifndef __NO_EXCEPTIONS
+        //run() must sleep until the periodic event is due, the event throws
+        //the fifth time it runs
+        const long long period=static_cast<long long>(TICK_FREQ*0.01);
+        long long t1=getTick();
+        feq.postPeriodic(te,t20_f3,period);
+        try {
+            feq.run();
+            fail("run() returned");
+        } catch(int i) {
+            if(i!=6) fail("Wrong");
+        }
+        long long t2=getTick();
+        if(t20_v1!=5 || t2-t1<5*period || t2-t1>5*period+2) fail("Periodic");
+        if(te.isPending()==false) fail("Pending");
+        #endif //__NO_EXCEPTIONS
+    } //Destroying te cancels it
+    
+    //
+    // Testing EventDispatcher
+    //
+    const Priority lanePriorities[]={Priority(1),Priority(2)};
+    if(t20_disp.start(lanePriorities)==false) fail("start");
+    t20_disp.resetStats(0);
+    t20_disp.resetStats(1);
+    t20_v1=0;
+    t20_disp.post(0,bind(t20_f2,2,3));
+    Thread::sleep(10);
+    if(t20_v1!=5) fail("Not called");
+    {
+        FastInterruptDisableLock dLock;
+        bool hppw=false;
+        if(t20_disp.IRQpost(1,t20_f1,&hppw)==false) fail("IRQpost");
+        if(hppw==false) fail("hppw");
+        //Lane 0 has a lower priority, hppw must not be reset to false
+        if(t20_disp.IRQpost(0,t20_f1,&hppw)==false) fail("IRQpost");
+        if(hppw==false) fail("hppw reset");
+    }
+    Thread::sleep(10);
+    if(t20_v1!=1234) fail("Not called");
+    //Fill lane 0 while it is busy, lane 1 must not be affected
+    t20_disp.post(0,t20_f4);
+    Thread::sleep(5);
+    for(int i=0;i<4;i++)
+        if(t20_disp.postNonBlocking(0,bind(t20_f2,i,0))==false)
+            fail("postNonBlocking");
+    if(t20_disp.postNonBlocking(0,t20_f1)==true) fail("Lane not full");
+    t20_disp.post(1,bind(t20_f2,10,10));
+    Thread::sleep(5);
+    if(t20_v1!=20) fail("Lane blocked");
+    Thread::sleep(30);
+    if(t20_v1!=3) fail("Not called");
+    EventLaneStats ls=t20_disp.getStats(0);
+    if(ls.posted!=7 || ls.dropped!=1 || ls.run!=7 || ls.depth!=0 ||
+       ls.maxDepth!=4) fail("Lane stats");
+    if(ls.maxLatency<static_cast<long long>(TICK_FREQ*0.01) ||
+       ls.totalLatency<ls.maxLatency) fail("Lane latency");
+    ls=t20_disp.getStats(1);
+    if(ls.posted!=2 || ls.dropped!=0 || ls.run!=2 || ls.depth!=0) 
+        fail("Lane stats");
+    
+    //
+    // Testing UniqueCallback
+    //
+    t20_v1=0;
+    T20_c2 c2(&t20_v1);
+    UniqueCallback<20> ucb(std::move(c2));
+    UniqueCallback<20> ucb2(std::move(ucb));
+    if(ucb || !ucb2) fail("UniqueCallback move");
+    ucb(); //Empty, does nothing
+    ucb2();
+    if(t20_v1!=1) fail("UniqueCallback");
+    
+    //
+    // Testing BoundedEventQueue
+    //
+    BoundedEventQueue<3> beq;
+    if(beq.empty()==false || beq.size()!=0) fail("Empty EventQueue");
+    
+    beq.runOne(); //This tests that runOne() does not block
+    if(beq.runAll()!=0) fail("runAll");
+    
+    t20_v1=0;
+    beq.post(T20_c2(&t20_v1)); //Move only callable
+    beq.post(t20_f1);
+    beq.post(bind(t20_f2,2,3));
+    if(beq.postNonBlocking(t20_f1)==true) fail("PostNonBlocking");
+    if(t20_v1!=0) fail("Too early");
+    if(beq.empty() || beq.size()!=3) fail("Not empty EventQueue");
+    beq.runOne();
+    if(t20_v1!=1) fail("Not called");
+    if(beq.size()!=2) fail("Not empty EventQueue");
+    if(beq.runAll()!=2) fail("runAll");
+    if(t20_v1!=5) fail("Not called");
+    if(beq.empty()==false || beq.size()!=0) fail("Empty EventQueue");
+    
+    //Empty callbacks are not posted
+    beq.post(UniqueCallback<20>());
+    if(beq.postNonBlocking(UniqueCallback<20>())==true) fail("Empty callback");
+    if(beq.empty()==false || beq.runAll()!=0) fail("Empty callback");
+    
+    //Check that the ring wraps around
+    for(int i=0;i<5;i++)
+    {
+        t20_v1=0;
+        if(beq.postNonBlocking(bind(t20_f2,i,1))==false) fail("PostNonBlocking");
+        if(beq.postNonBlocking(bind(t20_f2,i,2))==false) fail("PostNonBlocking");
+        if(beq.runAll()!=2 || t20_v1!=i+2) fail("runAll");
+    }
+    
+    //Events of a batch that filled the queue can post to it without blocking
+    for(int i=0;i<3;i++) beq.post([&beq]{ beq.post(t20_f1); });
+    if(beq.runAll()!=3 || beq.size()!=3) fail("post from runAll");
+    t20_v1=0;
+    if(beq.runAll()!=3 || t20_v1!=1234) fail("post from runAll");
     
     pass();
 }
@@ -4129,6 +4472,420 @@ static void test_26()
     pass();
 }
 
+//
+// Test 27
+//
+/*
+tests:
+ObjectPool
+Arena
+PoolAllocator
+ArenaAllocator
+*/
+
+struct T27Obj
+{
+    T27Obj(int a) : a(a) { t27count++; }
+    ~T27Obj() { t27count--; }
+    int a;
+    static int t27count;
+};
+
+int T27Obj::t27count=0;
+
+static ObjectPool<T27Obj,4> t27pool;
+
+static void test_27()
+{
+    test_name("ObjectPool and Arena");
+    //ObjectPool
+    T27Obj *objs[4];
+    for(int i=0;i<4;i++)
+    {
+        objs[i]=t27pool.construct(i);
+        if(objs[i]==nullptr || objs[i]->a!=i) fail("construct");
+        if(t27pool.contains(objs[i])==false) fail("contains");
+    }
+    if(T27Obj::t27count!=4 || t27pool.size()!=4) fail("count");
+    if(t27pool.construct(4)!=nullptr) fail("pool not full");
+    T27Obj *freed=objs[2];
+    t27pool.destroy(objs[2]);
+    if(T27Obj::t27count!=3 || t27pool.size()!=3) fail("destroy");
+    {
+        FastInterruptDisableLock dLock;
+        void *p=t27pool.IRQallocate();
+        if(p!=freed) fail("reuse");
+        if(t27pool.IRQallocate()!=nullptr) fail("pool not full (IRQ)");
+        t27pool.IRQdeallocate(p);
+    }
+    objs[2]=t27pool.construct(2);
+    for(int i=0;i<4;i++) t27pool.destroy(objs[i]);
+    if(T27Obj::t27count!=0 || t27pool.size()!=0) fail("destroy all");
+    int local;
+    if(t27pool.contains(&local)) fail("contains");
+    //Arena
+    StaticArena<64> arena;
+    char *c=reinterpret_cast<char*>(arena.allocate(1,1));
+    int *i=reinterpret_cast<int*>(arena.allocate(sizeof(int),alignof(int)));
+    if(c==nullptr || i==nullptr) fail("arena allocate");
+    if(reinterpret_cast<uintptr_t>(i) % alignof(int)) fail("arena align");
+    if(arena.contains(c)==false || arena.contains(i)==false) fail("contains");
+    if(arena.allocate(64)!=nullptr) fail("arena not full");
+    arena.reset();
+    if(arena.used()!=0 || arena.allocate(64)!=c) fail("arena reset");
+    arena.reset();
+    //PoolAllocator, list nodes beyond the pool size come from the heap
+    {
+        list<int,PoolAllocator<int,4> > l;
+        for(int j=0;j<10;j++) l.push_back(j);
+        int j=0;
+        for(auto it=l.begin();it!=l.end();++it) if(*it!=j++) fail("list");
+        l.remove(5);
+        if(l.size()!=9) fail("list remove");
+    }
+    //ArenaAllocator
+    {
+        ArenaAllocator<int> alloc(arena);
+        vector<int,ArenaAllocator<int> > v(alloc);
+        v.reserve(8);
+        if(arena.contains(v.data())==false) fail("vector in arena");
+        for(int j=0;j<100;j++) v.push_back(j); //Overflows to the heap
+        for(int j=0;j<100;j++) if(v[j]!=j) fail("vector");
+    }
+    pass();
+}
+
+//
+// Test 28
+//
+/*
+tests:
+HazardPointer
+intrusive_ref_ptr move and detach
+*/
+
+class T28Obj : public IntrusiveRefCounted
+{
+public:
+    T28Obj() : magic(0x28) { t28count++; }
+    virtual ~T28Obj() { magic=0; t28count--; }
+    int magic;
+    static int t28count;
+};
+
+int T28Obj::t28count=0;
+
+static intrusive_ref_ptr<T28Obj> t28shared;
+static volatile bool t28quit;
+
+/**
+ * Remove the object from t28shared, as a close() would do
+ */
+static void t28remove()
+{
+    intrusive_ref_ptr<T28Obj> old=atomic_exchange(&t28shared,
+            intrusive_ref_ptr<T28Obj>());
+    if(old && HazardPointer::transferOwnership(old.get())) old.detach();
+}
+
+static void *t28p1(void *argv)
+{
+    while(t28quit==false)
+    {
+        HazardPointer hp;
+        if(hp.valid()==false) fail("valid (2)");
+        T28Obj *p=hp.protect(t28shared);
+        if(p && p->magic!=0x28) fail("deleted while protected (2)");
+        Thread::yield();
+        if(hp.release()) intrusive_ref_ptr<T28Obj> drop(p,false);
+    }
+    return 0;
+}
+
+static void test_28()
+{
+    test_name("HazardPointer");
+    //intrusive_ref_ptr move and detach
+    {
+        intrusive_ref_ptr<T28Obj> a(new T28Obj);
+        intrusive_ref_ptr<T28Obj> b(move(a));
+        if(a || b.use_count()!=1) fail("move ctor");
+        a=move(b);
+        if(b || a.use_count()!=1) fail("move assign");
+        T28Obj *raw=a.detach();
+        if(a || T28Obj::t28count!=1) fail("detach");
+        intrusive_ref_ptr<T28Obj> c(raw,false);
+        if(c.use_count()!=1) fail("addRef");
+    }
+    if(T28Obj::t28count!=0) fail("leak (1)");
+    //Object not removed while protected
+    t28shared=intrusive_ref_ptr<T28Obj>(new T28Obj);
+    {
+        HazardPointer hp;
+        if(hp.valid()==false) fail("valid (1)");
+        T28Obj *p=hp.protect(t28shared);
+        if(p!=t28shared.get() || t28shared.use_count()!=1) fail("protect");
+        if(hp.release()) fail("release (1)");
+    }
+    //Object removed while protected by two hazard pointers, the reference is
+    //passed from the first to the second
+    {
+        HazardPointer hp1, hp2;
+        HazardPointer hp3;
+        if(hp3.valid()) fail("exhausted");
+        T28Obj *p1=hp1.protect(t28shared);
+        T28Obj *p2=hp2.protect(t28shared);
+        t28remove();
+        if(T28Obj::t28count!=1) fail("deleted while protected (1)");
+        if(hp1.release()) fail("release (2)");
+        if(T28Obj::t28count!=1) fail("transfer");
+        if(hp2.release()==false) fail("release (3)");
+        intrusive_ref_ptr<T28Obj> drop(p2,false);
+        if(p1!=p2) fail("protect");
+    }
+    if(T28Obj::t28count!=0) fail("leak (2)");
+    //Concurrent access
+    t28quit=false;
+    pthread_t t;
+    pthread_create(&t,0,t28p1,0);
+    for(int i=0;i<100;i++)
+    {
+        atomic_store(&t28shared,intrusive_ref_ptr<T28Obj>(new T28Obj));
+        Thread::yield();
+        t28remove();
+        Thread::yield();
+    }
+    t28quit=true;
+    pthread_join(t,0);
+    if(T28Obj::t28count!=0) fail("leak (3)");
+    pass();
+}
+
+//
+// Test 29
+//
+/*
+tests:
+thread safe initialization of function local static objects
+*/
+
+static int t29count=0;
+#ifndef __NO_EXCEPTIONS
+static bool t29throw;
+#endif //__NO_EXCEPTIONS
+
+class T29Obj
+{
+public:
+    T29Obj() : a(0)
+    {
+        t29count++;
+        #ifndef __NO_EXCEPTIONS
+        if(t29throw) { t29throw=false; throw 29; }
+        #endif //__NO_EXCEPTIONS
+        Thread::sleep(50); //Let other threads contend for the object
+        a=29;
+    }
+    int a;
+};
+
+static T29Obj& t29get()
+{
+    static T29Obj obj;
+    return obj;
+}
+
+static void *t29p1(void *argv)
+{
+    if(t29get().a!=29) fail("not initialized (1)");
+    return 0;
+}
+
+static void test_29()
+{
+    test_name("Static initialization");
+    #ifndef __NO_EXCEPTIONS
+    //Initialization aborted by an exception is retried
+    t29throw=true;
+    try {
+        t29get();
+        fail("exception not thrown");
+    } catch(int& e) {
+        if(e!=29) fail("wrong exception");
+    }
+    if(t29count!=1) fail("count (1)");
+    t29count=0;
+    #endif //__NO_EXCEPTIONS
+    //Threads with the same and higher priority wait for the object
+    Thread *t1=Thread::create(t29p1,STACK_SMALL,0,NULL,Thread::JOINABLE);
+    Thread::sleep(10);
+    Thread *t2=Thread::create(t29p1,STACK_SMALL,1,NULL,Thread::JOINABLE);
+    Thread *t3=Thread::create(t29p1,STACK_SMALL,0,NULL,Thread::JOINABLE);
+    if(t29get().a!=29) fail("not initialized (2)");
+    t1->join();
+    t2->join();
+    t3->join();
+    if(t29count!=1) fail("count (2)");
+    pass();
+}
+
+//
+// Test 30
+//
+/*
+tests:
+crc16
+crc32
+crc32c
+HardwareCrc (where available)
+*/
+
+static void test_30()
+{
+    test_name("CRC");
+    const char msg[]="123456789";
+    if(crc16(msg,9)!=0x29b1) fail("crc16");
+    if(crc32(msg,9)!=0xcbf43926) fail("crc32");
+    if(crc32c(msg,9)!=0xe3069283) fail("crc32c");
+    //Unaligned buffers and messages processed in two parts
+    unsigned char buf[64+3];
+    for(unsigned int i=0;i<sizeof(buf);i++) buf[i]=i*37+11;
+    for(int off=0;off<4;off++)
+    {
+        const unsigned char *m=buf+off;
+        unsigned short c16=crc16(m,64);
+        unsigned int c32=crc32(m,64);
+        unsigned int c32c=crc32c(m,64);
+        for(int i=0;i<=64;i+=7)
+        {
+            if(crc16(m+i,64-i,crc16(m,i))!=c16) fail("crc16 split");
+            if(crc32(m+i,64-i,crc32(m,i))!=c32) fail("crc32 split");
+            if(crc32c(m+i,64-i,crc32c(m,i))!=c32c) fail("crc32c split");
+        }
+        #ifdef WITH_HARDWARE_CRC_TEST
+        HardwareCrc& hw=HardwareCrc::instance();
+        if(hw.crc16(m,64)!=c16) fail("hardware crc16");
+        if(hw.crc32(m,64)!=c32) fail("hardware crc32");
+        if(hw.crc32c(m,64)!=c32c) fail("hardware crc32c");
+        if(hw.crc32(m+5,59,crc32(m,5))!=c32) fail("hardware crc32 split");
+        #endif //WITH_HARDWARE_CRC_TEST
+    }
+    pass();
+}
+
+//
+// Test 31
+//
+/*
+tests:
+malloc/calloc/realloc/free correctness, including the small object heap
+reallocf/reallocarray/malloc_usable_size
+*/
+
+static void t31_fill(void *p, unsigned int size, unsigned char seed)
+{
+    unsigned char *c=reinterpret_cast<unsigned char*>(p);
+    for(unsigned int i=0;i<size;i++) c[i]=seed+i;
+}
+
+static bool t31_check(void *p, unsigned int size, unsigned char seed)
+{
+    unsigned char *c=reinterpret_cast<unsigned char*>(p);
+    for(unsigned int i=0;i<size;i++) if(c[i]!=static_cast<unsigned char>(seed+i))
+        return false;
+    return true;
+}
+
+static void test_31()
+{
+    test_name("Heap correctness");
+    free(nullptr); //Must do nothing
+    //Mixed sizes, both below and above the small object limit, freed out of
+    //order so that freed blocks get reused by objects of a different size
+    const int numSlots=32;
+    void *slots[numSlots];
+    unsigned int sizes[numSlots];
+    unsigned int size=1;
+    for(int i=0;i<numSlots;i++)
+    {
+        size=(size*7+5) % 300 + 1;
+        sizes[i]=size;
+        slots[i]=malloc(size);
+        if(slots[i]==nullptr) fail("malloc");
+        if(malloc_usable_size(slots[i])<size) fail("malloc_usable_size");
+        t31_fill(slots[i],size,i);
+    }
+    for(int i=0;i<numSlots;i++)
+        if(t31_check(slots[i],sizes[i],i)==false) fail("heap corrupted (1)");
+    for(int i=0;i<numSlots;i+=2) free(slots[i]);
+    for(int i=0;i<numSlots;i+=2)
+    {
+        sizes[i]=sizes[numSlots-1-i];
+        slots[i]=malloc(sizes[i]);
+        if(slots[i]==nullptr) fail("malloc");
+        t31_fill(slots[i],sizes[i],i);
+    }
+    for(int i=0;i<numSlots;i++)
+        if(t31_check(slots[i],sizes[i],i)==false) fail("heap corrupted (2)");
+    for(int i=0;i<numSlots;i++) free(slots[i]);
+    //calloc has to zero memory even when reusing freed blocks that were dirty
+    for(unsigned int s : {8u,24u,100u,128u,129u,512u})
+    {
+        void *dirty=malloc(s);
+        if(dirty==nullptr) fail("malloc");
+        memset(dirty,0xff,s);
+        free(dirty);
+        unsigned char *z=reinterpret_cast<unsigned char*>(calloc(s,1));
+        if(z==nullptr) fail("calloc");
+        for(unsigned int i=0;i<s;i++) if(z[i]!=0) fail("calloc not zeroed");
+        free(z);
+    }
+    //realloc crossing the small/large object boundary in both directions
+    void *p=malloc(40);
+    if(p==nullptr) fail("malloc");
+    t31_fill(p,40,3);
+    p=realloc(p,600);
+    if(p==nullptr) fail("realloc small to large");
+    if(t31_check(p,40,3)==false) fail("realloc small to large content");
+    t31_fill(p,600,5);
+    p=realloc(p,20);
+    if(p==nullptr) fail("realloc large to small");
+    if(t31_check(p,20,5)==false) fail("realloc large to small content");
+    p=realloc(p,100);
+    if(p==nullptr) fail("realloc small to small");
+    if(t31_check(p,20,5)==false) fail("realloc small to small content");
+    free(p);
+    p=realloc(nullptr,16); //Same as malloc
+    if(p==nullptr) fail("realloc(nullptr)");
+    free(p);
+    //reallocf and reallocarray accept small object heap pointers
+    p=malloc(16);
+    if(p==nullptr) fail("malloc");
+    t31_fill(p,16,7);
+    p=reallocf(p,256);
+    if(p==nullptr) fail("reallocf");
+    if(t31_check(p,16,7)==false) fail("reallocf content");
+    p=reallocarray(p,4,8);
+    if(p==nullptr) fail("reallocarray");
+    if(t31_check(p,16,7)==false) fail("reallocarray content");
+    if(reallocarray(p,0x10000,0x10000)!=nullptr) fail("reallocarray overflow");
+    if(t31_check(p,16,7)==false) fail("reallocarray overflow content");
+    free(p);
+    if(malloc_usable_size(nullptr)!=0) fail("malloc_usable_size(nullptr)");
+    #ifdef WITH_SMALL_HEAP
+    //Small sizes must actually come from the small object heap
+    p=malloc(SmallHeap::maxSize);
+    if(p==nullptr) fail("malloc");
+    if(SmallHeap::objectSize(p)<SmallHeap::maxSize) fail("objectSize");
+    free(p);
+    p=malloc(SmallHeap::maxSize+1);
+    if(p==nullptr) fail("malloc");
+    if(SmallHeap::objectSize(p)!=0) fail("objectSize (large)");
+    free(p);
+    #endif //WITH_SMALL_HEAP
+    pass();
+}
+
 #if defined(_ARCH_CORTEXM7_STM32F7) || defined(_ARCH_CORTEXM7_STM32H7)
 static Thread *waiting=nullptr; /// Thread waiting on DMA completion IRQ
 
@@ -4815,6 +5572,936 @@ static void fs_test_4()
     checkInodes("/sd/testdir",testdirIno,sdInode,sdDevice,sdDevice);
     pass();
 }
+
+//
+// Filesystem test 5
+//
+/*
+tests:
+fsync()
+file size visible to stat() only after the file is synced
+write-behind flusher thread (if enabled)
+*/
+
+static void fs_test_5()
+{
+    test_name("fsync and write-behind");
+    const char name[]="/sd/testdir/wbehind.txt";
+    int fd=open(name,O_WRONLY|O_CREAT|O_TRUNC,0644);
+    if(fd<0) fail("open");
+    const char data[]="0123456789";
+    const int size=sizeof(data)-1;
+    if(write(fd,data,size)!=size) fail("write");
+    if(fsync(fd)!=0) fail("fsync");
+    struct stat st;
+    if(stat(name,&st)!=0 || st.st_size!=size) fail("size after fsync");
+    #ifdef WITH_WRITE_BEHIND
+    //Not synced yet, the directory entry still holds the old size
+    if(write(fd,data,size)!=size) fail("write");
+    if(stat(name,&st)!=0 || st.st_size!=size) fail("size before flush");
+    Thread::sleep(WRITE_BEHIND_DELAY+100);
+    if(stat(name,&st)!=0 || st.st_size!=2*size) fail("size after flush");
+    #endif //WITH_WRITE_BEHIND
+    if(close(fd)!=0) fail("close");
+    if(unlink(name)!=0) fail("unlink");
+    pass();
+}
+
+//
+// Filesystem test 6
+//
+/*
+tests:
+TmpFs
+*/
+
+static void fs_test_6()
+{
+    test_name("TmpFs");
+    const unsigned int size=4*TmpFs::blockSize;
+    intrusive_ref_ptr<TmpFs> tmpfs(new TmpFs(size));
+    if(mkdir("/tmpfs",0755)!=0) fail("mkdir");
+    if(FilesystemManager::instance().kmount("/tmpfs",tmpfs)!=0) fail("kmount");
+    if(mkdir("/tmpfs/dir",0755)!=0) fail("mkdir dir");
+    int fd=open("/tmpfs/dir/a",O_RDWR|O_CREAT,0644);
+    if(fd<0) fail("open");
+    const char data[]="0123456789";
+    const int len=sizeof(data)-1;
+    if(write(fd,data,len)!=len) fail("write");
+    //Seek past the end of file, the gap must read as zeros
+    if(lseek(fd,2*len,SEEK_SET)!=2*len) fail("lseek");
+    if(write(fd,data,len)!=len) fail("write");
+    if(rename("/tmpfs/dir/a","/tmpfs/b")!=0) fail("rename");
+    struct stat st;
+    if(stat("/tmpfs/b",&st)!=0 || st.st_size!=3*len) fail("stat");
+    if(stat("/tmpfs/dir/a",&st)==0) fail("stat after rename");
+    //Unlink while open, the content must remain accessible
+    if(unlink("/tmpfs/b")!=0) fail("unlink");
+    char buf[3*len];
+    if(lseek(fd,0,SEEK_SET)!=0) fail("lseek");
+    if(read(fd,buf,sizeof(buf))!=sizeof(buf)) fail("read");
+    if(memcmp(buf,data,len) || memcmp(buf+2*len,data,len)) fail("data");
+    for(int i=len;i<2*len;i++) if(buf[i]!=0) fail("gap");
+    if(tmpfs->getFreeSpace()==size) fail("freed while open");
+    if(close(fd)!=0) fail("close");
+    if(tmpfs->getFreeSpace()!=size) fail("not freed on close");
+    //Filling the filesystem must result in a short write, then ENOSPC
+    fd=open("/tmpfs/dir/c",O_WRONLY|O_CREAT,0644);
+    if(fd<0) fail("open");
+    char *big=new char[2*size];
+    memset(big,0,2*size);
+    if(write(fd,big,2*size)!=size) fail("short write");
+    if(write(fd,big,1)!=-1 || errno!=ENOSPC) fail("ENOSPC");
+    delete[] big;
+    if(close(fd)!=0) fail("close");
+    if(rmdir("/tmpfs/dir")==0) fail("rmdir not empty");
+    DIR *d=opendir("/tmpfs/dir");
+    if(d==NULL) fail("opendir");
+    int entries=0;
+    while(struct dirent *de=readdir(d))
+    {
+        entries++;
+        if(strcmp(de->d_name,".") && strcmp(de->d_name,"..")
+            && strcmp(de->d_name,"c")) fail("readdir");
+    }
+    if(entries!=3) fail("entry count");
+    closedir(d);
+    if(unlink("/tmpfs/dir/c")!=0) fail("unlink");
+    if(rmdir("/tmpfs/dir")!=0) fail("rmdir");
+    if(FilesystemManager::instance().umount("/tmpfs")!=0) fail("umount");
+    if(rmdir("/tmpfs")!=0) fail("rmdir mountpoint");
+    pass();
+}
+
+//
+// Filesystem test 7
+//
+/*
+tests:
+RomFs
+*/
+
+static void fs_test_7()
+{
+    test_name("RomFs");
+    intrusive_ref_ptr<RomFs> romfs(new RomFs(romfsImage));
+    if(romfs->mountFailed()) fail("mount");
+    if(mkdir("/romfs",0755)!=0) fail("mkdir");
+    if(FilesystemManager::instance().kmount("/romfs",romfs)!=0) fail("kmount");
+    FILE *f=fopen("/romfs/hello.txt","r");
+    if(f==NULL) fail("fopen");
+    char line[32];
+    if(fgets(line,sizeof(line),f)==NULL || strcmp(line,"Hello, RomFs\n"))
+        fail("content");
+    fclose(f);
+    struct stat st;
+    if(stat("/romfs/dir",&st)!=0 || !S_ISDIR(st.st_mode)) fail("stat dir");
+    if(stat("/romfs/dir/data.bin",&st)!=0 || st.st_size!=16) fail("stat");
+    if(stat("/romfs/dir/missing",&st)==0) fail("stat missing");
+    int fd=open("/romfs/dir/data.bin",O_RDONLY);
+    if(fd<0) fail("open");
+    //The content must be accessible in place in the image
+    const unsigned char *ptr=0;
+    if(ioctl(fd,IOCTL_GET_XIP_POINTER,&ptr)!=0) fail("ioctl");
+    if(ptr<romfsImage || ptr>=romfsImage+sizeof(romfsImage)) fail("pointer");
+    for(int i=0;i<16;i++) if(ptr[i]!=i) fail("xip content");
+    if(close(fd)!=0) fail("close");
+    if(open("/romfs/hello.txt",O_WRONLY)>=0 || errno!=EROFS) fail("EROFS");
+    if(unlink("/romfs/hello.txt")==0) fail("unlink");
+    if(FilesystemManager::instance().umount("/romfs")!=0) fail("umount");
+    if(rmdir("/romfs")!=0) fail("rmdir mountpoint");
+    pass();
+}
+
+//
+// Filesystem test 8
+//
+/*
+tests:
+FilesystemManager path lookup cache invalidation
+*/
+
+static void fs_test_8()
+{
+    test_name("Dentry cache");
+    const char name[]="/sd/testdir/dcache.txt";
+    const char upper[]="/sd/testdir/DCACHE.TXT";
+    const char renamed[]="/sd/testdir/dcache2.txt";
+    struct stat st;
+    //Repeated lookups of a missing file, the second one hits the cache
+    for(int i=0;i<2;i++)
+    {
+        if(stat(name,&st)==0 || errno!=ENOENT) fail("stat missing");
+        if(stat(upper,&st)==0 || errno!=ENOENT) fail("stat missing");
+        if(open(name,O_RDONLY)>=0 || errno!=ENOENT) fail("open missing");
+    }
+    int fd=open(name,O_WRONLY|O_CREAT,0644);
+    if(fd<0) fail("open");
+    if(close(fd)!=0) fail("close");
+    if(stat(name,&st)!=0) fail("stat after create");
+    //Fat32 is case insensitive, this path now exists too
+    if(stat(upper,&st)!=0) fail("stat after create (case)");
+    if(stat(renamed,&st)==0) fail("stat missing");
+    if(rename(name,renamed)!=0) fail("rename");
+    if(stat(name,&st)==0) fail("stat after rename");
+    if(stat(renamed,&st)!=0) fail("stat renamed");
+    if(unlink(renamed)!=0) fail("unlink");
+    if(stat(renamed,&st)==0) fail("stat after unlink");
+    //Cached paths crossing a mountpoint must not survive umount
+    if(mkdir("/sd/testdir/dcache",0755)!=0) fail("mkdir");
+    intrusive_ref_ptr<TmpFs> tmpfs(new TmpFs(TmpFs::blockSize));
+    if(FilesystemManager::instance().kmount("/sd/testdir/dcache",tmpfs)!=0)
+        fail("kmount");
+    fd=open("/sd/testdir/dcache/a",O_WRONLY|O_CREAT,0644);
+    if(fd<0) fail("open");
+    if(close(fd)!=0) fail("close");
+    if(stat("/sd/testdir/dcache/a",&st)!=0) fail("stat");
+    if(FilesystemManager::instance().umount("/sd/testdir/dcache")!=0)
+        fail("umount");
+    if(stat("/sd/testdir/dcache/a",&st)==0) fail("stat after umount");
+    if(rmdir("/sd/testdir/dcache")!=0) fail("rmdir");
+    pass();
+}
+
+//
+// Filesystem test 9
+//
+/*
+tests:
+file descriptor table growing up to MAX_OPEN_FILES
+*/
+
+static void fs_test_9()
+{
+    test_name("File descriptor table");
+    int fds[MAX_OPEN_FILES];
+    int count=0;
+    for(;;)
+    {
+        int fd=open("/dev/null",O_RDWR);
+        if(fd<0) break;
+        if(count>=MAX_OPEN_FILES || fd>=MAX_OPEN_FILES) fail("fd range");
+        fds[count++]=fd;
+    }
+    if(errno!=ENFILE) fail("errno");
+    //Files opened by other tests may still be open, but not that many
+    if(count<MAX_OPEN_FILES-8) fail("too few files");
+    //Entries in all chunks must be usable
+    for(int i=0;i<count;i++)
+        if(write(fds[i],"x",1)!=1) fail("write");
+    //Closed descriptors are reused
+    if(close(fds[count-1])!=0) fail("close");
+    if(open("/dev/null",O_RDWR)!=fds[count-1]) fail("reuse");
+    for(int i=0;i<count;i++) if(close(fds[i])!=0) fail("close");
+    if(close(fds[count-1])==0) fail("double close");
+    pass();
+}
+
+//
+// Filesystem test 10
+//
+/*
+tests:
+poll()
+*/
+
+#ifdef WITH_DEVFS
+/**
+ * A device that becomes readable only when setReady() is called
+ */
+class PollTestDevice : public Device
+{
+public:
+    PollTestDevice() : Device(Device::STREAM), ready(false) {}
+
+    int poll(int events, PollEntry *entry)
+    {
+        FastInterruptDisableLock dLock;
+        if(ready) return events & POLLIN;
+        if(entry) queue.IRQadd(entry);
+        return 0;
+    }
+
+    void setReady()
+    {
+        {
+            FastInterruptDisableLock dLock;
+            ready=true;
+        }
+        queue.wakeup();
+    }
+
+private:
+    PollQueue queue;
+    bool ready;
+};
+
+static void fs_t10_p1(void *argv)
+{
+    Thread::sleep(50);
+    reinterpret_cast<PollTestDevice*>(argv)->setReady();
+}
+#endif //WITH_DEVFS
+
+static void fs_test_10()
+{
+    test_name("poll");
+    int fd=open("/dev/null",O_RDWR);
+    if(fd<0) fail("open");
+    pollfd fds[3];
+    fds[0].fd=fd;
+    fds[0].events=POLLIN | POLLOUT;
+    fds[1].fd=-1; //Negative fds are ignored
+    fds[1].events=POLLIN;
+    fds[2].fd=open("/dev/null",O_RDWR);
+    fds[2].events=POLLIN;
+    if(fds[2].fd<0 || close(fds[2].fd)!=0) fail("close"); //Closed fd
+    if(poll(fds,3,-1)!=2) fail("poll 1");
+    if(fds[0].revents!=(POLLIN | POLLOUT)) fail("revents 1");
+    if(fds[1].revents!=0) fail("revents 2");
+    if(fds[2].revents!=POLLNVAL) fail("revents 3");
+    if(close(fd)!=0) fail("close");
+    #ifdef WITH_DEVFS
+    intrusive_ref_ptr<PollTestDevice> dev(new PollTestDevice);
+    intrusive_ref_ptr<DevFs> devfs=FilesystemManager::instance().getDevFs();
+    if(!devfs || devfs->addDevice("polltest",dev)==false) fail("addDevice");
+    fd=open("/dev/polltest",O_RDONLY);
+    if(fd<0) fail("open");
+    fds[0].fd=fd;
+    fds[0].events=POLLIN;
+    if(poll(fds,1,0)!=0 || fds[0].revents!=0) fail("poll 2");
+    long long start=getTick();
+    if(poll(fds,1,20)!=0 || fds[0].revents!=0) fail("poll 3");
+    if(getTick()-start<20*TICK_FREQ/1000) fail("timeout too short");
+    Thread *t=Thread::create(fs_t10_p1,STACK_SMALL,0,dev.get(),Thread::JOINABLE);
+    if(poll(fds,1,-1)!=1 || fds[0].revents!=POLLIN) fail("poll 4");
+    t->join();
+    if(close(fd)!=0) fail("close");
+    if(devfs->remove("polltest")==false) fail("remove");
+    #endif //WITH_DEVFS
+    pass();
+}
+
+//
+// Filesystem test 11
+//
+/*
+tests:
+pipe()
+mkfifo()
+splice()
+*/
+
+static void fs_t11_p1(void *argv)
+{
+    int fd=reinterpret_cast<int>(argv);
+    char buffer[64];
+    for(unsigned int i=0;i<sizeof(buffer);i++) buffer[i]=i;
+    //Write more than the pipe buffer, so that the writer has to block
+    for(unsigned int i=0;i<4*PIPE_BUFFER_SIZE/sizeof(buffer);i++)
+        if(write(fd,buffer,sizeof(buffer))!=sizeof(buffer)) fail("write");
+    if(close(fd)!=0) fail("close");
+}
+
+static void fs_test_11()
+{
+    test_name("Pipes");
+    int fds[2];
+    if(pipe(fds)!=0) fail("pipe");
+    struct stat st;
+    if(fstat(fds[0],&st)!=0 || !S_ISFIFO(st.st_mode)) fail("fstat");
+    if(lseek(fds[0],0,SEEK_SET)>=0 || errno!=ESPIPE) fail("lseek");
+    if(write(fds[0],"x",1)>=0) fail("write to read end");
+    const char data[]="0123456789";
+    if(write(fds[1],data,sizeof(data))!=sizeof(data)) fail("write");
+    pollfd pfd;
+    pfd.fd=fds[0];
+    pfd.events=POLLIN;
+    if(poll(&pfd,1,0)!=1 || pfd.revents!=POLLIN) fail("poll");
+    char buffer[64];
+    if(read(fds[0],buffer,sizeof(buffer))!=sizeof(data)) fail("read");
+    if(memcmp(buffer,data,sizeof(data))) fail("read data");
+    if(poll(&pfd,1,0)!=0) fail("poll empty");
+    //Reading while a writer thread blocks on a full pipe
+    Thread *t=Thread::create(fs_t11_p1,STACK_SMALL,0,
+        reinterpret_cast<void*>(fds[1]),Thread::JOINABLE);
+    unsigned int total=0;
+    for(;;)
+    {
+        ssize_t r=read(fds[0],buffer,sizeof(buffer)/2);
+        if(r<0) fail("read");
+        if(r==0) break; //End of file, writer closed its end
+        for(ssize_t i=0;i<r;i++)
+            if(buffer[i]!=static_cast<char>((total+i)%sizeof(buffer)))
+                fail("data");
+        total+=r;
+    }
+    t->join();
+    if(total!=4*PIPE_BUFFER_SIZE) fail("total");
+    if(poll(&pfd,1,0)!=1 || (pfd.revents & POLLHUP)==0) fail("poll hup");
+    if(close(fds[0])!=0) fail("close");
+    //Writing with no readers
+    if(pipe(fds)!=0) fail("pipe");
+    if(close(fds[0])!=0) fail("close");
+    if(write(fds[1],data,sizeof(data))>=0 || errno!=EPIPE) fail("EPIPE");
+    if(close(fds[1])!=0) fail("close");
+    //FIFOs and splice() to and from a file
+    intrusive_ref_ptr<TmpFs> tmpfs(new TmpFs(4*TmpFs::blockSize));
+    if(mkdir("/pipefs",0755)!=0) fail("mkdir");
+    if(FilesystemManager::instance().kmount("/pipefs",tmpfs)!=0) fail("kmount");
+    if(mkfifo("/pipefs/fifo",0600)!=0) fail("mkfifo");
+    if(mkfifo("/pipefs/fifo",0600)==0 || errno!=EEXIST) fail("EEXIST");
+    if(stat("/pipefs/fifo",&st)!=0 || !S_ISFIFO(st.st_mode)) fail("stat");
+    fds[0]=open("/pipefs/fifo",O_RDONLY);
+    fds[1]=open("/pipefs/fifo",O_WRONLY);
+    if(fds[0]<0 || fds[1]<0) fail("open fifo");
+    int fd=open("/pipefs/file",O_RDWR|O_CREAT,0644);
+    if(fd<0) fail("open");
+    if(write(fds[1],data,sizeof(data))!=sizeof(data)) fail("write");
+    if(splice(fds[0],fd,sizeof(buffer))!=sizeof(data)) fail("splice out");
+    if(splice(fd,fd,1)>=0 || errno!=EINVAL) fail("splice no pipe");
+    if(splice(fds[0],fds[1],1)>=0 || errno!=EINVAL) fail("splice same pipe");
+    if(lseek(fd,0,SEEK_SET)!=0) fail("lseek");
+    if(splice(fd,fds[1],sizeof(buffer))!=sizeof(data)) fail("splice in");
+    if(read(fds[0],buffer,sizeof(buffer))!=sizeof(data)) fail("read");
+    if(memcmp(buffer,data,sizeof(data))) fail("splice data");
+    if(close(fd)!=0 || close(fds[0])!=0 || close(fds[1])!=0) fail("close");
+    if(unlink("/pipefs/fifo")!=0 || unlink("/pipefs/file")!=0) fail("unlink");
+    if(FilesystemManager::instance().umount("/pipefs")!=0) fail("umount");
+    if(rmdir("/pipefs")!=0) fail("rmdir mountpoint");
+    pass();
+}
+
+//
+// Filesystem test 12
+//
+/*
+tests:
+BlockCache write back, eviction and IOCTL_SYNC
+*/
+
+/**
+ * RAM disk that counts syncs and can be made to fail writes
+ */
+class Fs12RamDisk : public FileBase
+{
+public:
+    Fs12RamDisk() : FileBase(intrusive_ref_ptr<FilesystemBase>()),
+            seekPoint(0), syncs(0), failWrites(false)
+    {
+        memset(data,0,sizeof(data));
+    }
+
+    virtual ssize_t write(const void *d, size_t len)
+    {
+        if(failWrites) return -EIO;
+        if(seekPoint+len>sizeof(data)) return -ENOSPC;
+        memcpy(data+seekPoint,d,len);
+        seekPoint+=len;
+        return len;
+    }
+
+    virtual ssize_t read(void *d, size_t len)
+    {
+        if(seekPoint+len>sizeof(data)) return -EIO;
+        memcpy(d,data+seekPoint,len);
+        seekPoint+=len;
+        return len;
+    }
+
+    virtual off_t lseek(off_t pos, int whence)
+    {
+        if(whence!=SEEK_SET || pos<0 || pos>=static_cast<off_t>(sizeof(data)))
+            return -EINVAL;
+        return seekPoint=pos;
+    }
+
+    virtual int fstat(struct stat *pstat) const
+    {
+        memset(pstat,0,sizeof(struct stat));
+        pstat->st_size=sizeof(data);
+        return 0;
+    }
+
+    virtual int ioctl(int cmd, void *arg)
+    {
+        if(cmd!=IOCTL_SYNC) return -1;
+        syncs++;
+        return 0;
+    }
+
+    static const unsigned int numBlocks=8;
+    unsigned char data[numBlocks*BlockCache::blockSize];
+    unsigned int seekPoint;
+    int syncs;
+    bool failWrites;
+};
+
+static void fs_t12_fill(unsigned char *buffer, unsigned char value)
+{
+    memset(buffer,value,BlockCache::blockSize);
+}
+
+static bool fs_t12_check(const unsigned char *buffer, unsigned char value)
+{
+    for(unsigned int i=0;i<BlockCache::blockSize;i++)
+        if(buffer[i]!=value) return false;
+    return true;
+}
+
+static void fs_test_12()
+{
+    test_name("Block cache");
+    const int bs=BlockCache::blockSize;
+    Fs12RamDisk *disk=new Fs12RamDisk;
+    intrusive_ref_ptr<FileBase> diskRef(disk);
+    intrusive_ref_ptr<BlockCache> cache(new BlockCache(diskRef,2));
+    unsigned char buffer[4*bs];
+    //Unaligned accesses are rejected
+    if(cache->lseek(1,SEEK_SET)!=1) fail("lseek");
+    if(cache->write(buffer,bs)!=-EINVAL) fail("unaligned write");
+    if(cache->lseek(0,SEEK_SET)!=0) fail("lseek");
+    if(cache->read(buffer,bs/2)!=-EINVAL) fail("unaligned read");
+    //Single block writes stay in the cache
+    for(int i=0;i<2;i++)
+    {
+        fs_t12_fill(buffer,i+1);
+        if(cache->lseek(i*bs,SEEK_SET)!=i*bs) fail("lseek");
+        if(cache->write(buffer,bs)!=bs) fail("write");
+    }
+    if(cache->getDiskWrites()!=0) fail("write back too early");
+    if(!fs_t12_check(disk->data,0) || !fs_t12_check(disk->data+bs,0))
+        fail("disk modified");
+    //Reading block 0 makes block 1 the least recently used
+    if(cache->lseek(0,SEEK_SET)!=0) fail("lseek");
+    if(cache->read(buffer,bs)!=bs || !fs_t12_check(buffer,1)) fail("read");
+    if(cache->getHits()!=1) fail("hits");
+    //Writing a third block evicts block 1, which is written back
+    fs_t12_fill(buffer,3);
+    if(cache->lseek(2*bs,SEEK_SET)!=2*bs) fail("lseek");
+    if(cache->write(buffer,bs)!=bs) fail("write");
+    if(cache->getDiskWrites()!=1) fail("eviction");
+    if(!fs_t12_check(disk->data+bs,2)) fail("evicted block");
+    if(!fs_t12_check(disk->data,0) || !fs_t12_check(disk->data+2*bs,0))
+        fail("disk modified");
+    //Multi block reads see dirty cached blocks
+    if(cache->lseek(0,SEEK_SET)!=0) fail("lseek");
+    if(cache->read(buffer,4*bs)!=4*bs) fail("multi block read");
+    if(!fs_t12_check(buffer,1) || !fs_t12_check(buffer+bs,2) ||
+       !fs_t12_check(buffer+2*bs,3) || !fs_t12_check(buffer+3*bs,0))
+        fail("multi block read data");
+    //IOCTL_SYNC writes back everything and is forwarded to the device
+    if(cache->ioctl(IOCTL_SYNC,0)!=0) fail("sync");
+    if(disk->syncs!=1) fail("sync not forwarded");
+    if(!fs_t12_check(disk->data,1) || !fs_t12_check(disk->data+2*bs,3))
+        fail("data after sync");
+    //Multi block writes update cached copies
+    fs_t12_fill(buffer,4);
+    fs_t12_fill(buffer+bs,5);
+    if(cache->lseek(0,SEEK_SET)!=0) fail("lseek");
+    if(cache->write(buffer,2*bs)!=2*bs) fail("multi block write");
+    if(cache->lseek(0,SEEK_SET)!=0) fail("lseek");
+    if(cache->read(buffer,bs)!=bs || !fs_t12_check(buffer,4))
+        fail("stale cached block");
+    //A failed sync reports the error and keeps the data dirty
+    fs_t12_fill(buffer,6);
+    if(cache->lseek(0,SEEK_SET)!=0) fail("lseek");
+    if(cache->write(buffer,bs)!=bs) fail("write");
+    disk->failWrites=true;
+    if(cache->ioctl(IOCTL_SYNC,0)!=-1) fail("sync error");
+    if(disk->syncs!=1) fail("sync forwarded after error");
+    disk->failWrites=false;
+    if(cache->ioctl(IOCTL_SYNC,0)!=0) fail("sync retry");
+    if(!fs_t12_check(disk->data,6)) fail("data after retry");
+    pass();
+}
+
+//
+// Filesystem test 13
+//
+/*
+tests:
+ftruncate() and posix_fallocate() growing and shrinking files, on Fat32 and
+TmpFs
+*/
+
+/**
+ * Check the file content, the first dataSize bytes must be the test pattern
+ * and the rest zeros
+ */
+static void fs_t13_verify(int fd, int size, int dataSize)
+{
+    struct stat st;
+    if(fstat(fd,&st)!=0 || st.st_size!=size) fail("size");
+    if(lseek(fd,0,SEEK_SET)!=0) fail("lseek");
+    char buffer[512];
+    for(int i=0;i<size;)
+    {
+        int r=read(fd,buffer,sizeof(buffer));
+        if(r<=0) fail("read");
+        for(int j=0;j<r;j++,i++)
+        {
+            char expected=i<dataSize ? 'a'+i%26 : 0;
+            if(buffer[j]!=expected) fail("data");
+        }
+    }
+    if(read(fd,buffer,sizeof(buffer))!=0) fail("read past end");
+}
+
+static void fs_t13_run(const char *name, int maxSize)
+{
+    int fd=open(name,O_RDWR|O_CREAT|O_TRUNC,0644);
+    if(fd<0) fail("open");
+    const int len=1000;
+    char data[len];
+    for(int i=0;i<len;i++) data[i]='a'+i%26;
+    if(write(fd,data,len)!=len) fail("write");
+    //Grow, shrink and grow again, the truncated data must not reappear
+    if(ftruncate(fd,maxSize)!=0) fail("ftruncate grow");
+    fs_t13_verify(fd,maxSize,len);
+    if(ftruncate(fd,600)!=0) fail("ftruncate shrink");
+    fs_t13_verify(fd,600,600);
+    if(ftruncate(fd,3000)!=0) fail("ftruncate regrow");
+    fs_t13_verify(fd,3000,600);
+    if(ftruncate(fd,0)!=0) fail("ftruncate zero");
+    fs_t13_verify(fd,0,0);
+    if(ftruncate(fd,-1)==0 || errno!=EINVAL) fail("ftruncate EINVAL");
+    //posix_fallocate never shrinks, and extends with zeros
+    if(lseek(fd,0,SEEK_SET)!=0) fail("lseek");
+    if(write(fd,data,len)!=len) fail("write");
+    if(posix_fallocate(fd,0,100)!=0) fail("fallocate inside");
+    fs_t13_verify(fd,len,len);
+    if(posix_fallocate(fd,maxSize/2,maxSize/2)!=0) fail("fallocate");
+    fs_t13_verify(fd,maxSize,len);
+    if(posix_fallocate(fd,-1,100)!=EINVAL) fail("fallocate EINVAL");
+    if(posix_fallocate(fd,0,0)!=EINVAL) fail("fallocate EINVAL");
+    //Writing over the allocated area
+    for(int i=0;i<len;i++) data[i]='a'+(i+len)%26;
+    if(lseek(fd,len,SEEK_SET)!=len) fail("lseek");
+    if(write(fd,data,len)!=len) fail("write");
+    fs_t13_verify(fd,maxSize,2*len);
+    if(close(fd)!=0) fail("close");
+    //The size must be persistent
+    struct stat st;
+    if(stat(name,&st)!=0 || st.st_size!=maxSize) fail("stat");
+    fd=open(name,O_RDONLY);
+    if(fd<0) fail("open");
+    if(ftruncate(fd,0)==0) fail("ftruncate read only");
+    if(posix_fallocate(fd,0,maxSize+1)==0) fail("fallocate read only");
+    fs_t13_verify(fd,maxSize,2*len);
+    if(close(fd)!=0) fail("close");
+    if(unlink(name)!=0) fail("unlink");
+}
+
+static void fs_test_13()
+{
+    test_name("ftruncate and posix_fallocate");
+    //Large enough to span multiple clusters
+    fs_t13_run("/sd/testdir/truncate.dat",40000);
+    intrusive_ref_ptr<TmpFs> tmpfs(new TmpFs(32*TmpFs::blockSize));
+    if(mkdir("/truncfs",0755)!=0) fail("mkdir");
+    if(FilesystemManager::instance().kmount("/truncfs",tmpfs)!=0) fail("kmount");
+    fs_t13_run("/truncfs/truncate.dat",16*TmpFs::blockSize);
+    if(FilesystemManager::instance().umount("/truncfs")!=0) fail("umount");
+    if(rmdir("/truncfs")!=0) fail("rmdir mountpoint");
+    pass();
+}
+
+//
+// Filesystem test 14
+//
+/*
+tests:
+random seek in fragmented files, which uses the Fat32 cluster link map
+*/
+
+/**
+ * \return the expected content of the test file at the given offset
+ */
+static char fs_t14_byte(unsigned int offset, unsigned int file)
+{
+    unsigned int word=(offset/4)*2654435761u+file;
+    return word>>(8*(offset%4));
+}
+
+static void fs_t14_check(int fd, unsigned int offset, unsigned int len,
+        unsigned int file)
+{
+    char buffer[64];
+    if(lseek(fd,offset,SEEK_SET)!=static_cast<off_t>(offset)) fail("lseek");
+    if(read(fd,buffer,len)!=static_cast<ssize_t>(len)) fail("read");
+    for(unsigned int i=0;i<len;i++)
+        if(buffer[i]!=fs_t14_byte(offset+i,file)) fail("data");
+}
+
+static void fs_test_14()
+{
+    test_name("Seek in fragmented files");
+    iprintf("Please wait (long test)\n");
+    const char *names[]={"/sd/testdir/frag_1.dat","/sd/testdir/frag_2.dat"};
+    const int chunk=8192;
+    const int size=24*chunk;
+    int fds[2];
+    for(int i=0;i<2;i++)
+        if((fds[i]=open(names[i],O_RDWR|O_CREAT|O_TRUNC,0644))<0) fail("open");
+    //Writing the two files alternately interleaves their clusters
+    char *buffer=new char[chunk];
+    for(int offset=0;offset<size;offset+=chunk)
+    {
+        for(int i=0;i<2;i++)
+        {
+            for(int j=0;j<chunk;j++)
+                buffer[j]=fs_t14_byte(offset+j,i);
+            if(write(fds[i],buffer,chunk)!=chunk) fail("write");
+        }
+    }
+    delete[] buffer;
+    if(close(fds[1])!=0) fail("close");
+    //Random seeks, including across cluster boundaries
+    for(int i=0;i<1000;i++)
+    {
+        unsigned int len=1+rand()%64;
+        unsigned int offset=rand()%(size-len+1);
+        fs_t14_check(fds[0],offset,len,0);
+    }
+    fs_t14_check(fds[0],0,64,0);
+    fs_t14_check(fds[0],size-64,64,0);
+    if(lseek(fds[0],size,SEEK_SET)!=size) fail("lseek end");
+    if(lseek(fds[0],size+1,SEEK_SET)>=0) fail("lseek past end");
+    //Overwriting after seeking, then extending the file past the clusters
+    //covered by the link map
+    char data[64];
+    for(unsigned int i=0;i<sizeof(data);i++) data[i]=fs_t14_byte(i,2);
+    const int middle=size/2-sizeof(data)/2;
+    if(lseek(fds[0],middle,SEEK_SET)!=middle) fail("lseek");
+    if(write(fds[0],data,sizeof(data))!=sizeof(data)) fail("write middle");
+    if(lseek(fds[0],0,SEEK_END)!=size) fail("lseek");
+    if(write(fds[0],data,sizeof(data))!=sizeof(data)) fail("write end");
+    fs_t14_check(fds[0],middle-64,64,0);
+    fs_t14_check(fds[0],middle+sizeof(data),64,0);
+    for(int i=0;i<2;i++)
+    {
+        char buffer[sizeof(data)];
+        int offset=i==0 ? middle : size;
+        if(lseek(fds[0],offset,SEEK_SET)!=offset) fail("lseek");
+        if(read(fds[0],buffer,sizeof(buffer))!=sizeof(buffer)) fail("read");
+        if(memcmp(buffer,data,sizeof(data))) fail("written data");
+    }
+    if(close(fds[0])!=0) fail("close");
+    //The other file was not modified
+    if((fds[1]=open(names[1],O_RDONLY))<0) fail("open");
+    for(int i=0;i<200;i++)
+    {
+        unsigned int len=1+rand()%64;
+        unsigned int offset=rand()%(size-len+1);
+        fs_t14_check(fds[1],offset,len,1);
+    }
+    if(close(fds[1])!=0) fail("close");
+    for(int i=0;i<2;i++) if(unlink(names[i])!=0) fail("unlink");
+    pass();
+}
+
+//
+// Filesystem test 15
+//
+/*
+tests:
+O_DIRECT reads and writes on Fat32, and coherence with buffered access
+*/
+
+/**
+ * Read size bytes at offset, and compare them with the expected content
+ */
+static void fs_t15_check(int fd, const char *expected, int offset, int size,
+        int fileSize)
+{
+    char *buffer=new char[size];
+    if(lseek(fd,offset,SEEK_SET)!=offset) fail("lseek");
+    int result=read(fd,buffer,size);
+    int readSize=min(size,fileSize-offset);
+    if(result!=readSize) fail("read");
+    if(memcmp(buffer,expected+offset,readSize)) fail("data");
+    delete[] buffer;
+}
+
+static void fs_test_15()
+{
+    test_name("O_DIRECT");
+    #ifdef O_DIRECT
+    const char name[]="/sd/testdir/direct.dat";
+    const int sector=512;
+    const int maxSize=10*sector;
+    char *expected=new char[maxSize];
+    for(int i=0;i<maxSize;i++) expected[i]=rand() & 0xff;
+    //Aligned direct writes, also extending the file
+    int fd=open(name,O_RDWR|O_CREAT|O_TRUNC|O_DIRECT,0644);
+    if(fd<0) fail("open");
+    if(write(fd,expected,8*sector)!=8*sector) fail("write");
+    int size=8*sector;
+    //Unaligned size or offset are rejected
+    if(write(fd,expected,100)!=-1 || errno!=EINVAL) fail("unaligned write");
+    if(lseek(fd,100,SEEK_SET)!=100) fail("lseek");
+    if(write(fd,expected,sector)!=-1 || errno!=EINVAL) fail("unaligned write");
+    if(read(fd,expected,sector)!=-1 || errno!=EINVAL) fail("unaligned read");
+    if(lseek(fd,0,SEEK_SET)!=0) fail("lseek");
+    if(read(fd,expected,100)!=-1 || errno!=EINVAL) fail("unaligned read");
+    //Aligned direct reads
+    fs_t15_check(fd,expected,0,size,size);
+    fs_t15_check(fd,expected,sector,2*sector,size);
+    if(close(fd)!=0) fail("close");
+    //Direct and buffered readers of the same file
+    fd=open(name,O_RDONLY|O_DIRECT);
+    int fd2=open(name,O_RDONLY);
+    if(fd<0 || fd2<0) fail("open");
+    fs_t15_check(fd2,expected,1000,100,size);
+    fs_t15_check(fd,expected,0,size,size);
+    fs_t15_check(fd2,expected,size-10,10,size);
+    if(close(fd)!=0 || close(fd2)!=0) fail("close");
+    //Direct access sees buffered writes, including a partial last sector
+    fd=open(name,O_RDWR);
+    if(fd<0) fail("open");
+    for(int i=1000;i<1100;i++) expected[i]^=0xff;
+    if(lseek(fd,1000,SEEK_SET)!=1000) fail("lseek");
+    if(write(fd,expected+1000,100)!=100) fail("write");
+    if(lseek(fd,0,SEEK_END)!=size) fail("lseek");
+    if(write(fd,expected+size,300)!=300) fail("write");
+    size+=300;
+    if(close(fd)!=0) fail("close");
+    fd=open(name,O_RDONLY|O_DIRECT);
+    if(fd<0) fail("open");
+    fs_t15_check(fd,expected,0,maxSize,size);
+    fs_t15_check(fd,expected,8*sector,sector,size);
+    if(close(fd)!=0) fail("close");
+    //Buffered access sees direct writes
+    fd=open(name,O_WRONLY|O_DIRECT);
+    if(fd<0) fail("open");
+    for(int i=sector;i<3*sector;i++) expected[i]^=0xff;
+    if(lseek(fd,sector,SEEK_SET)!=sector) fail("lseek");
+    if(write(fd,expected+sector,2*sector)!=2*sector) fail("write");
+    if(close(fd)!=0) fail("close");
+    fd=open(name,O_RDONLY);
+    if(fd<0) fail("open");
+    fs_t15_check(fd,expected,0,size,size);
+    fs_t15_check(fd,expected,sector-1,2*sector+2,size);
+    if(close(fd)!=0) fail("close");
+    if(unlink(name)!=0) fail("unlink");
+    delete[] expected;
+    #else //O_DIRECT
+    iprintf("Skipped, the C library does not define O_DIRECT\n");
+    #endif //O_DIRECT
+    pass();
+}
+
+//
+// Filesystem test 16
+//
+/*
+tests:
+concurrent reads and writes of different files on the same volume
+*/
+
+static const int fs_t16_numFiles=4;
+static const int fs_t16_size=16384;
+static const char *fs_t16_names[fs_t16_numFiles]=
+{
+    "/sd/testdir/conc_0.dat", "/sd/testdir/conc_1.dat",
+    "/sd/testdir/conc_2.dat", "/sd/testdir/conc_3.dat"
+};
+static volatile bool fs_t16_error;
+
+static unsigned char fs_t16_byte(int file, int pos)
+{
+    return file*37+pos*7+(pos>>8);
+}
+
+static bool fs_t16_check(int file)
+{
+    int fd=open(fs_t16_names[file],O_RDONLY);
+    if(fd<0) return false;
+    unsigned char buffer[300];
+    int pos=0;
+    bool ok=true;
+    //Odd sized reads, so that they straddle sector boundaries
+    while(ok && pos<fs_t16_size)
+    {
+        int size=min<int>(sizeof(buffer)-file,fs_t16_size-pos);
+        if(read(fd,buffer,size)!=size) ok=false;
+        for(int i=0;ok && i<size;i++)
+            if(buffer[i]!=fs_t16_byte(file,pos+i)) ok=false;
+        pos+=size;
+    }
+    if(ok && read(fd,buffer,1)!=0) ok=false;
+    if(close(fd)!=0) ok=false;
+    return ok;
+}
+
+static void fs_t16_p1(void *argv)
+{
+    int file=reinterpret_cast<int>(argv);
+    if(file & 1)
+    {
+        //Readers check a file written before the test
+        for(int i=0;i<4;i++) if(fs_t16_check(file)==false) fs_t16_error=true;
+        return;
+    }
+    //Writers write their file while the others are running
+    int fd=open(fs_t16_names[file],O_WRONLY|O_CREAT|O_TRUNC,0644);
+    if(fd<0)
+    {
+        fs_t16_error=true;
+        return;
+    }
+    unsigned char buffer[200];
+    int pos=0;
+    while(pos<fs_t16_size)
+    {
+        int size=min<int>(sizeof(buffer)-file,fs_t16_size-pos);
+        for(int i=0;i<size;i++) buffer[i]=fs_t16_byte(file,pos+i);
+        if(write(fd,buffer,size)!=size)
+        {
+            fs_t16_error=true;
+            break;
+        }
+        pos+=size;
+    }
+    if(close(fd)!=0) fs_t16_error=true;
+}
+
+static void fs_test_16()
+{
+    test_name("Concurrent file access");
+    iprintf("Please wait (long test)\n");
+    const int bufferSize=256;
+    unsigned char buffer[bufferSize];
+    for(int file=1;file<fs_t16_numFiles;file+=2)
+    {
+        int fd=open(fs_t16_names[file],O_WRONLY|O_CREAT|O_TRUNC,0644);
+        if(fd<0) fail("open");
+        for(int pos=0;pos<fs_t16_size;pos+=bufferSize)
+        {
+            for(int i=0;i<bufferSize;i++) buffer[i]=fs_t16_byte(file,pos+i);
+            if(write(fd,buffer,bufferSize)!=bufferSize) fail("write");
+        }
+        if(close(fd)!=0) fail("close");
+    }
+    fs_t16_error=false;
+    Thread *threads[fs_t16_numFiles];
+    for(int i=0;i<fs_t16_numFiles;i++)
+    {
+        threads[i]=Thread::create(fs_t16_p1,2048+512,1,
+            reinterpret_cast<void*>(i),Thread::JOINABLE);
+        if(threads[i]==0) fail("thread creation");
+    }
+    for(int i=0;i<fs_t16_numFiles;i++) threads[i]->join();
+    if(fs_t16_error) fail("concurrent access");
+    //Check what the writers wrote once they are done
+    for(int file=0;file<fs_t16_numFiles;file++)
+    {
+        if(fs_t16_check(file)==false) fail("data");
+        if(unlink(fs_t16_names[file])!=0) fail("unlink");
+    }
+    pass();
+}
 #endif //WITH_FILESYSTEM
 
 //
@@ -5157,6 +6844,58 @@ static void benchmark_4()
     iprintf("%d fast disable/enable interrupts pairs per second\n",i);
 }
 
+//
+// Benchmark 5
+//
+/*
+tests:
+malloc/free time, with the small object heap and with the C library allocator
+*/
+
+static int b5_run(bool smallHeap)
+{
+    //Objects have different sizes and lifetimes, like in real code
+    const int numSlots=16;
+    void *slots[numSlots]={0};
+    b4_end=false;
+    #ifndef SCHED_TYPE_EDF
+    Thread::create(b4_t1,STACK_SMALL);
+    #else
+    Thread::create(b4_t1,STACK_SMALL,0);
+    #endif
+    Thread::yield();
+    int i=0;
+    unsigned int size=1;
+    while(b4_end==false)
+    {
+        int slot=i % numSlots;
+        size=(size*5+3) % 128 + 1;
+        if(smallHeap)
+        {
+            free(slots[slot]);
+            slots[slot]=malloc(size);
+        } else {
+            _free_r(__getreent(),slots[slot]);
+            slots[slot]=_malloc_r(__getreent(),size);
+        }
+        if(slots[slot]==0) fail("out of memory");
+        i++;
+    }
+    for(int j=0;j<numSlots;j++)
+    {
+        if(smallHeap) free(slots[j]);
+        else _free_r(__getreent(),slots[j]);
+    }
+    return i;
+}
+
+static void benchmark_5()
+{
+    //Each iteration frees an object and allocates another one
+    iprintf("%d malloc/free pairs per second\n",b5_run(true));
+    iprintf("%d C library malloc/free pairs per second\n",b5_run(false));
+}
+
 #ifdef WITH_PROCESSES
 
 unsigned int* memAllocation(unsigned int size)
@@ -41,8 +41,8 @@ static const unsigned int cacheLine=32; //Cortex-M7 cache line size
  * - non-shareable
  * - readable/writable/executable only by privileged code (for compatibility
  *   with the way processes use the MPU)
- * \param region MPU region. Note that region 6 and 7 are used by processes, and
- * should be avoided here
+ * \param region MPU region. Note that regions 6 and 7 are used by processes,
+ * and region 5 for shared memory, so they should be avoided here
  * \param base base address, aligned to a 32Byte cache line
  * \param size size, must be at least 32 and a power of 2, or it is rounded to
  * the next power of 2
@@ -98,4 +98,17 @@ void markBufferAfterDmaRead(void *buffer, int size)
 }
 #endif
 
+#if defined(__ICACHE_PRESENT) && (__ICACHE_PRESENT==1)
+void markBufferAfterCodeWrite(void *buffer, int size)
+{
+    #if defined(__DCACHE_PRESENT) && (__DCACHE_PRESENT==1)
+    //With a write-through cache this only waits for the write buffer to
+    //drain, but it is required if the cache policy is ever changed
+    auto result=alignBuffer(buffer,size);
+    SCB_CleanDCache_by_Addr(result.first,result.second);
+    #endif
+    SCB_InvalidateICache();
+}
+#endif
+
 } //namespace miosix
@@ -148,6 +148,20 @@ void markBufferAfterDmaRead(void *buffer, int size);
 inline void markBufferAfterDmaRead(void *buffer, int size) {}
 #endif
 
+/**
+ * Call this function after the CPU has written code to a buffer, such as a
+ * program decompressed or loaded in RAM, before jumping to it. The data cache
+ * is cleaned, and the instruction cache is invalidated as it may still contain
+ * the code previously found at the same addresses.
+ * \param buffer buffer
+ * \param size buffer size
+ */
+#if defined(__ICACHE_PRESENT) && (__ICACHE_PRESENT==1)
+void markBufferAfterCodeWrite(void *buffer, int size);
+#else
+inline void markBufferAfterCodeWrite(void *buffer, int size) {}
+#endif
+
 } //namespace miosix
 
 #endif //CACHE_CORTEX_MX_H
@@ -46,6 +46,8 @@ unsigned int sizeToMpu(unsigned int size)
 // class MPUConfiguration
 //
 
+MPUConfiguration *MPUConfiguration::loaded=nullptr;
+
 MPUConfiguration::MPUConfiguration(unsigned int *elfBase, unsigned int elfSize,
         unsigned int *imageBase, unsigned int imageSize)
 {
@@ -67,17 +69,41 @@ MPUConfiguration::MPUConfiguration(unsigned int *elfBase, unsigned int elfSize,
                | MPU_RASR_C_Msk
                | 1 //Enable bit
                | sizeToMpu(imageSize)<<1;
+    clearSharedRegion();
+}
+
+void MPUConfiguration::setSharedRegion(unsigned int *base, unsigned int size)
+{
+    regValues[4]=(reinterpret_cast<unsigned int>(base) & (~0x1f))
+               | MPU_RBAR_VALID_Msk | 5; //Region 5
+    regValues[5]=3<<MPU_RASR_AP_Pos //Privileged: RW, unprivileged: RW
+               | MPU_RASR_XN_Msk
+               | MPU_RASR_C_Msk
+               | 1 //Enable bit
+               | sizeToMpu(size)<<1;
+    invalidate();
+}
+
+void MPUConfiguration::clearSharedRegion()
+{
+    //Region 5 has to be written anyway when switching to a process, as it may
+    //have been left enabled by the previous one
+    regValues[4]=MPU_RBAR_VALID_Msk | 5;
+    regValues[5]=0;
+    invalidate();
 }
 
 void MPUConfiguration::dumpConfiguration()
 {
-    for(int i=0;i<2;i++)
+    for(int i=0;i<3;i++)
     {
+        if((regValues[2*i+1] & 1)==0) continue; //Region not enabled
         unsigned int base=regValues[2*i] & (~0x1f);
         unsigned int end=base+(1<<(((regValues[2*i+1]>>1) & 31)+1));
         char w=regValues[2*i+1] & (1<<MPU_RASR_AP_Pos) ? 'w' : '-';
         char x=regValues[2*i+1] & MPU_RASR_XN_Msk ? '-' : 'x';
-        iprintf("* MPU region %d 0x%08x-0x%08x r%c%c\n",i+6,base,end,w,x);
+        iprintf("* MPU region %d 0x%08x-0x%08x r%c%c\n",
+                regValues[2*i] & 0xf,base,end,w,x);
     }
 }
 
@@ -95,7 +121,9 @@ bool MPUConfiguration::withinForReading(const void *ptr, size_t size) const
     size_t base=reinterpret_cast<size_t>(ptr);
     //The last check is to prevent a wraparound to be considered valid
     return (   (base>=codeStart && base+size<codeEnd)
-            || (base>=dataStart && base+size<dataEnd)) && base+size>=base;
+            || (base>=dataStart && base+size<dataEnd)
+            || (hasSharedRegion() && withinRegion(2,base,size)))
+            && base+size>=base;
 }
 
 bool MPUConfiguration::withinForWriting(const void *ptr, size_t size) const
@@ -104,7 +132,9 @@ bool MPUConfiguration::withinForWriting(const void *ptr, size_t size) const
     size_t dataEnd=dataStart+(1<<(((regValues[3]>>1) & 31)+1));
     size_t base=reinterpret_cast<size_t>(ptr);
     //The last check is to prevent a wraparound to be considered valid
-    return base>=dataStart && base+size<dataEnd && base+size>=base;
+    return (   (base>=dataStart && base+size<dataEnd)
+            || (hasSharedRegion() && withinRegion(2,base,size)))
+            && base+size>=base;
 }
 
 bool MPUConfiguration::withinForReading(const char* str) const
@@ -118,6 +148,13 @@ bool MPUConfiguration::withinForReading(const char* str) const
         return strnlen(str,codeEnd-base)<codeEnd-base;
     if((base>=dataStart) && (base<dataEnd))
         return strnlen(str,dataEnd-base)<dataEnd-base;
+    if(hasSharedRegion())
+    {
+        size_t shmStart=regValues[4] & (~0x1f);
+        size_t shmEnd=shmStart+(1<<(((regValues[5]>>1) & 31)+1));
+        if((base>=shmStart) && (base<shmEnd))
+            return strnlen(str,shmEnd-base)<shmEnd-base;
+    }
     return false;
 }
 
@@ -74,6 +74,46 @@ public:
     MPUConfiguration(unsigned int *elfBase, unsigned int elfSize,
             unsigned int *imageBase, unsigned int imageSize);
     
+    /**
+     * \internal
+     * Configure the additional region used to map a shared memory object
+     * inside the process. Only one shared region per process is supported.
+     * Unprivileged code will be able to read and write it, but not execute it.
+     * \param base base address of the shared region, must be aligned to its
+     * size
+     * \param size size of the shared region, must be a power of two >=32
+     */
+    void setSharedRegion(unsigned int *base, unsigned int size);
+    
+    /**
+     * \internal
+     * Disable the shared memory region, if configured
+     */
+    void clearSharedRegion();
+    
+    /**
+     * \return true if a shared memory region is configured
+     */
+    bool hasSharedRegion() const { return regValues[5] & 1; }
+    
+    /**
+     * Copy constructor
+     */
+    MPUConfiguration(const MPUConfiguration& rhs)
+    {
+        for(int i=0;i<6;i++) regValues[i]=rhs.regValues[i];
+    }
+    
+    /**
+     * Operator=
+     */
+    MPUConfiguration& operator=(const MPUConfiguration& rhs)
+    {
+        for(int i=0;i<6;i++) regValues[i]=rhs.regValues[i];
+        invalidate();
+        return *this;
+    }
+    
     /**
      * \internal
      * This method is used to configure the Memoy Protection region for a 
@@ -82,12 +122,24 @@ public:
      */
     void IRQenable()
     {
-       MPU->RBAR=regValues[0];
-       MPU->RASR=regValues[1];
-       MPU->RBAR=regValues[2];
-       MPU->RASR=regValues[3];
-       __set_CONTROL(3); 
-   }
+        //The regions are left programmed when switching to kernelspace, as
+        //they only restrict unprivileged code, so when switching back to the
+        //same process there is nothing to do
+        if(loaded!=this)
+        {
+            //Since the region number is encoded in RBAR, the three regions
+            //are written through RBAR and its aliases RBAR_A1, RBAR_A2 with a
+            //single burst transfer, without going through RNR
+            unsigned int *src=regValues;
+            volatile uint32_t *dst=&MPU->RBAR;
+            asm volatile("ldmia %0, {r0-r5} \n\t"
+                         "stmia %1, {r0-r5}"
+                         ::"r"(src),"r"(dst)
+                         :"r0","r1","r2","r3","r4","r5","memory");
+            loaded=this;
+        }
+        __set_CONTROL(3); 
+    }
     
     /**
      * \internal
@@ -138,11 +190,42 @@ public:
      * \return true if the buffer is correctly within the process
      */
     bool withinForReading(const char *str) const;
+    
+    /**
+     * Destructor
+     */
+    ~MPUConfiguration() { invalidate(); }
 
-    //Uses default copy constructor and operator=
 private:
-    ///These value are copied into the MPU registers to configure them
-    unsigned int regValues[4]; 
+    /**
+     * Must be called every time regValues is changed, so that the next
+     * IRQenable() reprograms the MPU. Also called on destruction, as another
+     * configuration may later be constructed at the same address
+     */
+    void invalidate()
+    {
+        if(loaded==this) loaded=nullptr;
+    }
+    
+    /**
+     * \param i region index within regValues, 0 to 2
+     * \param ptr base pointer of the buffer to check
+     * \param size buffer size
+     * \return true if the buffer is within the given region
+     */
+    bool withinRegion(int i, size_t ptr, size_t size) const
+    {
+        size_t start=regValues[2*i] & (~0x1f);
+        size_t end=start+(1<<(((regValues[2*i+1]>>1) & 31)+1));
+        return ptr>=start && ptr+size<end;
+    }
+
+    ///These value are copied into the MPU registers to configure them.
+    ///Region 6 is the code, region 7 the RAM image and region 5 the optional
+    ///shared memory region
+    unsigned int regValues[6]; 
+    ///The configuration currently programmed in the MPU, if any
+    static MPUConfiguration *loaded;
 };
 
 #endif //WITH_PROCESSES
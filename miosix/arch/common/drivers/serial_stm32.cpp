@@ -890,6 +890,15 @@ int STM32Serial::ioctl(int cmd, void* arg)
     }
 }
 
+int STM32Serial::poll(int events, PollEntry *entry)
+{
+    int result=events & POLLOUT;
+    FastInterruptDisableLock dLock;
+    if((events & POLLIN) && rxQueue.isEmpty()==false) result|=POLLIN;
+    if(result==0 && entry) rxPoll.IRQadd(entry);
+    return result;
+}
+
 void STM32Serial::IRQhandleInterrupt()
 {
     #if !defined(_ARCH_CORTEXM7_STM32F7) && !defined(_ARCH_CORTEXM7_STM32H7) \
@@ -939,6 +948,7 @@ void STM32Serial::IRQhandleInterrupt()
     if((status & USART_SR_IDLE) || rxQueue.size()>=rxQueueMin)
     {
         //Enough data in buffer or idle line, awake thread
+        rxPoll.IRQwakeup();
         if(rxWaiting)
         {
             rxWaiting->IRQwakeup();
@@ -965,6 +975,7 @@ void STM32Serial::IRQhandleDMArx()
 {
     IRQreadDma();
     idle=false;
+    rxPoll.IRQwakeup();
     if(rxWaiting==0) return;
     rxWaiting->IRQwakeup();
     if(rxWaiting->IRQgetPriority()>Thread::IRQgetCurrentThread()->IRQgetPriority())
@@ -173,6 +173,16 @@ public:
      */
     int ioctl(int cmd, void *arg);
     
+    /**
+     * Check whether readBlock() would block, used to implement poll().
+     * Writes are always reported as possible, as they only block for the time
+     * needed to transmit the data
+     * \param events events of interest, such as POLLIN and POLLOUT
+     * \param entry if not null, entry to add to the rx PollQueue
+     * \return the ready events among the requested ones
+     */
+    int poll(int events, PollEntry *entry);
+    
     /**
      * \internal the serial port interrupts call this member function.
      * Never call this from user code.
@@ -262,6 +272,7 @@ private:
     DynUnsyncQueue<char> rxQueue;     ///< Receiving queue
     static const unsigned int rxQueueMin=16; ///< Minimum queue size
     Thread *rxWaiting=0;              ///< Thread waiting for rx, or 0
+    PollQueue rxPoll;                 ///< Threads polling for rx
     
     USART_TypeDef *port;              ///< Pointer to USART peripheral
     #ifdef SERIAL_DMA
@@ -0,0 +1,99 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "interfaces/endianness.h"
+#include "stm32_hardware_crc.h"
+
+namespace miosix {
+
+/**
+ * \param x an int
+ * \return the same int with its bits in reverse order
+ */
+static inline unsigned int reverseBits(unsigned int x)
+{
+    #if __CORTEX_M>=3
+    return __RBIT(x);
+    #else //__CORTEX_M>=3
+    x=((x>>1) & 0x55555555) | ((x & 0x55555555)<<1);
+    x=((x>>2) & 0x33333333) | ((x & 0x33333333)<<2);
+    x=((x>>4) & 0x0f0f0f0f) | ((x & 0x0f0f0f0f)<<4);
+    return swapBytes32(x);
+    #endif //__CORTEX_M>=3
+}
+
+//
+// class HardwareCrc
+//
+
+HardwareCrc& HardwareCrc::instance()
+{
+    static HardwareCrc singleton;
+    return singleton;
+}
+
+unsigned short HardwareCrc::crc16(const void *message, unsigned int length,
+                                  unsigned short crc)
+{
+    Lock<FastMutex> l(mutex);
+    CRC->POL=0x1021;
+    CRC->INIT=crc;
+    CRC->CR=CRC_CR_POLYSIZE_0 | CRC_CR_RESET;
+    feed(message,length);
+    return CRC->DR;
+}
+
+unsigned int HardwareCrc::reflected32(unsigned int poly, const void *message,
+                                      unsigned int length, unsigned int crc)
+{
+    Lock<FastMutex> l(mutex);
+    CRC->POL=poly;
+    //The peripheral shifts the crc register towards the msb, so its content
+    //is the bit reversed of the crc computed with reflected input
+    CRC->INIT=reverseBits(~crc);
+    CRC->CR=CRC_CR_REV_OUT | CRC_CR_REV_IN_0 | CRC_CR_RESET;
+    feed(message,length);
+    return ~CRC->DR;
+}
+
+void HardwareCrc::feed(const void *message, unsigned int length)
+{
+    const unsigned char *m=reinterpret_cast<const unsigned char*>(message);
+    volatile unsigned char *dr8=reinterpret_cast<volatile unsigned char*>(
+        &CRC->DR);
+    //Word accesses need aligned data
+    for(;length>0 && (reinterpret_cast<unsigned int>(m) & 0x3);length--)
+        *dr8=*m++;
+    const unsigned int *w=reinterpret_cast<const unsigned int*>(m);
+    //The peripheral processes words starting from the most significant byte,
+    //swap bytes so that they are processed in memory order
+    for(;length>=4;length-=4) CRC->DR=swapBytes32(*w++);
+    m=reinterpret_cast<const unsigned char*>(w);
+    for(;length>0;length--) *dr8=*m++;
+}
+
+} //namespace miosix
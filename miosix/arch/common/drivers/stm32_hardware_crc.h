@@ -0,0 +1,139 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef STM32_HARDWARE_CRC_H
+#define STM32_HARDWARE_CRC_H
+
+#include "interfaces/arch_registers.h"
+#include "kernel/sync.h"
+
+#if !defined(CRC_POL_POL) || !defined(CRC_CR_REV_IN)
+#error "HardwareCrc requires a CRC peripheral with programmable polynomial"
+#endif
+
+namespace miosix {
+
+/**
+ * Class to compute CRCs with the hardware CRC peripheral in Miosix
+ * Works with the CRC peripheral with programmable polynomial found in
+ * stm32f07x/f09x, stm32f3, stm32l4, stm32f7 and stm32h7.
+ * The results are the same as the software crc32(), crc32c() and crc16(), so
+ * the software implementation can be used on the other side of a link
+ */
+class HardwareCrc
+{
+public:
+    /**
+     * \return an instance of this class (singleton)
+     */
+    static HardwareCrc& instance();
+    
+    /**
+     * Calculate the crc32 on a string of bytes
+     * \param message string of bytes
+     * \param length message length
+     * \param crc to compute the crc32 of a message in multiple parts, pass
+     * the value returned when processing the previous part
+     * \return the crc32
+     */
+    unsigned int crc32(const void *message, unsigned int length,
+                       unsigned int crc=0)
+    {
+        return reflected32(0x04c11db7,message,length,crc);
+    }
+    
+    /**
+     * Calculate the crc32c on a string of bytes
+     * \param message string of bytes
+     * \param length message length
+     * \param crc to compute the crc32c of a message in multiple parts, pass
+     * the value returned when processing the previous part
+     * \return the crc32c
+     */
+    unsigned int crc32c(const void *message, unsigned int length,
+                        unsigned int crc=0)
+    {
+        return reflected32(0x1edc6f41,message,length,crc);
+    }
+    
+    /**
+     * Calculate the ccitt crc16 on a string of bytes
+     * \param message string of bytes
+     * \param length message length
+     * \param crc to compute the crc16 of a message in multiple parts, pass
+     * the value returned when processing the previous part
+     * \return the crc16
+     */
+    unsigned short crc16(const void *message, unsigned int length,
+                         unsigned short crc=0xffff);
+    
+private:
+    HardwareCrc(const HardwareCrc&);
+    HardwareCrc& operator=(const HardwareCrc&);
+    
+    /**
+     * Constructor
+     */
+    HardwareCrc()
+    {
+        miosix::FastInterruptDisableLock dLock;
+        #if defined(RCC_AHBENR_CRCEN)
+        RCC->AHBENR |= RCC_AHBENR_CRCEN;
+        #elif defined(RCC_AHB1ENR_CRCEN)
+        RCC->AHB1ENR |= RCC_AHB1ENR_CRCEN;
+        #else
+        RCC->AHB4ENR |= RCC_AHB4ENR_CRCEN;
+        #endif
+        RCC_SYNC();
+    }
+    
+    /**
+     * Calculate a 32 bit crc with reflected input and output, initial value
+     * and final xor of 0xffffffff
+     * \param poly polynomial, in normal bit order
+     * \param message string of bytes
+     * \param length message length
+     * \param crc previous crc value
+     * \return the crc
+     */
+    unsigned int reflected32(unsigned int poly, const void *message,
+                             unsigned int length, unsigned int crc);
+    
+    /**
+     * Feed a message to the CRC peripheral, that must be already configured
+     * to reverse the bits in each byte, if required
+     * \param message string of bytes
+     * \param length message length
+     */
+    static void feed(const void *message, unsigned int length);
+    
+    miosix::FastMutex mutex; ///< To protect against concurrent access
+};
+
+} //namespace miosix
+
+#endif //STM32_HARDWARE_CRC_H
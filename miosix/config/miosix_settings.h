@@ -97,12 +97,52 @@ namespace miosix {
 /// filesystem is synced so that a power failure happens data is not lost
 /// (unless power failure happens exactly between the write and the sync)
 /// Unfortunately write latency and throughput becomes twice as worse
-/// By default it is defined (slow but safe)
-#define SYNC_AFTER_WRITE
+/// By default it is not defined, WITH_WRITE_BEHIND is used instead
+//#define SYNC_AFTER_WRITE
+
+/// \def WITH_WRITE_BEHIND
+/// Alternative to SYNC_AFTER_WRITE. Written files are synced by a kernel
+/// thread WRITE_BEHIND_DELAY milliseconds after the first unsynced write, or
+/// as soon as WRITE_BEHIND_THRESHOLD bytes are written, whichever comes first.
+/// This bounds the data lost in case of power failure, with a throughput close
+/// to the one with no sync at all. fsync() can be used as an explicit barrier
+/// Note that this changes the previous default, SYNC_AFTER_WRITE: a write()
+/// that returned successfully may now be lost if power fails within
+/// WRITE_BEHIND_DELAY milliseconds. Applications relying on each write being
+/// durable should either call fsync() or define SYNC_AFTER_WRITE instead
+/// By default it is defined
+#define WITH_WRITE_BEHIND
+const unsigned int WRITE_BEHIND_DELAY=1000;
+const unsigned int WRITE_BEHIND_THRESHOLD=32768;
+
+/// Number of 512 byte blocks in the write-back cache interposed between the
+/// SD card and Fat32Fs. Caching the FAT and directory sectors greatly reduces
+/// the number of card transactions, set to 0 to disable the cache
+const unsigned int BLOCK_CACHE_SIZE=8;
+
+/// Number of entries in the path lookup cache of the FilesystemManager, which
+/// holds recently resolved paths as well as paths found not to exist, so that
+/// repeatedly opening or stat-ing the same path is faster. Set to 0 to disable
+const unsigned int DENTRY_CACHE_SIZE=16;
 
 /// Maximum number of open files. Trying to open more will fail.
 /// Cannot be lower than 3, as the first three are stdin, stdout, stderr
-const unsigned char MAX_OPEN_FILES=8;
+/// File descriptor tables grow in chunks of FILE_TABLE_CHUNK_SIZE entries as
+/// files are opened, so a table only costs one pointer every
+/// FILE_TABLE_CHUNK_SIZE entries plus the chunks actually used
+const unsigned short MAX_OPEN_FILES=64;
+const unsigned short FILE_TABLE_CHUNK_SIZE=8; //Must be a power of 2
+
+/// Size in bytes of the ring buffer of pipes and FIFOs, allocated when a pipe
+/// is created. Writes are never interleaved, whatever their size
+const unsigned int PIPE_BUFFER_SIZE=512;
+
+/// Number of DevFs open files, and of file descriptor tables (one per process
+/// plus the kernel one), whose memory is taken from preallocated pools, so
+/// that opening devices and creating processes doesn't use the heap up to
+/// these numbers. Beyond them memory is allocated from the heap
+const unsigned int DEVFS_FILE_POOL_SIZE=8;
+const unsigned int FILE_TABLE_POOL_SIZE=4;
 
 /// \def WITH_PROCESSES
 /// If uncommented enables support for processes as well as threads.
@@ -115,6 +155,10 @@ const unsigned char MAX_OPEN_FILES=8;
 #error Processes require C++ exception support
 #endif //defined(WITH_PROCESSES) && defined(__NO_EXCEPTIONS)
 
+#if defined(SYNC_AFTER_WRITE) && defined(WITH_WRITE_BEHIND)
+#error SYNC_AFTER_WRITE and WITH_WRITE_BEHIND are mutually exclusive
+#endif //defined(SYNC_AFTER_WRITE) && defined(WITH_WRITE_BEHIND)
+
 #if defined(WITH_PROCESSES) && !defined(WITH_FILESYSTEM)
 #error Processes require filesystem support
 #endif //defined(WITH_PROCESSES) && !defined(WITH_FILESYSTEM)
@@ -151,6 +195,15 @@ const unsigned char MAX_OPEN_FILES=8;
  */
 //#define JTAG_DISABLE_SLEEP
 
+/**
+ * \def WITH_SMALL_HEAP
+ * If defined, malloc() and operator new serve requests of up to 128 bytes from
+ * segregated size classes, in O(1) time and without pausing the kernel.
+ * Memory for small objects is taken from the heap in 1KB slabs that are never
+ * returned to it. By default it is defined.
+ */
+#define WITH_SMALL_HEAP
+
 /// Minimum stack size (MUST be divisible by 4)
 const unsigned int STACK_MIN=256;
 
@@ -171,6 +224,11 @@ const unsigned int MAX_PROCESS_IMAGE_SIZE=64*1024;
 /// size the kernel will not run it (MUST be divisible by 4)
 const unsigned int MIN_PROCESS_STACK_SIZE=STACK_MIN;
 
+/// Number of programs loaded from the filesystem that are kept in RAM after
+/// the processes using them terminate, so that launching them again does not
+/// require reading the file. Zero disables caching
+const unsigned int ELF_CACHE_SIZE=4;
+
 /// Every userspace thread has two stacks, one for when it is running in
 /// userspace and one for when it is running in kernelspace (that is, while it
 /// is executing system calls). This is the size of the stack for when the
@@ -29,6 +29,9 @@
 #define CALLBACK_H
 
 #include <stdint.h>
+#include <new>
+#include <utility>
+#include <type_traits>
 
 namespace miosix {
 
@@ -46,6 +49,7 @@ protected:
     {
         CALL,
         ASSIGN,
+        MOVE,
         DESTROY
     };
     /**
@@ -78,12 +82,50 @@ protected:
                     //use placement new
                     new (o1) T(*o2);
                     break;
+                case MOVE:
+                    new (o1) T(std::move(*const_cast<T*>(o2)));
+                    break;
                 case DESTROY:
                     o1->~T();
                     break;
             }
         }
     };
+
+    /**
+     * Same as TypeDependentOperation, but for function objects that can only
+     * be moved, used by UniqueCallback.
+     */
+    template<typename T>
+    class TypeDependentMoveOperation
+    {
+    public:
+        /**
+         * Perform the type-dependent operations
+         * \param a storage for the any object, stores the function object
+         * \param b storage for the source object for the move constructor
+         * \param op operation, ASSIGN is not supported
+         */
+        static void operation(int32_t *a, const int32_t *b, Op op)
+        {
+            T *o1=reinterpret_cast<T*>(a);
+            T *o2=reinterpret_cast<T*>(const_cast<int32_t*>(b));
+            switch(op)
+            {
+                case CALL:
+                    (*o1)();
+                    break;
+                case MOVE:
+                    new (o1) T(std::move(*o2));
+                    break;
+                case DESTROY:
+                    o1->~T();
+                    break;
+                default:
+                    break;
+            }
+        }
+    };
 };
 
 /**
@@ -137,6 +179,17 @@ public:
         if(operation) operation(any,rhs.any,ASSIGN);
     }
     
+    /**
+     * Move constructor, leaves rhs empty
+     * \param rhs object to move
+     */
+    Callback(Callback&& rhs)
+    {
+        operation=rhs.operation;
+        if(operation) operation(any,rhs.any,MOVE);
+        rhs.clear();
+    }
+
     /**
      * Operator =
      * \param rhs object to copy
@@ -144,6 +197,13 @@ public:
      */
     Callback& operator= (const Callback& rhs);
 
+    /**
+     * Move assignment, leaves rhs empty
+     * \param rhs object to move
+     * \return *this
+     */
+    Callback& operator= (Callback&& rhs);
+
     /**
      * Assignment operation, assigns a function object to this callback.
      * \param funtor function object a copy of which is stored internally
@@ -220,6 +280,17 @@ Callback<N>& Callback<N>::operator= (const Callback<N>& rhs)
     return *this;
 }
 
+template<unsigned N>
+Callback<N>& Callback<N>::operator= (Callback<N>&& rhs)
+{
+    if(this==&rhs) return *this; //Handle assignmento to self
+    if(operation) operation(any,0,DESTROY);
+    operation=rhs.operation;
+    if(operation) operation(any,rhs.any,MOVE);
+    rhs.clear();
+    return *this;
+}
+
 template<unsigned N>
 template<typename T>
 Callback<N>& Callback<N>::operator= (T functor)
@@ -238,6 +309,140 @@ Callback<N>& Callback<N>::operator= (T functor)
     return *this;
 }
 
+/**
+ * A UniqueCallback is like a Callback, but it can also store function objects
+ * that can only be moved, such as those owning a resource, and for this reason
+ * it can itself only be moved, not copied. Like Callback, it never allocates
+ * memory on the heap, and it is used by BoundedEventQueue to move events in
+ * and out of the queue without copying them.
+ * 
+ * \param N the size in bytes that an instance of this class reserves to
+ * store the function objects, see Callback
+ */
+template<unsigned N>
+class UniqueCallback : private CallbackBase
+{
+public:
+    /**
+     * Default constructor. Produces an empty callback.
+     */
+    UniqueCallback() : operation(0) {}
+
+    /**
+     * Constructor. Not explicit by design.
+     * \param functor function object which is moved or copied internally
+     */
+    template<typename T, typename = typename std::enable_if<
+        !std::is_same<typename std::decay<T>::type,UniqueCallback>::value>::type>
+    UniqueCallback(T&& functor) : operation(0)
+    {
+        *this=std::forward<T>(functor);
+    }
+
+    /**
+     * Move constructor, leaves rhs empty
+     * \param rhs object to move
+     */
+    UniqueCallback(UniqueCallback&& rhs)
+    {
+        operation=rhs.operation;
+        if(operation) operation(any,rhs.any,MOVE);
+        rhs.clear();
+    }
+
+    /**
+     * Move assignment, leaves rhs empty
+     * \param rhs object to move
+     * \return *this
+     */
+    UniqueCallback& operator= (UniqueCallback&& rhs);
+
+    /**
+     * Assignment operation, assigns a function object to this callback.
+     * \param funtor function object which is moved or copied internally
+     */
+    template<typename T, typename = typename std::enable_if<
+        !std::is_same<typename std::decay<T>::type,UniqueCallback>::value>::type>
+    UniqueCallback& operator= (T&& functor);
+
+    /**
+     * Removes any function object stored in this class
+     */
+    void clear()
+    {
+        if(operation) operation(any,0,DESTROY);
+        operation=0;
+    }
+
+    /**
+     * Call the callback, or do nothing if no callback is set
+     */
+    void operator() ()
+    {
+        if(operation) operation(any,0,CALL);
+    }
+
+    /**
+     * Call the callback, generating undefined behaviour if no callback is set
+     */
+    void call()
+    {
+        operation(any,0,CALL);
+    }
+
+    /**
+     * \return true if the object contains a callback
+     */
+    explicit operator bool() const { return operation!=0; }
+
+    /**
+     * Destructor
+     */
+    ~UniqueCallback()
+    {
+        if(operation) operation(any,0,DESTROY);
+    }
+
+private:
+    UniqueCallback(const UniqueCallback&)=delete;
+    UniqueCallback& operator= (const UniqueCallback&)=delete;
+
+    /// Aligned to 8 bytes for the same reason explained in Callback
+    int32_t any[(N+3)/4] __attribute__((aligned(8)));
+    void (*operation)(int32_t *a, const int32_t *b, Op op);
+};
+
+template<unsigned N>
+UniqueCallback<N>& UniqueCallback<N>::operator= (UniqueCallback<N>&& rhs)
+{
+    if(this==&rhs) return *this; //Handle assignmento to self
+    if(operation) operation(any,0,DESTROY);
+    operation=rhs.operation;
+    if(operation) operation(any,rhs.any,MOVE);
+    rhs.clear();
+    return *this;
+}
+
+template<unsigned N>
+template<typename T, typename>
+UniqueCallback<N>& UniqueCallback<N>::operator= (T&& functor)
+{
+    typedef typename std::decay<T>::type U;
+
+    //If an error is reported about this line an attempt to store a too large
+    //object is made. Increase N.
+    static_assert(sizeof(any)>=sizeof(U),"");
+
+    //This should not fail unless something has a stricter alignment than double
+    static_assert(__alignof__(any)>=__alignof__(U),"");
+
+    if(operation) operation(any,0,DESTROY);
+
+    new (reinterpret_cast<U*>(any)) U(std::forward<T>(functor));
+    operation=TypeDependentMoveOperation<U>::operation;
+    return *this;
+}
+
 } //namespace miosix
 
 #endif //CALLBACK_H
@@ -48,7 +48,7 @@ void EventQueue::run()
     for(;;)
     {
         while(events.empty()) cv.wait(l);
-        function<void ()> f=events.front();
+        function<void ()> f=move(events.front());
         events.pop_front();
         {
             Unlock<FastMutex> u(l);
@@ -63,7 +63,7 @@ void EventQueue::runOne()
     {
         Lock<FastMutex> l(m);
         if(events.empty()) return;
-        f=events.front();
+        f=move(events.front());
         events.pop_front();
     }
     f();
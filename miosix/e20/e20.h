@@ -32,6 +32,7 @@
 
 #include <list>
 #include <functional>
+#include <cstring>
 #include <miosix.h>
 #include "callback.h"
 
@@ -42,6 +43,8 @@ namespace miosix {
  * 
  * Makes use of heap allocations and as such it is not possible to post events
  * from within interrupt service routines. For this, use FixedEventQueue.
+ * To avoid heap allocations when posting events from threads, use
+ * BoundedEventQueue.
  * 
  * This class acts as a synchronization point, multiple threads can post
  * events, and multiple threads can call run() or runOne() (thread pooling).
@@ -109,6 +112,60 @@ private:
     ConditionVariable cv; ///< Condition variable for synchronisation
 };
 
+template<unsigned SlotSize>
+class FixedEventQueueBase;
+
+/**
+ * An event that runs at a given time, or periodically, posted to a
+ * FixedEventQueue with postAt() or postPeriodic().
+ * 
+ * The timed event is linked in the queue till it is run, or as long as it is
+ * periodic, so it is the handle to cancel it and must be kept alive. Destroying
+ * the object cancels the event. As for the queue slots, no heap memory is used.
+ * 
+ * \param SlotSize size of the Callback object, must be the same of the
+ * FixedEventQueue the event is posted to
+ */
+template<unsigned SlotSize=20>
+class TimedEvent
+{
+public:
+    /**
+     * Constructor
+     */
+    TimedEvent() : queue(0), next(0), when(0), period(0) {}
+
+    /**
+     * Destructor, cancels the event if it is pending
+     */
+    ~TimedEvent()
+    {
+        if(queue) queue->cancelImpl(*this);
+    }
+
+    /**
+     * \return true if the event is waiting to run, for a periodic event this
+     * is true until it is cancelled
+     */
+    bool isPending() const
+    {
+        FastInterruptDisableLock dLock;
+        return queue!=0;
+    }
+
+private:
+    TimedEvent(const TimedEvent&);
+    TimedEvent& operator= (const TimedEvent&);
+
+    friend class FixedEventQueueBase<SlotSize>;
+
+    FixedEventQueueBase<SlotSize> *queue; ///< Queue, or 0 if not pending
+    TimedEvent *next;          ///< Next timed event, sorted by time
+    long long when;            ///< When the event should run, in ticks
+    long long period;          ///< Period in ticks, or 0 if not periodic
+    Callback<SlotSize> event;  ///< Event to run
+};
+
 /**
  * This class is to extract from FixedEventQueue code that
  * does not depend on the NumSlots template parameters.
@@ -120,8 +177,17 @@ protected:
     /**
      * Constructor.
      */
-    FixedEventQueueBase() : put(0), get(0), n(0), waitingGet(0), waitingPut(0)
-    {}
+    FixedEventQueueBase() : put(0), get(0), n(0), waitingGet(0), waitingPut(0),
+            timers(0) {}
+
+    /**
+     * Destructor, cancels pending timed events
+     */
+    ~FixedEventQueueBase()
+    {
+        InterruptDisableLock dLock;
+        while(timers) IRQremoveTimer(*timers);
+    }
 
     /**
      * Post an event. Blocks if event queue is full.
@@ -163,6 +229,31 @@ protected:
      */
     void runOneImpl(Callback<SlotSize> *events, unsigned int size);
 
+    /**
+     * Post an event that runs at a given time, or periodically.
+     * If the timed event is already pending, it is rescheduled.
+     * \param timer timed event, the handle to cancel it
+     * \param event event to post
+     * \param absoluteTime when the event should run, in ticks
+     * \param period 0 for a one shot event, otherwise the event runs every
+     * period ticks
+     */
+    void postAtImpl(TimedEvent<SlotSize>& timer, Callback<SlotSize>& event,
+            long long absoluteTime, long long period);
+
+    /**
+     * Cancel a timed event
+     * \param timer timed event
+     * \return true if the event was pending
+     */
+    bool cancelImpl(TimedEvent<SlotSize>& timer)
+    {
+        InterruptDisableLock dLock;
+        if(timer.queue!=this) return false;
+        IRQremoveTimer(timer);
+        return true;
+    }
+
     /**
      * \return the number of events in the queue
      */
@@ -183,11 +274,45 @@ private:
         bool token;        ///< To tolerate spurious wakeups
     };
 
+    friend class TimedEvent<SlotSize>; ///< To call cancelImpl()
+
+    /**
+     * Wait until an event is posted or the first timed event is due, must be
+     * called with interrupts disabled
+     * \param dLock the lock that disabled interrupts
+     */
+    void IRQwaitForEvents(InterruptDisableLock& dLock);
+
+    /**
+     * If the first timed event is due, take it out of the list, or put it
+     * back in the list with the next deadline if it is periodic.
+     * Must be called with interrupts disabled
+     * \param f the event to run is copied here
+     * \return true if a timed event is due
+     */
+    bool IRQtakeDueTimer(Callback<SlotSize>& f);
+
+    /**
+     * Insert a timed event in the list sorted by time, and if it is the first
+     * one wake a thread waiting in run(), so that it waits until the new time.
+     * Must be called with interrupts disabled
+     * \param timer timed event
+     */
+    void IRQinsertTimer(TimedEvent<SlotSize>& timer);
+
+    /**
+     * Remove a timed event from the list, must be called with interrupts
+     * disabled and the timed event in the list
+     * \param timer timed event
+     */
+    void IRQremoveTimer(TimedEvent<SlotSize>& timer);
+
     unsigned int put; ///< Put position into events
     unsigned int get; ///< Get position into events
     unsigned int n;   ///< Number of occupied event slots
     WaitingList *waitingGet; ///< List of threads waiting to get an event
     WaitingList *waitingPut; ///< List of threads waiting to put an event
+    TimedEvent<SlotSize> *timers; ///< Timed events, sorted by time
 };
 
 template<unsigned SlotSize>
@@ -245,23 +370,19 @@ void FixedEventQueueBase<SlotSize>::runImpl(Callback<SlotSize> *events,
     InterruptDisableLock dLock;
     for(;;)
     {
-        while(n<=0)
+        Callback<SlotSize> f;
+        bool timed;
+        //Timed events that are due run first, so that they are not delayed
+        //by a queue that never empties
+        while((timed=IRQtakeDueTimer(f))==false && n<=0)
+            IRQwaitForEvents(dLock);
+        if(timed)
         {
-            WaitingList w;
-            w.token=false;
-            w.t=Thread::IRQgetCurrentThread();
-            w.next=waitingGet;
-            waitingGet=&w;
-            while(w.token==false)
-            {
-                Thread::IRQwait();
-                {
-                    InterruptEnableLock eLock(dLock);
-                    Thread::yield();
-                }
-            }
+            InterruptEnableLock eLock(dLock);
+            f();
+            continue;
         }
-        Callback<SlotSize> f=events[get]; //This may allocate memory
+        f=events[get]; //This may allocate memory
         if(++get>=size) get=0;
         n--;
         if(waitingPut)
@@ -286,20 +407,115 @@ void FixedEventQueueBase<SlotSize>::runOneImpl(Callback<SlotSize> *events,
         //Not FastInterruptDisableLock as the operator= of the bound
         //parameters of the Callback may allocate
         InterruptDisableLock dLock;
-        if(n<=0) return;
-        f=events[get]; //This may allocate memory
-        if(++get>=size) get=0;
-        n--;
-        if(waitingPut)
+        if(IRQtakeDueTimer(f)==false)
         {
-            waitingPut->token=true;
-            waitingPut->t->IRQwakeup();
-            waitingPut=waitingPut->next;
+            if(n<=0) return;
+            f=events[get]; //This may allocate memory
+            if(++get>=size) get=0;
+            n--;
+            if(waitingPut)
+            {
+                waitingPut->token=true;
+                waitingPut->t->IRQwakeup();
+                waitingPut=waitingPut->next;
+            }
         }
     }
     f();
 }
 
+template<unsigned SlotSize>
+void FixedEventQueueBase<SlotSize>::postAtImpl(TimedEvent<SlotSize>& timer,
+        Callback<SlotSize>& event, long long absoluteTime, long long period)
+{
+    //Not FastInterruptDisableLock as the operator= of the bound
+    //parameters of the Callback may allocate
+    InterruptDisableLock dLock;
+    if(timer.queue) timer.queue->IRQremoveTimer(timer);
+    timer.event=event; //This may allocate memory
+    timer.when=absoluteTime;
+    timer.period=period;
+    IRQinsertTimer(timer);
+}
+
+template<unsigned SlotSize>
+void FixedEventQueueBase<SlotSize>::IRQwaitForEvents(InterruptDisableLock& dLock)
+{
+    WaitingList w;
+    w.token=false;
+    w.t=Thread::IRQgetCurrentThread();
+    w.next=waitingGet;
+    waitingGet=&w;
+    while(w.token==false)
+    {
+        if(timers)
+        {
+            //The kernel sleep queue wakes us when the first timed event is due
+            if(Thread::IRQenableIrqAndTimedWait(dLock,timers->when)) continue;
+            //Timeout, if nobody woke us remove ourselves from the list
+            if(w.token) break;
+            for(WaitingList **x=&waitingGet;*x;x=&(*x)->next)
+            {
+                if(*x!=&w) continue;
+                *x=w.next;
+                break;
+            }
+            break;
+        }
+        Thread::IRQwait();
+        {
+            InterruptEnableLock eLock(dLock);
+            Thread::yield();
+        }
+    }
+}
+
+template<unsigned SlotSize>
+bool FixedEventQueueBase<SlotSize>::IRQtakeDueTimer(Callback<SlotSize>& f)
+{
+    if(timers==0 || timers->when>getTick()) return false;
+    TimedEvent<SlotSize>& timer=*timers;
+    f=timer.event; //This may allocate memory
+    IRQremoveTimer(timer);
+    if(timer.period)
+    {
+        //Increment the previous deadline, not the current time, so that
+        //periodic events don't drift
+        timer.when+=timer.period;
+        IRQinsertTimer(timer);
+    } else timer.event.clear();
+    return true;
+}
+
+template<unsigned SlotSize>
+void FixedEventQueueBase<SlotSize>::IRQinsertTimer(TimedEvent<SlotSize>& timer)
+{
+    TimedEvent<SlotSize> **x=&timers;
+    while(*x && (*x)->when<=timer.when) x=&(*x)->next;
+    timer.next=*x;
+    *x=&timer;
+    timer.queue=this;
+    if(timers==&timer && waitingGet)
+    {
+        waitingGet->token=true;
+        waitingGet->t->IRQwakeup();
+        waitingGet=waitingGet->next;
+    }
+}
+
+template<unsigned SlotSize>
+void FixedEventQueueBase<SlotSize>::IRQremoveTimer(TimedEvent<SlotSize>& timer)
+{
+    for(TimedEvent<SlotSize> **x=&timers;*x;x=&(*x)->next)
+    {
+        if(*x!=&timer) continue;
+        *x=timer.next;
+        break;
+    }
+    timer.next=0;
+    timer.queue=0;
+}
+
 /**
  * A fixed size event queue.
  * 
@@ -423,7 +639,8 @@ public:
     }
 
     /**
-     * Run at most one event. This function does not block.
+     * Run at most one event, or one timed event that is due. This function does
+     * not block.
      * 
      * \throws any exception that is thrown by the event functions
      */
@@ -431,6 +648,53 @@ public:
     {
         this->runOneImpl(events,NumSlots);
     }
+
+    /**
+     * Post an event that runs at a given time. If the timed event is already
+     * pending, it is rescheduled. Timed events don't use the queue slots, and
+     * threads in run() sleep until the first timed event is due, unless other
+     * events are posted before.
+     * 
+     * \param timer timed event, the handle to cancel the event. It must be
+     * kept alive until the event has run
+     * \param event function function to be called in the thread that calls
+     * run() or runOne(), with the same restrictions as post()
+     * \param absoluteTime when the event should run, in ticks
+     */
+    void postAt(TimedEvent<SlotSize>& timer, Callback<SlotSize> event,
+            long long absoluteTime)
+    {
+        this->postAtImpl(timer,event,absoluteTime,0);
+    }
+
+    /**
+     * Post an event that runs periodically, the first time after one period.
+     * If the timed event is already pending, it is rescheduled. Deadlines are
+     * computed from the previous deadline, so the event doesn't drift even if
+     * run() is late in running it.
+     * 
+     * \param timer timed event, the handle to cancel the event. It must be
+     * kept alive until the event is cancelled
+     * \param event function function to be called in the thread that calls
+     * run() or runOne(), with the same restrictions as post()
+     * \param period period in ticks, must be greater than zero
+     */
+    void postPeriodic(TimedEvent<SlotSize>& timer, Callback<SlotSize> event,
+            long long period)
+    {
+        this->postAtImpl(timer,event,getTick()+period,period);
+    }
+
+    /**
+     * Cancel a timed event. A periodic event can also cancel itself.
+     * 
+     * \param timer timed event
+     * \return true if the event was pending
+     */
+    bool cancel(TimedEvent<SlotSize>& timer)
+    {
+        return this->cancelImpl(timer);
+    }
     
     /**
      * \return the number of events in the queue
@@ -455,6 +719,475 @@ private:
     Callback<SlotSize> events[NumSlots]; ///< Fixed size queue of events
 };
 
+/**
+ * A bounded event queue for threads.
+ * 
+ * Like EventQueue, events can only be posted by threads, but like
+ * FixedEventQueue the queue is a ring of NumSlots slots allocated as part of
+ * the object, so posting and running events makes no use of the heap.
+ * Events are stored in a UniqueCallback, so function objects that can only be
+ * moved can be posted, and they are moved in and out of the queue instead of
+ * being copied.
+ * 
+ * This class acts as a synchronization point, multiple threads can post
+ * events, and multiple threads can call run(), runOne() or runAll()
+ * (thread pooling).
+ * 
+ * \param NumSlots maximum queue length
+ * \param SlotSize size of the UniqueCallback objects, see FixedEventQueue
+ */
+template<unsigned NumSlots, unsigned SlotSize=20>
+class BoundedEventQueue
+{
+public:
+    /**
+     * Constructor.
+     */
+    BoundedEventQueue() : put(0), get(0), n(0) {}
+
+    /**
+     * Post an event, blocking if the event queue is full.
+     * 
+     * \param event function function to be called in the thread that calls
+     * run(), runOne() or runAll(). Bind can be used to bind parameters to the
+     * function. Empty callbacks are ignored, as there is nothing to run.
+     */
+    void post(UniqueCallback<SlotSize> event)
+    {
+        //An empty callback in the ring would be mistaken for a free slot
+        if(!event) return;
+        Lock<FastMutex> l(m);
+        while(events[put]) notFull.wait(l);
+        insert(event);
+    }
+
+    /**
+     * Post an event in the queue, or return if the queue was full.
+     * 
+     * \param event function function to be called in the thread that calls
+     * run(), runOne() or runAll(). Bind can be used to bind parameters to the
+     * function.
+     * \return false if there was no space in the queue, or if the callback
+     * is empty
+     */
+    bool postNonBlocking(UniqueCallback<SlotSize> event)
+    {
+        if(!event) return false;
+        Lock<FastMutex> l(m);
+        if(events[put]) return false;
+        insert(event);
+        return true;
+    }
+
+    /**
+     * This function blocks waiting for events being posted, and when available
+     * it calls the event function. To return from this event loop an event
+     * function must throw an exception.
+     * 
+     * \throws any exception that is thrown by the event functions
+     */
+    void run()
+    {
+        for(;;)
+        {
+            UniqueCallback<SlotSize> f;
+            {
+                Lock<FastMutex> l(m);
+                while(n==0) notEmpty.wait(l);
+                f=extract();
+            }
+            f();
+        }
+    }
+
+    /**
+     * Run at most one event. This function does not block.
+     * 
+     * \throws any exception that is thrown by the event functions
+     */
+    void runOne()
+    {
+        UniqueCallback<SlotSize> f;
+        {
+            Lock<FastMutex> l(m);
+            if(n==0) return;
+            f=extract();
+        }
+        f();
+    }
+
+    /**
+     * Run all the events that are in the queue when this function is called.
+     * This function does not block. The events are taken from the queue with
+     * a single lock acquisition, then moved out of their slots a few at a time
+     * before being run, so running a batch of events costs much less locking
+     * than running them one by one. As the slots are freed before the events
+     * are run, events can post to this queue even if the batch filled it.
+     * Events posted while the batch is running are left in the queue.
+     * 
+     * \return the number of events run
+     * \throws any exception that is thrown by the event functions. In this
+     * case the events of the batch that were not yet run are discarded
+     */
+    unsigned int runAll()
+    {
+        unsigned int first, count;
+        {
+            Lock<FastMutex> l(m);
+            first=get;
+            count=n;
+            get=(get+n)%NumSlots;
+            n=0;
+        }
+        //The slots of the batch are still full, so they won't be touched by
+        //threads posting events until the events are moved out of them
+        const unsigned int chunkSize=NumSlots<4 ? NumSlots : 4;
+        UniqueCallback<SlotSize> chunk[chunkSize];
+        for(unsigned int i=0;i<count;i+=chunkSize)
+        {
+            unsigned int c=count-i<chunkSize ? count-i : chunkSize;
+            {
+                Lock<FastMutex> l(m);
+                for(unsigned int j=0;j<c;j++)
+                    chunk[j]=std::move(events[(first+i+j)%NumSlots]);
+                notFull.broadcast();
+            }
+            #ifndef __NO_EXCEPTIONS
+            try {
+            #endif //__NO_EXCEPTIONS
+                for(unsigned int j=0;j<c;j++)
+                {
+                    chunk[j].call();
+                    chunk[j].clear();
+                }
+            #ifndef __NO_EXCEPTIONS
+            } catch(...) {
+                release(first+i+c,count-i-c);
+                throw;
+            }
+            #endif //__NO_EXCEPTIONS
+        }
+        return count;
+    }
+
+    /**
+     * \return the number of events in the queue
+     */
+    unsigned int size() const
+    {
+        Lock<FastMutex> l(m);
+        return n;
+    }
+
+    /**
+     * \return true if the queue has no events
+     */
+    bool empty() const
+    {
+        Lock<FastMutex> l(m);
+        return n==0;
+    }
+
+private:
+    BoundedEventQueue(const BoundedEventQueue&);
+    BoundedEventQueue& operator= (const BoundedEventQueue&);
+
+    /**
+     * Move an event in the queue, must be called with the mutex locked and
+     * the slot at put free
+     * \param event event to insert
+     */
+    void insert(UniqueCallback<SlotSize>& event)
+    {
+        events[put]=std::move(event);
+        if(++put>=NumSlots) put=0;
+        n++;
+        notEmpty.signal();
+    }
+
+    /**
+     * Move an event out of the queue, must be called with the mutex locked and
+     * the queue not empty
+     * \return the event
+     */
+    UniqueCallback<SlotSize> extract()
+    {
+        UniqueCallback<SlotSize> result(std::move(events[get]));
+        if(++get>=NumSlots) get=0;
+        n--;
+        notFull.signal();
+        return result;
+    }
+
+    /**
+     * Free the slots of a batch that runAll() could not run
+     * \param first first slot to free
+     * \param count number of slots to free
+     */
+    void release(unsigned int first, unsigned int count)
+    {
+        Lock<FastMutex> l(m);
+        for(unsigned int i=0;i<count;i++) events[(first+i)%NumSlots].clear();
+        if(count) notFull.broadcast();
+    }
+
+    UniqueCallback<SlotSize> events[NumSlots]; ///< Ring of events
+    unsigned int put; ///< Put position into events
+    unsigned int get; ///< Get position into events
+    unsigned int n;   ///< Number of events waiting to be run
+    mutable FastMutex m; ///< Mutex for synchronisation
+    ConditionVariable notEmpty; ///< To wait for events to run
+    ConditionVariable notFull;  ///< To wait for a free slot
+};
+
+/**
+ * Statistics of a lane of an EventDispatcher. Times are in ticks
+ */
+struct EventLaneStats
+{
+    unsigned int posted;    ///< Number of events posted to the lane
+    unsigned int dropped;   ///< Events not posted because the lane was full
+    unsigned int run;       ///< Number of events run
+    unsigned int depth;     ///< Number of events in the lane or being posted
+    unsigned int maxDepth;  ///< Maximum number of events in the lane
+    long long maxLatency;   ///< Maximum time from post to run of an event
+    long long totalLatency; ///< Sum of the times from post to run of events
+};
+
+/**
+ * A prioritized event dispatcher made of NumLanes lanes, each one being a
+ * FixedEventQueue served by its own worker thread with its own priority.
+ * Events posted to a lane run in order in its worker thread, and events
+ * posted to a higher priority lane preempt events of lower priority lanes,
+ * so urgent events don't wait behind bulk work.
+ * 
+ * As with FixedEventQueue no heap memory is used, and events can be posted
+ * also from interrupt handlers, to any lane.
+ * 
+ * For each lane, the dispatcher collects the number of posted, dropped and
+ * run events, the queue depth and the latency from post to run.
+ * 
+ * Worker threads are never terminated, so an EventDispatcher should be a
+ * global object, or anyway never be destroyed after start() is called.
+ * 
+ * \param NumLanes number of lanes
+ * \param NumSlots maximum length of each lane
+ * \param SlotSize size of the Callback objects, see FixedEventQueue
+ */
+template<unsigned NumLanes, unsigned NumSlots, unsigned SlotSize=20>
+class EventDispatcher
+{
+public:
+    /**
+     * Constructor.
+     */
+    EventDispatcher()
+    {
+        for(unsigned int i=0;i<NumLanes;i++)
+        {
+            memset(&lanes[i].stats,0,sizeof(EventLaneStats));
+            lanes[i].thread=0;
+        }
+    }
+
+    /**
+     * Start the worker threads, can be called only once.
+     * \param priorities array of NumLanes priorities, one for each lane
+     * \param stackSize stack size of worker threads
+     * \return true on success, false if not all threads could be created
+     */
+    bool start(const Priority *priorities,
+            unsigned int stackSize=STACK_DEFAULT_FOR_PTHREAD)
+    {
+        bool result=true;
+        for(unsigned int i=0;i<NumLanes;i++)
+        {
+            if(lanes[i].thread) continue;
+            lanes[i].thread=Thread::create(worker,stackSize,priorities[i],
+                &lanes[i].queue);
+            if(lanes[i].thread==0) result=false;
+        }
+        return result;
+    }
+
+    /**
+     * Post an event to a lane, blocking if the lane is full.
+     * \param lane lane index, from 0 to NumLanes-1
+     * \param event function function to be called in the worker thread of the
+     * lane, with the same restrictions of FixedEventQueue::post()
+     */
+    void post(unsigned int lane, Callback<SlotSize> event)
+    {
+        Lane& l=lanes[lane];
+        {
+            //Not FastInterruptDisableLock as the operator= of the bound
+            //parameters of the Callback may allocate
+            InterruptDisableLock dLock;
+            if(IRQpostImpl(l,event,0,false)) return;
+            //The lane is full. Once in the queue, the event may run before
+            //this thread can update the statistics, so count it before
+            l.stats.posted++;
+            l.stats.depth++;
+        }
+        l.queue.post(LaneEvent(&l.stats,event));
+        FastInterruptDisableLock dLock;
+        //The event took the slot just freed by the worker, filling the lane
+        l.stats.maxDepth=NumSlots;
+    }
+
+    /**
+     * Post an event to a lane, or return if the lane was full.
+     * \param lane lane index, from 0 to NumLanes-1
+     * \param event function function to be called in the worker thread of the
+     * lane, with the same restrictions of FixedEventQueue::postNonBlocking()
+     * \return false if there was no space in the lane
+     */
+    bool postNonBlocking(unsigned int lane, Callback<SlotSize> event)
+    {
+        InterruptDisableLock dLock;
+        return IRQpostImpl(lanes[lane],event,0);
+    }
+
+    /**
+     * Post an event to a lane, or return if the lane was full.
+     * Can be called only with interrupts disabled or within an interrupt
+     * handler, with the same restrictions of FixedEventQueue::IRQpost().
+     * \param lane lane index, from 0 to NumLanes-1
+     * \param event function function to be called in the worker thread of the
+     * lane
+     * \param hppw set to true if the worker thread of the lane has a higher
+     * priority than the current thread, otherwise the variable is not modified.
+     * If true, an interrupt handler should call the scheduler
+     * \return false if there was no space in the lane
+     */
+    bool IRQpost(unsigned int lane, Callback<SlotSize> event, bool *hppw=0)
+    {
+        return IRQpostImpl(lanes[lane],event,hppw);
+    }
+
+    /**
+     * \param lane lane index, from 0 to NumLanes-1
+     * \return the statistics of the lane
+     */
+    EventLaneStats getStats(unsigned int lane) const
+    {
+        FastInterruptDisableLock dLock;
+        return lanes[lane].stats;
+    }
+
+    /**
+     * Reset the statistics of a lane, except the current depth
+     * \param lane lane index, from 0 to NumLanes-1
+     */
+    void resetStats(unsigned int lane)
+    {
+        FastInterruptDisableLock dLock;
+        EventLaneStats& s=lanes[lane].stats;
+        unsigned int depth=s.depth;
+        memset(&s,0,sizeof(EventLaneStats));
+        s.depth=depth;
+        s.maxDepth=depth;
+    }
+
+private:
+    EventDispatcher(const EventDispatcher&);
+    EventDispatcher& operator= (const EventDispatcher&);
+
+    /**
+     * The function object stored in the lanes, wraps the posted event to
+     * measure its latency
+     */
+    class LaneEvent
+    {
+    public:
+        LaneEvent(EventLaneStats *stats, const Callback<SlotSize>& event)
+                : stats(stats), postTime(getTick()), event(event) {}
+
+        void operator() ()
+        {
+            long long latency=getTick()-postTime;
+            {
+                FastInterruptDisableLock dLock;
+                stats->depth--;
+                stats->run++;
+                stats->totalLatency+=latency;
+                if(latency>stats->maxLatency) stats->maxLatency=latency;
+            }
+            event();
+        }
+
+    private:
+        EventLaneStats *stats;    ///< Statistics of the lane
+        long long postTime;       ///< When the event was posted
+        Callback<SlotSize> event; ///< Posted event
+    };
+
+    typedef FixedEventQueue<NumSlots,sizeof(LaneEvent)> LaneQueue;
+
+    /**
+     * A lane of the dispatcher
+     */
+    struct Lane
+    {
+        LaneQueue queue;      ///< Events of the lane
+        EventLaneStats stats; ///< Statistics of the lane
+        Thread *thread;       ///< Worker thread
+    };
+
+    /**
+     * Post an event to a lane, must be called with interrupts disabled.
+     * The statistics are updated after the event is in the queue, as the
+     * worker thread can't run it till interrupts are enabled again
+     * \param l lane
+     * \param event event to post
+     * \param hppw if not null, set to true if a higher priority thread is
+     * awakened, otherwise not modified
+     * \param countDropped if true, a failed post is counted as dropped
+     * \return false if there was no space in the lane
+     */
+    static bool IRQpostImpl(Lane& l, Callback<SlotSize>& event, bool *hppw,
+            bool countDropped=true)
+    {
+        bool woken;
+        if(l.queue.IRQpost(LaneEvent(&l.stats,event),woken)==false)
+        {
+            if(countDropped) l.stats.dropped++;
+            return false;
+        }
+        if(hppw && woken) *hppw=true;
+        l.stats.posted++;
+        l.stats.depth++;
+        //depth also counts events of threads blocked in post(), which are
+        //not yet in the lane
+        unsigned int inLane=l.stats.depth<NumSlots ? l.stats.depth : NumSlots;
+        if(inLane>l.stats.maxDepth) l.stats.maxDepth=inLane;
+        return true;
+    }
+
+    /**
+     * Worker thread of a lane
+     * \param argv the lane queue
+     */
+    static void worker(void *argv)
+    {
+        LaneQueue *queue=reinterpret_cast<LaneQueue*>(argv);
+        for(;;)
+        {
+            #ifndef __NO_EXCEPTIONS
+            //An exception thrown by an event terminates run(), catch it so
+            //that the lane keeps being served
+            try {
+                queue->run();
+            } catch(...) {}
+            #else //__NO_EXCEPTIONS
+            queue->run();
+            #endif //__NO_EXCEPTIONS
+        }
+    }
+
+    Lane lanes[NumLanes]; ///< Dispatcher lanes
+};
+
 } //namespace miosix
 
 #endif //E20_H
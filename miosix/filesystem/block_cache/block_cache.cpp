@@ -0,0 +1,272 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "block_cache.h"
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include "filesystem/ioctl.h"
+#include "kernel/logging.h"
+
+using namespace std;
+
+namespace miosix {
+
+#ifdef WITH_FILESYSTEM
+
+//
+// class BlockCache
+//
+
+BlockCache::BlockCache(intrusive_ref_ptr<FileBase> disk, unsigned int numBlocks)
+        : FileBase(intrusive_ref_ptr<FilesystemBase>()), disk(disk),
+          numBlocks(numBlocks), entries(0), buffer(0), seekPoint(0),
+          useCounter(0), hits(0), misses(0), diskReads(0), diskWrites(0)
+{
+    if(numBlocks==0) return;
+    entries=new Entry[numBlocks];
+    buffer=new unsigned char[numBlocks*blockSize];
+    for(unsigned int i=0;i<numBlocks;i++)
+    {
+        entries[i].valid=false;
+        entries[i].dirty=false;
+    }
+}
+
+ssize_t BlockCache::write(const void *data, size_t len)
+{
+    if(len==0) return 0;
+    Lock<FastMutex> l(mutex);
+    if(seekPoint % blockSize || len % blockSize) return -EINVAL;
+    unsigned int block=seekPoint/blockSize;
+    unsigned int count=len/blockSize;
+    if(count==1 && numBlocks>0)
+    {
+        int i=find(block);
+        if(i>=0) hits++;
+        else {
+            //The whole block is overwritten, no need to read it first
+            misses++;
+            if((i=allocate())<0) return i;
+            entries[i].block=block;
+            entries[i].valid=true;
+        }
+        memcpy(blockData(i),data,blockSize);
+        entries[i].dirty=true;
+        entries[i].lastUse=++useCounter;
+    } else {
+        if(int result=diskWrite(data,block,count)) return result;
+        //Keep cached copies coherent, they are now clean
+        const unsigned char *d=reinterpret_cast<const unsigned char*>(data);
+        for(unsigned int i=0;i<numBlocks;i++)
+        {
+            if(!entries[i].valid) continue;
+            unsigned int b=entries[i].block;
+            if(b<block || b>=block+count) continue;
+            memcpy(blockData(i),d+(b-block)*blockSize,blockSize);
+            entries[i].dirty=false;
+        }
+    }
+    seekPoint+=len;
+    return len;
+}
+
+ssize_t BlockCache::read(void *data, size_t len)
+{
+    if(len==0) return 0;
+    Lock<FastMutex> l(mutex);
+    if(seekPoint % blockSize || len % blockSize) return -EINVAL;
+    unsigned int block=seekPoint/blockSize;
+    unsigned int count=len/blockSize;
+    if(count==1 && numBlocks>0)
+    {
+        int i=find(block);
+        if(i>=0) hits++;
+        else {
+            misses++;
+            if((i=allocate())<0) return i;
+            if(int result=diskRead(blockData(i),block,1)) return result;
+            entries[i].block=block;
+            entries[i].valid=true;
+        }
+        memcpy(data,blockData(i),blockSize);
+        entries[i].lastUse=++useCounter;
+    } else {
+        if(int result=diskRead(data,block,count)) return result;
+        //Dirty cached blocks are newer than what is on the device
+        unsigned char *d=reinterpret_cast<unsigned char*>(data);
+        for(unsigned int i=0;i<numBlocks;i++)
+        {
+            if(!entries[i].valid || !entries[i].dirty) continue;
+            unsigned int b=entries[i].block;
+            if(b<block || b>=block+count) continue;
+            memcpy(d+(b-block)*blockSize,blockData(i),blockSize);
+        }
+    }
+    seekPoint+=len;
+    return len;
+}
+
+off_t BlockCache::lseek(off_t pos, int whence)
+{
+    Lock<FastMutex> l(mutex);
+    off_t newSeekPoint=seekPoint;
+    switch(whence)
+    {
+        case SEEK_CUR:
+            newSeekPoint+=pos;
+            break;
+        case SEEK_SET:
+            newSeekPoint=pos;
+            break;
+        default:
+            return -EINVAL;
+    }
+    if(newSeekPoint<0) return -EOVERFLOW;
+    seekPoint=newSeekPoint;
+    return seekPoint;
+}
+
+int BlockCache::fstat(struct stat *pstat) const
+{
+    return disk->fstat(pstat);
+}
+
+int BlockCache::ioctl(int cmd, void *arg)
+{
+    if(cmd==IOCTL_SYNC)
+    {
+        Lock<FastMutex> l(mutex);
+        if(flush()) return -1;
+    }
+    return disk->ioctl(cmd,arg);
+}
+
+void BlockCache::resetStats()
+{
+    Lock<FastMutex> l(mutex);
+    hits=misses=diskReads=diskWrites=0;
+}
+
+BlockCache::~BlockCache()
+{
+    //Errors can't be returned from here, code that needs to know whether the
+    //data reached the device has to issue IOCTL_SYNC before dropping the
+    //cache, as Fat32Fs does when unmounted. All blocks that can be written are
+    //written anyway
+    if(int result=flush())
+        errorLog("Block cache: write back failed, data lost (%d)\n",result);
+    delete[] entries;
+    delete[] buffer;
+}
+
+int BlockCache::find(unsigned int block) const
+{
+    for(unsigned int i=0;i<numBlocks;i++)
+        if(entries[i].valid && entries[i].block==block) return i;
+    return -1;
+}
+
+int BlockCache::allocate()
+{
+    int victim=0;
+    unsigned int maxAge=0;
+    for(unsigned int i=0;i<numBlocks;i++)
+    {
+        if(!entries[i].valid) return i;
+        //Unsigned subtraction keeps working when useCounter wraps around
+        unsigned int age=useCounter-entries[i].lastUse;
+        if(age>=maxAge)
+        {
+            maxAge=age;
+            victim=i;
+        }
+    }
+    if(int result=writeBack(victim)) return result;
+    entries[victim].valid=false;
+    return victim;
+}
+
+int BlockCache::writeBack(int i)
+{
+    if(!entries[i].dirty) return 0;
+    if(int result=diskWrite(blockData(i),entries[i].block,1)) return result;
+    entries[i].dirty=false;
+    return 0;
+}
+
+int BlockCache::flush()
+{
+    //Writing in ascending order is friendlier to flash translation layers.
+    //A block that fails to be written stays dirty, but does not prevent the
+    //following ones from being written
+    int error=0;
+    bool first=true;
+    unsigned int last=0;
+    for(;;)
+    {
+        int next=-1;
+        for(unsigned int i=0;i<numBlocks;i++)
+        {
+            if(!entries[i].valid || !entries[i].dirty) continue;
+            if(!first && entries[i].block<=last) continue;
+            if(next<0 || entries[i].block<entries[next].block) next=i;
+        }
+        if(next<0) return error;
+        first=false;
+        last=entries[next].block;
+        int result=writeBack(next);
+        if(result && error==0) error=result;
+    }
+}
+
+int BlockCache::diskRead(void *data, unsigned int block, unsigned int count)
+{
+    diskReads++;
+    off_t where=static_cast<off_t>(block)*blockSize;
+    if(disk->lseek(where,SEEK_SET)<0) return -EIO;
+    ssize_t size=static_cast<ssize_t>(count)*blockSize;
+    ssize_t result=disk->read(data,size);
+    if(result<0) return result;
+    return result==size ? 0 : -EIO;
+}
+
+int BlockCache::diskWrite(const void *data, unsigned int block,
+        unsigned int count)
+{
+    diskWrites++;
+    off_t where=static_cast<off_t>(block)*blockSize;
+    if(disk->lseek(where,SEEK_SET)<0) return -EIO;
+    ssize_t size=static_cast<ssize_t>(count)*blockSize;
+    ssize_t result=disk->write(data,size);
+    if(result<0) return result;
+    return result==size ? 0 : -EIO;
+}
+
+#endif //WITH_FILESYSTEM
+
+} //namespace miosix
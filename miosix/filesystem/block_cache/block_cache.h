@@ -0,0 +1,231 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef BLOCK_CACHE_H
+#define	BLOCK_CACHE_H
+
+#include "filesystem/file.h"
+#include "kernel/sync.h"
+#include "config/miosix_settings.h"
+
+namespace miosix {
+
+#ifdef WITH_FILESYSTEM
+
+/**
+ * A write-back block cache that can be interposed between a filesystem and
+ * the block device it is mounted on. It is itself a FileBase, so any
+ * filesystem that accesses its disk through read()/write()/lseek() can be
+ * mounted on top of it transparently.
+ * 
+ * Single block accesses, which is how filesystems usually access metadata
+ * such as the FAT and directory entries, go through an LRU cache. Dirty
+ * blocks are only written to the device when evicted or when IOCTL_SYNC is
+ * received, so the durability guarantees of the filesystem are preserved as
+ * long as it issues IOCTL_SYNC when needed. Multi block accesses, typically
+ * file data, bypass the cache so as not to evict metadata, but are kept
+ * coherent with it.
+ * 
+ * Only accesses aligned to blockSize and multiple of blockSize are supported.
+ * Classes of this type are reference counted, must be allocated on the heap
+ * and managed through intrusive_ref_ptr<FileBase>
+ */
+class BlockCache : public FileBase
+{
+public:
+    /**
+     * Constructor
+     * \param disk the block device to cache
+     * \param numBlocks number of blocks in the cache. If zero, all accesses
+     * are passed through to the device, which is useful to measure the
+     * number of device transactions without caching
+     */
+    BlockCache(intrusive_ref_ptr<FileBase> disk, unsigned int numBlocks);
+    
+    /**
+     * Write data to the file, if the file supports writing.
+     * \param data the data to write
+     * \param len the number of bytes to write
+     * \return the number of written characters, or a negative number in case
+     * of errors
+     */
+    virtual ssize_t write(const void *data, size_t len);
+    
+    /**
+     * Read data from the file, if the file supports reading.
+     * \param data buffer to store read data
+     * \param len the number of bytes to read
+     * \return the number of read characters, or a negative number in case
+     * of errors
+     */
+    virtual ssize_t read(void *data, size_t len);
+    
+    /**
+     * Move file pointer, if the file supports random-access.
+     * \param pos offset to sum to the beginning of the file, current position
+     * or end of file, depending on whence
+     * \param whence SEEK_SET, SEEK_CUR or SEEK_END
+     * \return the offset from the beginning of the file if the operation
+     * completed, or a negative number in case of errors
+     */
+    virtual off_t lseek(off_t pos, int whence);
+    
+    /**
+     * Return file information.
+     * \param pstat pointer to stat struct
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int fstat(struct stat *pstat) const;
+    
+    /**
+     * Perform various operations on a file descriptor. IOCTL_SYNC writes back
+     * all dirty blocks before being forwarded to the device, all other
+     * commands are forwarded unchanged
+     * \param cmd specifies the operation to perform
+     * \param arg optional argument that some operation require
+     * \return the exact return value depends on CMD, -1 is returned on error
+     */
+    virtual int ioctl(int cmd, void *arg);
+    
+    /**
+     * \return the number of single block accesses served from the cache
+     */
+    unsigned int getHits() const { return hits; }
+    
+    /**
+     * \return the number of single block accesses not found in the cache
+     */
+    unsigned int getMisses() const { return misses; }
+    
+    /**
+     * \return the number of read transactions issued to the device
+     */
+    unsigned int getDiskReads() const { return diskReads; }
+    
+    /**
+     * \return the number of write transactions issued to the device
+     */
+    unsigned int getDiskWrites() const { return diskWrites; }
+    
+    /**
+     * Reset all the statistics counters to zero
+     */
+    void resetStats();
+    
+    /**
+     * Destructor. Writes back all dirty blocks. Write errors can't be
+     * reported and are only logged, so issue IOCTL_SYNC before destroying
+     * the cache to know if all data reached the device
+     */
+    ~BlockCache();
+    
+    static const unsigned int blockSize=512; ///< Size of a cached block
+    
+private:
+    BlockCache(const BlockCache&);
+    BlockCache& operator=(const BlockCache&);
+    
+    /**
+     * A cached block
+     */
+    struct Entry
+    {
+        unsigned int block;   ///< Block number on the device
+        unsigned int lastUse; ///< LRU timestamp
+        bool valid;           ///< Entry contains a block
+        bool dirty;           ///< Entry must be written back
+    };
+    
+    /**
+     * \param block block number
+     * \return the cache entry holding the block or -1 if not cached
+     */
+    int find(unsigned int block) const;
+    
+    /**
+     * Select a cache entry to hold a new block, writing back the least
+     * recently used one if dirty
+     * \return the entry index, or a negative number on failure
+     */
+    int allocate();
+    
+    /**
+     * Write back a dirty entry
+     * \param i entry index
+     * \return 0 on success, or a negative number on failure
+     */
+    int writeBack(int i);
+    
+    /**
+     * Write back all dirty entries, in ascending block order. If a block
+     * can't be written, it is left dirty and the other ones are still written
+     * \return 0 on success, or the first error encountered
+     */
+    int flush();
+    
+    /**
+     * Read from the device
+     * \param data buffer where read data will be stored
+     * \param block first block to read
+     * \param count number of blocks
+     * \return 0 on success, or a negative number on failure
+     */
+    int diskRead(void *data, unsigned int block, unsigned int count);
+    
+    /**
+     * Write to the device
+     * \param data data to write
+     * \param block first block to write
+     * \param count number of blocks
+     * \return 0 on success, or a negative number on failure
+     */
+    int diskWrite(const void *data, unsigned int block, unsigned int count);
+    
+    /**
+     * \param i entry index
+     * \return a pointer to the data of the entry
+     */
+    unsigned char *blockData(int i) { return buffer+i*blockSize; }
+    
+    FastMutex mutex;
+    intrusive_ref_ptr<FileBase> disk; ///< Cached device
+    const unsigned int numBlocks;     ///< Number of cache entries
+    Entry *entries;                   ///< Cache entries
+    unsigned char *buffer;            ///< Cache entries' data
+    off_t seekPoint;                  ///< Seek point (note that off_t is 64bit)
+    unsigned int useCounter;          ///< Used to generate LRU timestamps
+    unsigned int hits;                ///< Cache hits
+    unsigned int misses;              ///< Cache misses
+    unsigned int diskReads;           ///< Device read transactions
+    unsigned int diskWrites;          ///< Device write transactions
+};
+
+#endif //WITH_FILESYSTEM
+
+} //namespace miosix
+
+#endif //BLOCK_CACHE_H
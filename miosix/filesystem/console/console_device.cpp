@@ -131,6 +131,11 @@ int TerminalDevice::ioctl(int cmd, void *arg)
     return 0;
 }
 
+int TerminalDevice::poll(int events, PollEntry *entry)
+{
+    return device->poll(events,entry);
+}
+
 pair<size_t,bool> TerminalDevice::normalize(char *buffer, ssize_t begin,
         ssize_t end)
 {
@@ -101,6 +101,14 @@ public:
      */
     virtual int ioctl(int cmd, void *arg);
     
+    /**
+     * Check whether read() or write() would block
+     * \param events events of interest, such as POLLIN and POLLOUT
+     * \param entry if not null, entry to add to the device PollQueue
+     * \return the ready events among the requested ones
+     */
+    virtual int poll(int events, PollEntry *entry);
+    
     /**
      * Enables or disables echo of commands on the terminal
      * \param echo true to enable echo, false to disable it
@@ -0,0 +1,171 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "dentry_cache.h"
+#include "file_access.h"
+
+using namespace std;
+
+namespace miosix {
+
+#ifdef WITH_FILESYSTEM
+
+//
+// class DentryCache
+//
+
+DentryCache::DentryCache() : entries(DENTRY_CACHE_SIZE), useCounter(0),
+        generation(0) {}
+
+bool DentryCache::lookup(string& path, bool followLastSymlink,
+        ResolvedPath& result)
+{
+    if(entries.empty()) return false;
+    unsigned int h=hash(path,followLastSymlink ? 1 : 2);
+    Lock<FastMutex> l(mutex);
+    Entry *e=find(h,path,false,followLastSymlink);
+    if(e==0) return false;
+    path=e->resolved;
+    result=ResolvedPath(e->fs,e->off);
+    return true;
+}
+
+void DentryCache::add(const string& path, bool followLastSymlink,
+        const string& resolved, const ResolvedPath& result)
+{
+    if(entries.empty() || result.result<0) return;
+    unsigned int h=hash(path,followLastSymlink ? 1 : 2);
+    Lock<FastMutex> l(mutex);
+    Entry *e=find(h,path,false,followLastSymlink);
+    if(e==0) e=victim();
+    e->hash=h;
+    e->valid=true;
+    e->negative=false;
+    e->follow=followLastSymlink;
+    e->off=result.off;
+    e->path=path;
+    e->resolved=resolved;
+    e->fs=result.fs;
+}
+
+bool DentryCache::lookupNegative(const string& resolved,
+        unsigned int& generation)
+{
+    if(entries.empty()) return false;
+    unsigned int h=hash(resolved,3);
+    Lock<FastMutex> l(mutex);
+    generation=this->generation;
+    return find(h,resolved,true,false)!=0;
+}
+
+void DentryCache::addNegative(const string& resolved, unsigned int generation)
+{
+    if(entries.empty()) return;
+    unsigned int h=hash(resolved,3);
+    Lock<FastMutex> l(mutex);
+    //Files were created since the filesystem was accessed, maybe this one too
+    if(generation!=this->generation) return;
+    if(find(h,resolved,true,false)) return;
+    Entry *e=victim();
+    e->hash=h;
+    e->valid=true;
+    e->negative=true;
+    e->follow=false;
+    e->off=0;
+    e->path=resolved;
+    e->resolved.clear();
+    e->fs.reset();
+}
+
+void DentryCache::invalidateNegative()
+{
+    if(entries.empty()) return;
+    Lock<FastMutex> l(mutex);
+    generation++;
+    for(vector<Entry>::iterator it=entries.begin();it!=entries.end();++it)
+    {
+        if(it->valid==false || it->negative==false) continue;
+        it->valid=false;
+        it->path.clear();
+    }
+}
+
+void DentryCache::invalidate()
+{
+    if(entries.empty()) return;
+    Lock<FastMutex> l(mutex);
+    generation++;
+    for(vector<Entry>::iterator it=entries.begin();it!=entries.end();++it)
+    {
+        it->valid=false;
+        it->path.clear();
+        it->resolved.clear();
+        it->fs.reset(); //Don't keep umounted filesystems alive
+    }
+}
+
+unsigned int DentryCache::hash(const string& path, unsigned int tag)
+{
+    //FNV-1a
+    unsigned int result=2166136261u^tag;
+    for(string::const_iterator it=path.begin();it!=path.end();++it)
+    {
+        result^=static_cast<unsigned char>(*it);
+        result*=16777619u;
+    }
+    return result;
+}
+
+DentryCache::Entry *DentryCache::find(unsigned int hash, const string& path,
+        bool negative, bool follow)
+{
+    for(vector<Entry>::iterator it=entries.begin();it!=entries.end();++it)
+    {
+        if(it->valid==false || it->hash!=hash) continue;
+        if(it->negative!=negative || it->path!=path) continue;
+        if(negative==false && it->follow!=follow) continue;
+        it->lastUse=++useCounter;
+        return &(*it);
+    }
+    return 0;
+}
+
+DentryCache::Entry *DentryCache::victim()
+{
+    Entry *result=&entries[0];
+    for(vector<Entry>::iterator it=entries.begin();it!=entries.end();++it)
+    {
+        if(it->valid==false) { result=&(*it); break; }
+        if(it->lastUse<result->lastUse) result=&(*it);
+    }
+    result->lastUse=++useCounter;
+    return result;
+}
+
+#endif //WITH_FILESYSTEM
+
+} //namespace miosix
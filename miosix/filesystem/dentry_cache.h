@@ -0,0 +1,172 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef DENTRY_CACHE_H
+#define	DENTRY_CACHE_H
+
+#include <string>
+#include <vector>
+#include "file.h"
+#include "kernel/sync.h"
+#include "config/miosix_settings.h"
+
+namespace miosix {
+
+#ifdef WITH_FILESYSTEM
+
+// Forward decls
+class ResolvedPath;
+
+/**
+ * Cache of recently resolved paths, used by FilesystemManager to avoid
+ * walking the mountpoint table (and the filesystems, if they support
+ * symlinks) every time the same path is opened.
+ * It also holds negative entries, that is canonical paths that were found not
+ * to exist, so that repeated lookups of missing files don't have to go through
+ * the filesystem directory scan.
+ * The cache has DENTRY_CACHE_SIZE entries, and the least recently used one is
+ * replaced when it is full. This class is thread safe.
+ */
+class DentryCache
+{
+public:
+    /**
+     * Constructor
+     */
+    DentryCache();
+
+    /**
+     * Lookup a path resolution
+     * \param path absolute path as passed to resolvePath(). If found, it is
+     * replaced by the resolved path
+     * \param followLastSymlink as passed to resolvePath()
+     * \param result if found, the resolved path is stored here
+     * \return true if the path was found in the cache
+     */
+    bool lookup(std::string& path, bool followLastSymlink,
+            ResolvedPath& result);
+
+    /**
+     * Add a successful path resolution to the cache
+     * \param path absolute path as passed to resolvePath()
+     * \param followLastSymlink as passed to resolvePath()
+     * \param resolved resolved path
+     * \param result result of the resolution
+     */
+    void add(const std::string& path, bool followLastSymlink,
+            const std::string& resolved, const ResolvedPath& result);
+
+    /**
+     * Lookup a negative entry
+     * \param resolved resolved path
+     * \param generation the current generation is returned here, to be passed
+     * to addNegative() if the path is then found not to exist
+     * \return true if the path is known not to exist
+     */
+    bool lookupNegative(const std::string& resolved, unsigned int& generation);
+
+    /**
+     * Add a negative entry
+     * \param resolved resolved path that was found not to exist
+     * \param generation value returned by lookupNegative() before accessing
+     * the filesystem. If files were created in the meantime the entry is not
+     * added, as it may be already stale
+     */
+    void addNegative(const std::string& resolved, unsigned int generation);
+
+    /**
+     * Drop all negative entries. To be called whenever a file or directory
+     * is created
+     */
+    void invalidateNegative();
+
+    /**
+     * Drop all entries. To be called whenever the filesystem tree changes in
+     * a way that can affect path resolution, such as mount, umount, rename,
+     * unlink and rmdir
+     */
+    void invalidate();
+
+private:
+    DentryCache(const DentryCache&);
+    DentryCache& operator=(const DentryCache&);
+
+    /**
+     * A cache entry
+     */
+    struct Entry
+    {
+        Entry() : hash(0), lastUse(0), valid(false), negative(false),
+                follow(false), off(0) {}
+
+        unsigned int hash;    ///< Hash of path, to speed up lookups
+        unsigned int lastUse; ///< For LRU replacement
+        bool valid;           ///< True if the entry is in use
+        bool negative;        ///< True if the path does not exist
+        bool follow;          ///< followLastSymlink of the resolution
+        size_t off;           ///< Offset into resolved of the fs relative path
+        std::string path;     ///< Path being looked up
+        std::string resolved; ///< Resolved path, unused if negative
+        intrusive_ref_ptr<FilesystemBase> fs; ///< Filesystem, null if negative
+    };
+
+    /**
+     * \param path a path
+     * \param tag distinguishes positive entries with and without
+     * followLastSymlink and negative entries
+     * \return the hash of the path
+     */
+    static unsigned int hash(const std::string& path, unsigned int tag);
+
+    /**
+     * \param hash hash of the entry
+     * \param path path of the entry
+     * \param negative true if looking for a negative entry
+     * \param follow followLastSymlink, ignored for negative entries
+     * \return the matching entry, or 0 if not found. Must be called with the
+     * mutex locked
+     */
+    Entry *find(unsigned int hash, const std::string& path, bool negative,
+            bool follow);
+
+    /**
+     * \return the entry to replace when adding a new one. Must be called with
+     * the mutex locked
+     */
+    Entry *victim();
+
+    FastMutex mutex;
+    std::vector<Entry> entries; ///< The cache entries
+    unsigned int useCounter;    ///< Incremented at each lookup, for LRU
+    unsigned int generation;    ///< Incremented when files are created
+};
+
+#endif //WITH_FILESYSTEM
+
+} //namespace miosix
+
+#endif //DENTRY_CACHE_H
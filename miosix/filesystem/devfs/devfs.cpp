@@ -30,6 +30,9 @@
 #include <errno.h>
 #include <fcntl.h>
 #include "filesystem/stringpart.h"
+#include "filesystem/file_access.h"
+#include "filesystem/pipe/pipe.h"
+#include "kernel/object_pool.h"
 
 using namespace std;
 
@@ -113,6 +116,28 @@ public:
      * \return the exact return value depends on CMD, -1 is returned on error
      */
     virtual int ioctl(int cmd, void *arg);
+    
+    /**
+     * Check whether read() or write() would block
+     * \param events events of interest, such as POLLIN and POLLOUT
+     * \param entry if not null, entry to add to the device PollQueue
+     * \return the ready events among the requested ones
+     */
+    virtual int poll(int events, PollEntry *entry);
+
+    /**
+     * Allocate a DevFsFile from a pool, so that opening devices doesn't use
+     * the heap unless more than DEVFS_FILE_POOL_SIZE files are open
+     * \param size object size
+     * \return a pointer to the allocated memory
+     */
+    static void *operator new(size_t size);
+
+    /**
+     * Free a DevFsFile allocated with operator new
+     * \param p pointer to the object
+     */
+    static void operator delete(void *p);
 
 private:
     intrusive_ref_ptr<Device> dev; ///< Device file
@@ -120,6 +145,22 @@ private:
     int flags;                     ///< File open flags
 };
 
+/// Memory for DevFsFile objects
+static ObjectPool<DevFsFile,DEVFS_FILE_POOL_SIZE> devFsFilePool;
+
+void *DevFsFile::operator new(size_t size)
+{
+    void *result=devFsFilePool.allocate();
+    if(result) return result;
+    return ::operator new(size);
+}
+
+void DevFsFile::operator delete(void *p)
+{
+    if(devFsFilePool.contains(p)) devFsFilePool.deallocate(p);
+    else ::operator delete(p);
+}
+
 ssize_t DevFsFile::write(const void *data, size_t len)
 {
     if((flags & _FWRITE)==0) return -EINVAL;
@@ -176,6 +217,11 @@ int DevFsFile::ioctl(int cmd, void *arg)
     return dev->ioctl(cmd,arg);
 }
 
+int DevFsFile::poll(int events, PollEntry *entry)
+{
+    return dev->poll(events,entry);
+}
+
 //
 // class Device
 //
@@ -219,10 +265,58 @@ int Device::ioctl(int cmd, void *arg)
     return -ENOTTY; //Means the operation does not apply to this descriptor
 }
 
+int Device::poll(int events, PollEntry *entry)
+{
+    return events & (POLLIN | POLLOUT);
+}
+
 Device::~Device() {}
 
 #ifdef WITH_DEVFS
 
+/**
+ * A FIFO special file in DevFs, all its open files share the same pipe
+ */
+class DevFsFifo : public Device
+{
+public:
+    /**
+     * Constructor
+     */
+    DevFsFifo() : Device(Device::STREAM), pipe(new Pipe) {}
+    
+    /**
+     * Return a new end of the FIFO
+     * \param file the file object will be stored here, if the call succeeds
+     * \param fs pointer to the DevFs
+     * \param flags file flags (open for reading, writing, ...)
+     * \param mode file permissions
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int open(intrusive_ref_ptr<FileBase>& file,
+            intrusive_ref_ptr<FilesystemBase> fs, int flags, int mode)
+    {
+        flags++; //To convert from O_RDONLY, O_WRONLY, ... to _FREAD, _FWRITE
+        file=intrusive_ref_ptr<FileBase>(new PipeFile(fs,pipe,
+            flags & (_FREAD | _FWRITE | _FNONBLOCK)));
+        return 0;
+    }
+    
+    /**
+     * Obtain information for the FIFO
+     * \param pstat pointer to stat struct
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int fstat(struct stat *pstat) const
+    {
+        fillStatHelper(pstat,st_ino,st_dev,S_IFIFO | 0600);//prw-------
+        return 0;
+    }
+    
+private:
+    intrusive_ref_ptr<Pipe> pipe; ///< Shared by all the open files
+};
+
 /**
  * Directory class for DevFs 
  */
@@ -324,6 +418,8 @@ bool DevFs::addDevice(const char *name, intrusive_ref_ptr<Device> dev)
     bool result=files.insert(make_pair(StringPart(name),dev)).second;
     //Assign inode to the file
     if(result) dev->setFileInfo(atomicAddExchange(&inodeCount,1),filesystemId);
+    //Paths previously looked up may now exist
+    if(result) FilesystemManager::instance().filesCreated();
     return result;
 }
 
@@ -400,6 +496,17 @@ int DevFs::rmdir(StringPart& name)
     return -EACCES; // No directories support in DevFs yet
 }
 
+int DevFs::mkfifo(StringPart& name, int mode)
+{
+    if(name.empty()) return -EEXIST;
+    for(unsigned int i=0;i<name.length();i++)
+        if(name[i]=='/')
+            return -EACCES; //DevFs does not support subdirectories
+    intrusive_ref_ptr<Device> fifo(new DevFsFifo);
+    if(addDevice(name.c_str(),fifo)==false) return -EEXIST;
+    return 0;
+}
+
 #endif //WITH_DEVFS
 
 } //namespace miosix
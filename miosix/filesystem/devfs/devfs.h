@@ -81,7 +81,7 @@ public:
      * \param mode file permissions
      * \return 0 on success, or a negative number on failure
      */
-    int open(intrusive_ref_ptr<FileBase>& file,
+    virtual int open(intrusive_ref_ptr<FileBase>& file,
             intrusive_ref_ptr<FilesystemBase> fs, int flags, int mode);
     
     /**
@@ -89,7 +89,7 @@ public:
      * \param pstat file information is stored here
      * \return 0 on success, or a negative number on failure
      */
-    int fstat(struct stat *pstat) const;
+    virtual int fstat(struct stat *pstat) const;
     
     /**
      * Check whether the file refers to a terminal.
@@ -150,6 +150,16 @@ public:
      */
     virtual int ioctl(int cmd, void *arg);
     
+    /**
+     * Check whether readBlock() or writeBlock() would block, used to implement
+     * poll(). See FileBase::poll(). This default implementation returns the
+     * device as always ready.
+     * \param events events of interest, such as POLLIN and POLLOUT
+     * \param entry if not null, entry to add to the device PollQueue
+     * \return the ready events among the requested ones
+     */
+    virtual int poll(int events, PollEntry *entry);
+    
     /**
      * Destructor
      */
@@ -257,6 +267,14 @@ public:
      */
     virtual int rmdir(StringPart& name);
     
+    /**
+     * Create a FIFO special file
+     * \param name FIFO name
+     * \param mode FIFO permissions
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int mkfifo(StringPart& name, int mode);
+    
 private:
     
     FastMutex mutex;
@@ -4,13 +4,20 @@
  */
 
 #include "diskio.h"
+#include "ff.h"
 #include "filesystem/ioctl.h"
+#include "kernel/sync.h"
 #include "config/miosix_settings.h"
 
 #ifdef WITH_FILESYSTEM
 
 using namespace miosix;
 
+/// As FatFs releases the volume lock while transferring file data, multiple
+/// threads may access the disk concurrently. This lock makes the seek and the
+/// subsequent read or write atomic
+static FastMutex diskMutex;
+
 // #ifdef __cplusplus
 // extern "C" {
 // #endif
@@ -52,6 +59,7 @@ DRESULT disk_read (
 	UINT count		/* Number of sectors to read (1..255) */
 )
 {
+    Lock<FastMutex> l(diskMutex);
     if(pdrv->lseek(static_cast<off_t>(sector)*512,SEEK_SET)<0) return RES_ERROR;
     if(pdrv->read(buff,count*512)!=static_cast<ssize_t>(count)*512) return RES_ERROR;
     return RES_OK;
@@ -68,6 +76,7 @@ DRESULT disk_write (
 	UINT count		/* Number of sectors to write (1..255) */
 )
 {
+    Lock<FastMutex> l(diskMutex);
     if(pdrv->lseek(static_cast<off_t>(sector)*512,SEEK_SET)<0) return RES_ERROR;
     if(pdrv->write(buff,count*512)!=static_cast<ssize_t>(count)*512) return RES_ERROR;
     return RES_OK;
@@ -105,6 +114,44 @@ DRESULT disk_ioctl (
      return 0x210000;//TODO: this stub just returns date 01/01/1980 0.00.00
  }
 
+/**
+ * \internal
+ * Create the volume sync object. The FastMutex of the Fat32Fs owning the
+ * volume is used, which is already assigned to sobj before mounting
+ */
+int ff_cre_syncobj(BYTE vol, _SYNC_t *sobj)
+{
+    return *sobj!=0;
+}
+
+/**
+ * \internal
+ * Lock the volume
+ */
+int ff_req_grant(_SYNC_t sobj)
+{
+    sobj->lock();
+    return 1;
+}
+
+/**
+ * \internal
+ * Unlock the volume
+ */
+void ff_rel_grant(_SYNC_t sobj)
+{
+    sobj->unlock();
+}
+
+/**
+ * \internal
+ * Delete the volume sync object, which is owned by Fat32Fs
+ */
+int ff_del_syncobj(_SYNC_t sobj)
+{
+    return 1;
+}
+
 // #ifdef __cplusplus
 // }
 // #endif
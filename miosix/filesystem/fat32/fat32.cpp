@@ -35,8 +35,11 @@
 #include <cstring>
 #include <string>
 #include <cstdio>
+#include <climits>
+#include <algorithm>
 #include "filesystem/stringpart.h"
 #include "filesystem/ioctl.h"
+#include "filesystem/write_behind.h"
 #include "util/unicode.h"
 
 using namespace std;
@@ -180,7 +183,9 @@ Fat32Directory::~Fat32Directory()
 }
 
 /**
- * Files of the Fat32Fs filesystem
+ * Files of the Fat32Fs filesystem. Operations on a file are serialized by a
+ * per-file mutex, while FatFs internally locks the volume only when accessing
+ * shared state such as the FAT, so that I/O on different files can overlap
  */
 class Fat32File : public FileBase
 {
@@ -189,7 +194,7 @@ public:
      * Constructor
      * \param parent the filesystem to which this file belongs
      */
-    Fat32File(intrusive_ref_ptr<FilesystemBase> parent, FastMutex& mutex);
+    Fat32File(intrusive_ref_ptr<FilesystemBase> parent);
     
     /**
      * Write data to the file, if the file supports writing.
@@ -234,6 +239,24 @@ public:
      */
     virtual int ioctl(int cmd, void *arg);
     
+    /**
+     * Truncate or extend the file to the given size. If the file is extended,
+     * the extended part reads as zeros. The file pointer is not changed
+     * \param size new file size
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int ftruncate(off_t size);
+    
+    /**
+     * Allocate storage for the byte range [offset,offset+len), extending the
+     * file size if needed, so that subsequent writes to the range can't fail
+     * due to lack of space
+     * \param offset start of the range
+     * \param len length of the range
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int fallocate(off_t offset, off_t len);
+    
     /**
      * \return the FatFs FIL object 
      */
@@ -244,38 +267,112 @@ public:
      */
     void setInode(int inode) { this->inode=inode; }
     
+    /**
+     * Enable direct I/O. In this mode reads and writes must start at a file
+     * offset multiple of the sector size and have a size multiple of the
+     * sector size, and are transferred between the caller's buffer and the
+     * disk with as few multi-block transfers as possible
+     */
+    void setDirect() { direct=true; }
+    
     /**
      * Destructor
      */
     ~Fat32File();
     
 private:
+    /**
+     * Grow the file to the given size, filling it with zeros. Clusters are
+     * reserved in advance, so that they are contiguous if possible.
+     * Must be called with the mutex locked
+     * \param size new file size, must be greater than the current one
+     * \return 0 on success, or a negative number on failure
+     */
+    int extend(DWORD size);
+    
+    /**
+     * Build the cluster link map used by FatFs for fast seek, if the file is
+     * large enough to benefit from it. Must be called with the mutex locked
+     */
+    void buildLinkMap();
+    
+    /**
+     * Drop the cluster link map, needs to be called before any operation
+     * that changes the file's cluster chain. Must be called with the mutex
+     * locked
+     */
+    void dropLinkMap();
+    
+    /// Initial size of the link map, enough for a file with 7 fragments
+    static const unsigned int linkMapInitialSize=16;
+    /// Maximum size of the link map, for a file with up to 63 fragments.
+    /// Files that are more fragmented than this fall back to normal seek
+    static const unsigned int linkMapMaxSize=128;
+    
     FIL file;
-    FastMutex& mutex;
+    FastMutex mutex; ///< Serializes accesses to file
     int inode;
+    bool reserved; ///< True if IOCTL_RESERVE was used
+    bool direct;   ///< True if opened with O_DIRECT
+    bool noLinkMap; ///< True if the file is too fragmented for a link map
+    unsigned long long linkMapBytes; ///< Bytes covered by the link map
+    #ifdef WITH_WRITE_BEHIND
+    bool writeBehind; ///< True if the file has been passed to WriteBehind
+    #endif //WITH_WRITE_BEHIND
 };
 
 //
 // class Fat32File
 //
 
-Fat32File::Fat32File(intrusive_ref_ptr<FilesystemBase> parent, FastMutex& mutex)
-        : FileBase(parent), mutex(mutex), inode(0) {}
+Fat32File::Fat32File(intrusive_ref_ptr<FilesystemBase> parent)
+        : FileBase(parent), inode(0), reserved(false), direct(false),
+          noLinkMap(false),
+          linkMapBytes(0)
+{
+    #ifdef WITH_WRITE_BEHIND
+    writeBehind=false;
+    #endif //WITH_WRITE_BEHIND
+}
 
 ssize_t Fat32File::write(const void *data, size_t len)
 {
     Lock<FastMutex> l(mutex);
+    //FatFs can't extend the cluster chain in fast seek mode
+    if(file.cltbl && f_tell(&file)+len>linkMapBytes) dropLinkMap();
+    if(direct)
+    {
+        if(f_tell(&file) % _MAX_SS || len % _MAX_SS) return -EINVAL;
+        DWORD end=f_tell(&file)+len;
+        if(end>f_size(&file) && end>f_tell(&file))
+        {
+            //Allocate all the clusters before writing, so that they are
+            //contiguous if possible and f_write can do a single transfer.
+            //If this fails, f_write will allocate as much as it can
+            dropLinkMap();
+            if(f_reserve(&file,end)==FR_OK) reserved=true;
+        }
+    }
     unsigned int bytesWritten;
     if(int res=translateError(f_write(&file,data,len,&bytesWritten))) return res;
     #ifdef SYNC_AFTER_WRITE
     if(f_sync(&file)!=FR_OK) return -EIO;
-    #endif //SYNC_AFTER_WRITE    
+    #endif //SYNC_AFTER_WRITE
+    #ifdef WITH_WRITE_BEHIND
+    if(bytesWritten>0)
+    {
+        writeBehind=true;
+        if(WriteBehind::instance().written(this,bytesWritten))
+            if(f_sync(&file)!=FR_OK) return -EIO;
+    }
+    #endif //WITH_WRITE_BEHIND
     return static_cast<int>(bytesWritten);
 }
 
 ssize_t Fat32File::read(void *data, size_t len)
 {
     Lock<FastMutex> l(mutex);
+    if(direct && (f_tell(&file) % _MAX_SS || len % _MAX_SS)) return -EINVAL;
     unsigned int bytesRead;
     if(int res=translateError(f_read(&file,data,len,&bytesRead))) return res;
     return static_cast<int>(bytesRead);
@@ -301,6 +398,7 @@ off_t Fat32File::lseek(off_t pos, int whence)
     }
     //We don't support seek past EOF for Fat32
     if(offset<0 || offset>static_cast<off_t>(f_size(&file))) return -EOVERFLOW;
+    buildLinkMap();
     if(int result=translateError(
         f_lseek(&file,static_cast<unsigned long>(offset)))) return result;
     return offset;
@@ -321,15 +419,144 @@ int Fat32File::fstat(struct stat *pstat) const
 
 int Fat32File::ioctl(int cmd, void *arg)
 {
-    if(cmd!=IOCTL_SYNC) return -ENOTTY;
     Lock<FastMutex> l(mutex);
-    return translateError(f_sync(&file));
+    switch(cmd)
+    {
+        case IOCTL_SYNC:
+            #ifdef WITH_WRITE_BEHIND
+            if(writeBehind) WriteBehind::instance().synced(this);
+            #endif //WITH_WRITE_BEHIND
+            return translateError(f_sync(&file));
+        case IOCTL_RESERVE:
+        {
+            off_t size=*reinterpret_cast<off_t*>(arg);
+            if(size<0) return -EINVAL;
+            if(size>INT_MAX) return -EFBIG;
+            dropLinkMap();
+            FRESULT res=f_reserve(&file,size);
+            if(res==FR_OK) reserved=true;
+            return translateError(res);
+        }
+        default:
+            return -ENOTTY;
+    }
+}
+
+int Fat32File::ftruncate(off_t size)
+{
+    if(size<0) return -EINVAL;
+    if(size>INT_MAX) return -EFBIG;
+    Lock<FastMutex> l(mutex);
+    dropLinkMap();
+    DWORD oldPos=f_tell(&file);
+    int result;
+    if(size>static_cast<off_t>(f_size(&file))) result=extend(size);
+    else {
+        //Also frees clusters reserved past the new end of file
+        result=translateError(f_lseek(&file,size));
+        if(result==0) result=translateError(f_truncate(&file));
+    }
+    //We don't support seek past EOF for Fat32, so the file pointer is clamped
+    f_lseek(&file,min<DWORD>(oldPos,f_size(&file)));
+    if(result==0) result=translateError(f_sync(&file));
+    return result;
+}
+
+int Fat32File::fallocate(off_t offset, off_t len)
+{
+    if(offset<0 || len<=0) return -EINVAL;
+    if(offset+len>INT_MAX) return -EFBIG;
+    Lock<FastMutex> l(mutex);
+    if(offset+len<=static_cast<off_t>(f_size(&file))) return 0;
+    dropLinkMap();
+    DWORD oldPos=f_tell(&file);
+    int result=extend(offset+len);
+    f_lseek(&file,oldPos);
+    if(result==0) result=translateError(f_sync(&file));
+    return result;
 }
 
 Fat32File::~Fat32File()
 {
+    #ifdef WITH_WRITE_BEHIND
+    //Must be done before locking the mutex, as the flusher thread may be
+    //syncing this file
+    if(writeBehind) WriteBehind::instance().closed(this);
+    #endif //WITH_WRITE_BEHIND
     Lock<FastMutex> l(mutex);
-    if(inode) f_close(&file); //TODO: what to do with error code?
+    if(inode==0) return;
+    dropLinkMap();
+    if(reserved)
+    {
+        //Free reserved clusters that were not written to
+        if(f_lseek(&file,f_size(&file))==FR_OK) f_truncate(&file);
+    }
+    f_close(&file); //TODO: what to do with error code?
+}
+
+void Fat32File::buildLinkMap()
+{
+    if(file.cltbl || noLinkMap) return;
+    //Small files are seeked fast enough by following the FAT
+    const DWORD clusterSize=file.fs->csize*_MAX_SS;
+    if(f_size(&file)<=4*clusterSize) return;
+    DWORD size=linkMapInitialSize;
+    for(;;)
+    {
+        DWORD *map=new DWORD[size];
+        map[0]=size;
+        file.cltbl=map;
+        FRESULT res=f_lseek(&file,CREATE_LINKMAP);
+        if(res==FR_OK)
+        {
+            //Table is a sequence of (length,start cluster) pairs, 0 terminated
+            linkMapBytes=0;
+            for(DWORD *p=map+1;*p;p+=2) linkMapBytes+=*p;
+            linkMapBytes*=clusterSize;
+            return;
+        }
+        file.cltbl=0;
+        DWORD needed=map[0]; //On FR_NOT_ENOUGH_CORE, the required size
+        delete[] map;
+        if(res!=FR_NOT_ENOUGH_CORE || needed>linkMapMaxSize)
+        {
+            noLinkMap=true;
+            return;
+        }
+        size=needed;
+    }
+}
+
+void Fat32File::dropLinkMap()
+{
+    noLinkMap=false;
+    linkMapBytes=0;
+    if(file.cltbl==0) return;
+    delete[] file.cltbl;
+    file.cltbl=0;
+}
+
+int Fat32File::extend(DWORD size)
+{
+    if(int result=translateError(f_reserve(&file,size))) return result;
+    if(int result=translateError(f_lseek(&file,f_size(&file)))) return result;
+    //Write zeros in chunks large enough to be transferred as multiple sectors
+    const unsigned int chunkSize=4096;
+    char *zeros=new char[chunkSize];
+    memset(zeros,0,chunkSize);
+    int result=0;
+    while(f_size(&file)<size)
+    {
+        //First align the file pointer to the chunk size
+        unsigned int len=chunkSize-f_tell(&file) % chunkSize;
+        len=min<DWORD>(len,size-f_size(&file));
+        unsigned int bytesWritten;
+        result=translateError(f_write(&file,zeros,len,&bytesWritten));
+        if(result==0 && bytesWritten!=len) result=-ENOSPC;
+        if(result) break;
+    }
+    delete[] zeros;
+    return result;
 }
 
 //
@@ -340,6 +567,7 @@ Fat32Fs::Fat32Fs(intrusive_ref_ptr<FileBase> disk)
         : mutex(FastMutex::RECURSIVE), failed(true)
 {
     filesystem.drv=disk;
+    filesystem.sobj=&mutex; //FatFs uses our mutex as the volume lock
     failed=f_mount(&filesystem,1,false)!=FR_OK;
 }
 
@@ -375,7 +603,7 @@ int Fat32Fs::open(intrusive_ref_ptr<FileBase>& file, StringPart& name,
         else if(flags & _FCREAT) openflags|=FA_OPEN_ALWAYS;//If !exists create
         else openflags|=FA_OPEN_EXISTING;//If not exists fail
 
-        intrusive_ref_ptr<Fat32File> f(new Fat32File(shared_from_this(),mutex));
+        intrusive_ref_ptr<Fat32File> f(new Fat32File(shared_from_this()));
         Lock<FastMutex> l(mutex);
         if(int res=translateError(f_open(&filesystem,f->fil(),name.c_str(),openflags)))
             return res;
@@ -385,13 +613,16 @@ int Fat32Fs::open(intrusive_ref_ptr<FileBase>& file, StringPart& name,
             if(int result=lstat(name,&st)) return result;
         }
         f->setInode(st.st_ino);
+        #ifdef _FDIRECT
+        if(flags & _FDIRECT) f->setDirect();
+        #endif //_FDIRECT
 
         //Can't open files larger than INT_MAX
         if(static_cast<int>(f_size(f->fil()))<0) return -EOVERFLOW;
 
-        #ifdef SYNC_AFTER_WRITE
+        #if defined(SYNC_AFTER_WRITE) || defined(WITH_WRITE_BEHIND)
         if(f_sync(f->fil())!=FR_OK) return -EFAULT;
-        #endif //SYNC_AFTER_WRITE
+        #endif //SYNC_AFTER_WRITE || WITH_WRITE_BEHIND
 
         //If file opened for appending, seek to end of file
         if(flags & _FAPPEND)
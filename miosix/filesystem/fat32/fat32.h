@@ -114,7 +114,7 @@ private:
     int unlinkRmdirHelper(StringPart& name, bool delDir);
     
     FATFS filesystem;
-    FastMutex mutex;
+    FastMutex mutex; ///< Volume lock, also used by FatFs as its sync object
     bool failed; ///< Failed to mount
 };
 
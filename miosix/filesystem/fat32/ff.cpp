@@ -167,9 +167,8 @@
 
 /* Reentrancy related */
 #if _FS_REENTRANT
-#if _USE_LFN == 1
-#error Static LFN work area cannot be used at thread-safe configuration.
-#endif
+//Note: the static LFN work area is in the FATFS object, and is thus protected
+//by the volume lock, so _USE_LFN == 1 is thread-safe in this port
 #define	ENTER_FF(fs)		{ if (!lock_fs(fs)) return FR_TIMEOUT; }
 #define	LEAVE_FF(fs, res)	{ unlock_fs(fs, res); return res; }
 #else
@@ -177,6 +176,18 @@
 #define LEAVE_FF(fs, res)	return res
 #endif
 
+//f_read() and f_write() release the volume lock while transferring file data
+//sectors, so that an I/O on one file does not block other files. This is safe
+//as the file's cluster chain can't change while the file is open (_FS_LOCK)
+//and the caller serializes concurrent access to the same FIL object
+#if _FS_REENTRANT
+#define	SUSPEND_FF(fs)		ff_rel_grant((fs)->sobj)
+#define	RESUME_FF(fs)		ff_req_grant((fs)->sobj)
+#else
+#define	SUSPEND_FF(fs)
+#define	RESUME_FF(fs)
+#endif
+
 #define	ABORT(fs, res)		{ fp->err = (BYTE)(res); LEAVE_FF(fs, res); }
 
 
@@ -2601,9 +2612,22 @@ FRESULT f_read (
 			sect += csect;
 			cc = btr / SS(fp->fs);				/* When remaining bytes >= sector size, */
 			if (cc) {							/* Read maximum contiguous sectors directly */
-				if (csect + cc > fp->fs->csize)	/* Clip at cluster boundary */
+				if (csect + cc > fp->fs->csize) {	/* Clip at cluster boundary */
 					cc = fp->fs->csize - csect;
-				if (disk_read(fp->fs->drv, rbuff, sect, cc))
+					//Extend the transfer over physically contiguous clusters
+					//including the first sectors of a last, partially used, one
+					while (btr / SS(fp->fs) > cc) {
+						clst = get_fat(fp->fs, fp->clust);
+						if (clst != fp->clust + 1) break;
+						fp->clust = clst;
+						cc += fp->fs->csize;
+					}
+					if (cc > btr / SS(fp->fs)) cc = btr / SS(fp->fs);
+				}
+				SUSPEND_FF(fp->fs);
+				DRESULT dres = disk_read(fp->fs->drv, rbuff, sect, cc);
+				RESUME_FF(fp->fs);
+				if (dres)
 					ABORT(fp->fs, FR_DISK_ERR);
 #if !_FS_READONLY && _FS_MINIMIZE <= 2			/* Replace one of the read sectors with cached data if it contains a dirty sector */
 #if _FS_TINY
@@ -2619,14 +2643,18 @@ FRESULT f_read (
 			}
 #if !_FS_TINY
 			if (fp->dsect != sect) {			/* Load data sector if not in cache */
+				DRESULT dres = RES_OK;
+				SUSPEND_FF(fp->fs);
 #if !_FS_READONLY
 				if (fp->flag & FA__DIRTY) {		/* Write-back dirty sector cache */
-					if (disk_write(fp->fs->drv, fp->buf, fp->dsect, 1))
-						ABORT(fp->fs, FR_DISK_ERR);
-					fp->flag &= ~FA__DIRTY;
+					dres = disk_write(fp->fs->drv, fp->buf, fp->dsect, 1);
+					if (dres == RES_OK) fp->flag &= ~FA__DIRTY;
 				}
 #endif
-				if (disk_read(fp->fs->drv, fp->buf, sect, 1))	/* Fill sector cache */
+				if (dres == RES_OK)				/* Fill sector cache */
+					dres = disk_read(fp->fs->drv, fp->buf, sect, 1);
+				RESUME_FF(fp->fs);
+				if (dres)
 					ABORT(fp->fs, FR_DISK_ERR);
 			}
 #endif
@@ -2705,7 +2733,10 @@ FRESULT f_write (
 				ABORT(fp->fs, FR_DISK_ERR);
 #else
 			if (fp->flag & FA__DIRTY) {		/* Write-back sector cache */
-				if (disk_write(fp->fs->drv, fp->buf, fp->dsect, 1))
+				SUSPEND_FF(fp->fs);
+				DRESULT dres = disk_write(fp->fs->drv, fp->buf, fp->dsect, 1);
+				RESUME_FF(fp->fs);
+				if (dres)
 					ABORT(fp->fs, FR_DISK_ERR);
 				fp->flag &= ~FA__DIRTY;
 			}
@@ -2715,9 +2746,23 @@ FRESULT f_write (
 			sect += csect;
 			cc = btw / SS(fp->fs);			/* When remaining bytes >= sector size, */
 			if (cc) {						/* Write maximum contiguous sectors directly */
-				if (csect + cc > fp->fs->csize)	/* Clip at cluster boundary */
+				if (csect + cc > fp->fs->csize) {	/* Clip at cluster boundary */
 					cc = fp->fs->csize - csect;
-				if (disk_write(fp->fs->drv, wbuff, sect, cc))
+					//Extend the transfer over physically contiguous clusters
+					//that are already allocated, such as reserved with f_reserve
+					//including the first sectors of a last, partially used, one
+					while (btw / SS(fp->fs) > cc) {
+						clst = get_fat(fp->fs, fp->clust);
+						if (clst != fp->clust + 1) break;
+						fp->clust = clst;
+						cc += fp->fs->csize;
+					}
+					if (cc > btw / SS(fp->fs)) cc = btw / SS(fp->fs);
+				}
+				SUSPEND_FF(fp->fs);
+				DRESULT dres = disk_write(fp->fs->drv, wbuff, sect, cc);
+				RESUME_FF(fp->fs);
+				if (dres)
 					ABORT(fp->fs, FR_DISK_ERR);
 #if _FS_MINIMIZE <= 2
 #if _FS_TINY
@@ -2741,10 +2786,12 @@ FRESULT f_write (
 				fp->fs->winsect = sect;
 			}
 #else
-			if (fp->dsect != sect) {		/* Fill sector cache with file data */
-				if (fp->fptr < fp->fsize &&
-					disk_read(fp->fs->drv, fp->buf, sect, 1))
-						ABORT(fp->fs, FR_DISK_ERR);
+			if (fp->dsect != sect && fp->fptr < fp->fsize) {	/* Fill sector cache with file data */
+				SUSPEND_FF(fp->fs);
+				DRESULT dres = disk_read(fp->fs->drv, fp->buf, sect, 1);
+				RESUME_FF(fp->fs);
+				if (dres)
+					ABORT(fp->fs, FR_DISK_ERR);
 			}
 #endif
 			fp->dsect = sect;
@@ -3415,12 +3462,19 @@ FRESULT f_truncate (
 		}
 	}
 	if (res == FR_OK) {
-		if (fp->fsize > fp->fptr) {
-			fp->fsize = fp->fptr;	/* Set file size to current R/W point */
-			fp->flag |= FA__WRITTEN;
+		//Note: also when fsize == fptr, to free clusters reserved past
+		//the end of file by f_reserve()
+		if (fp->fsize >= fp->fptr) {
+			if (fp->fsize > fp->fptr) {
+				fp->fsize = fp->fptr;	/* Set file size to current R/W point */
+				fp->flag |= FA__WRITTEN;
+			}
 			if (fp->fptr == 0) {	/* When set file size to zero, remove entire cluster chain */
-				res = remove_chain(fp->fs, fp->sclust);
-				fp->sclust = 0;
+				if (fp->sclust) {
+					res = remove_chain(fp->fs, fp->sclust);
+					fp->sclust = 0;
+					fp->flag |= FA__WRITTEN;
+				}
 			} else {				/* When truncate a part of the file, remove remaining clusters */
 				ncl = get_fat(fp->fs, fp->clust);
 				res = FR_OK;
@@ -3449,6 +3503,128 @@ FRESULT f_truncate (
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Reserve Clusters                                                      */
+/*-----------------------------------------------------------------------*/
+/* Extend the cluster chain of a file so that it can grow up to fsz bytes
+/  without allocating clusters. A physically contiguous run of clusters is
+/  searched first, so that writes to the reserved area can be transferred as
+/  multiple sectors at once. The file size does not change, clusters past
+/  the end of file are freed by f_truncate(). If there is not enough space,
+/  the cluster chain is left unchanged. */
+
+/* The volume is locked during the search, so only this many FAT entries are
+/  scanned before falling back to allocating clusters one by one */
+#define RESERVE_SCAN_MAX	4096
+
+FRESULT f_reserve (
+	FIL* fp,		/* Pointer to the file object */
+	DWORD fsz		/* Size the file must be able to grow to */
+)
+{
+	FRESULT res;
+	DWORD csz, need, ncl, lcl, clst, cs, stop, run, scan, end;
+	FATFS *fs;
+
+
+	res = validate(fp);						/* Check validity of the object */
+	if (res == FR_OK) {
+		if (fp->err) {						/* Check error */
+			res = (FRESULT)fp->err;
+		} else {
+			if (!(fp->flag & FA_WRITE))		/* Check access mode */
+				res = FR_DENIED;
+		}
+	}
+	if (res != FR_OK) LEAVE_FF(fp->fs, res);
+	fs = fp->fs;
+
+	csz = (DWORD)fs->csize * SS(fs);		/* Cluster size in bytes */
+	need = fsz / csz + (fsz % csz ? 1 : 0);	/* Clusters needed */
+	ncl = lcl = 0;							/* Follow the current chain to its end */
+	for (clst = fp->sclust; clst >= 2 && clst < fs->n_fatent; ) {
+		ncl++;
+		lcl = clst;
+		clst = get_fat(fs, clst);
+		if (clst == 1) LEAVE_FF(fs, FR_INT_ERR);
+		if (clst == 0xFFFFFFFF) LEAVE_FF(fs, FR_DISK_ERR);
+	}
+	if (ncl >= need) LEAVE_FF(fs, FR_OK);	/* Already large enough */
+	need -= ncl;
+
+	/* Look for a contiguous run of free clusters, preferably after the chain */
+	clst = lcl ? lcl + 1 : fs->last_clust + 1;
+	if (clst < 2 || clst >= fs->n_fatent) clst = 2;
+	stop = clst;
+	run = 0;
+	scan = need > RESERVE_SCAN_MAX ? need : RESERVE_SCAN_MAX;
+	for (;;) {
+		cs = get_fat(fs, clst);
+		if (cs == 1) LEAVE_FF(fs, FR_INT_ERR);
+		if (cs == 0xFFFFFFFF) LEAVE_FF(fs, FR_DISK_ERR);
+		if (cs == 0) {
+			if (++run == need) break;		/* Found */
+		} else run = 0;
+		if (++clst >= fs->n_fatent) {		/* Wrap around, a run can't wrap */
+			clst = 2;
+			run = 0;
+		}
+		if (clst == stop || --scan == 0) break;	/* Not found */
+	}
+
+	if (run == need) {						/* Link the run to the chain */
+		clst = clst - need + 1;				/* First cluster of the run */
+		for (cs = clst; cs < clst + need - 1 && res == FR_OK; cs++)
+			res = put_fat(fs, cs, cs + 1);
+		if (res == FR_OK) res = put_fat(fs, cs, 0x0FFFFFFF);
+		if (res == FR_OK) {
+			if (lcl) {
+				res = put_fat(fs, lcl, clst);
+			} else {
+				fp->sclust = clst;
+				fp->flag |= FA__WRITTEN;	/* Directory entry needs update */
+			}
+		}
+		if (res == FR_OK) {
+			fs->last_clust = cs;
+			if (fs->free_clust != 0xFFFFFFFF) {
+				fs->free_clust -= need;
+				fs->fsi_flag |= 1;
+			}
+		}
+	} else {								/* Fragmented volume, allocate one by one */
+		end = lcl;
+		for (; need && res == FR_OK; need--) {
+			clst = create_chain(fs, lcl);
+			if (clst == 0) res = FR_DENIED;
+			else if (clst == 1) res = FR_INT_ERR;
+			else if (clst == 0xFFFFFFFF) res = FR_DISK_ERR;
+			else {
+				if (!lcl) {
+					fp->sclust = clst;
+					fp->flag |= FA__WRITTEN;
+				}
+				lcl = clst;
+			}
+		}
+		if (res != FR_OK && lcl != end) {	/* Free the clusters allocated so far */
+			if (end) {
+				clst = get_fat(fs, end);
+				if (put_fat(fs, end, 0x0FFFFFFF) == FR_OK) remove_chain(fs, clst);
+			} else {
+				clst = fp->sclust;
+				fp->sclust = 0;
+				remove_chain(fs, clst);
+			}
+		}
+	}
+
+	LEAVE_FF(fs, res);
+}
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Delete a File or Directory                                            */
 /*-----------------------------------------------------------------------*/
@@ -44,8 +44,10 @@
 /* To enable f_mkfs() function, set _USE_MKFS to 1 and set _FS_READONLY to 0 */
 
 
-#define	_USE_FASTSEEK	0	/* 0:Disable or 1:Enable */
+#define	_USE_FASTSEEK	1	/* 0:Disable or 1:Enable */
 /* To enable fast seek feature, set _USE_FASTSEEK to 1. */
+//Note: the cluster link map is built lazily by Fat32File on the first
+//seek in large files, and dropped whenever the cluster chain may change
 
 
 #define _USE_LABEL		0	/* 0:Disable or 1:Enable */
@@ -196,12 +198,13 @@
 /* A header file that defines sync object types on the O/S, such as
 /  windows.h, ucos_ii.h and semphr.h, must be included prior to ff.h. */
 
-//Note by TFT: the reentrant option uses just one big lock for each FATFS, so
-//given there's no concurrency advantage in using this option, we're just using
-//an ordinary FastMutex in class Fat32Fs and locking it before calling FatFs.
-#define _FS_REENTRANT	0		/* 0:Disable or 1:Enable */
+//Note: the sync object is the FastMutex of class Fat32Fs, used as the
+//volume lock. FatFs locks it for the duration of each call, except while
+//f_read() and f_write() transfer file data, so that accessing a file does not
+//block access to other files for the duration of the disk transaction.
+#define _FS_REENTRANT	1		/* 0:Disable or 1:Enable */
 #define _FS_TIMEOUT		1000	/* Timeout period in unit of time ticks */
-#define	_SYNC_t			HANDLE	/* O/S dependent type of sync object. e.g. HANDLE, OS_EVENT*, ID and etc.. */
+#define	_SYNC_t			miosix::FastMutex*	/* O/S dependent type of sync object. e.g. HANDLE, OS_EVENT*, ID and etc.. */
 
 /* The _FS_REENTRANT option switches the re-entrancy (thread safe) of the FatFs module.
 /
@@ -31,6 +31,8 @@
 #include <fcntl.h>
 #include "file_access.h"
 #include "config/miosix_settings.h"
+#include "kernel/kernel.h"
+#include "kernel/scheduler/scheduler.h"
 
 using namespace std;
 
@@ -68,11 +70,41 @@ int FileBase::ioctl(int cmd, void *arg)
     return -ENOTTY; //Means the operation does not apply to this descriptor
 }
 
+int FileBase::ftruncate(off_t size)
+{
+    return -EINVAL; //Not a regular file
+}
+
+int FileBase::fallocate(off_t offset, off_t len)
+{
+    return -ENODEV; //Not a regular file
+}
+
 int FileBase::getdents(void *dp, int len)
 {
     return -EBADF;
 }
 
+int FileBase::poll(int events, PollEntry *entry)
+{
+    return events & (POLLIN | POLLOUT);
+}
+
+ssize_t FileBase::spliceTo(FileBase *out, size_t len)
+{
+    return -EINVAL; //Default implementation, for files without a buffer
+}
+
+ssize_t FileBase::spliceFrom(FileBase *in, size_t len)
+{
+    return -EINVAL; //Default implementation, for files without a buffer
+}
+
+const void *FileBase::getSpliceBuffer() const
+{
+    return 0; //Default implementation, for files without a buffer
+}
+
 #endif //WITH_FILESYSTEM
 
 FileBase::~FileBase()
@@ -170,6 +202,11 @@ int FilesystemBase::readlink(StringPart& name, string& target)
     return -EINVAL; //Default implementation, for filesystems without symlinks
 }
 
+int FilesystemBase::mkfifo(StringPart& name, int mode)
+{
+    return -EPERM; //Default implementation, for filesystems without FIFOs
+}
+
 bool FilesystemBase::supportsSymlinks() const { return false; }
 
 void FilesystemBase::newFileOpened() { atomicAdd(&openFileCount,1); }
@@ -186,4 +223,66 @@ void FilesystemBase::fileCloseHook()
 
 FilesystemBase::~FilesystemBase() {}
 
+//
+// class PollQueue
+//
+
+void PollQueue::IRQadd(PollEntry *entry)
+{
+    if(entry->queue) return; //Already added
+    entry->queue=this;
+    entry->prev=0;
+    entry->next=head;
+    if(head) head->prev=entry;
+    head=entry;
+}
+
+void PollQueue::add(PollEntry *entry)
+{
+    FastInterruptDisableLock dLock;
+    IRQadd(entry);
+}
+
+void PollQueue::IRQwakeup()
+{
+    if(IRQwakeupWaiters()) Scheduler::IRQfindNextThread();
+}
+
+void PollQueue::wakeup()
+{
+    if(head==0) return; //Nobody is polling, avoid disabling interrupts
+    bool hppw;
+    {
+        FastInterruptDisableLock dLock;
+        hppw=IRQwakeupWaiters();
+    }
+    //If the woken thread has higher priority than our priority, yield
+    if(hppw) Thread::yield();
+}
+
+void PollQueue::remove(PollEntry *entry)
+{
+    FastInterruptDisableLock dLock;
+    PollQueue *queue=entry->queue;
+    if(queue==0) return;
+    if(entry->prev) entry->prev->next=entry->next;
+    else queue->head=entry->next;
+    if(entry->next) entry->next->prev=entry->prev;
+    entry->queue=0;
+}
+
+bool PollQueue::IRQwakeupWaiters()
+{
+    bool hppw=false;
+    for(PollEntry *e=head;e;e=e->next)
+    {
+        e->waiter->woken=true;
+        Thread *t=e->waiter->thread;
+        t->IRQwakeup();
+        if(t->IRQgetPriority()>Thread::IRQgetCurrentThread()->IRQgetPriority())
+            hppw=true;
+    }
+    return hppw;
+}
+
 } //namespace miosix
@@ -29,6 +29,7 @@
 #include <sys/stat.h>
 #include "kernel/intrusive.h"
 #include "config/miosix_settings.h"
+#include "poll.h"
 
 #ifndef FILE_H
 #define	FILE_H
@@ -38,6 +39,93 @@ namespace miosix {
 // Forward decls
 class FilesystemBase;
 class StringPart;
+class Thread;
+class PollQueue;
+
+/**
+ * \internal
+ * A thread blocked in poll()
+ */
+struct PollWaiter
+{
+    Thread *thread;      ///< Thread blocked in poll()
+    volatile bool woken; ///< Set when one of the polled files changes state
+};
+
+/**
+ * \internal
+ * Links a PollWaiter to the PollQueue of one of the files it is polling.
+ * poll() allocates one for each polled file
+ */
+struct PollEntry
+{
+    PollEntry() : waiter(0), queue(0), prev(0), next(0) {}
+
+    PollWaiter *waiter; ///< The thread blocked in poll()
+    PollQueue *queue;   ///< Queue this entry is in, or 0
+    PollEntry *prev;    ///< Previous entry in the queue
+    PollEntry *next;    ///< Next entry in the queue
+};
+
+/**
+ * Files and devices whose read() or write() can block embed one of these,
+ * and wake it whenever they may have become readable or writable, so that
+ * threads blocked in poll() on them are woken
+ */
+class PollQueue
+{
+public:
+    /**
+     * Constructor
+     */
+    PollQueue() : head(0) {}
+
+    /**
+     * Add a thread blocked in poll() to the queue. Must be called with
+     * interrupts disabled. To avoid missed wakeups, the check that the file
+     * is not ready and the call to this function must happen atomically with
+     * respect to the code calling IRQwakeup()
+     * \param entry entry passed to FileBase::poll()
+     */
+    void IRQadd(PollEntry *entry);
+
+    /**
+     * Add a thread blocked in poll() to the queue
+     * \param entry entry passed to FileBase::poll()
+     */
+    void add(PollEntry *entry);
+
+    /**
+     * Wake all the threads blocked in poll() on this queue. Must be called with
+     * interrupts disabled, can be called from interrupt context
+     */
+    void IRQwakeup();
+
+    /**
+     * Wake all the threads blocked in poll() on this queue
+     */
+    void wakeup();
+
+    /**
+     * Remove an entry from the queue it is in, if any
+     * \param entry entry to remove
+     */
+    static void remove(PollEntry *entry);
+
+private:
+    PollQueue(const PollQueue&);
+    PollQueue& operator=(const PollQueue&);
+
+    /**
+     * Wake all the threads blocked in poll() on this queue. Must be called with
+     * interrupts disabled
+     * \return true if a thread with higher priority than the current one was
+     * woken
+     */
+    bool IRQwakeupWaiters();
+
+    PollEntry *head; ///< First entry in the queue
+};
 
 /**
  * The unix file abstraction. Also some device drivers are seen as files.
@@ -113,6 +201,24 @@ public:
      */
     virtual int ioctl(int cmd, void *arg);
     
+    /**
+     * Truncate or extend the file to the given size. If the file is extended,
+     * the extended part reads as zeros. The file pointer is not changed
+     * \param size new file size
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int ftruncate(off_t size);
+    
+    /**
+     * Allocate storage for the byte range [offset,offset+len), extending the
+     * file size if needed, so that subsequent writes to the range can't fail
+     * due to lack of space
+     * \param offset start of the range
+     * \param len length of the range
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int fallocate(off_t offset, off_t len);
+    
     /**
      * Also directories can be opened as files. In this case, this system call
      * allows to retrieve directory entries.
@@ -124,6 +230,48 @@ public:
      */
     virtual int getdents(void *dp, int len);
     
+    /**
+     * Check whether read() or write() would block, used to implement poll().
+     * Files whose read() or write() can block have to override this, and if
+     * not ready and entry is not null, add entry to a PollQueue that is woken
+     * when the file state changes. The default implementation returns the
+     * file as always ready, as it is for regular files.
+     * \param events events of interest, such as POLLIN and POLLOUT
+     * \param entry if not null, entry to add to the file PollQueue
+     * \return the ready events among the requested ones, plus POLLERR and
+     * POLLHUP if those conditions occurred
+     */
+    virtual int poll(int events, PollEntry *entry);
+    
+    /**
+     * Move data from this file to another without going through a user
+     * buffer, used to implement splice(). Only files that have an internal
+     * buffer, such as pipes, implement this. The default implementation
+     * returns -EINVAL
+     * \param out file where data is written
+     * \param len maximum number of bytes to move
+     * \return the number of moved bytes, or a negative number on failure
+     */
+    virtual ssize_t spliceTo(FileBase *out, size_t len);
+    
+    /**
+     * Move data from another file to this one without going through a user
+     * buffer, used to implement splice(). Only files that have an internal
+     * buffer, such as pipes, implement this. The default implementation
+     * returns -EINVAL
+     * \param in file where data is read
+     * \param len maximum number of bytes to move
+     * \return the number of moved bytes, or a negative number on failure
+     */
+    virtual ssize_t spliceFrom(FileBase *in, size_t len);
+    
+    /**
+     * \return the object owning the internal buffer used by spliceTo() and
+     * spliceFrom(), so that splice() can reject moving data from a buffer to
+     * itself. The default implementation returns null
+     */
+    virtual const void *getSpliceBuffer() const;
+    
     /**
      * \return a pointer to the parent filesystem
      */
@@ -307,6 +455,15 @@ public:
      */
     virtual int rmdir(StringPart& name)=0;
     
+    /**
+     * Create a FIFO special file. The default implementation returns -EPERM,
+     * for filesystems that can't store FIFOs
+     * \param name FIFO name
+     * \param mode FIFO permissions
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int mkfifo(StringPart& name, int mode);
+    
     /**
      * Follows a symbolic link
      * \param path path identifying a symlink, relative to the local filesystem
@@ -32,7 +32,10 @@
 #include "console/console_device.h"
 #include "mountpointfs/mountpointfs.h"
 #include "fat32/fat32.h"
+#include "block_cache/block_cache.h"
+#include "pipe/pipe.h"
 #include "kernel/logging.h"
+#include "kernel/kernel.h"
 #ifdef WITH_PROCESSES
 #include "kernel/process.h"
 #endif //WITH_PROCESSES
@@ -69,24 +72,42 @@ namespace miosix {
  * of a string.
  */
 
+/**
+ * Drop a reference removed from a file descriptor table, unless another
+ * thread is accessing the file through a BorrowedFile, in which case the
+ * reference is transferred to it
+ * \param file reference removed from the table
+ */
+static void dropRemovedFile(intrusive_ref_ptr<FileBase>& file)
+{
+    if(file && HazardPointer::transferOwnership(file.get())) file.detach();
+}
+
 //
 // class FileDescriptorTable
 //
 
 FileDescriptorTable::FileDescriptorTable()
-    : mutex(FastMutex::RECURSIVE), cwd("/")
+    : mutex(FastMutex::RECURSIVE), cwd("/"), bytesRead(0), bytesWritten(0)
 {
+    for(int i=0;i<numChunks;i++) chunks[i]=0;
     FilesystemManager::instance().addFileDescriptorTable(this);
+    intrusive_ref_ptr<FileBase> *files=entry(0,true);
     files[0]=files[1]=files[2]=intrusive_ref_ptr<FileBase>(
         new TerminalDevice(DefaultConsole::instance().get()));
 }
 
 FileDescriptorTable::FileDescriptorTable(const FileDescriptorTable& rhs)
-    : mutex(FastMutex::RECURSIVE), cwd(rhs.cwd)
+    : mutex(FastMutex::RECURSIVE), cwd(rhs.cwd), bytesRead(0), bytesWritten(0)
 {
     //No need to lock the mutex since we are in a constructor and there can't
     //be pointers to this in other threads yet
-    for(int i=0;i<MAX_OPEN_FILES;i++) this->files[i]=atomic_load(&rhs.files[i]);
+    for(int i=0;i<numChunks;i++) chunks[i]=0;
+    for(int i=0;i<MAX_OPEN_FILES;i++)
+    {
+        intrusive_ref_ptr<FileBase> file=rhs.getFile(i);
+        if(file) *entry(i,true)=file;
+    }
     FilesystemManager::instance().addFileDescriptorTable(this);
 }
 
@@ -95,7 +116,14 @@ FileDescriptorTable& FileDescriptorTable::operator=(
 {
     Lock<FastMutex> l(mutex);
     for(int i=0;i<MAX_OPEN_FILES;i++)
-        atomic_store(&this->files[i],atomic_load(&rhs.files[i]));
+    {
+        intrusive_ref_ptr<FileBase> file=rhs.getFile(i);
+        //Don't allocate chunks just to store empty entries
+        intrusive_ref_ptr<FileBase> *e=entry(i,!!file);
+        if(e==0) continue;
+        intrusive_ref_ptr<FileBase> old=atomic_exchange(e,file);
+        dropRemovedFile(old);
+    }
     return *this;
 }
 
@@ -105,14 +133,13 @@ int FileDescriptorTable::open(const char* name, int flags, int mode)
     Lock<FastMutex> l(mutex);
     for(int i=3;i<MAX_OPEN_FILES;i++)
     {
-        if(files[i]) continue;
+        intrusive_ref_ptr<FileBase> *e=entry(i,true);
+        if(*e) continue;
         //Found an empty file descriptor
         string path=absolutePath(name);
         if(path.empty()) return -ENAMETOOLONG;
-        ResolvedPath openData=FilesystemManager::instance().resolvePath(path);
-        if(openData.result<0) return openData.result;
-        StringPart sp(path,string::npos,openData.off);
-        int result=openData.fs->open(files[i],sp,flags,mode);
+        int result=FilesystemManager::instance().openHelper(*e,path,
+                flags,mode);
         if(result==0) return i; //The file descriptor
         else return result; //The error code
     }
@@ -123,16 +150,28 @@ int FileDescriptorTable::close(int fd)
 {
     //No need to lock the mutex when deleting
     if(fd<0 || fd>=MAX_OPEN_FILES) return -EBADF;
+    intrusive_ref_ptr<FileBase> *e=entry(fd,false);
+    if(e==0) return -EBADF; //Chunk not allocated, so file not open
     intrusive_ref_ptr<FileBase> toClose;
-    toClose=atomic_exchange(files+fd,intrusive_ref_ptr<FileBase>());
+    toClose=atomic_exchange(e,intrusive_ref_ptr<FileBase>());
     if(!toClose) return -EBADF; //File entry was not open
+    dropRemovedFile(toClose);
     return 0;
 }
 
 void FileDescriptorTable::closeAll()
 {
-    for(int i=0;i<MAX_OPEN_FILES;i++)
-        atomic_exchange(files+i,intrusive_ref_ptr<FileBase>());
+    for(int i=0;i<numChunks;i++)
+    {
+        FileChunk *chunk=chunks[i];
+        if(chunk==0) continue;
+        for(int j=0;j<FILE_TABLE_CHUNK_SIZE;j++)
+        {
+            intrusive_ref_ptr<FileBase> toClose;
+            toClose=atomic_exchange(chunk->files+j,intrusive_ref_ptr<FileBase>());
+            dropRemovedFile(toClose);
+        }
+    }
 }
 
 int FileDescriptorTable::getcwd(char *buf, size_t len)
@@ -181,10 +220,7 @@ int FileDescriptorTable::mkdir(const char *name, int mode)
     if(name==0 || name[0]=='\0') return -EFAULT;
     string path=absolutePath(name);
     if(path.empty()) return -ENAMETOOLONG;
-    ResolvedPath openData=FilesystemManager::instance().resolvePath(path,true);
-    if(openData.result<0) return openData.result;
-    StringPart sp(path,string::npos,openData.off);
-    return openData.fs->mkdir(sp,mode);
+    return FilesystemManager::instance().mkdirHelper(path,mode);
 }
 
 int FileDescriptorTable::rmdir(const char *name)
@@ -192,10 +228,7 @@ int FileDescriptorTable::rmdir(const char *name)
     if(name==0 || name[0]=='\0') return -EFAULT;
     string path=absolutePath(name);
     if(path.empty()) return -ENAMETOOLONG;
-    ResolvedPath openData=FilesystemManager::instance().resolvePath(path,true);
-    if(openData.result<0) return openData.result;
-    StringPart sp(path,string::npos,openData.off);
-    return openData.fs->rmdir(sp);
+    return FilesystemManager::instance().rmdirHelper(path);
 }
 
 int FileDescriptorTable::unlink(const char *name)
@@ -216,6 +249,101 @@ int FileDescriptorTable::rename(const char *oldName, const char *newName)
     return FilesystemManager::instance().renameHelper(oldPath,newPath);
 }
 
+int FileDescriptorTable::poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    if(fds==0 && nfds>0) return -EFAULT;
+    if(nfds>MAX_OPEN_FILES) return -EINVAL;
+    //Keep a reference to the files, so that they can't be deleted while their
+    //PollQueue still contains our entries
+    vector<intrusive_ref_ptr<FileBase>> files(nfds);
+    vector<PollEntry> entries(nfds);
+    PollWaiter waiter;
+    waiter.thread=Thread::getCurrentThread();
+    waiter.woken=false;
+    for(nfds_t i=0;i<nfds;i++)
+    {
+        entries[i].waiter=&waiter;
+        if(fds[i].fd>=0) files[i]=getFile(fds[i].fd);
+    }
+    long long deadline=0;
+    if(timeout>0)
+    {
+        long long ticks=(static_cast<long long>(timeout)*TICK_FREQ+999)/1000;
+        deadline=getTick()+max(ticks,1LL);
+    }
+    int result;
+    for(bool first=true;;first=false)
+    {
+        result=0;
+        for(nfds_t i=0;i<nfds;i++)
+        {
+            fds[i].revents=0;
+            if(fds[i].fd<0) continue;
+            if(!files[i]) fds[i].revents=POLLNVAL;
+            else {
+                //Register in the PollQueues only on the first pass, and only
+                //as long as no file is ready, as we won't block otherwise
+                PollEntry *entry=(first && result==0 && timeout!=0)
+                               ? &entries[i] : 0;
+                int events=fds[i].events | POLLERR | POLLHUP;
+                fds[i].revents=files[i]->poll(events,entry) & events;
+            }
+            if(fds[i].revents) result++;
+        }
+        if(result>0 || timeout==0) break;
+        FastInterruptDisableLock dLock;
+        //A file may have become ready after we checked it, but if so it has
+        //already set woken, so we don't wait
+        if(waiter.woken==false)
+        {
+            if(timeout<0)
+            {
+                Thread::IRQwait();
+                {
+                    FastInterruptEnableLock eLock(dLock);
+                    Thread::yield();
+                }
+            } else if(Thread::IRQenableIrqAndTimedWait(dLock,deadline)==false)
+                break;
+        }
+        waiter.woken=false;
+    }
+    for(nfds_t i=0;i<nfds;i++) PollQueue::remove(&entries[i]);
+    return result;
+}
+
+int FileDescriptorTable::mkfifo(const char *name, int mode)
+{
+    if(name==0 || name[0]=='\0') return -EFAULT;
+    string path=absolutePath(name);
+    if(path.empty()) return -ENAMETOOLONG;
+    return FilesystemManager::instance().mkfifoHelper(path,mode);
+}
+
+int FileDescriptorTable::pipe(int fds[2])
+{
+    if(fds==0) return -EFAULT;
+    Lock<FastMutex> l(mutex);
+    intrusive_ref_ptr<FileBase> *e[2];
+    int found=0;
+    for(int i=3;i<MAX_OPEN_FILES && found<2;i++)
+    {
+        e[found]=entry(i,true);
+        if(*e[found]) continue;
+        fds[found++]=i;
+    }
+    if(found<2) return -ENFILE;
+    //Anonymous pipes have no parent filesystem
+    intrusive_ref_ptr<Pipe> p(new Pipe);
+    intrusive_ref_ptr<FileBase> in(
+        new PipeFile(intrusive_ref_ptr<FilesystemBase>(),p,_FREAD));
+    intrusive_ref_ptr<FileBase> out(
+        new PipeFile(intrusive_ref_ptr<FilesystemBase>(),p,_FWRITE));
+    atomic_store(e[0],in);
+    atomic_store(e[1],out);
+    return 0;
+}
+
 int FileDescriptorTable::statImpl(const char* name, struct stat* pstat, bool f)
 {
     if(name==0 || name[0]=='\0' || pstat==0) return -EFAULT;
@@ -230,6 +358,39 @@ FileDescriptorTable::~FileDescriptorTable()
     //There's no need to lock the mutex and explicitly close files eventually
     //left open, because if there are other threads accessing this while we are
     //being deleted we have bigger problems anyway
+    for(int i=0;i<numChunks;i++) delete chunks[i];
+}
+
+intrusive_ref_ptr<FileBase> *FileDescriptorTable::entry(int fd, bool allocate)
+{
+    FileChunk *chunk=chunks[fd/FILE_TABLE_CHUNK_SIZE];
+    if(chunk==0)
+    {
+        if(allocate==false) return 0;
+        chunk=new FileChunk;
+        //Publish the chunk only once its entries are initialized, as getFile()
+        //may access it concurrently. The caller holds the mutex, so no other
+        //thread can be allocating the same chunk
+        static_assert(sizeof(FileChunk*)==sizeof(int),"");
+        volatile int *ptr=reinterpret_cast<volatile int*>(
+                chunks+fd/FILE_TABLE_CHUNK_SIZE);
+        atomicSwap(ptr,reinterpret_cast<int>(chunk));
+    }
+    return chunk->files+fd%FILE_TABLE_CHUNK_SIZE;
+}
+
+void FileDescriptorTable::addBytes(unsigned long long& counter, ssize_t bytes)
+{
+    //64 bit counters can't be updated atomically on 32 bit architectures
+    FastInterruptDisableLock dLock;
+    counter+=bytes;
+}
+
+unsigned long long FileDescriptorTable::getBytes(
+        const unsigned long long& counter)
+{
+    FastInterruptDisableLock dLock;
+    return counter;
 }
 
 string FileDescriptorTable::absolutePath(const char* path)
@@ -523,8 +684,8 @@ int FilesystemManager::kmount(const char* path, intrusive_ref_ptr<FilesystemBase
     }
     if(filesystems.insert(make_pair(StringPart(temp),fs)).second==false)
         return -EBUSY; //Means already mounted
-    else
-        return 0;
+    dentryCache.invalidate();
+    return 0;
 }
 
 int FilesystemManager::umount(const char* path, bool force)
@@ -554,7 +715,7 @@ int FilesystemManager::umount(const char* path, bool force)
     //Note that since we are locking the same mutex used by resolvePath(),
     //other threads can't open new files concurrently while we check
     #ifdef WITH_PROCESSES
-    list<FileDescriptorTable*>::iterator it3;
+    FileTableList::iterator it3;
     for(it3=fileTables.begin();it3!=fileTables.end();++it3)
     {
         for(int i=0;i<MAX_OPEN_FILES;i++)
@@ -613,6 +774,7 @@ int FilesystemManager::umount(const char* path, bool force)
     //It is now safe to umount all filesystems
     for(it5=fsToUmount.begin();it5!=fsToUmount.end();++it5)
         filesystems.erase(*it5);
+    dentryCache.invalidate();
     return 0;
 }
 
@@ -620,12 +782,13 @@ void FilesystemManager::umountAll()
 {
     Lock<FastMutex> l(mutex);
     #ifdef WITH_PROCESSES
-    list<FileDescriptorTable*>::iterator it;
+    FileTableList::iterator it;
     for(it=fileTables.begin();it!=fileTables.end();++it) (*it)->closeAll();
     #else //WITH_PROCESSES
     getFileDescriptorTable().closeAll();
     #endif //WITH_PROCESSES
     filesystems.clear();
+    dentryCache.invalidate();
 }
 
 ResolvedPath FilesystemManager::resolvePath(string& path, bool followLastSymlink)
@@ -636,8 +799,14 @@ ResolvedPath FilesystemManager::resolvePath(string& path, bool followLastSymlink
     if(path.empty() || path[0]!='/') return ResolvedPath(-ENOENT);
 
     Lock<FastMutex> l(mutex);
+    ResolvedPath result;
+    if(dentryCache.lookup(path,followLastSymlink,result)) return result;
     PathResolution pr(filesystems);
-    return pr.resolvePath(path,followLastSymlink);
+    if(DENTRY_CACHE_SIZE==0) return pr.resolvePath(path,followLastSymlink);
+    string original(path); //resolvePath() modifies path in place
+    result=pr.resolvePath(path,followLastSymlink);
+    dentryCache.add(original,followLastSymlink,path,result);
+    return result;
 }
 
 int FilesystemManager::unlinkHelper(string& path)
@@ -650,15 +819,68 @@ int FilesystemManager::unlinkHelper(string& path)
     //After resolvePath() so path is in canonical form and symlinks are followed
     if(filesystems.find(StringPart(path))!=filesystems.end()) return -EBUSY;
     StringPart sp(path,string::npos,openData.off);
-    return openData.fs->unlink(sp);
+    int result=openData.fs->unlink(sp);
+    dentryCache.invalidate();
+    return result;
 }
 
 int FilesystemManager::statHelper(string& path, struct stat *pstat, bool f)
 {
     ResolvedPath openData=resolvePath(path,f);
     if(openData.result<0) return openData.result;
+    unsigned int generation;
+    if(dentryCache.lookupNegative(path,generation)) return -ENOENT;
+    StringPart sp(path,string::npos,openData.off);
+    int result=openData.fs->lstat(sp,pstat);
+    if(result==-ENOENT) dentryCache.addNegative(path,generation);
+    return result;
+}
+
+int FilesystemManager::openHelper(intrusive_ref_ptr<FileBase>& file,
+        string& path, int flags, int mode)
+{
+    ResolvedPath openData=resolvePath(path);
+    if(openData.result<0) return openData.result;
+    unsigned int generation=0;
+    if((flags & O_CREAT)==0 && dentryCache.lookupNegative(path,generation))
+        return -ENOENT;
+    StringPart sp(path,string::npos,openData.off);
+    int result=openData.fs->open(file,sp,flags,mode);
+    if(flags & O_CREAT)
+    {
+        if(result==0) dentryCache.invalidateNegative();
+    } else if(result==-ENOENT) dentryCache.addNegative(path,generation);
+    return result;
+}
+
+int FilesystemManager::mkdirHelper(string& path, int mode)
+{
+    ResolvedPath openData=resolvePath(path,true);
+    if(openData.result<0) return openData.result;
+    StringPart sp(path,string::npos,openData.off);
+    int result=openData.fs->mkdir(sp,mode);
+    if(result==0) dentryCache.invalidateNegative();
+    return result;
+}
+
+int FilesystemManager::mkfifoHelper(string& path, int mode)
+{
+    ResolvedPath openData=resolvePath(path,true);
+    if(openData.result<0) return openData.result;
+    StringPart sp(path,string::npos,openData.off);
+    int result=openData.fs->mkfifo(sp,mode);
+    if(result==0) dentryCache.invalidateNegative();
+    return result;
+}
+
+int FilesystemManager::rmdirHelper(string& path)
+{
+    ResolvedPath openData=resolvePath(path,true);
+    if(openData.result<0) return openData.result;
     StringPart sp(path,string::npos,openData.off);
-    return openData.fs->lstat(sp,pstat);
+    int result=openData.fs->rmdir(sp);
+    dentryCache.invalidate();
+    return result;
 }
 
 int FilesystemManager::renameHelper(string& oldPath, string& newPath)
@@ -682,7 +904,9 @@ int FilesystemManager::renameHelper(string& oldPath, string& newPath)
     
     //Can't rename a directory into a subdirectory of itself
     if(newSp.startsWith(oldSp)) return -EINVAL;
-    return oldOpenData.fs->rename(oldSp,newSp);
+    int result=oldOpenData.fs->rename(oldSp,newSp);
+    dentryCache.invalidate();
+    return result;
 }
 
 short int FilesystemManager::getFilesystemId()
@@ -731,6 +955,7 @@ basicFilesystemSetup(intrusive_ref_ptr<Device> dev)
     intrusive_ref_ptr<Fat32Fs> fat32;
     if(fat32failed==false)
     {
+        if(BLOCK_CACHE_SIZE>0) disk=new BlockCache(disk,BLOCK_CACHE_SIZE);
         fat32=new Fat32Fs(disk);
         if(fat32->mountFailed()) fat32failed=true;
     }
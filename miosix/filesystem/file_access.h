@@ -35,9 +35,12 @@
 #include <sys/stat.h>
 #include "file.h"
 #include "stringpart.h"
+#include "dentry_cache.h"
 #include "devfs/devfs.h"
 #include "kernel/sync.h"
 #include "kernel/intrusive.h"
+#include "kernel/hazard.h"
+#include "kernel/object_pool.h"
 #include "config/miosix_settings.h"
 
 #ifdef WITH_FILESYSTEM
@@ -77,6 +80,54 @@ public:
     size_t off;
 };
 
+class FileDescriptorTable;
+
+/**
+ * A non-owning handle to the file at an entry of a file descriptor table,
+ * meant to be allocated on the stack for the duration of a syscall.
+ * The file is protected by a HazardPointer instead of incrementing its
+ * reference count, so that if another thread closes the file descriptor in
+ * the meantime, the file is deleted only once the handle is destroyed.
+ */
+class BorrowedFile
+{
+public:
+    /**
+     * Constructor
+     * \param table file descriptor table
+     * \param fd file descriptor
+     */
+    BorrowedFile(const FileDescriptorTable& table, int fd);
+
+    /**
+     * \return the file, or nullptr if the file descriptor is not open
+     */
+    FileBase *get() const { return file; }
+
+    /**
+     * \return the file, must not be called if the file descriptor is not open
+     */
+    FileBase *operator->() const { return file; }
+
+    /**
+     * \return true if the file descriptor is open
+     */
+    explicit operator bool() const { return file!=0; }
+
+    /**
+     * Destructor
+     */
+    ~BorrowedFile();
+
+private:
+    BorrowedFile(const BorrowedFile&);
+    BorrowedFile& operator= (const BorrowedFile&);
+
+    HazardPointer hazard;
+    intrusive_ref_ptr<FileBase> ref; ///< Used if no hazard pointer is available
+    FileBase *file;
+};
+
 /**
  * This class maps file descriptors to file objects, allowing to
  * perform file operations
@@ -136,9 +187,11 @@ public:
         //Important, since len is specified by standard to be unsigned, but the
         //return value has to be signed
         if(static_cast<ssize_t>(len)<0) return -EINVAL;
-        intrusive_ref_ptr<FileBase> file=getFile(fd);
+        BorrowedFile file(*this,fd);
         if(!file) return -EBADF;
-        return file->write(data,len);
+        ssize_t result=file->write(data,len);
+        if(result>0) addBytes(bytesWritten,result);
+        return result;
     }
     
     /**
@@ -154,9 +207,11 @@ public:
         //Important, since len is specified by standard to be unsigned, but the
         //return value has to be signed
         if(static_cast<ssize_t>(len)<0) return -EINVAL;
-        intrusive_ref_ptr<FileBase> file=getFile(fd);
+        BorrowedFile file(*this,fd);
         if(!file) return -EBADF;
-        return file->read(data,len);
+        ssize_t result=file->read(data,len);
+        if(result>0) addBytes(bytesRead,result);
+        return result;
     }
     
     /**
@@ -169,7 +224,7 @@ public:
      */
     off_t lseek(int fd, off_t pos, int whence)
     {
-        intrusive_ref_ptr<FileBase> file=getFile(fd);
+        BorrowedFile file(*this,fd);
         if(!file) return -EBADF;
         return file->lseek(pos,whence);
     }
@@ -182,7 +237,7 @@ public:
     int fstat(int fd, struct stat *pstat) const
     {
         if(pstat==0) return -EFAULT;
-        intrusive_ref_ptr<FileBase> file=getFile(fd);
+        BorrowedFile file(*this,fd);
         if(!file) return -EBADF;
         return file->fstat(pstat);
     }
@@ -194,7 +249,7 @@ public:
      */
     int isatty(int fd) const
     {
-        intrusive_ref_ptr<FileBase> file=getFile(fd);
+        BorrowedFile file(*this,fd);
         if(!file) return -EBADF;
         return file->isatty();
     }
@@ -229,7 +284,7 @@ public:
      */
     int fcntl(int fd, int cmd, int opt)
     {
-        intrusive_ref_ptr<FileBase> file=getFile(fd);
+        BorrowedFile file(*this,fd);
         if(!file) return -EBADF;
         return file->fcntl(cmd,opt);
     }
@@ -243,11 +298,38 @@ public:
     int ioctl(int fd, int cmd, void *arg)
     {
         //arg unchecked here, as some ioctl don't use it
-        intrusive_ref_ptr<FileBase> file=getFile(fd);
+        BorrowedFile file(*this,fd);
         if(!file) return -EBADF;
         return file->ioctl(cmd,arg);
     }
     
+    /**
+     * Truncate or extend a file
+     * \param fd file descriptor
+     * \param size new file size
+     * \return 0 on success, or a negative number on failure
+     */
+    int ftruncate(int fd, off_t size)
+    {
+        BorrowedFile file(*this,fd);
+        if(!file) return -EBADF;
+        return file->ftruncate(size);
+    }
+    
+    /**
+     * Allocate storage for a byte range of a file
+     * \param fd file descriptor
+     * \param offset start of the range
+     * \param len length of the range
+     * \return 0 on success, or a negative number on failure
+     */
+    int fallocate(int fd, off_t offset, off_t len)
+    {
+        BorrowedFile file(*this,fd);
+        if(!file) return -EBADF;
+        return file->fallocate(offset,len);
+    }
+    
     /**
      * List directory content
      * \param dp dp pointer to a memory buffer where one or more struct dirent
@@ -260,7 +342,7 @@ public:
     {
         if(dp==0) return -EFAULT;
         if(reinterpret_cast<unsigned>(dp) & 0x3) return -EFAULT; //Not aligned
-        intrusive_ref_ptr<FileBase> file=getFile(fd);
+        BorrowedFile file(*this,fd);
         if(!file) return -EBADF;
         return file->getdents(dp,len);
     }
@@ -310,6 +392,59 @@ public:
      */
     int rename(const char *oldName, const char *newName);
     
+    /**
+     * Wait for one or more file descriptors to become ready for I/O
+     * \param fds array of file descriptors to poll, the revents field of each
+     * element is filled with the ready events
+     * \param nfds number of elements in fds
+     * \param timeout timeout in milliseconds, 0 to return immediately, or a
+     * negative number to wait indefinitely
+     * \return the number of file descriptors with nonzero revents, 0 on
+     * timeout, or a negative number on failure
+     */
+    int poll(struct pollfd *fds, nfds_t nfds, int timeout);
+    
+    /**
+     * Create a FIFO special file
+     * \param name FIFO name
+     * \param mode FIFO permissions
+     * \return 0 on success, or a negative number on failure
+     */
+    int mkfifo(const char *name, int mode);
+    
+    /**
+     * Create an anonymous pipe
+     * \param fds the file descriptor of the read end is stored in fds[0],
+     * the one of the write end in fds[1]
+     * \return 0 on success, or a negative number on failure
+     */
+    int pipe(int fds[2]);
+    
+    /**
+     * Move data between two file descriptors without copying it to a user
+     * buffer. At least one of the two file descriptors has to be a pipe, and
+     * data is transferred directly from or to the pipe buffer. The two file
+     * descriptors can't refer to the same pipe
+     * \param fdIn file descriptor where data is read
+     * \param fdOut file descriptor where data is written
+     * \param len maximum number of bytes to move
+     * \return the number of moved bytes, 0 at end of file, or a negative
+     * number on failure
+     */
+    ssize_t splice(int fdIn, int fdOut, size_t len)
+    {
+        intrusive_ref_ptr<FileBase> in=getFile(fdIn);
+        intrusive_ref_ptr<FileBase> out=getFile(fdOut);
+        if(!in || !out) return -EBADF;
+        //Moving data from a pipe to itself would deadlock
+        const void *buffer=in->getSpliceBuffer();
+        if(buffer && buffer==out->getSpliceBuffer()) return -EINVAL;
+        //Try with fdIn being a pipe first, then fdOut
+        ssize_t result=in->spliceTo(out.get(),len);
+        if(result!=-EINVAL) return result;
+        return out->spliceFrom(in.get(),len);
+    }
+    
     /**
      * Retrieves an entry in the file descriptor table
      * \param fd file descriptor, index into the table
@@ -319,8 +454,22 @@ public:
      */
     intrusive_ref_ptr<FileBase> getFile(int fd) const
     {
-        if(fd<0 || fd>=MAX_OPEN_FILES) return intrusive_ref_ptr<FileBase>();
-        return atomic_load(files+fd);
+        const intrusive_ref_ptr<FileBase> *e=getEntry(fd);
+        if(e==0) return intrusive_ref_ptr<FileBase>();
+        return atomic_load(e);
+    }
+    
+    /**
+     * \return the number of bytes read through this file descriptor table
+     */
+    unsigned long long getBytesRead() const { return getBytes(bytesRead); }
+    
+    /**
+     * \return the number of bytes written through this file descriptor table
+     */
+    unsigned long long getBytesWritten() const
+    {
+        return getBytes(bytesWritten);
     }
     
     /**
@@ -329,6 +478,35 @@ public:
     ~FileDescriptorTable();
     
 private:
+    /**
+     * Retrieves an entry in the file descriptor table, for reading
+     * \param fd file descriptor, index into the table
+     * \return the table entry, or 0 if the index is out of bounds or its
+     * chunk was not allocated
+     */
+    const intrusive_ref_ptr<FileBase> *getEntry(int fd) const
+    {
+        if(fd<0 || fd>=MAX_OPEN_FILES) return 0;
+        //No need to lock, chunks are only deallocated by the destructor
+        FileChunk *chunk=chunks[fd/FILE_TABLE_CHUNK_SIZE];
+        if(chunk==0) return 0;
+        return chunk->files+fd%FILE_TABLE_CHUNK_SIZE;
+    }
+    
+    /**
+     * Atomically increment a byte counter
+     * \param counter counter to increment
+     * \param bytes value to add
+     */
+    static void addBytes(unsigned long long& counter, ssize_t bytes);
+    
+    /**
+     * Atomically read a byte counter
+     * \param counter counter to read
+     * \return the counter value
+     */
+    static unsigned long long getBytes(const unsigned long long& counter);
+    
     /**
      * Append cwd to path if it is not an absolute path
      * \param path an absolute or relative path, must not be null
@@ -347,14 +525,62 @@ private:
      */
     int statImpl(const char *name, struct stat *pstat, bool f);
     
+    /**
+     * A chunk of the file descriptor table
+     */
+    struct FileChunk
+    {
+        intrusive_ref_ptr<FileBase> files[FILE_TABLE_CHUNK_SIZE];
+    };
+    
+    /**
+     * \param fd file descriptor, must be within 0 and MAX_OPEN_FILES
+     * \param allocate if true, allocate the chunk holding the entry if it does
+     * not exist yet. In this case the mutex must be locked
+     * \return the table entry, or 0 if its chunk was not allocated
+     */
+    intrusive_ref_ptr<FileBase> *entry(int fd, bool allocate);
+    
     FastMutex mutex; ///< Locks on writes to file object pointers, not on accesses
     
     std::string cwd; ///< Current working directory
     
-    /// Holds the mapping between fd and file objects
-    intrusive_ref_ptr<FileBase> files[MAX_OPEN_FILES];
+    /// Number of chunks in a full file descriptor table
+    static const int numChunks=
+            (MAX_OPEN_FILES+FILE_TABLE_CHUNK_SIZE-1)/FILE_TABLE_CHUNK_SIZE;
+    
+    /// Holds the mapping between fd and file objects. Chunks are allocated as
+    /// files are opened, and are never deallocated until the table is deleted,
+    /// so that getFile() can access them without locking
+    FileChunk * volatile chunks[numChunks];
+    
+    unsigned long long bytesRead;    ///< Bytes read, for resource accounting
+    unsigned long long bytesWritten; ///< Bytes written, for resource accounting
+    
+    friend class BorrowedFile;
 };
 
+inline BorrowedFile::BorrowedFile(const FileDescriptorTable& table, int fd)
+    : file(0)
+{
+    const intrusive_ref_ptr<FileBase> *e=table.getEntry(fd);
+    if(e==0) return;
+    if(hazard.valid()) file=hazard.protect(*e);
+    else {
+        //Nested too deeply, take a reference instead
+        ref=atomic_load(e);
+        file=ref.get();
+    }
+}
+
+inline BorrowedFile::~BorrowedFile()
+{
+    //If the file descriptor was closed meanwhile, drop the reference that
+    //was transferred to us
+    if(hazard.valid() && hazard.release())
+        intrusive_ref_ptr<FileBase> drop(file,false);
+}
+
 /**
  * This class contains information on all the mounted filesystems
  */
@@ -446,6 +672,56 @@ public:
      */
     int statHelper(std::string& path, struct stat *pstat, bool f);
     
+    /**
+     * \internal
+     * Helper function to open a file. Only meant to be used by
+     * FileDescriptorTable::open()
+     * \param file the opened file is stored here
+     * \param path path of file to open
+     * \param flags file flags (open for reading, writing, ...)
+     * \param mode access mode in case a new file is created
+     * \return 0 on success, or a negative number on failure
+     */
+    int openHelper(intrusive_ref_ptr<FileBase>& file, std::string& path,
+            int flags, int mode);
+    
+    /**
+     * \internal
+     * Helper function to create a directory. Only meant to be used by
+     * FileDescriptorTable::mkdir()
+     * \param path path of the directory to create
+     * \param mode access mode
+     * \return 0 on success, or a negative number on failure
+     */
+    int mkdirHelper(std::string& path, int mode);
+    
+    /**
+     * \internal
+     * Helper function to remove a directory. Only meant to be used by
+     * FileDescriptorTable::rmdir()
+     * \param path path of the directory to remove
+     * \return 0 on success, or a negative number on failure
+     */
+    int rmdirHelper(std::string& path);
+    
+    /**
+     * \internal
+     * Helper function to create a FIFO. Only meant to be used by
+     * FileDescriptorTable::mkfifo()
+     * \param path path of the FIFO to create
+     * \param mode access mode
+     * \return 0 on success, or a negative number on failure
+     */
+    int mkfifoHelper(std::string& path, int mode);
+    
+    /**
+     * \internal
+     * Must be called by filesystems that can create files other than through
+     * their open() and mkdir() member functions, such as DevFs::addDevice(),
+     * as paths previously found not to exist are cached
+     */
+    void filesCreated() { dentryCache.invalidateNegative(); }
+    
     /**
      * \internal
      * Helper function to unlink a file or directory. Only meant to be used by
@@ -510,8 +786,14 @@ private:
     /// Mounted filesystem
     std::map<StringPart,intrusive_ref_ptr<FilesystemBase> > filesystems;
     
+    /// Recently resolved paths
+    DentryCache dentryCache;
+    
     #ifdef WITH_PROCESSES
-    std::list<FileDescriptorTable*> fileTables; ///< Process file tables
+    /// List of file tables, with nodes allocated from a pool
+    typedef std::list<FileDescriptorTable*,
+        PoolAllocator<FileDescriptorTable*,FILE_TABLE_POOL_SIZE> > FileTableList;
+    FileTableList fileTables; ///< Process file tables
     #endif //WITH_PROCESSES
     #ifdef WITH_DEVFS
     intrusive_ref_ptr<DevFs> devFs;
@@ -37,7 +37,9 @@ enum Ioctl
     IOCTL_TCSETATTR_NOW=102,
     IOCTL_TCSETATTR_FLUSH=103,
     IOCTL_TCSETATTR_DRAIN=104,
-    IOCTL_FLUSH=105
+    IOCTL_FLUSH=105,
+    IOCTL_RESERVE=106, ///< Reserve space for a file to grow to *(off_t*)arg bytes
+    IOCTL_GET_XIP_POINTER=107 ///< Store in *(const void**)arg a pointer to the file content
 };
 
 }
@@ -0,0 +1,278 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "pipe.h"
+#include <cstring>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+
+using namespace std;
+
+namespace miosix {
+
+#ifdef WITH_FILESYSTEM
+
+//
+// class Pipe
+//
+
+Pipe::Pipe() : buffer(new char[PIPE_BUFFER_SIZE]), get(0), used(0),
+        readers(0), writers(0), hadReader(false), hadWriter(false) {}
+
+void Pipe::addEnd(int flags)
+{
+    Lock<FastMutex> l(mutex);
+    if(flags & _FREAD) { readers++; hadReader=true; }
+    if(flags & _FWRITE) { writers++; hadWriter=true; }
+    cond.broadcast();
+}
+
+void Pipe::removeEnd(int flags)
+{
+    Lock<FastMutex> l(mutex);
+    if(flags & _FREAD) readers--;
+    if(flags & _FWRITE) writers--;
+    if(readers==0 && writers==0)
+    {
+        //Nobody is using the FIFO anymore, the next users start from scratch
+        get=used=0;
+        hadReader=hadWriter=false;
+    }
+    cond.broadcast();
+    pollQueue.wakeup();
+}
+
+ssize_t Pipe::read(void *data, size_t len, bool nonblock)
+{
+    if(len==0) return 0;
+    Lock<FastMutex> l1(readMutex);
+    Lock<FastMutex> l(mutex);
+    int result=waitForData(l,nonblock);
+    if(result<=0) return result;
+    char *buf=reinterpret_cast<char*>(data);
+    unsigned int count=min<size_t>(len,used);
+    unsigned int first=min(count,PIPE_BUFFER_SIZE-get);
+    memcpy(buf,buffer+get,first);
+    memcpy(buf+first,buffer,count-first);
+    consumed(count);
+    return count;
+}
+
+ssize_t Pipe::write(const void *data, size_t len, bool nonblock)
+{
+    Lock<FastMutex> l1(writeMutex);
+    Lock<FastMutex> l(mutex);
+    const char *buf=reinterpret_cast<const char*>(data);
+    size_t written=0;
+    while(written<len)
+    {
+        int result=waitForSpace(l,nonblock);
+        //After a partial write, report the written bytes instead of the error
+        if(result<0) return written>0 ? written : result;
+        unsigned int put=(get+used)%PIPE_BUFFER_SIZE;
+        unsigned int count=min<size_t>(len-written,PIPE_BUFFER_SIZE-used);
+        unsigned int first=min(count,PIPE_BUFFER_SIZE-put);
+        memcpy(buffer+put,buf+written,first);
+        memcpy(buffer,buf+written+first,count-first);
+        produced(count);
+        written+=count;
+    }
+    return written;
+}
+
+ssize_t Pipe::spliceTo(FileBase *out, size_t len, bool nonblock)
+{
+    if(len==0) return 0;
+    //Holding readMutex, no one else can remove data from the pipe, so the
+    //data can be written to out without holding mutex, as out may block
+    Lock<FastMutex> l1(readMutex);
+    unsigned int start, count;
+    {
+        Lock<FastMutex> l(mutex);
+        int result=waitForData(l,nonblock);
+        if(result<=0) return result;
+        start=get;
+        count=min<size_t>(len,min(used,PIPE_BUFFER_SIZE-get));
+    }
+    ssize_t result=out->write(buffer+start,count);
+    if(result<=0) return result;
+    Lock<FastMutex> l(mutex);
+    consumed(result);
+    return result;
+}
+
+ssize_t Pipe::spliceFrom(FileBase *in, size_t len, bool nonblock)
+{
+    if(len==0) return 0;
+    //Holding writeMutex, no one else can add data to the pipe, so the data
+    //can be read from in without holding mutex, as in may block
+    Lock<FastMutex> l1(writeMutex);
+    unsigned int put, count;
+    {
+        Lock<FastMutex> l(mutex);
+        int result=waitForSpace(l,nonblock);
+        if(result<0) return result;
+        put=(get+used)%PIPE_BUFFER_SIZE;
+        count=min<size_t>(len,min(PIPE_BUFFER_SIZE-used,PIPE_BUFFER_SIZE-put));
+    }
+    ssize_t result=in->read(buffer+put,count);
+    if(result<=0) return result;
+    Lock<FastMutex> l(mutex);
+    produced(result);
+    return result;
+}
+
+int Pipe::poll(int flags, int events, PollEntry *entry)
+{
+    Lock<FastMutex> l(mutex);
+    int result=0;
+    if(flags & _FREAD)
+    {
+        if(hadWriter && writers==0) result|=POLLHUP;
+        if(used>0 || (result & POLLHUP)) result|=events & POLLIN;
+    }
+    if(flags & _FWRITE)
+    {
+        if(hadReader && readers==0) result|=POLLERR;
+        else if(used<PIPE_BUFFER_SIZE) result|=events & POLLOUT;
+    }
+    //Adding the entry with mutex locked, state changes can't be missed
+    if(result==0 && entry) pollQueue.add(entry);
+    return result;
+}
+
+Pipe::~Pipe()
+{
+    delete[] buffer;
+}
+
+int Pipe::waitForData(Lock<FastMutex>& l, bool nonblock)
+{
+    for(;;)
+    {
+        if(used>0) return 1;
+        if(hadWriter && writers==0) return 0; //End of file
+        if(nonblock) return -EAGAIN;
+        cond.wait(l);
+    }
+}
+
+int Pipe::waitForSpace(Lock<FastMutex>& l, bool nonblock)
+{
+    for(;;)
+    {
+        if(hadReader && readers==0) return -EPIPE;
+        if(used<PIPE_BUFFER_SIZE) return 1;
+        if(nonblock) return -EAGAIN;
+        cond.wait(l);
+    }
+}
+
+void Pipe::consumed(unsigned int len)
+{
+    get=(get+len)%PIPE_BUFFER_SIZE;
+    used-=len;
+    cond.broadcast();
+    pollQueue.wakeup();
+}
+
+void Pipe::produced(unsigned int len)
+{
+    used+=len;
+    cond.broadcast();
+    pollQueue.wakeup();
+}
+
+//
+// class PipeFile
+//
+
+PipeFile::PipeFile(intrusive_ref_ptr<FilesystemBase> parent,
+        intrusive_ref_ptr<Pipe> pipe, int flags)
+        : FileBase(parent), pipe(pipe), flags(flags)
+{
+    pipe->addEnd(flags);
+}
+
+ssize_t PipeFile::write(const void *data, size_t len)
+{
+    if((flags & _FWRITE)==0) return -EBADF;
+    return pipe->write(data,len,flags & _FNONBLOCK);
+}
+
+ssize_t PipeFile::read(void *data, size_t len)
+{
+    if((flags & _FREAD)==0) return -EBADF;
+    return pipe->read(data,len,flags & _FNONBLOCK);
+}
+
+off_t PipeFile::lseek(off_t pos, int whence)
+{
+    return -ESPIPE;
+}
+
+int PipeFile::fstat(struct stat *pstat) const
+{
+    memset(pstat,0,sizeof(struct stat));
+    if(getParent()) pstat->st_dev=getParent()->getFsId();
+    pstat->st_mode=S_IFIFO | 0600; //prw-------
+    pstat->st_nlink=1;
+    pstat->st_blksize=PIPE_BUFFER_SIZE;
+    return 0;
+}
+
+int PipeFile::poll(int events, PollEntry *entry)
+{
+    return pipe->poll(flags,events,entry);
+}
+
+ssize_t PipeFile::spliceTo(FileBase *out, size_t len)
+{
+    if((flags & _FREAD)==0) return -EBADF;
+    return pipe->spliceTo(out,len,flags & _FNONBLOCK);
+}
+
+ssize_t PipeFile::spliceFrom(FileBase *in, size_t len)
+{
+    if((flags & _FWRITE)==0) return -EBADF;
+    return pipe->spliceFrom(in,len,flags & _FNONBLOCK);
+}
+
+const void *PipeFile::getSpliceBuffer() const
+{
+    return pipe.get();
+}
+
+PipeFile::~PipeFile()
+{
+    pipe->removeEnd(flags);
+}
+
+#endif //WITH_FILESYSTEM
+
+} //namespace miosix
@@ -0,0 +1,266 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef PIPE_H
+#define	PIPE_H
+
+#include "filesystem/file.h"
+#include "kernel/sync.h"
+#include "config/miosix_settings.h"
+
+namespace miosix {
+
+#ifdef WITH_FILESYSTEM
+
+/**
+ * The ring buffer shared by the two ends of a pipe or FIFO. Readers and
+ * writers are counted so that reading returns end of file once all writers
+ * have closed the pipe, and writing fails with EPIPE once all readers have.
+ * Unlike POSIX, opening a FIFO does not block waiting for the other end,
+ * rather read() and write() block until the other end is opened for the
+ * first time.
+ */
+class Pipe : public IntrusiveRefCounted
+{
+public:
+    /**
+     * Constructor
+     */
+    Pipe();
+    
+    /**
+     * Called when an end of the pipe is opened
+     * \param flags _FREAD, _FWRITE, or both
+     */
+    void addEnd(int flags);
+    
+    /**
+     * Called when an end of the pipe is closed
+     * \param flags the same flags passed to addEnd()
+     */
+    void removeEnd(int flags);
+    
+    /**
+     * Read data from the pipe, blocking if it is empty
+     * \param data buffer to store read data
+     * \param len the number of bytes to read
+     * \param nonblock if true, return -EAGAIN instead of blocking
+     * \return the number of read bytes, 0 on end of file, or a negative
+     * number in case of errors
+     */
+    ssize_t read(void *data, size_t len, bool nonblock);
+    
+    /**
+     * Write data to the pipe, blocking until all data has been written.
+     * Writes are never interleaved with those of other writers
+     * \param data the data to write
+     * \param len the number of bytes to write
+     * \param nonblock if true, write only as much data as fits in the buffer,
+     * returning -EAGAIN if the buffer is full
+     * \return the number of written bytes, or a negative number in case of
+     * errors
+     */
+    ssize_t write(const void *data, size_t len, bool nonblock);
+    
+    /**
+     * Move data from the pipe to a file, writing it directly from the pipe
+     * buffer. Blocks if the pipe is empty
+     * \param out file where data is written
+     * \param len maximum number of bytes to move
+     * \param nonblock if true, return -EAGAIN instead of blocking
+     * \return the number of moved bytes, 0 on end of file, or a negative
+     * number in case of errors
+     */
+    ssize_t spliceTo(FileBase *out, size_t len, bool nonblock);
+    
+    /**
+     * Move data from a file to the pipe, reading it directly into the pipe
+     * buffer. Blocks if the pipe is full
+     * \param in file where data is read
+     * \param len maximum number of bytes to move
+     * \param nonblock if true, return -EAGAIN instead of blocking
+     * \return the number of moved bytes, 0 if in is at end of file, or a
+     * negative number in case of errors
+     */
+    ssize_t spliceFrom(FileBase *in, size_t len, bool nonblock);
+    
+    /**
+     * Check whether reading or writing would block, see FileBase::poll()
+     * \param flags _FREAD, _FWRITE or both, depending on the pipe end
+     * \param events events of interest
+     * \param entry if not null, entry to add to the PollQueue
+     * \return the ready events among the requested ones, plus POLLHUP if all
+     * writers closed the pipe and POLLERR if all readers did
+     */
+    int poll(int flags, int events, PollEntry *entry);
+    
+    /**
+     * Destructor
+     */
+    ~Pipe();
+    
+private:
+    Pipe(const Pipe&);
+    Pipe& operator=(const Pipe&);
+    
+    /**
+     * Wait till the pipe contains data. Must be called with mutex locked
+     * \param l lock on mutex
+     * \param nonblock if true, return -EAGAIN instead of blocking
+     * \return 1 if the pipe contains data, 0 on end of file, or a negative
+     * number in case of errors
+     */
+    int waitForData(Lock<FastMutex>& l, bool nonblock);
+    
+    /**
+     * Wait till the pipe has free space. Must be called with mutex locked
+     * \param l lock on mutex
+     * \param nonblock if true, return -EAGAIN instead of blocking
+     * \return 1 if the pipe has free space, or a negative number in case of
+     * errors
+     */
+    int waitForSpace(Lock<FastMutex>& l, bool nonblock);
+    
+    /**
+     * Remove data from the pipe and wake blocked writers.
+     * Must be called with mutex locked
+     * \param len number of bytes removed
+     */
+    void consumed(unsigned int len);
+    
+    /**
+     * Add data to the pipe and wake blocked readers.
+     * Must be called with mutex locked
+     * \param len number of bytes added
+     */
+    void produced(unsigned int len);
+    
+    FastMutex readMutex;    ///< Serializes readers
+    FastMutex writeMutex;   ///< Serializes writers
+    FastMutex mutex;        ///< Protects the pipe state
+    ConditionVariable cond; ///< Signaled when the pipe state changes
+    PollQueue pollQueue;    ///< Threads polling the pipe
+    char *buffer;           ///< Ring buffer
+    unsigned int get;       ///< Index of the first byte to read
+    unsigned int used;      ///< Number of bytes in the buffer
+    short readers;          ///< Number of open read ends
+    short writers;          ///< Number of open write ends
+    bool hadReader;         ///< A read end was opened since the pipe was idle
+    bool hadWriter;         ///< A write end was opened since the pipe was idle
+};
+
+/**
+ * One end of a pipe or FIFO
+ */
+class PipeFile : public FileBase
+{
+public:
+    /**
+     * Constructor
+     * \param parent the filesystem containing the FIFO, or an empty pointer
+     * for anonymous pipes
+     * \param pipe the pipe
+     * \param flags _FREAD, _FWRITE, or both, and optionally _FNONBLOCK
+     */
+    PipeFile(intrusive_ref_ptr<FilesystemBase> parent,
+            intrusive_ref_ptr<Pipe> pipe, int flags);
+    
+    /**
+     * Write data to the pipe
+     * \param data the data to write
+     * \param len the number of bytes to write
+     * \return the number of written characters, or a negative number in
+     * case of errors
+     */
+    virtual ssize_t write(const void *data, size_t len);
+    
+    /**
+     * Read data from the pipe
+     * \param data buffer to store read data
+     * \param len the number of bytes to read
+     * \return the number of read characters, or a negative number in
+     * case of errors
+     */
+    virtual ssize_t read(void *data, size_t len);
+    
+    /**
+     * Pipes are not seekable
+     * \return -ESPIPE
+     */
+    virtual off_t lseek(off_t pos, int whence);
+    
+    /**
+     * Return file information.
+     * \param pstat pointer to stat struct
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int fstat(struct stat *pstat) const;
+    
+    /**
+     * Check whether read() or write() would block
+     * \param events events of interest, such as POLLIN and POLLOUT
+     * \param entry if not null, entry to add to the pipe PollQueue
+     * \return the ready events among the requested ones
+     */
+    virtual int poll(int events, PollEntry *entry);
+    
+    /**
+     * Move data from the pipe to another file
+     * \param out file where data is written
+     * \param len maximum number of bytes to move
+     * \return the number of moved bytes, or a negative number on failure
+     */
+    virtual ssize_t spliceTo(FileBase *out, size_t len);
+    
+    /**
+     * Move data from another file to the pipe
+     * \param in file where data is read
+     * \param len maximum number of bytes to move
+     * \return the number of moved bytes, or a negative number on failure
+     */
+    virtual ssize_t spliceFrom(FileBase *in, size_t len);
+    
+    /**
+     * \return the pipe, which is shared by all the ends of the same pipe
+     */
+    virtual const void *getSpliceBuffer() const;
+    
+    /**
+     * Destructor
+     */
+    ~PipeFile();
+    
+private:
+    intrusive_ref_ptr<Pipe> pipe; ///< The pipe
+    int flags;                    ///< File open flags
+};
+
+#endif //WITH_FILESYSTEM
+
+} //namespace miosix
+
+#endif //PIPE_H
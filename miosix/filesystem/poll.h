@@ -0,0 +1,73 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef POLL_H
+#define	POLL_H
+
+/*
+ * The C library has no <poll.h>, so the poll() API is declared here. Include
+ * this header to use poll() both in the kernel and in processes.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+typedef unsigned int nfds_t;
+
+struct pollfd
+{
+    int fd;        ///< File descriptor, ignored if negative
+    short events;  ///< Requested events
+    short revents; ///< Returned events
+};
+
+#define POLLIN     0x0001 ///< Data can be read without blocking
+#define POLLPRI    0x0002 ///< Priority data can be read, never returned
+#define POLLOUT    0x0004 ///< Data can be written without blocking
+#define POLLERR    0x0008 ///< Error condition, always reported
+#define POLLHUP    0x0010 ///< Peer closed, always reported
+#define POLLNVAL   0x0020 ///< fd is not open, always reported
+#define POLLRDNORM POLLIN
+#define POLLWRNORM POLLOUT
+
+/**
+ * Wait until one of the file descriptors becomes ready
+ * \param fds file descriptors to wait for and events of interest
+ * \param nfds number of elements in fds
+ * \param timeout timeout in milliseconds, 0 to return immediately, a negative
+ * number to wait indefinitely
+ * \return the number of elements of fds with a nonzero revents field, 0 on
+ * timeout, or -1 on failure
+ */
+int poll(struct pollfd *fds, nfds_t nfds, int timeout);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+
+#endif //POLL_H
@@ -0,0 +1,364 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "romfs.h"
+#include <cstring>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include "filesystem/stringpart.h"
+#include "filesystem/ioctl.h"
+
+using namespace std;
+
+namespace miosix {
+
+#ifdef WITH_FILESYSTEM
+
+/**
+ * Regular file of RomFs
+ */
+class RomFsFile : public FileBase
+{
+public:
+    /**
+     * Constructor
+     * \param parent the filesystem to which this file belongs
+     * \param data file content
+     * \param size file size
+     * \param inode file inode
+     */
+    RomFsFile(intrusive_ref_ptr<FilesystemBase> parent, const char *data,
+            unsigned int size, int inode) : FileBase(parent), data(data),
+            size(size), inode(inode), seekPoint(0) {}
+    
+    /**
+     * Write data to the file, if the file supports writing.
+     * \param data the data to write
+     * \param len the number of bytes to write
+     * \return the number of written characters, or a negative number in case
+     * of errors
+     */
+    virtual ssize_t write(const void *data, size_t len);
+    
+    /**
+     * Read data from the file, if the file supports reading.
+     * \param data buffer to store read data
+     * \param len the number of bytes to read
+     * \return the number of read characters, or a negative number in case
+     * of errors
+     */
+    virtual ssize_t read(void *data, size_t len);
+    
+    /**
+     * Move file pointer, if the file supports random-access.
+     * \param pos offset to sum to the beginning of the file, current position
+     * or end of file, depending on whence
+     * \param whence SEEK_SET, SEEK_CUR or SEEK_END
+     * \return the offset from the beginning of the file if the operation
+     * completed, or a negative number in case of errors
+     */
+    virtual off_t lseek(off_t pos, int whence);
+    
+    /**
+     * Return file information.
+     * \param pstat pointer to stat struct
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int fstat(struct stat *pstat) const;
+    
+    /**
+     * Perform various operations on a file descriptor
+     * \param cmd specifies the operation to perform
+     * \param arg optional argument that some operation require
+     * \return the exact return value depends on CMD, -1 is returned on error
+     */
+    virtual int ioctl(int cmd, void *arg);
+    
+private:
+    const char *data;       ///< File content
+    const unsigned int size;///< File size
+    const int inode;        ///< File inode
+    off_t seekPoint;        ///< Seek point
+};
+
+ssize_t RomFsFile::write(const void *data, size_t len)
+{
+    return -EBADF;
+}
+
+ssize_t RomFsFile::read(void *data, size_t len)
+{
+    if(seekPoint>=size) return 0;
+    len=min<off_t>(len,size-seekPoint);
+    memcpy(data,this->data+seekPoint,len);
+    seekPoint+=len;
+    return len;
+}
+
+off_t RomFsFile::lseek(off_t pos, int whence)
+{
+    off_t newSeekPoint=seekPoint;
+    switch(whence)
+    {
+        case SEEK_CUR:
+            newSeekPoint+=pos;
+            break;
+        case SEEK_SET:
+            newSeekPoint=pos;
+            break;
+        case SEEK_END:
+            newSeekPoint=size+pos;
+            break;
+        default:
+            return -EINVAL;
+    }
+    if(newSeekPoint<0) return -EOVERFLOW;
+    seekPoint=newSeekPoint;
+    return seekPoint;
+}
+
+int RomFsFile::fstat(struct stat *pstat) const
+{
+    memset(pstat,0,sizeof(struct stat));
+    pstat->st_dev=getParent()->getFsId();
+    pstat->st_ino=inode;
+    pstat->st_mode=S_IFREG | 0555; //-r-xr-xr-x
+    pstat->st_nlink=1;
+    pstat->st_size=size;
+    return 0;
+}
+
+int RomFsFile::ioctl(int cmd, void *arg)
+{
+    if(cmd!=IOCTL_GET_XIP_POINTER) return -ENOTTY;
+    *reinterpret_cast<const void**>(arg)=data;
+    return 0;
+}
+
+/**
+ * Directory class for RomFs
+ */
+class RomFsDirectory : public DirectoryBase
+{
+public:
+    /**
+     * \param parent parent filesystem
+     * \param fs parent filesystem, needed to compute inodes
+     * \param dir the directory we're listing
+     * \param currentInode inode of the directory we're listing
+     * \param parentInode inode of the parent directory
+     */
+    RomFsDirectory(intrusive_ref_ptr<FilesystemBase> parent, const RomFs *fs,
+            const RomFsEntry *dir, int currentInode, int parentInode)
+            : DirectoryBase(parent), fs(fs), dir(dir),
+              currentInode(currentInode), parentInode(parentInode),
+              index(0), first(true) {}
+    
+    /**
+     * Also directories can be opened as files. In this case, this system
+     * call allows to retrieve directory entries.
+     * \param dp pointer to a memory buffer where one or more struct dirent
+     * will be placed. dp must be four words aligned.
+     * \param len memory buffer size.
+     * \return the number of bytes read on success, or a negative number on
+     * failure.
+     */
+    virtual int getdents(void *dp, int len);
+    
+private:
+    const RomFs *fs;              ///< Filesystem
+    const RomFsEntry *dir;        ///< Directory we're listing
+    int currentInode,parentInode; ///< Inodes of . and ..
+    unsigned int index;           ///< First unhandled item in directory
+    bool first;                   ///< True if first time getdents is called
+};
+
+int RomFsDirectory::getdents(void *dp, int len)
+{
+    if(len<minimumBufferSize) return -EINVAL;
+    if(index>dir->size) return 0; //Directory has ended
+    
+    char *begin=reinterpret_cast<char*>(dp);
+    char *buffer=begin;
+    char *end=buffer+len;
+    if(first)
+    {
+        first=false;
+        addDefaultEntries(&buffer,currentInode,parentInode);
+    }
+    const RomFsEntry *table=reinterpret_cast<const RomFsEntry*>(
+        fs->image+dir->dataOffset);
+    for(;index<dir->size;index++)
+    {
+        const RomFsEntry *e=&table[index];
+        char type=(e->flags & RomFsEntry::directory) ? DT_DIR : DT_REG;
+        StringPart name(fs->image+e->nameOffset);
+        if(addEntry(&buffer,end,fs->inode(e),type,name)<0)
+            return buffer-begin; //Buffer finished
+    }
+    if(addTerminatingEntry(&buffer,end)<0) return buffer-begin;
+    index++; //Mark the directory as ended
+    return buffer-begin;
+}
+
+//
+// class RomFs
+//
+
+RomFs::RomFs(const void *image) : image(reinterpret_cast<const char*>(image)),
+        failed(true)
+{
+    if(reinterpret_cast<unsigned int>(image) % romFsDataAlignment) return;
+    const RomFsHeader *header=reinterpret_cast<const RomFsHeader*>(image);
+    if(header->magic!=RomFsHeader::romFsMagic) return;
+    if(header->rootOffset+header->rootEntries*sizeof(RomFsEntry)
+        >header->imageSize) return;
+    rootEntry.nameOffset=0;
+    rootEntry.dataOffset=header->rootOffset;
+    rootEntry.size=header->rootEntries;
+    rootEntry.flags=RomFsEntry::directory;
+    failed=false;
+}
+
+int RomFs::open(intrusive_ref_ptr<FileBase>& file, StringPart& name,
+        int flags, int mode)
+{
+    if(failed) return -ENOENT;
+    if(flags & (O_WRONLY | O_RDWR | O_APPEND | O_CREAT | O_TRUNC))
+        return -EROFS;
+    const RomFsEntry *entry;
+    int parentInode;
+    if(int result=lookup(name,entry,parentInode)) return result;
+    if(entry->flags & RomFsEntry::directory)
+    {
+        file=intrusive_ref_ptr<FileBase>(new RomFsDirectory(
+            shared_from_this(),this,entry,inode(entry),parentInode));
+    } else {
+        file=intrusive_ref_ptr<FileBase>(new RomFsFile(shared_from_this(),
+            image+entry->dataOffset,entry->size,inode(entry)));
+    }
+    return 0;
+}
+
+int RomFs::lstat(StringPart& name, struct stat *pstat)
+{
+    if(failed) return -ENOENT;
+    const RomFsEntry *entry;
+    int parentInode;
+    if(int result=lookup(name,entry,parentInode)) return result;
+    fillStat(entry,pstat);
+    return 0;
+}
+
+int RomFs::unlink(StringPart& name)
+{
+    return -EROFS;
+}
+
+int RomFs::rename(StringPart& oldName, StringPart& newName)
+{
+    return -EROFS;
+}
+
+int RomFs::mkdir(StringPart& name, int mode)
+{
+    return -EROFS;
+}
+
+int RomFs::rmdir(StringPart& name)
+{
+    return -EROFS;
+}
+
+int RomFs::lookup(StringPart& name, const RomFsEntry *& entry, int& parentInode)
+{
+    entry=&rootEntry;
+    parentInode=parentFsMountpointInode;
+    const char *path=name.c_str();
+    unsigned int len=name.length();
+    unsigned int begin=0;
+    while(begin<len)
+    {
+        unsigned int end=begin;
+        while(end<len && path[end]!='/') end++;
+        if((entry->flags & RomFsEntry::directory)==0) return -ENOTDIR;
+        const char *component=path+begin;
+        unsigned int componentLen=end-begin;
+        const RomFsEntry *table=reinterpret_cast<const RomFsEntry*>(
+            image+entry->dataOffset);
+        //Binary search, entries are sorted by name
+        unsigned int lo=0, hi=entry->size;
+        const RomFsEntry *found=0;
+        while(lo<hi)
+        {
+            unsigned int mid=lo+(hi-lo)/2;
+            const char *entryName=image+table[mid].nameOffset;
+            int c=strncmp(entryName,component,componentLen);
+            if(c==0 && entryName[componentLen]!='\0') c=1;
+            if(c==0)
+            {
+                found=&table[mid];
+                break;
+            }
+            if(c<0) lo=mid+1; else hi=mid;
+        }
+        if(found==0) return -ENOENT;
+        parentInode=inode(entry);
+        entry=found;
+        begin=end+1;
+    }
+    return 0;
+}
+
+int RomFs::inode(const RomFsEntry *entry) const
+{
+    //Entries are at least 16 bytes from the start of the image because of
+    //the header, so their offset can't clash with the root inode
+    if(entry==&rootEntry) return rootDirInode;
+    return reinterpret_cast<const char*>(entry)-image;
+}
+
+void RomFs::fillStat(const RomFsEntry *entry, struct stat *pstat) const
+{
+    memset(pstat,0,sizeof(struct stat));
+    pstat->st_dev=filesystemId;
+    pstat->st_ino=inode(entry);
+    pstat->st_nlink=1;
+    if(entry->flags & RomFsEntry::directory)
+    {
+        pstat->st_mode=S_IFDIR | 0555; //dr-xr-xr-x
+    } else {
+        pstat->st_mode=S_IFREG | 0555; //-r-xr-xr-x
+        pstat->st_size=entry->size;
+    }
+}
+
+#endif //WITH_FILESYSTEM
+
+} //namespace miosix
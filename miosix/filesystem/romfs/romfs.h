@@ -0,0 +1,160 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef ROMFS_H
+#define	ROMFS_H
+
+#include "filesystem/file.h"
+#include "filesystem/romfs/romfs_types.h"
+#include "config/miosix_settings.h"
+
+namespace miosix {
+
+#ifdef WITH_FILESYSTEM
+
+/**
+ * A read-only filesystem whose image is stored in memory, usually in the
+ * microcontroller's internal flash. Images are built from a directory tree
+ * with the mx-buildromfs host tool, which can output a C++ source file that is
+ * then compiled and linked with the application, for example
+ * \code
+ * extern const unsigned char romfsImage[];
+ * intrusive_ref_ptr<RomFs> romfs(new RomFs(romfsImage));
+ * if(romfs->mountFailed()==false)
+ * {
+ *     mkdir("/rom",0755);
+ *     FilesystemManager::instance().kmount("/rom",romfs);
+ * }
+ * \endcode
+ * The file content can be accessed in place, without copying it in RAM, by
+ * getting a pointer to it with ioctl(fd,IOCTL_GET_XIP_POINTER,&ptr).
+ */
+class RomFs : public FilesystemBase
+{
+public:
+    /**
+     * Constructor
+     * \param image pointer to the filesystem image. The image is not copied,
+     * so it must remain valid as long as the filesystem exists. It must be
+     * aligned to romFsDataAlignment
+     */
+    RomFs(const void *image);
+    
+    /**
+     * Open a file
+     * \param file the file object will be stored here, if the call succeeds
+     * \param name the name of the file to open, relative to the local
+     * filesystem
+     * \param flags file flags (open for reading, writing, ...)
+     * \param mode file permissions
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int open(intrusive_ref_ptr<FileBase>& file, StringPart& name,
+            int flags, int mode);
+    
+    /**
+     * Obtain information on a file, identified by a path name. Does not follow
+     * symlinks
+     * \param name path name, relative to the local filesystem
+     * \param pstat file information is stored here
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int lstat(StringPart& name, struct stat *pstat);
+    
+    /**
+     * Remove a file or directory
+     * \param name path name of file or directory to remove
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int unlink(StringPart& name);
+    
+    /**
+     * Rename a file or directory
+     * \param oldName old file name
+     * \param newName new file name
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int rename(StringPart& oldName, StringPart& newName);
+    
+    /**
+     * Create a directory
+     * \param name directory name
+     * \param mode directory permissions
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int mkdir(StringPart& name, int mode);
+    
+    /**
+     * Remove a directory if empty
+     * \param name directory name
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int rmdir(StringPart& name);
+    
+    /**
+     * \return true if the filesystem failed to mount, because the image is
+     * not valid
+     */
+    bool mountFailed() const { return failed; }
+    
+private:
+    /**
+     * Find a file or directory. Each path component is looked up with a
+     * binary search in the directory table
+     * \param name path relative to the filesystem
+     * \param entry the entry is returned here
+     * \param parentInode the inode of the directory containing the entry
+     * is returned here
+     * \return 0 on success, or a negative number on failure
+     */
+    int lookup(StringPart& name, const RomFsEntry *& entry, int& parentInode);
+    
+    /**
+     * \param entry an entry of this filesystem
+     * \return its inode
+     */
+    int inode(const RomFsEntry *entry) const;
+    
+    /**
+     * \param entry an entry of this filesystem
+     * \param pstat file information is stored here
+     */
+    void fillStat(const RomFsEntry *entry, struct stat *pstat) const;
+    
+    const char *image;    ///< Filesystem image
+    RomFsEntry rootEntry; ///< Entry pointing to the root directory table
+    bool failed;          ///< Failed to mount
+    static const int rootDirInode=1;
+    
+    friend class RomFsDirectory;
+};
+
+#endif //WITH_FILESYSTEM
+
+} //namespace miosix
+
+#endif //ROMFS_H
@@ -0,0 +1,76 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef ROMFS_TYPES_H
+#define ROMFS_TYPES_H
+
+// NOTE: this file is also used by the mx-buildromfs host tool, so it must not
+// depend on the rest of the kernel
+
+namespace miosix {
+
+/*
+ * A RomFs image is made of a header, followed by directory tables, by the
+ * \0 terminated file names and by the file content. Every directory table is
+ * an array of RomFsEntry sorted by name, so that lookups can use binary search.
+ * File content is aligned to romFsDataAlignment bytes, to allow using it in
+ * place from flash memory. All offsets are relative to the start of the image,
+ * and all fields are little endian.
+ */
+
+/**
+ * RomFs image header
+ */
+struct RomFsHeader
+{
+    static const unsigned int romFsMagic=0x4652584d; ///< "MXRF"
+
+    unsigned int magic;       ///< Must be romFsMagic
+    unsigned int imageSize;   ///< Size of the whole image, including header
+    unsigned int rootOffset;  ///< Offset of the root directory table
+    unsigned int rootEntries; ///< Number of entries in the root directory
+};
+
+/**
+ * RomFs directory entry
+ */
+struct RomFsEntry
+{
+    static const unsigned int directory=1; ///< Flag bit for directories
+
+    unsigned int nameOffset; ///< Offset of the \0 terminated name
+    unsigned int dataOffset; ///< Offset of the file content or directory table
+    unsigned int size;       ///< File size, or number of entries in directory
+    unsigned int flags;      ///< Bitmask of flags
+};
+
+/// Alignment of file content in the image
+const unsigned int romFsDataAlignment=8;
+
+} //namespace miosix
+
+#endif //ROMFS_TYPES_H
@@ -0,0 +1,62 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef SPLICE_H
+#define	SPLICE_H
+
+#include <sys/types.h>
+
+/*
+ * splice() is not part of the C library, so it is declared here. Include this
+ * header to use splice() both in the kernel and in processes. pipe() and
+ * mkfifo() are declared in <unistd.h> and <sys/stat.h> as usual.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+/**
+ * Move data between two file descriptors without copying it to a user buffer.
+ * At least one of the two file descriptors has to be a pipe or FIFO, and data
+ * is read or written directly from or to the pipe buffer, so moving data from
+ * a pipe to a file or device costs a single copy. Unlike the Linux call of the
+ * same name, there are no offset and flags parameters, data is read and
+ * written at the current file position. If the two file descriptors refer
+ * to the same pipe, the call fails with EINVAL
+ * \param fdIn file descriptor where data is read
+ * \param fdOut file descriptor where data is written
+ * \param len maximum number of bytes to move
+ * \return the number of moved bytes, 0 at end of file, or -1 on failure
+ */
+ssize_t splice(int fdIn, int fdOut, size_t len);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+
+#endif //SPLICE_H
@@ -0,0 +1,743 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "tmpfs.h"
+#include <map>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include "filesystem/stringpart.h"
+#include "filesystem/pipe/pipe.h"
+
+using namespace std;
+
+namespace miosix {
+
+#ifdef WITH_FILESYSTEM
+
+/**
+ * A file, directory or FIFO of TmpFs. Nodes are reference counted, so that a file
+ * that is unlinked while open is deallocated only when it is closed.
+ * Member functions must be called with the filesystem mutex locked
+ */
+class TmpFsNode : public IntrusiveRefCounted
+{
+public:
+    typedef map<StringPart,intrusive_ref_ptr<TmpFsNode> > Entries;
+    
+    /**
+     * Constructor
+     * \param fs filesystem the node belongs to
+     * \param inode inode number
+     * \param directory true if the node is a directory
+     * \param parentInode inode of the parent directory
+     */
+    TmpFsNode(TmpFs *fs, int inode, bool directory, int parentInode)
+            : fs(fs), inode(inode), parentInode(parentInode), size(0),
+              directory(directory) {}
+    
+    /**
+     * Change the size of the file, allocating or freeing blocks. If the file
+     * grows, the new part is left uninitialized
+     * \param newSize new file size
+     * \return 0 on success, or a negative number on failure
+     */
+    int resize(unsigned int newSize);
+    
+    /**
+     * Copy data to the file. The range must be within the file size
+     * \param data data to write, or nullptr to fill with zeros
+     * \param pos position in the file
+     * \param len number of bytes
+     */
+    void writeData(const char *data, unsigned int pos, unsigned int len);
+    
+    /**
+     * Copy data from the file. The range must be within the file size
+     * \param data buffer where data is stored
+     * \param pos position in the file
+     * \param len number of bytes
+     */
+    void readData(char *data, unsigned int pos, unsigned int len) const;
+    
+    /**
+     * \return the number of allocated blocks
+     */
+    unsigned int allocatedBlocks() const;
+    
+    /**
+     * Fill a stat struct with information about the node
+     * \param pstat pointer to stat struct
+     */
+    void fillStat(struct stat *pstat) const;
+    
+    /**
+     * Destructor, frees the blocks
+     */
+    ~TmpFsNode();
+    
+    TmpFs *fs;                       ///< Filesystem the node belongs to
+    const int inode;                 ///< Inode number
+    int parentInode;                 ///< Parent directory inode (directories)
+    unsigned int size;               ///< File size in bytes
+    const bool directory;            ///< True if this is a directory
+    vector<TmpFs::Extent> extents;   ///< File content
+    Entries entries;                 ///< Directory content
+    intrusive_ref_ptr<Pipe> fifo;    ///< FIFO buffer, empty if not a FIFO
+    
+private:
+    TmpFsNode(const TmpFsNode&);
+    TmpFsNode& operator=(const TmpFsNode&);
+    
+    /**
+     * Find the memory holding a byte of the file
+     * \param pos position in the file, must be within the allocated blocks
+     * \param contiguous number of bytes that are contiguous in memory starting
+     * from the returned pointer is returned here
+     * \return a pointer to the byte at position pos
+     */
+    char *locate(unsigned int pos, unsigned int& contiguous) const;
+};
+
+int TmpFsNode::resize(unsigned int newSize)
+{
+    unsigned int needed=(newSize+TmpFs::blockSize-1)/TmpFs::blockSize;
+    unsigned int allocated=allocatedBlocks();
+    if(needed>allocated)
+    {
+        if(int result=fs->allocate(extents,needed-allocated)) return result;
+    } else if(needed<allocated) fs->deallocate(extents,allocated-needed);
+    size=newSize;
+    return 0;
+}
+
+void TmpFsNode::writeData(const char *data, unsigned int pos, unsigned int len)
+{
+    while(len>0)
+    {
+        unsigned int contiguous;
+        char *p=locate(pos,contiguous);
+        unsigned int n=min(len,contiguous);
+        if(data)
+        {
+            memcpy(p,data,n);
+            data+=n;
+        } else memset(p,0,n);
+        pos+=n;
+        len-=n;
+    }
+}
+
+void TmpFsNode::readData(char *data, unsigned int pos, unsigned int len) const
+{
+    while(len>0)
+    {
+        unsigned int contiguous;
+        const char *p=locate(pos,contiguous);
+        unsigned int n=min(len,contiguous);
+        memcpy(data,p,n);
+        data+=n;
+        pos+=n;
+        len-=n;
+    }
+}
+
+unsigned int TmpFsNode::allocatedBlocks() const
+{
+    unsigned int result=0;
+    for(unsigned int i=0;i<extents.size();i++) result+=extents[i].count;
+    return result;
+}
+
+void TmpFsNode::fillStat(struct stat *pstat) const
+{
+    memset(pstat,0,sizeof(struct stat));
+    pstat->st_dev=fs->getFsId();
+    pstat->st_ino=inode;
+    if(directory) pstat->st_mode=S_IFDIR | 0755;   //drwxr-xr-x
+    else if(fifo) pstat->st_mode=S_IFIFO | 0600;   //prw-------
+    else pstat->st_mode=S_IFREG | 0755;            //-rwxr-xr-x
+    pstat->st_nlink=1;
+    pstat->st_size=size;
+    pstat->st_blksize=TmpFs::blockSize;
+    pstat->st_blocks=allocatedBlocks()*TmpFs::blockSize/512;
+}
+
+TmpFsNode::~TmpFsNode()
+{
+    //The mutex is recursive, as the last reference to a node may be dropped
+    //either while the filesystem is already locked (unlink) or not (close)
+    Lock<FastMutex> l(fs->mutex);
+    fs->deallocate(extents,allocatedBlocks());
+}
+
+char *TmpFsNode::locate(unsigned int pos, unsigned int& contiguous) const
+{
+    for(unsigned int i=0;i<extents.size();i++)
+    {
+        unsigned int extentSize=extents[i].count*TmpFs::blockSize;
+        if(pos<extentSize)
+        {
+            contiguous=extentSize-pos;
+            return fs->arena+extents[i].first*TmpFs::blockSize+pos;
+        }
+        pos-=extentSize;
+    }
+    contiguous=0; //Should never happen
+    return 0;
+}
+
+/**
+ * Regular file of TmpFs
+ */
+class TmpFsFile : public FileBase
+{
+public:
+    /**
+     * Constructor
+     * \param parent the filesystem to which this file belongs
+     * \param node the node holding the file content
+     * \param flags file open flags (_FREAD, _FWRITE, ...)
+     */
+    TmpFsFile(intrusive_ref_ptr<FilesystemBase> parent,
+            intrusive_ref_ptr<TmpFsNode> node, int flags)
+            : FileBase(parent), node(node), seekPoint(0), flags(flags) {}
+    
+    /**
+     * Write data to the file, if the file supports writing.
+     * \param data the data to write
+     * \param len the number of bytes to write
+     * \return the number of written characters, or a negative number in case
+     * of errors
+     */
+    virtual ssize_t write(const void *data, size_t len);
+    
+    /**
+     * Read data from the file, if the file supports reading.
+     * \param data buffer to store read data
+     * \param len the number of bytes to read
+     * \return the number of read characters, or a negative number in case
+     * of errors
+     */
+    virtual ssize_t read(void *data, size_t len);
+    
+    /**
+     * Move file pointer, if the file supports random-access.
+     * \param pos offset to sum to the beginning of the file, current position
+     * or end of file, depending on whence
+     * \param whence SEEK_SET, SEEK_CUR or SEEK_END
+     * \return the offset from the beginning of the file if the operation
+     * completed, or a negative number in case of errors
+     */
+    virtual off_t lseek(off_t pos, int whence);
+    
+    /**
+     * Return file information.
+     * \param pstat pointer to stat struct
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int fstat(struct stat *pstat) const;
+    
+    /**
+     * Truncate or extend the file to the given size. If the file is extended,
+     * the extended part reads as zeros. The file pointer is not changed
+     * \param size new file size
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int ftruncate(off_t size);
+    
+    /**
+     * Allocate storage for the byte range [offset,offset+len), extending the
+     * file size if needed, so that subsequent writes to the range can't fail
+     * due to lack of space
+     * \param offset start of the range
+     * \param len length of the range
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int fallocate(off_t offset, off_t len);
+    
+private:
+    /**
+     * Grow the file, filling the new part with zeros.
+     * Must be called with the mutex locked
+     * \param newSize new file size, must be greater than the current one
+     * \return 0 on success, or a negative number on failure
+     */
+    int extend(unsigned int newSize);
+    
+    intrusive_ref_ptr<TmpFsNode> node; ///< File content
+    off_t seekPoint;                   ///< Seek point
+    int flags;                         ///< File open flags
+};
+
+ssize_t TmpFsFile::write(const void *data, size_t len)
+{
+    if((flags & _FWRITE)==0) return -EBADF;
+    Lock<FastMutex> l(node->fs->mutex);
+    if(flags & _FAPPEND) seekPoint=node->size;
+    if(seekPoint+static_cast<off_t>(len)>INT_MAX) return -EFBIG;
+    unsigned int end=seekPoint+len;
+    unsigned int oldSize=node->size;
+    if(end>oldSize && node->resize(end)!=0)
+    {
+        //Not enough space, write as much as fits
+        unsigned int capacity=(node->allocatedBlocks()+node->fs->freeBlocks)
+                             *TmpFs::blockSize;
+        if(capacity<=seekPoint) return -ENOSPC;
+        end=capacity;
+        len=end-seekPoint;
+        node->resize(end);
+    }
+    //If seeked past the end of file, the gap reads as zeros
+    if(seekPoint>oldSize) node->writeData(0,oldSize,seekPoint-oldSize);
+    node->writeData(reinterpret_cast<const char*>(data),seekPoint,len);
+    seekPoint+=len;
+    return len;
+}
+
+ssize_t TmpFsFile::read(void *data, size_t len)
+{
+    if((flags & _FREAD)==0) return -EBADF;
+    Lock<FastMutex> l(node->fs->mutex);
+    if(seekPoint>=node->size) return 0;
+    len=min<off_t>(len,node->size-seekPoint);
+    node->readData(reinterpret_cast<char*>(data),seekPoint,len);
+    seekPoint+=len;
+    return len;
+}
+
+off_t TmpFsFile::lseek(off_t pos, int whence)
+{
+    Lock<FastMutex> l(node->fs->mutex);
+    off_t newSeekPoint=seekPoint;
+    switch(whence)
+    {
+        case SEEK_CUR:
+            newSeekPoint+=pos;
+            break;
+        case SEEK_SET:
+            newSeekPoint=pos;
+            break;
+        case SEEK_END:
+            newSeekPoint=node->size+pos;
+            break;
+        default:
+            return -EINVAL;
+    }
+    if(newSeekPoint<0) return -EOVERFLOW;
+    seekPoint=newSeekPoint;
+    return seekPoint;
+}
+
+int TmpFsFile::fstat(struct stat *pstat) const
+{
+    Lock<FastMutex> l(node->fs->mutex);
+    node->fillStat(pstat);
+    return 0;
+}
+
+int TmpFsFile::ftruncate(off_t size)
+{
+    if((flags & _FWRITE)==0) return -EBADF;
+    if(size<0) return -EINVAL;
+    if(size>INT_MAX) return -EFBIG;
+    Lock<FastMutex> l(node->fs->mutex);
+    if(size>static_cast<off_t>(node->size)) return extend(size);
+    return node->resize(size);
+}
+
+int TmpFsFile::fallocate(off_t offset, off_t len)
+{
+    if((flags & _FWRITE)==0) return -EBADF;
+    if(offset<0 || len<=0) return -EINVAL;
+    if(offset+len>INT_MAX) return -EFBIG;
+    Lock<FastMutex> l(node->fs->mutex);
+    if(offset+len<=static_cast<off_t>(node->size)) return 0;
+    return extend(offset+len);
+}
+
+int TmpFsFile::extend(unsigned int newSize)
+{
+    unsigned int oldSize=node->size;
+    if(int result=node->resize(newSize)) return result;
+    node->writeData(0,oldSize,newSize-oldSize);
+    return 0;
+}
+
+/**
+ * Directory class for TmpFs
+ */
+class TmpFsDirectory : public DirectoryBase
+{
+public:
+    /**
+     * \param parent parent filesystem
+     * \param node the directory we're listing
+     * \param parentInode inode of the parent directory
+     */
+    TmpFsDirectory(intrusive_ref_ptr<FilesystemBase> parent,
+            intrusive_ref_ptr<TmpFsNode> node, int parentInode)
+            : DirectoryBase(parent), node(node), parentInode(parentInode),
+              first(true), last(false)
+    {
+        if(node->entries.empty()==false)
+            currentItem=node->entries.begin()->first.c_str();
+    }
+    
+    /**
+     * Also directories can be opened as files. In this case, this system
+     * call allows to retrieve directory entries.
+     * \param dp pointer to a memory buffer where one or more struct dirent
+     * will be placed. dp must be four words aligned.
+     * \param len memory buffer size.
+     * \return the number of bytes read on success, or a negative number on
+     * failure.
+     */
+    virtual int getdents(void *dp, int len);
+    
+    /**
+     * Return file information.
+     * \param pstat pointer to stat struct
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int fstat(struct stat *pstat) const;
+    
+private:
+    intrusive_ref_ptr<TmpFsNode> node; ///< Directory we're listing
+    string currentItem;                ///< First unhandled item in directory
+    int parentInode;                   ///< Inode of ..
+    
+    bool first; ///< True if first time getdents is called
+    bool last;  ///< True if directory has ended
+};
+
+int TmpFsDirectory::getdents(void *dp, int len)
+{
+    if(len<minimumBufferSize) return -EINVAL;
+    if(last) return 0;
+    
+    Lock<FastMutex> l(node->fs->mutex);
+    char *begin=reinterpret_cast<char*>(dp);
+    char *buffer=begin;
+    char *end=buffer+len;
+    if(first)
+    {
+        first=false;
+        addDefaultEntries(&buffer,node->inode,parentInode);
+    }
+    if(currentItem.empty()==false)
+    {
+        //If the saved entry has been removed, continue from the next one
+        TmpFsNode::Entries::iterator it;
+        it=node->entries.lower_bound(StringPart(currentItem.c_str()));
+        for(;it!=node->entries.end();++it)
+        {
+            char type=DT_REG;
+            if(it->second->directory) type=DT_DIR;
+            else if(it->second->fifo) type=DT_FIFO;
+            if(addEntry(&buffer,end,it->second->inode,type,it->first)>0)
+                continue;
+            //Buffer finished
+            currentItem=it->first.c_str();
+            return buffer-begin;
+        }
+    }
+    addTerminatingEntry(&buffer,end);
+    last=true;
+    return buffer-begin;
+}
+
+int TmpFsDirectory::fstat(struct stat *pstat) const
+{
+    Lock<FastMutex> l(node->fs->mutex);
+    node->fillStat(pstat);
+    return 0;
+}
+
+//
+// class TmpFs
+//
+
+TmpFs::TmpFs(unsigned int size) : mutex(FastMutex::RECURSIVE),
+        numBlocks((size+blockSize-1)/blockSize), freeBlocks(numBlocks),
+        used(numBlocks,false), inodeCount(rootDirInode+1)
+{
+    arena=new char[numBlocks*blockSize];
+    root=new TmpFsNode(this,rootDirInode,true,rootDirInode);
+}
+
+int TmpFs::open(intrusive_ref_ptr<FileBase>& file, StringPart& name,
+        int flags, int mode)
+{
+    flags++; //To convert from O_RDONLY, O_WRONLY, ... to _FREAD, _FWRITE, ...
+    Lock<FastMutex> l(mutex);
+    intrusive_ref_ptr<TmpFsNode> node;
+    int result=lookup(name.c_str(),name.length(),node);
+    if(result==-ENOENT && (flags & _FCREAT) && name.empty()==false)
+    {
+        intrusive_ref_ptr<TmpFsNode> parent;
+        string leaf;
+        if(int res=lookupParent(name,parent,leaf)) return res;
+        node=new TmpFsNode(this,inodeCount++,false,parent->inode);
+        parent->entries.insert(make_pair(StringPart(leaf.c_str()),node));
+    } else if(result) return result;
+    else if((flags & (_FCREAT | _FEXCL))==(_FCREAT | _FEXCL)) return -EEXIST;
+    
+    if(node->directory)
+    {
+        if(flags & (_FWRITE | _FAPPEND | _FTRUNC)) return -EISDIR;
+        int up=node==root ? parentFsMountpointInode : node->parentInode;
+        file=intrusive_ref_ptr<FileBase>(
+            new TmpFsDirectory(shared_from_this(),node,up));
+        return 0;
+    }
+    if(node->fifo)
+    {
+        file=intrusive_ref_ptr<FileBase>(new PipeFile(shared_from_this(),
+            node->fifo,flags & (_FREAD | _FWRITE | _FNONBLOCK)));
+        return 0;
+    }
+    if((flags & (_FWRITE | _FTRUNC))==(_FWRITE | _FTRUNC)) node->resize(0);
+    file=intrusive_ref_ptr<FileBase>(
+        new TmpFsFile(shared_from_this(),node,flags));
+    return 0;
+}
+
+int TmpFs::lstat(StringPart& name, struct stat *pstat)
+{
+    Lock<FastMutex> l(mutex);
+    intrusive_ref_ptr<TmpFsNode> node;
+    if(int result=lookup(name.c_str(),name.length(),node)) return result;
+    node->fillStat(pstat);
+    return 0;
+}
+
+int TmpFs::unlink(StringPart& name)
+{
+    Lock<FastMutex> l(mutex);
+    intrusive_ref_ptr<TmpFsNode> parent;
+    string leaf;
+    if(int result=lookupParent(name,parent,leaf)) return result;
+    TmpFsNode::Entries::iterator it=parent->entries.find(StringPart(leaf.c_str()));
+    if(it==parent->entries.end()) return -ENOENT;
+    if(it->second->directory) return -EISDIR;
+    //If the file is open, its content is freed when it is closed
+    parent->entries.erase(it);
+    return 0;
+}
+
+int TmpFs::rename(StringPart& oldName, StringPart& newName)
+{
+    Lock<FastMutex> l(mutex);
+    intrusive_ref_ptr<TmpFsNode> oldParent, newParent;
+    string oldLeaf, newLeaf;
+    if(int result=lookupParent(oldName,oldParent,oldLeaf)) return result;
+    if(int result=lookupParent(newName,newParent,newLeaf)) return result;
+    TmpFsNode::Entries::iterator it;
+    it=oldParent->entries.find(StringPart(oldLeaf.c_str()));
+    if(it==oldParent->entries.end()) return -ENOENT;
+    intrusive_ref_ptr<TmpFsNode> node=it->second;
+    
+    TmpFsNode::Entries::iterator target;
+    target=newParent->entries.find(StringPart(newLeaf.c_str()));
+    if(target!=newParent->entries.end())
+    {
+        if(target->second==node) return 0; //Renaming a file to itself
+        if(node->directory)
+        {
+            if(target->second->directory==false) return -ENOTDIR;
+            if(target->second->entries.empty()==false) return -ENOTEMPTY;
+        } else if(target->second->directory) return -EISDIR;
+        newParent->entries.erase(target);
+    }
+    oldParent->entries.erase(it);
+    newParent->entries.insert(make_pair(StringPart(newLeaf.c_str()),node));
+    if(node->directory) node->parentInode=newParent->inode;
+    return 0;
+}
+
+int TmpFs::mkdir(StringPart& name, int mode)
+{
+    if(name.empty()) return -EEXIST;
+    Lock<FastMutex> l(mutex);
+    intrusive_ref_ptr<TmpFsNode> parent;
+    string leaf;
+    if(int result=lookupParent(name,parent,leaf)) return result;
+    StringPart key(leaf.c_str());
+    if(parent->entries.find(key)!=parent->entries.end()) return -EEXIST;
+    parent->entries.insert(make_pair(key,intrusive_ref_ptr<TmpFsNode>(
+        new TmpFsNode(this,inodeCount++,true,parent->inode))));
+    return 0;
+}
+
+int TmpFs::mkfifo(StringPart& name, int mode)
+{
+    if(name.empty()) return -EEXIST;
+    Lock<FastMutex> l(mutex);
+    intrusive_ref_ptr<TmpFsNode> parent;
+    string leaf;
+    if(int result=lookupParent(name,parent,leaf)) return result;
+    StringPart key(leaf.c_str());
+    if(parent->entries.find(key)!=parent->entries.end()) return -EEXIST;
+    intrusive_ref_ptr<TmpFsNode> node(
+        new TmpFsNode(this,inodeCount++,false,parent->inode));
+    node->fifo=new Pipe;
+    parent->entries.insert(make_pair(key,node));
+    return 0;
+}
+
+int TmpFs::rmdir(StringPart& name)
+{
+    if(name.empty()) return -EBUSY; //Can't remove the root directory
+    Lock<FastMutex> l(mutex);
+    intrusive_ref_ptr<TmpFsNode> parent;
+    string leaf;
+    if(int result=lookupParent(name,parent,leaf)) return result;
+    TmpFsNode::Entries::iterator it=parent->entries.find(StringPart(leaf.c_str()));
+    if(it==parent->entries.end()) return -ENOENT;
+    if(it->second->directory==false) return -ENOTDIR;
+    if(it->second->entries.empty()==false) return -ENOTEMPTY;
+    parent->entries.erase(it);
+    return 0;
+}
+
+unsigned int TmpFs::getFreeSpace()
+{
+    Lock<FastMutex> l(mutex);
+    return freeBlocks*blockSize;
+}
+
+TmpFs::~TmpFs()
+{
+    //Nodes free their blocks when deallocated, so the arena must still exist
+    root.reset();
+    delete[] arena;
+}
+
+int TmpFs::lookup(const char *path, unsigned int len,
+        intrusive_ref_ptr<TmpFsNode>& node)
+{
+    node=root;
+    unsigned int begin=0;
+    while(begin<len)
+    {
+        unsigned int end=begin;
+        while(end<len && path[end]!='/') end++;
+        if(node->directory==false) return -ENOTDIR;
+        string component(path+begin,end-begin);
+        TmpFsNode::Entries::iterator it;
+        it=node->entries.find(StringPart(component.c_str()));
+        if(it==node->entries.end()) return -ENOENT;
+        node=it->second;
+        begin=end+1;
+    }
+    return 0;
+}
+
+int TmpFs::lookupParent(StringPart& name, intrusive_ref_ptr<TmpFsNode>& parent,
+        string& leaf)
+{
+    if(name.empty()) return -ENOENT;
+    size_t slash=name.findLastOf('/');
+    if(slash==string::npos)
+    {
+        parent=root;
+        leaf=name.c_str();
+    } else {
+        if(int result=lookup(name.c_str(),slash,parent)) return result;
+        leaf=name.c_str()+slash+1;
+    }
+    if(leaf.empty()) return -ENOENT;
+    if(parent->directory==false) return -ENOTDIR;
+    return 0;
+}
+
+int TmpFs::allocate(vector<Extent>& extents, unsigned int count)
+{
+    if(count>freeBlocks) return -ENOSPC;
+    freeBlocks-=count;
+    //First, try to grow the last extent in place
+    if(extents.empty()==false)
+    {
+        Extent& last=extents.back();
+        while(count>0 && last.first+last.count<numBlocks
+            && used[last.first+last.count]==false)
+        {
+            used[last.first+last.count]=true;
+            last.count++;
+            count--;
+        }
+    }
+    while(count>0)
+    {
+        //Look for the first free run that is large enough, while remembering
+        //the first free run as a fallback. Since count<=freeBlocks one exists
+        unsigned int first=numBlocks, runLength=0;
+        for(unsigned int i=0;i<numBlocks;)
+        {
+            if(used[i])
+            {
+                i++;
+                continue;
+            }
+            unsigned int j=i;
+            while(j<numBlocks && used[j]==false && j-i<count) j++;
+            if(runLength==0 || j-i==count)
+            {
+                first=i;
+                runLength=j-i;
+                if(runLength==count) break;
+            }
+            i=j;
+        }
+        for(unsigned int i=first;i<first+runLength;i++) used[i]=true;
+        extents.push_back(Extent(first,runLength));
+        count-=runLength;
+    }
+    return 0;
+}
+
+void TmpFs::deallocate(vector<Extent>& extents, unsigned int count)
+{
+    freeBlocks+=count;
+    while(count>0)
+    {
+        Extent& last=extents.back();
+        unsigned int n=min(count,last.count);
+        last.count-=n;
+        count-=n;
+        for(unsigned int i=0;i<n;i++) used[last.first+last.count+i]=false;
+        if(last.count==0) extents.pop_back();
+    }
+}
+
+#endif //WITH_FILESYSTEM
+
+} //namespace miosix
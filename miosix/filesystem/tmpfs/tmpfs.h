@@ -0,0 +1,212 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef TMPFS_H
+#define	TMPFS_H
+
+#include <vector>
+#include <string>
+#include "filesystem/file.h"
+#include "kernel/sync.h"
+#include "config/miosix_settings.h"
+
+namespace miosix {
+
+#ifdef WITH_FILESYSTEM
+
+//Forward decls
+class TmpFsNode;
+
+/**
+ * A filesystem that stores files in RAM. Its storage is a memory arena of
+ * fixed size, allocated when the filesystem is created, and divided in blocks.
+ * Files are stored as a list of extents, that is, runs of contiguous blocks,
+ * and the allocator tries to grow files in place to keep the number of extents
+ * low. Directories, rename and unlinking files while they are open are
+ * supported, as are FIFOs. The content of the filesystem is lost when it is
+ * umounted.
+ * 
+ * To use it, create a mountpoint and mount it, for example
+ * \code
+ * mkdir("/tmp",0755);
+ * FilesystemManager::instance().kmount("/tmp",
+ *     intrusive_ref_ptr<FilesystemBase>(new TmpFs(32*1024)));
+ * \endcode
+ */
+class TmpFs : public FilesystemBase
+{
+public:
+    /**
+     * Constructor
+     * \param size storage size in bytes, rounded up to a multiple of blockSize
+     */
+    TmpFs(unsigned int size);
+    
+    /**
+     * Open a file
+     * \param file the file object will be stored here, if the call succeeds
+     * \param name the name of the file to open, relative to the local
+     * filesystem
+     * \param flags file flags (open for reading, writing, ...)
+     * \param mode file permissions
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int open(intrusive_ref_ptr<FileBase>& file, StringPart& name,
+            int flags, int mode);
+    
+    /**
+     * Obtain information on a file, identified by a path name. Does not follow
+     * symlinks
+     * \param name path name, relative to the local filesystem
+     * \param pstat file information is stored here
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int lstat(StringPart& name, struct stat *pstat);
+    
+    /**
+     * Remove a file or directory
+     * \param name path name of file or directory to remove
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int unlink(StringPart& name);
+    
+    /**
+     * Rename a file or directory
+     * \param oldName old file name
+     * \param newName new file name
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int rename(StringPart& oldName, StringPart& newName);
+    
+    /**
+     * Create a directory
+     * \param name directory name
+     * \param mode directory permissions
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int mkdir(StringPart& name, int mode);
+    
+    /**
+     * Remove a directory if empty
+     * \param name directory name
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int rmdir(StringPart& name);
+    
+    /**
+     * Create a FIFO special file
+     * \param name FIFO name
+     * \param mode FIFO permissions
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int mkfifo(StringPart& name, int mode);
+    
+    /**
+     * \return the free space in bytes
+     */
+    unsigned int getFreeSpace();
+    
+    /**
+     * Destructor
+     */
+    ~TmpFs();
+    
+    static const unsigned int blockSize=256; ///< Allocation granularity
+    
+private:
+    friend class TmpFsNode;
+    friend class TmpFsFile;
+    friend class TmpFsDirectory;
+    
+    /**
+     * A run of contiguous blocks in the arena
+     */
+    struct Extent
+    {
+        Extent(unsigned int first, unsigned int count)
+                : first(first), count(count) {}
+        
+        unsigned int first; ///< Index of the first block
+        unsigned int count; ///< Number of blocks
+    };
+    
+    /**
+     * Find a file or directory. Must be called with the mutex locked
+     * \param path path relative to the filesystem, not necessarily \0
+     * terminated
+     * \param len path length
+     * \param node the node is returned here
+     * \return 0 on success, or a negative number on failure
+     */
+    int lookup(const char *path, unsigned int len,
+            intrusive_ref_ptr<TmpFsNode>& node);
+    
+    /**
+     * Find the directory containing a file or directory, that does not need to
+     * exist. Must be called with the mutex locked
+     * \param name path relative to the filesystem
+     * \param parent the parent directory is returned here
+     * \param leaf the last component of name is returned here
+     * \return 0 on success, or a negative number on failure
+     */
+    int lookupParent(StringPart& name, intrusive_ref_ptr<TmpFsNode>& parent,
+            std::string& leaf);
+    
+    /**
+     * Add blocks at the end of a list of extents. The last extent is grown in
+     * place if possible, otherwise the first free run that is large enough is
+     * used, falling back to splitting the allocation in more extents.
+     * Must be called with the mutex locked
+     * \param extents list of extents to grow
+     * \param count number of blocks to add
+     * \return 0 on success, or -ENOSPC, in which case nothing is allocated
+     */
+    int allocate(std::vector<Extent>& extents, unsigned int count);
+    
+    /**
+     * Remove blocks from the end of a list of extents.
+     * Must be called with the mutex locked
+     * \param extents list of extents to shrink
+     * \param count number of blocks to remove
+     */
+    void deallocate(std::vector<Extent>& extents, unsigned int count);
+    
+    FastMutex mutex;                ///< Protects everything, including data
+    char *arena;                    ///< Storage for file content
+    const unsigned int numBlocks;   ///< Number of blocks in the arena
+    unsigned int freeBlocks;        ///< Number of free blocks
+    std::vector<bool> used;         ///< Allocation bitmap
+    intrusive_ref_ptr<TmpFsNode> root; ///< Root directory
+    int inodeCount;                 ///< Next inode to assign
+    static const int rootDirInode=1;
+};
+
+#endif //WITH_FILESYSTEM
+
+} //namespace miosix
+
+#endif //TMPFS_H
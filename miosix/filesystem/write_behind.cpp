@@ -0,0 +1,144 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "write_behind.h"
+#include "file.h"
+#include "ioctl.h"
+#include "kernel/kernel.h"
+#include "kernel/logging.h"
+
+using namespace std;
+
+namespace miosix {
+
+#ifdef WITH_WRITE_BEHIND
+
+//
+// class WriteBehind
+//
+
+WriteBehind& WriteBehind::instance()
+{
+    static WriteBehind singleton;
+    return singleton;
+}
+
+bool WriteBehind::written(FileBase *file, size_t bytes)
+{
+    if(running==false) return true; //Nobody would sync the file
+    Lock<FastMutex> l(mutex);
+    auto it=find(file);
+    if(it==entries.end())
+    {
+        const long long delay=static_cast<long long>(WRITE_BEHIND_DELAY)*
+            TICK_FREQ/1000;
+        Entry e;
+        e.file=file;
+        e.deadline=getTick()+delay;
+        e.bytes=0;
+        entries.push_back(e);
+        it=--entries.end();
+        cond.broadcast();
+    }
+    it->bytes+=bytes;
+    if(it->bytes<WRITE_BEHIND_THRESHOLD) return false;
+    entries.erase(it);
+    return true;
+}
+
+void WriteBehind::synced(FileBase *file)
+{
+    Lock<FastMutex> l(mutex);
+    auto it=find(file);
+    if(it!=entries.end()) entries.erase(it);
+}
+
+void WriteBehind::closed(FileBase *file)
+{
+    Lock<FastMutex> l(mutex);
+    auto it=find(file);
+    if(it!=entries.end()) entries.erase(it);
+    while(flushing==file) cond.wait(l);
+}
+
+WriteBehind::WriteBehind() : flushing(0), running(true)
+{
+    if(Thread::create(flusherThread,STACK_DEFAULT_FOR_PTHREAD,MAIN_PRIORITY,
+        this)!=0) return;
+    //Fall back to syncing after each write
+    running=false;
+    errorLog("Write-behind: can't create flusher thread\n");
+}
+
+void WriteBehind::flusherThread(void *argv)
+{
+    reinterpret_cast<WriteBehind*>(argv)->flusher();
+}
+
+void WriteBehind::flusher()
+{
+    Lock<FastMutex> l(mutex);
+    for(;;)
+    {
+        if(entries.empty())
+        {
+            cond.wait(l);
+            continue;
+        }
+        //Entries are appended with increasing deadlines
+        Entry e=entries.front();
+        if(e.deadline>getTick())
+        {
+            Unlock<FastMutex> u(l);
+            Thread::sleepUntil(e.deadline);
+            continue;
+        }
+        entries.pop_front();
+        flushing=e.file;
+        int result;
+        {
+            Unlock<FastMutex> u(l);
+            result=e.file->ioctl(IOCTL_SYNC,0);
+        }
+        flushing=0;
+        cond.broadcast();
+        //There's nobody to return the error to. The file still has unsynced
+        //data, so the error is reported again by the next fsync()
+        if(result<0) errorLog("Write-behind: sync failed (%d)\n",result);
+    }
+}
+
+list<WriteBehind::Entry>::iterator WriteBehind::find(FileBase *file)
+{
+    for(auto it=entries.begin();it!=entries.end();++it)
+        if(it->file==file) return it;
+    return entries.end();
+}
+
+#endif //WITH_WRITE_BEHIND
+
+} //namespace miosix
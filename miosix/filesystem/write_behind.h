@@ -0,0 +1,138 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef WRITE_BEHIND_H
+#define	WRITE_BEHIND_H
+
+#include <list>
+#include "kernel/sync.h"
+#include "config/miosix_settings.h"
+
+namespace miosix {
+
+#ifdef WITH_WRITE_BEHIND
+
+// Forward decls
+class FileBase;
+
+/**
+ * Write-behind support for filesystems. Instead of syncing a file after each
+ * write, files notify this class when written to, and a kernel thread syncs
+ * them through IOCTL_SYNC at most WRITE_BEHIND_DELAY milliseconds after the
+ * first unsynced write. If more than WRITE_BEHIND_THRESHOLD bytes are written
+ * before that, the writing thread is asked to sync the file itself. This bounds
+ * the data lost in case of a power failure, while avoiding rewriting the
+ * file metadata after every small write.
+ * 
+ * Errors in syncs done by the flusher thread are only logged, as the file
+ * still has unsynced data they are reported to the application by the next
+ * fsync(). close() can't report them, so applications that need to know
+ * whether their data reached the disk have to call fsync() before close().
+ *
+ * If the flusher thread can't be created, files are synced after each write,
+ * as with SYNC_AFTER_WRITE.
+ */
+class WriteBehind
+{
+public:
+    /**
+     * \return the WriteBehind instance
+     */
+    static WriteBehind& instance();
+    
+    /**
+     * Notify that a file has been written to. Can be called with the file's
+     * own mutex locked, as the flusher thread never holds the WriteBehind
+     * mutex while syncing a file.
+     * \param file file written to
+     * \param bytes number of bytes written
+     * \return true if the threshold has been reached, or if there is no
+     * flusher thread. In this case the caller should sync the file
+     */
+    bool written(FileBase *file, size_t bytes);
+    
+    /**
+     * Notify that a file has been synced, for example by an explicit fsync()
+     * \param file synced file
+     */
+    void synced(FileBase *file);
+    
+    /**
+     * Must be called at the beginning of the destructor of a file that may
+     * have called written(). Waits until the flusher thread has stopped using
+     * the file pointer.
+     * \param file file being closed
+     */
+    void closed(FileBase *file);
+    
+private:
+    WriteBehind(const WriteBehind&);
+    WriteBehind& operator=(const WriteBehind&);
+    
+    /**
+     * Constructor, starts the flusher thread
+     */
+    WriteBehind();
+    
+    /**
+     * Entry point of the flusher thread
+     */
+    static void flusherThread(void *argv);
+    
+    /**
+     * Flusher thread main loop
+     */
+    void flusher();
+    
+    /**
+     * A file with unsynced data
+     */
+    struct Entry
+    {
+        FileBase *file;     ///< File with unsynced data
+        long long deadline; ///< When to sync it, in ticks
+        size_t bytes;       ///< Unsynced bytes
+    };
+    
+    /**
+     * \param file a file
+     * \return the entry of the file, or entries.end()
+     */
+    std::list<Entry>::iterator find(FileBase *file);
+    
+    FastMutex mutex;
+    ConditionVariable cond;    ///< Signaled when entries or flushing change
+    std::list<Entry> entries;  ///< Files with unsynced data
+    FileBase *flushing;        ///< File being synced by the flusher thread
+    bool running;              ///< False if the flusher thread creation failed
+};
+
+#endif //WITH_WRITE_BEHIND
+
+} //namespace miosix
+
+#endif //WRITE_BEHIND_H
@@ -0,0 +1,139 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "elf_loader.h"
+#include <stdexcept>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "filesystem/file_access.h"
+#include "core/cache_cortexMx.h"
+
+using namespace std;
+
+#ifdef WITH_PROCESSES
+
+namespace miosix {
+
+ElfLoader& ElfLoader::instance()
+{
+    static ElfLoader singleton;
+    return singleton;
+}
+
+int ElfLoader::load(FileDescriptorTable& files, const char *path,
+        intrusive_ref_ptr<ElfRamImage>& result)
+{
+    int fd=files.open(path,O_RDONLY,0);
+    if(fd<0) return fd;
+    struct stat st;
+    int error=files.fstat(fd,&st);
+    if(error==0 && !S_ISREG(st.st_mode)) error=-EACCES;
+    if(error==0 && st.st_size==0) error=-ENOEXEC;
+    if(error)
+    {
+        files.close(fd);
+        return error;
+    }
+    
+    Lock<FastMutex> l(mutex);
+    for(auto it=cache.begin();it!=cache.end();++it)
+    {
+        if(it->dev!=st.st_dev || it->ino!=st.st_ino) continue;
+        if(it->size==st.st_size && it->mtime==st.st_mtime)
+        {
+            hits++;
+            result=it->image;
+            cache.splice(cache.begin(),cache,it);
+            files.close(fd);
+            return 0;
+        }
+        cache.erase(it); //Stale, the file has changed
+        break;
+    }
+    
+    misses++;
+    intrusive_ref_ptr<ElfRamImage> image;
+    try {
+        error=readFile(files,fd,st.st_size,image);
+    } catch(exception&) {
+        error=-ENOMEM;
+    }
+    files.close(fd);
+    if(error) return error;
+    //Validate the file before caching it. If the file is compressed, the
+    //ElfProgram holds the decompressed copy, and the file content is dropped
+    try {
+        ElfProgram program(image->getElfBase(),image->getElfSize());
+        if(program.getRamImage()) image=program.getRamImage();
+    } catch(ElfFormatError&) {
+        return -ENOEXEC;
+    }
+    result=image;
+    
+    if(ELF_CACHE_SIZE==0) return 0;
+    if(cache.size()>=ELF_CACHE_SIZE) cache.pop_back();
+    Entry entry;
+    entry.dev=st.st_dev;
+    entry.ino=st.st_ino;
+    entry.size=st.st_size;
+    entry.mtime=st.st_mtime;
+    entry.image=image;
+    cache.push_front(entry);
+    return 0;
+}
+
+void ElfLoader::invalidate()
+{
+    Lock<FastMutex> l(mutex);
+    cache.clear();
+}
+
+int ElfLoader::readFile(FileDescriptorTable& files, int fd, off_t size,
+        intrusive_ref_ptr<ElfRamImage>& result)
+{
+    //Bigger files would not fit in the process pool anyway
+    if(size>0x7fffffff) return -EFBIG;
+    result=new ElfRamImage(size);
+    //Read straight into the block the program will run from with as few
+    //calls as possible, which allows filesystems to transfer entire sectors
+    //to the destination without going through their buffers
+    char *dest=reinterpret_cast<char*>(result->getElfBase());
+    for(off_t done=0;done<size;)
+    {
+        ssize_t r=files.read(fd,dest+done,size-done);
+        if(r<0) return r;
+        if(r==0) return -EIO; //File shrunk while being read
+        done+=r;
+    }
+    markBufferAfterCodeWrite(dest,size);
+    return 0;
+}
+
+} //namespace miosix
+
+#endif //WITH_PROCESSES
@@ -0,0 +1,128 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef ELF_LOADER_H
+#define ELF_LOADER_H
+
+#include <list>
+#include <sys/types.h>
+#include "sync.h"
+#include "elf_program.h"
+#include "config/miosix_settings.h"
+
+#ifdef WITH_PROCESSES
+
+namespace miosix {
+
+class FileDescriptorTable; //Forward decl
+
+/**
+ * Loads elf programs from the filesystem into RAM, so that processes can be
+ * spawned also from programs that were not linked with the kernel.
+ *
+ * The last ELF_CACHE_SIZE loaded programs are kept in RAM. Since the elf file
+ * in RAM is never written after being loaded it is shared among all the
+ * processes spawned from it, and launching a cached program again only costs
+ * a stat of the file.
+ */
+class ElfLoader
+{
+public:
+    /**
+     * \return the instance of this class (singleton)
+     */
+    static ElfLoader& instance();
+    
+    /**
+     * Load a program from a file. Compressed elf files produced by
+     * mx-elfpack are also supported.
+     * \param files file descriptor table used to open the file, relative
+     * paths are resolved using its current directory
+     * \param path path of the elf file
+     * \param result the elf file in RAM is returned here
+     * \return 0 on success, -ENOEXEC if the file is not a valid Miosix
+     * program, or another negative number on failure
+     */
+    int load(FileDescriptorTable& files, const char *path,
+             intrusive_ref_ptr<ElfRamImage>& result);
+    
+    /**
+     * Drop all cached programs. Programs are already reloaded if the file
+     * size or modification time changes, but filesystems that do not store
+     * the modification time can't detect a file rewritten with the same size
+     */
+    void invalidate();
+    
+    /**
+     * \return the number of loads that were served from the cache
+     */
+    unsigned int getHits() const { return hits; }
+    
+    /**
+     * \return the number of loads that required reading the file
+     */
+    unsigned int getMisses() const { return misses; }
+    
+private:
+    ElfLoader() : hits(0), misses(0) {}
+    ElfLoader(const ElfLoader&);
+    ElfLoader& operator= (const ElfLoader&);
+    
+    /**
+     * Read a whole file into RAM
+     * \param files file descriptor table
+     * \param fd file descriptor
+     * \param size file size
+     * \param result the elf file in RAM is returned here
+     * \return 0 on success, or a negative number on failure
+     */
+    static int readFile(FileDescriptorTable& files, int fd, off_t size,
+                        intrusive_ref_ptr<ElfRamImage>& result);
+    
+    /**
+     * A cached program
+     */
+    struct Entry
+    {
+        dev_t dev;    ///< Filesystem id of the elf file
+        ino_t ino;    ///< Inode of the elf file
+        off_t size;   ///< Size of the elf file
+        time_t mtime; ///< Modification time of the elf file
+        intrusive_ref_ptr<ElfRamImage> image; ///< Content, already unpacked
+    };
+    
+    FastMutex mutex;         ///< To guard access to the cache
+    std::list<Entry> cache;  ///< Most recently used first
+    unsigned int hits;       ///< Loads served from the cache
+    unsigned int misses;     ///< Loads that required reading the file
+};
+
+} //namespace miosix
+
+#endif //WITH_PROCESSES
+
+#endif //ELF_LOADER_H
@@ -0,0 +1,53 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef ELF_PACK_H
+#define ELF_PACK_H
+
+// NOTE: this file is also used by the mx-elfpack host tool, so it must not
+// depend on the rest of the kernel
+
+namespace miosix {
+
+/**
+ * Header of an elf file compressed by mx-elfpack. It is followed by the
+ * compressed data, that when decompressed yields an elf file of elfSize bytes.
+ * All fields are little endian.
+ */
+struct PackedElfHeader
+{
+    static const unsigned int lz4Magic=0x5a4c584d; ///< "MXLZ", LZ4 block
+
+    unsigned int magic;      ///< Identifies the compression algorithm
+    unsigned int elfSize;    ///< Size of the uncompressed elf file
+    unsigned int packedSize; ///< Size of the compressed data after the header
+    unsigned int reserved;   ///< Must be zero, pads the header to 16 bytes
+};
+
+} //namespace miosix
+
+#endif //ELF_PACK_H
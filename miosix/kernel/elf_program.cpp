@@ -26,8 +26,12 @@
  ***************************************************************************/
 
 #include "elf_program.h"
+#include "elf_pack.h"
 #include "process_pool.h"
+#include "util/lz4.h"
+#include "core/cache_cortexMx.h"
 #include <stdexcept>
+#include <algorithm>
 #include <cstring>
 #include <cstdio>
 
@@ -44,18 +48,61 @@ namespace miosix {
 ///By convention, in an elf file for Miosix, the data segment starts @ this addr
 static const unsigned int DATA_BASE=0x40000000;
 
+//
+// class ElfRamImage
+//
+
+ElfRamImage::ElfRamImage(unsigned int size) : size(size)
+{
+    blockSize=size<ProcessPool::blockSize ? ProcessPool::blockSize : size;
+    blockSize=MPUConfiguration::roundSizeForMPU(blockSize);
+    base=ProcessPool::instance().allocate(blockSize);
+}
+
+ElfRamImage::~ElfRamImage()
+{
+    ProcessPool::instance().deallocate(base);
+}
+
 //
 // class ElfProgram
 //
 
 ElfProgram::ElfProgram(const unsigned int *elf, unsigned int size)
-    : elf(elf), size(size)
+    : ram(unpack(elf,size)), elf(ram ? ram->getElfBase() : elf),
+      size(ram ? ram->getElfSize() : size)
 {
     //Trying to follow the "full recognition before processing" approach,
     //(http://www.cs.dartmouth.edu/~sergey/langsec/occupy/FullRecognition.jpg)
     //all of the elf fields that will later be used are checked in advance.
     //Unused fields are unchecked, so when using new fields, add new checks
-    if(validateHeader()==false) throw runtime_error("Bad file");
+    if(validateHeader()==false) throw ElfFormatError("Bad file");
+}
+
+ElfProgram::ElfProgram(intrusive_ref_ptr<ElfRamImage> ram)
+    : ram(ram), elf(ram->getElfBase()), size(ram->getElfSize())
+{
+    if(validateHeader()==false) throw ElfFormatError("Bad file");
+}
+
+intrusive_ref_ptr<ElfRamImage> ElfProgram::unpack(const unsigned int *data,
+        unsigned int size)
+{
+    intrusive_ref_ptr<ElfRamImage> result;
+    const PackedElfHeader *header=reinterpret_cast<const PackedElfHeader*>(data);
+    if(size<sizeof(PackedElfHeader) || header->magic!=PackedElfHeader::lz4Magic)
+        return result;
+    if(header->packedSize>size-sizeof(PackedElfHeader))
+        throw ElfFormatError("Bad compressed file");
+    //Decompress directly into the block the code will run from, this way the
+    //elf is never held in RAM twice
+    result=new ElfRamImage(header->elfSize);
+    int unpacked=lz4Decompress(header+1,header->packedSize,
+            result->getElfBase(),header->elfSize);
+    if(unpacked!=static_cast<int>(header->elfSize))
+        throw ElfFormatError("Bad compressed file");
+    markBufferAfterCodeWrite(result->getElfBase(),header->elfSize);
+    return result;
 }
 
 bool ElfProgram::validateHeader()
@@ -63,14 +110,14 @@ bool ElfProgram::validateHeader()
     //Validate ELF header
     //Note: this code assumes a little endian elf and a little endian ARM CPU
     if(isUnaligned8(getElfBase()))
-        throw runtime_error("Elf file load address alignment error");
+        throw ElfFormatError("Elf file load address alignment error");
     if(size<sizeof(Elf32_Ehdr)) return false;
     const Elf32_Ehdr *ehdr=getElfHeader();
     static const char magic[EI_NIDENT]={0x7f,'E','L','F',1,1,1};
     if(memcmp(ehdr->e_ident,magic,EI_NIDENT))
-        throw runtime_error("Unrecognized format");
-    if(ehdr->e_type!=ET_EXEC) throw runtime_error("Not an executable");
-    if(ehdr->e_machine!=EM_ARM) throw runtime_error("Wrong CPU arch");
+        throw ElfFormatError("Unrecognized format");
+    if(ehdr->e_type!=ET_EXEC) throw ElfFormatError("Not an executable");
+    if(ehdr->e_machine!=EM_ARM) throw ElfFormatError("Wrong CPU arch");
     if(ehdr->e_version!=EV_CURRENT) return false;
     if(ehdr->e_entry>=size) return false;
     if(ehdr->e_phoff>=size-sizeof(Elf32_Phdr)) return false;
@@ -79,13 +126,13 @@ bool ElfProgram::validateHeader()
     // of this requirement in the current ELF spec for ARM.
     if((ehdr->e_flags & EF_ARM_EABIMASK) != EF_ARM_EABI_VER5) return false;
     #if !defined(__FPU_USED) || __FPU_USED==0
-    if(ehdr->e_flags & EF_ARM_VFP_FLOAT) throw runtime_error("FPU required");
+    if(ehdr->e_flags & EF_ARM_VFP_FLOAT) throw ElfFormatError("FPU required");
     #endif
     if(ehdr->e_ehsize!=sizeof(Elf32_Ehdr)) return false;
     if(ehdr->e_phentsize!=sizeof(Elf32_Phdr)) return false;
     //This to avoid that the next condition could pass due to 32bit wraparound
     //20 is an arbitrary number, could be increased if required
-    if(ehdr->e_phnum>20) throw runtime_error("Too many segments");
+    if(ehdr->e_phnum>20) throw ElfFormatError("Too many segments");
     if(ehdr->e_phoff+(ehdr->e_phnum*sizeof(Elf32_Phdr))>size) return false;
     
     //Validate program header table
@@ -110,7 +157,7 @@ bool ElfProgram::validateHeader()
                 if(isUnaligned8(phdr->p_offset)) return false;
                 break;
             default:
-                throw runtime_error("Unsupported segment alignment");
+                throw ElfFormatError("Unsupported segment alignment");
         }
         
         switch(phdr->p_type)
@@ -119,7 +166,7 @@ bool ElfProgram::validateHeader()
                 if(phdr->p_flags & ~(PF_R | PF_W | PF_X)) return false;
                 if(!(phdr->p_flags & PF_R)) return false;
                 if((phdr->p_flags & PF_W) && (phdr->p_flags & PF_X))
-                    throw runtime_error("File violates W^X");
+                    throw ElfFormatError("File violates W^X");
                 if(phdr->p_flags & PF_X)
                 {
                     if(codeSegmentPresent) return false; //Can't apper twice
@@ -136,7 +183,7 @@ bool ElfProgram::validateHeader()
                     unsigned int maxSize=MAX_PROCESS_IMAGE_SIZE-
                         MIN_PROCESS_STACK_SIZE;
                     if(phdr->p_memsz>=maxSize)
-                        throw runtime_error("Data segment too big");
+                        throw ElfFormatError("Data segment too big");
                     dataSegmentSize=phdr->p_memsz;
                 }
                 break;
@@ -188,7 +235,7 @@ bool ElfProgram::validateDynamicSegment(const Elf32_Phdr *dynamic,
                 break;  
             case DT_MX_ABI:
                 if(dyn->d_un.d_val==DV_MX_ABI_V1) miosixTagFound=true;
-                else throw runtime_error("Unknown/unsupported DT_MX_ABI");
+                else throw ElfFormatError("Unknown/unsupported DT_MX_ABI");
                 break;
             case DT_MX_RAMSIZE:
                 ramSize=dyn->d_un.d_val;
@@ -199,24 +246,24 @@ bool ElfProgram::validateDynamicSegment(const Elf32_Phdr *dynamic,
             case DT_RELA:
             case DT_RELASZ:
             case DT_RELAENT:
-                throw runtime_error("RELA relocations unsupported");
+                throw ElfFormatError("RELA relocations unsupported");
             default:
                 //Ignore other entries
                 break;
         }
     }
-    if(miosixTagFound==false) throw runtime_error("Not a Miosix executable");
+    if(miosixTagFound==false) throw ElfFormatError("Not a Miosix executable");
     if(stackSize<MIN_PROCESS_STACK_SIZE)
-        throw runtime_error("Requested stack is too small");
+        throw ElfFormatError("Requested stack is too small");
     if(ramSize>MAX_PROCESS_IMAGE_SIZE)
-        throw runtime_error("Requested image size is too large");
+        throw ElfFormatError("Requested image size is too large");
     if((stackSize & 0x3) ||
        (ramSize & 0x3) ||
        (ramSize < ProcessPool::blockSize) ||
        (stackSize>MAX_PROCESS_IMAGE_SIZE) ||
        (dataSegmentSize>MAX_PROCESS_IMAGE_SIZE) ||
        (dataSegmentSize+stackSize>ramSize))
-        throw runtime_error("Invalid stack or RAM size");
+        throw ElfFormatError("Invalid stack or RAM size");
     
     if(hasRelocs!=0 && hasRelocs!=0x7) return false;
     if(hasRelocs)
@@ -241,7 +288,7 @@ bool ElfProgram::validateDynamicSegment(const Elf32_Phdr *dynamic,
                     if(rel->r_offset & 0x3) return false;
                     break;
                 default:
-                    throw runtime_error("Unexpected relocation type");
+                    throw ElfFormatError("Unexpected relocation type");
             }
         }
     }
@@ -307,6 +354,10 @@ void ProcessImage::load(const ElfProgram& program)
     memcpy(dataSegmentInMem,dataSegmentInFile,dataSegment->p_filesz);
     dataSegmentInMem+=dataSegment->p_filesz;
     memset(dataSegmentInMem,0,dataSegment->p_memsz-dataSegment->p_filesz);
+    //Fill the rest of the image, that will be used by the heap and stack,
+    //to measure their high watermark
+    loadSize=(dataSegment->p_memsz+3) & ~3;
+    fill(image+loadSize/4,image+size/4,STACK_FILL);
     if(hasRelocs)
     {
         const Elf32_Rel *rel=reinterpret_cast<const Elf32_Rel*>(base+dtRel);
@@ -338,6 +389,24 @@ void ProcessImage::load(const ElfProgram& program)
     }
 }
 
+unsigned int ProcessImage::getPeakUsage() const
+{
+    if(image==0) return 0;
+    //The heap grows upwards from the end of .bss, while the stack grows
+    //downwards from the end of the image. The largest run of untouched words
+    //is assumed to be the one between them. Smaller runs may be left in the
+    //heap and stack by memory allocated but never written, so look for it
+    const unsigned int *p=image+loadSize/4;
+    const unsigned int *end=image+size/4;
+    unsigned int run=0, largest=0;
+    for(;p<end;p++)
+    {
+        if(*p!=STACK_FILL) run=0;
+        else if(++run>largest) largest=run;
+    }
+    return size-largest*sizeof(unsigned int);
+}
+
 ProcessImage::~ProcessImage()
 {
     if(image) ProcessPool::instance().deallocate(image);
@@ -29,13 +29,74 @@
 #define	ELF_PROGRAM_H
 
 #include <utility>
+#include <stdexcept>
 #include "elf_types.h"
+#include "intrusive.h"
 #include "config/miosix_settings.h"
 
 #ifdef WITH_PROCESSES
 
 namespace miosix {
 
+/**
+ * An elf file that resides in RAM instead of FLASH, such as a decompressed
+ * elf. The memory is allocated from the process pool, so that the code
+ * segment can be protected by an MPU region that spans exactly this block.
+ */
+class ElfRamImage : public IntrusiveRefCounted
+{
+public:
+    /**
+     * Constructor, allocates the memory
+     * \param size size of the elf file that will be stored
+     * \throws runtime_error or bad_alloc if the memory can't be allocated
+     */
+    explicit ElfRamImage(unsigned int size);
+    
+    /**
+     * \return a pointer to the elf file 
+     */
+    unsigned int *getElfBase() const { return base; }
+    
+    /**
+     * \return the size of the elf file 
+     */
+    unsigned int getElfSize() const { return size; }
+    
+    /**
+     * \return the size of the allocated block, which is a power of two and
+     * greater or equal to the elf size
+     */
+    unsigned int getBlockSize() const { return blockSize; }
+    
+    /**
+     * Destructor, returns the memory to the process pool
+     */
+    ~ElfRamImage();
+    
+private:
+    ElfRamImage(const ElfRamImage&);
+    ElfRamImage& operator= (const ElfRamImage&);
+    
+    unsigned int *base;     ///< Pointer to the elf file
+    unsigned int size;      ///< Size of the elf file
+    unsigned int blockSize; ///< Size of the allocated block
+};
+
+/**
+ * Thrown by ElfProgram if the elf file is not valid, or can't be run by this
+ * kernel. Reported to userspace as ENOEXEC
+ */
+class ElfFormatError : public std::runtime_error
+{
+public:
+    /**
+     * Constructor
+     * \param what reason why the file was rejected
+     */
+    explicit ElfFormatError(const char *what) : std::runtime_error(what) {}
+};
+
 /**
  * This class represents an elf file.
  */
@@ -48,11 +109,19 @@ public:
      * remains of the caller, that is, the pointer is not deleted by this
      * class. This is done to allow passing a pointer directly to a location
      * in the microcontroller's FLASH memory, in order to avoid copying the
-     * elf in RAM
+     * elf in RAM. If the data is an elf compressed by mx-elfpack, it is
+     * decompressed in RAM, and the RAM copy is owned by this class.
      * \param size size of the content of the elf file
      */
     ElfProgram(const unsigned int *elf, unsigned int size);
     
+    /**
+     * Constructor
+     * \param ram an elf file already loaded in RAM. The memory is kept
+     * allocated as long as this object or one of its copies exists
+     */
+    explicit ElfProgram(intrusive_ref_ptr<ElfRamImage> ram);
+    
     /**
      * \return the a pointer to the elf header
      */
@@ -103,7 +172,24 @@ public:
         return size;
     }
     
+    /**
+     * \return the RAM copy of the elf file, or an empty pointer if the elf
+     * file is used in place 
+     */
+    intrusive_ref_ptr<ElfRamImage> getRamImage() const { return ram; }
+    
 private:
+    /**
+     * If the given data is a compressed elf, decompress it
+     * \param data elf file or compressed elf file
+     * \param size data size
+     * \return the decompressed elf file, or an empty pointer if the data is
+     * not compressed
+     * \throws runtime_error if the compressed data is not valid, or bad_alloc
+     */
+    static intrusive_ref_ptr<ElfRamImage> unpack(const unsigned int *data,
+            unsigned int size);
+    
     /**
      * \param size elf file size
      * \return false if the file is not valid
@@ -133,6 +219,7 @@ private:
      */
     static bool isUnaligned8(unsigned int x) { return x & 0b111; }
     
+    intrusive_ref_ptr<ElfRamImage> ram; ///<The elf file, if in RAM
     const unsigned int * const elf; ///<Pointer to the content of the elf file
     unsigned int size; ///< Size of the elf file
 };
@@ -146,7 +233,7 @@ public:
     /**
      * Constructor, creates an empty process image.
      */
-    ProcessImage() : image(0), size(0) {}
+    ProcessImage() : image(0), size(0), loadSize(0) {}
     
     /**
      * Starting from the content of the elf program, create an image in RAM of
@@ -170,6 +257,15 @@ public:
      */
     bool isValid() const { return image!=0; }
     
+    /**
+     * The part of the image after .bss is filled with a known pattern when
+     * the image is loaded, so that the heap and stack high watermarks can be
+     * found. Parts of the heap or stack that are allocated but never written
+     * are not counted, so the result is a lower bound.
+     * \return the peak number of bytes of the image used by the process
+     */
+    unsigned int getPeakUsage() const;
+    
     /**
      * Destructor. Deletes the process image memory.
      */
@@ -179,8 +275,9 @@ private:
     ProcessImage(const ProcessImage&);
     ProcessImage& operator= (const ProcessImage&);
     
-    unsigned int *image; //Pointer to the process image in RAM
-    unsigned int size;   //Size of the process image
+    unsigned int *image;   //Pointer to the process image in RAM
+    unsigned int size;     //Size of the process image
+    unsigned int loadSize; //Size of .data and .bss
 };
 
 } //namespace miosix
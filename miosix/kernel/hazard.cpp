@@ -0,0 +1,110 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "hazard.h"
+#include "kernel.h"
+
+namespace miosix {
+
+//
+// class HazardRecord
+//
+
+HazardRecord::HazardRecord() : used(0), linked(false), next(0)
+{
+    for(int i=0;i<numSlots;i++)
+    {
+        slots[i].ptr=0;
+        slots[i].owned=false;
+    }
+}
+
+//
+// class HazardPointer
+//
+
+HazardRecord *HazardPointer::records=0;
+
+HazardPointer::HazardPointer()
+    : record(&Thread::getCurrentThread()->hazards), slot(0)
+{
+    if(record->used>=HazardRecord::numSlots) return;
+    if(record->linked==false)
+    {
+        //Only the first time a thread uses a hazard pointer
+        FastInterruptDisableLock dLock;
+        record->next=records;
+        records=record;
+        record->linked=true;
+    }
+    slot=&record->slots[record->used++];
+}
+
+bool HazardPointer::transferOwnership(const void *p)
+{
+    FastInterruptDisableLock dLock;
+    return IRQtransferOwnership(p);
+}
+
+void HazardPointer::removeRecord(HazardRecord *record)
+{
+    if(record->linked==false) return;
+    FastInterruptDisableLock dLock;
+    for(HazardRecord **x=&records;*x;x=&(*x)->next)
+    {
+        if(*x!=record) continue;
+        *x=record->next;
+        break;
+    }
+    record->linked=false;
+}
+
+bool HazardPointer::releaseOwned(const void *p)
+{
+    FastInterruptDisableLock dLock;
+    slot->owned=false;
+    //Other threads may still be accessing the object, in this case pass the
+    //reference to one of them
+    return IRQtransferOwnership(p)==false;
+}
+
+bool HazardPointer::IRQtransferOwnership(const void *p)
+{
+    for(HazardRecord *r=records;r;r=r->next)
+    {
+        for(int i=0;i<HazardRecord::numSlots;i++)
+        {
+            HazardRecord::Slot& s=r->slots[i];
+            if(s.ptr!=p || s.owned) continue;
+            s.owned=true;
+            return true;
+        }
+    }
+    return false;
+}
+
+} //namespace miosix
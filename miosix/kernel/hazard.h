@@ -0,0 +1,198 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef HAZARD_H
+#define HAZARD_H
+
+namespace miosix {
+
+// Forward decls
+template<typename T>
+class intrusive_ref_ptr;
+
+/**
+ * \internal
+ * The hazard pointers of a thread, part of the Thread class
+ */
+class HazardRecord
+{
+public:
+    /**
+     * Constructor
+     */
+    HazardRecord();
+
+    static const int numSlots=2; ///< Hazard pointers of each thread
+
+private:
+    HazardRecord(const HazardRecord&);
+    HazardRecord& operator= (const HazardRecord&);
+
+    /**
+     * A hazard pointer
+     */
+    struct Slot
+    {
+        const void * volatile ptr; ///< Protected object, or nullptr
+        /// True if the thread owns a reference to the protected object, as the
+        /// object was removed from where it was shared while being protected
+        volatile bool owned;
+    };
+
+    Slot slots[numSlots]; ///< Hazard pointers
+    unsigned char used;   ///< Slots in use, only accessed by the owning thread
+    bool linked;          ///< True if the record is in the list of records
+    HazardRecord *next;   ///< Next record in the list of records
+
+    friend class HazardPointer;
+};
+
+/**
+ * A hazard pointer allows a thread to access an object managed by an
+ * intrusive_ref_ptr shared with other threads, such as a file in a file
+ * descriptor table, without incrementing and decrementing its reference
+ * count, which are atomic operations.
+ * 
+ * When a thread removes the object from where it is shared, it calls
+ * transferOwnership(), and if another thread is accessing the object through
+ * a hazard pointer, the removed reference is transferred to that thread
+ * instead of being dropped. The reference is then dropped when the hazard
+ * pointer is released, so the object is deleted only once no thread is
+ * accessing it.
+ * 
+ * Each thread has HazardRecord::numSlots hazard pointers, and objects of this
+ * class can only be allocated on the stack, and destroyed in reverse order
+ * of construction.
+ */
+class HazardPointer
+{
+public:
+    /**
+     * Constructor, takes a hazard pointer of the current thread
+     */
+    HazardPointer();
+
+    /**
+     * \return true if a hazard pointer was available. If false, protect()
+     * and release() can't be called, and the caller has to increment the
+     * reference count of the object instead
+     */
+    bool valid() const { return slot!=0; }
+
+    /**
+     * Protect the object managed by an intrusive_ref_ptr
+     * \param source the intrusive_ref_ptr that is shared among threads
+     * \return the protected object, or nullptr if source is empty. The object
+     * can be accessed till release() is called
+     */
+    template<typename T>
+    T *protect(const intrusive_ref_ptr<T>& source)
+    {
+        T *result=source.atomic_borrow();
+        for(;;)
+        {
+            slot->ptr=result;
+            //If the object was removed from source before the hazard pointer
+            //was set, it may already have been deleted, so try again
+            T *check=source.atomic_borrow();
+            if(check==result) return result;
+            //The reference may have been transferred to us in the meantime
+            if(release()) intrusive_ref_ptr<T> drop(result,false);
+            result=check;
+        }
+    }
+
+    /**
+     * Stop protecting the object
+     * \return true if the object has been removed from where it was shared
+     * while being protected, and the caller now owns a reference to it, that
+     * must be dropped by giving it to an intrusive_ref_ptr constructed with
+     * addRef set to false
+     */
+    bool release()
+    {
+        const void *p=slot->ptr;
+        slot->ptr=0;
+        //This is checked after clearing ptr, as transferOwnership() can't
+        //mark the slot as owned after that
+        if(slot->owned==false) return false;
+        return releaseOwned(p);
+    }
+
+    /**
+     * Destructor, gives back the hazard pointer. release() must be called
+     * before, if protect() was called
+     */
+    ~HazardPointer()
+    {
+        if(slot) record->used--;
+    }
+
+    /**
+     * Called after removing an object from where it is shared among threads,
+     * to transfer the removed reference to a thread that is protecting the
+     * object with a hazard pointer, if there is one
+     * \param p the removed object
+     * \return true if the reference was transferred, and the caller must call
+     * detach() on its intrusive_ref_ptr, false if the caller has to drop it
+     */
+    static bool transferOwnership(const void *p);
+
+    /**
+     * \internal
+     * Called by the Thread destructor to remove its record from the list
+     * \param record the hazard record of the thread
+     */
+    static void removeRecord(HazardRecord *record);
+
+private:
+    HazardPointer(const HazardPointer&);
+    HazardPointer& operator= (const HazardPointer&);
+
+    /**
+     * Slow path of release(), when the slot was owned
+     * \param p the protected object
+     * \return true if the caller has to drop the reference
+     */
+    bool releaseOwned(const void *p);
+
+    /**
+     * Mark the first slot that protects an object and is not yet owned as
+     * owned, must be called with interrupts disabled
+     * \param p the object
+     * \return true if a slot was found
+     */
+    static bool IRQtransferOwnership(const void *p);
+
+    HazardRecord *record;     ///< Hazard record of the current thread
+    HazardRecord::Slot *slot; ///< Hazard pointer, or nullptr if unavailable
+    static HazardRecord *records; ///< List of records of all threads
+};
+
+} //namespace miosix
+
+#endif //HAZARD_H
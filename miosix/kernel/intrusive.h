@@ -206,6 +206,18 @@ public:
         static_assert(std::has_virtual_destructor<T>::value,"");
     }
     
+    /**
+     * Constructor, with raw pointer to an object whose reference count has
+     * already been incremented on behalf of this intrusive_ref_ptr, such as
+     * one returned by detach()
+     * \param object object to manage
+     * \param addRef if false, don't increment the reference count
+     */
+    intrusive_ref_ptr(T *o, bool addRef) : object(o)
+    {
+        if(addRef) incrementRefCount();
+    }
+
     /**
      * Copy constructor, with same type of managed pointer
      * \param rhs object to manage
@@ -214,6 +226,15 @@ public:
     {
         incrementRefCount();
     }
+
+    /**
+     * Move constructor, leaves rhs empty without updating the reference count
+     * \param rhs object to manage
+     */
+    intrusive_ref_ptr(intrusive_ref_ptr&& rhs) : object(rhs.object)
+    {
+        rhs.object=0;
+    }
     
     /**
      * Generalized copy constructor, to support upcast among refcounted
@@ -245,6 +266,13 @@ public:
     template<typename U>
     intrusive_ref_ptr& operator= (const intrusive_ref_ptr<U>& rhs);
     
+    /**
+     * Move operator=, leaves rhs empty
+     * \param rhs object to manage
+     * \return a reference to *this 
+     */
+    intrusive_ref_ptr& operator= (intrusive_ref_ptr&& rhs);
+    
     /**
      * Operator=, with raw pointer
      * \param rhs object to manage
@@ -299,6 +327,21 @@ public:
         object=0;
     }
     
+    /**
+     * After a call to this member function, this intrusive_ref_ptr no longer
+     * points to the managed object, but the reference count is not
+     * decremented, so the caller becomes responsible for the reference, which
+     * can be given back to an intrusive_ref_ptr with the constructor taking
+     * the addRef parameter
+     * \return a pointer to the managed object
+     */
+    T *detach()
+    {
+        T *result=object;
+        object=0;
+        return result;
+    }
+    
     /**
      * \return the number of intrusive_ref_ptr that point to the managed object.
      * If return 0, than this points to nullptr 
@@ -317,6 +360,18 @@ public:
      */
     intrusive_ref_ptr atomic_load() const;
     
+    /**
+     * \internal
+     * Load the managed pointer with a single memory access, without
+     * incrementing the reference count. The pointer can be used only if the
+     * object is kept alive by other means, such as a HazardPointer.
+     * \return the managed pointer
+     */
+    T *atomic_borrow() const
+    {
+        return *const_cast<T * const volatile *>(&object);
+    }
+    
     /**
      * \internal
      * This is just an implementation detail.
@@ -383,6 +438,17 @@ intrusive_ref_ptr<T>& intrusive_ref_ptr<T>::operator=
     return *this;
 }
 
+template<typename T>
+intrusive_ref_ptr<T>& intrusive_ref_ptr<T>::operator=
+        (intrusive_ref_ptr<T>&& rhs)
+{
+    if(this==&rhs) return *this; //Handle assignment to self
+    if(decrementRefCount()) delete object;
+    object=rhs.object;
+    rhs.object=0;
+    return *this;
+}
+
 template<typename T>
 intrusive_ref_ptr<T>& intrusive_ref_ptr<T>::operator= (T* o)
 {
@@ -268,6 +268,16 @@ void IRQaddToSleepingList(SleepData *x)
 bool IRQwakeThreads()
 {
     tick++;//Increment tick
+    #ifdef WITH_PROCESSES
+    //Statistical CPU time accounting, the whole tick is charged to the
+    //process of the thread that was running when the tick occurred
+    if(ProcessBase *proc=cur->proc)
+    {
+        if(const_cast<Thread*>(cur)->flags.isInUserspace())
+            proc->usage.userTicks++;
+        else proc->usage.systemTicks++;
+    }
+    #endif //WITH_PROCESSES
     bool result=false;
     for(;;)
     {
@@ -275,6 +285,12 @@ bool IRQwakeThreads()
         //Since list is sorted, if we don't need to wake the first element
         //we don't need to wake the other too
         if(tick != sleeping_list->wakeup_time) break;
+        //Thread in timed wait, it also needs to be woken from the wait
+        if(sleeping_list->p->flags.isTimedWaiting())
+        {
+            sleeping_list->p->flags.IRQsetTimedWait(false);
+            sleeping_list->p->flags.IRQsetWait(false);
+        }
         sleeping_list->p->flags.IRQsetSleep(false);//Wake thread
         sleeping_list=sleeping_list->next;//Remove from list
         result=true;
@@ -458,7 +474,7 @@ void Thread::wakeup()
     //pausing the kernel is not enough because of IRQwait and IRQwakeup
     {
         FastInterruptDisableLock lock;
-        this->flags.IRQsetWait(false);
+        this->IRQwakeup();
     }
     #ifdef SCHED_TYPE_EDF
     yield();//The other thread might have a closer deadline
@@ -469,7 +485,7 @@ void Thread::PKwakeup()
 {
     //pausing the kernel is not enough because of IRQwait and IRQwakeup
     FastInterruptDisableLock lock;
-    this->flags.IRQsetWait(false);
+    this->IRQwakeup();
 }
 
 void Thread::detach()
@@ -564,9 +580,54 @@ void Thread::IRQwait()
     const_cast<Thread*>(cur)->flags.IRQsetWait(true);
 }
 
+template<typename EnableLock, typename DisableLock>
+bool Thread::IRQenableIrqAndTimedWaitImpl(DisableLock& dLock,
+        long long absoluteTime)
+{
+    if(absoluteTime<=getTick()) return false; //Timeout in the past, return
+    //The SleepData variable has to be in scope till the thread wakes up, as
+    //IRQaddToSleepingList() makes it part of a linked list. It is removed
+    //either by IRQwakeThreads() on timeout or by IRQwakeup()
+    SleepData d;
+    d.p=const_cast<Thread*>(cur);
+    d.wakeup_time=absoluteTime;
+    IRQaddToSleepingList(&d);//Also sets SLEEP_FLAG
+    d.p->flags.IRQsetTimedWait(true);
+    d.p->flags.IRQsetWait(true);
+    {
+        EnableLock eLock(dLock);
+        Thread::yield();
+    }
+    return getTick()<absoluteTime;
+}
+
+bool Thread::IRQenableIrqAndTimedWait(FastInterruptDisableLock& dLock,
+        long long absoluteTime)
+{
+    return IRQenableIrqAndTimedWaitImpl<FastInterruptEnableLock>(dLock,
+        absoluteTime);
+}
+
+bool Thread::IRQenableIrqAndTimedWait(InterruptDisableLock& dLock,
+        long long absoluteTime)
+{
+    return IRQenableIrqAndTimedWaitImpl<InterruptEnableLock>(dLock,
+        absoluteTime);
+}
+
 void Thread::IRQwakeup()
 {
     this->flags.IRQsetWait(false);
+    if(this->flags.isTimedWaiting()==false) return;
+    //Woken before the timeout, remove the thread from the sleeping list
+    this->flags.IRQsetTimedWait(false);
+    for(SleepData **x=&sleeping_list;*x;x=&(*x)->next)
+    {
+        if((*x)->p!=this) continue;
+        *x=(*x)->next;
+        this->flags.IRQsetSleep(false);
+        break;
+    }
 }
 
 bool Thread::IRQexists(Thread* p)
@@ -793,6 +854,7 @@ Thread::Thread(unsigned int *watermark, unsigned int stacksize,
 
 Thread::~Thread()
 {
+    HazardPointer::removeRecord(&hazards);
     if(cReentrancyData && cReentrancyData!=_GLOBAL_REENT)
     {
         _reclaim_reent(cReentrancyData);
@@ -34,6 +34,7 @@
 #include "interfaces/portability.h"
 #include "kernel/scheduler/sched_types.h"
 #include "stdlib_integration/libstdcpp_integration.h"
+#include "kernel/hazard.h"
 #include <cstdlib>
 #include <new>
 #include <functional>
@@ -661,6 +662,30 @@ public:
      */
     static void IRQwait();
 
+    /**
+     * Put the current thread in wait status until either wakeup() or
+     * IRQwakeup() is called, or absoluteTime is reached, whichever comes first.
+     * Must be called with interrupts disabled through dLock. Interrupts are
+     * enabled while waiting, and disabled again before returning.
+     * As with IRQwait(), spurious wakeups are possible, so the caller should
+     * check the condition it is waiting for in a loop.
+     * \param dLock the lock that disabled interrupts
+     * \param absoluteTime time in ticks when the wait times out
+     * \return false if the wait timed out, true otherwise
+     */
+    static bool IRQenableIrqAndTimedWait(FastInterruptDisableLock& dLock,
+            long long absoluteTime);
+
+    /**
+     * Same as IRQenableIrqAndTimedWait(FastInterruptDisableLock&,long long),
+     * for code that disabled interrupts through an InterruptDisableLock.
+     * \param dLock the lock that disabled interrupts
+     * \param absoluteTime time in ticks when the wait times out
+     * \return false if the wait timed out, true otherwise
+     */
+    static bool IRQenableIrqAndTimedWait(InterruptDisableLock& dLock,
+            long long absoluteTime);
+
     /**
      * Same as wakeup(), but is meant to be used only inside an IRQ or when
      * interrupts are disabled.
@@ -719,6 +744,17 @@ private:
     Thread(const Thread& p);///< No public copy constructor
     Thread& operator = (const Thread& p);///< No publc operator =
 
+    /**
+     * Implementation of both IRQenableIrqAndTimedWait() overloads
+     * \param EnableLock lock type that enables interrupts disabled by dLock
+     * \param dLock the lock that disabled interrupts
+     * \param absoluteTime time in ticks when the wait times out
+     * \return false if the wait timed out, true otherwise
+     */
+    template<typename EnableLock, typename DisableLock>
+    static bool IRQenableIrqAndTimedWaitImpl(DisableLock& dLock,
+            long long absoluteTime);
+
     class ThreadFlags
     {
     public:
@@ -755,6 +791,16 @@ private:
          */
         void IRQsetSleep(bool sleeping);
 
+        /**
+         * Set the timed wait flag of the thread.
+         * Can only be called with interrupts disabled or within an interrupt.
+         * \param waiting if true the flag will be set, otherwise cleared
+         */
+        void IRQsetTimedWait(bool waiting)
+        {
+            if(waiting) flags |= TIMED_WAIT; else flags &= ~TIMED_WAIT;
+        }
+
         /**
          * Set the deleted flag of the thread. This flag can't be cleared.
          * Can only be called with interrupts disabled or within an interrupt.
@@ -799,6 +845,12 @@ private:
          */
         bool isSleeping() const { return flags & SLEEP; }
 
+        /**
+         * \return true if the thread is both waiting and sleeping, as it is
+         * in IRQenableIrqAndTimedWait()
+         */
+        bool isTimedWaiting() const { return flags & TIMED_WAIT; }
+
         /**
          * \return true if the deleted and the detached flags are set
          */
@@ -868,6 +920,10 @@ private:
         ///\internal Thread is running in userspace
         static const unsigned int USERSPACE=1<<7;
 
+        ///\internal Thread is waiting with a timeout, so the wait flag has to
+        ///be cleared on timeout, and the sleep flag on wakeup
+        static const unsigned int TIMED_WAIT=1<<8;
+
         unsigned short flags;///<\internal flags are stored here
     };
     
@@ -984,6 +1040,8 @@ private:
     /// Per-thread instance of data to make the C and C++ libraries thread safe.
     struct _reent *cReentrancyData;
     CppReentrancyData cppReentrancyData;
+    ///Hazard pointers of this thread
+    HazardRecord hazards;
     #ifdef WITH_PROCESSES
     ///Process to which this thread belongs. Null if it is a kernel thread.
     ProcessBase *proc;
@@ -1025,6 +1083,8 @@ private:
     friend int ::pthread_cond_broadcast(pthread_cond_t *cond);
     //Needs access to cppReent
     friend class CppReentrancyAccessor;
+    //Needs access to hazards
+    friend class HazardPointer;
     #ifdef WITH_PROCESSES
     //Needs PKcreateUserspace(), setupUserspaceContext(), switchToUserspace()
     friend class Process;
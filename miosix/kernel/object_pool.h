@@ -0,0 +1,476 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "kernel.h"
+
+namespace miosix {
+
+/**
+ * A pool of up to N objects of type T, whose memory is statically allocated
+ * as part of the pool. Allocating and freeing is O(1) and only requires
+ * disabling interrupts for a few instructions, so it is deterministic and can
+ * be done also from interrupt context using the IRQ member functions.
+ * The constructor is constexpr, so global pools are initialized before any
+ * constructor runs, and can be used from other global constructors.
+ * \param T type of the objects
+ * \param N maximum number of objects
+ */
+template<typename T, unsigned int N>
+class ObjectPool
+{
+public:
+    /**
+     * Constructor
+     */
+    constexpr ObjectPool() : freeList(nullptr), firstUnused(0), allocated(0) {}
+
+    /**
+     * Allocate memory for an object, without constructing it
+     * \return a pointer to memory suitable to hold a T, or nullptr if the pool
+     * is full
+     */
+    void *allocate()
+    {
+        FastInterruptDisableLock dLock;
+        return IRQallocate();
+    }
+
+    /**
+     * Same as allocate(), but can be called only with interrupts disabled or
+     * within an interrupt routine
+     * \return a pointer to memory suitable to hold a T, or nullptr if the pool
+     * is full
+     */
+    void *IRQallocate()
+    {
+        Slot *result;
+        if(freeList)
+        {
+            result=freeList;
+            freeList=result->next;
+        } else if(firstUnused<N) {
+            result=&storage[firstUnused++];
+        } else return nullptr;
+        allocated++;
+        return result;
+    }
+
+    /**
+     * Free memory allocated with allocate(), without destroying the object
+     * \param p pointer to memory allocated by this pool
+     */
+    void deallocate(void *p)
+    {
+        FastInterruptDisableLock dLock;
+        IRQdeallocate(p);
+    }
+
+    /**
+     * Same as deallocate(), but can be called only with interrupts disabled or
+     * within an interrupt routine
+     * \param p pointer to memory allocated by this pool
+     */
+    void IRQdeallocate(void *p)
+    {
+        Slot *slot=reinterpret_cast<Slot*>(p);
+        slot->next=freeList;
+        freeList=slot;
+        allocated--;
+    }
+
+    /**
+     * Allocate and construct an object. Can't be called from interrupt
+     * context, as the constructor of T may not be safe to call there
+     * \param args arguments forwarded to the constructor of T
+     * \return a pointer to the object, or nullptr if the pool is full
+     * \throws whatever the constructor of T throws
+     */
+    template<typename... Args>
+    T *construct(Args&&... args)
+    {
+        void *p=allocate();
+        if(p==nullptr) return nullptr;
+        #ifndef __NO_EXCEPTIONS
+        try {
+        #endif //__NO_EXCEPTIONS
+            return new (p) T(std::forward<Args>(args)...);
+        #ifndef __NO_EXCEPTIONS
+        } catch(...) {
+            deallocate(p);
+            throw;
+        }
+        #endif //__NO_EXCEPTIONS
+    }
+
+    /**
+     * Destroy and free an object allocated with construct()
+     * \param p pointer to the object, can be nullptr
+     */
+    void destroy(T *p)
+    {
+        if(p==nullptr) return;
+        p->~T();
+        deallocate(p);
+    }
+
+    /**
+     * \param p a pointer
+     * \return true if p points to memory belonging to this pool
+     */
+    bool contains(const void *p) const
+    {
+        const Slot *slot=reinterpret_cast<const Slot*>(p);
+        return slot>=storage && slot<storage+N;
+    }
+
+    /**
+     * \return the number of objects currently allocated
+     */
+    unsigned int size() const { return allocated; }
+
+    /**
+     * \return the maximum number of objects
+     */
+    static constexpr unsigned int capacity() { return N; }
+
+private:
+    ObjectPool(const ObjectPool&);
+    ObjectPool& operator= (const ObjectPool&);
+
+    /**
+     * A slot either holds an object, or is part of the free list
+     */
+    union Slot
+    {
+        constexpr Slot() : next(nullptr) {}
+
+        Slot *next;
+        typename std::aligned_storage<sizeof(T),alignof(T)>::type object;
+    };
+
+    Slot *freeList;           ///< Slots that have been freed
+    unsigned int firstUnused; ///< Slots from here on have never been allocated
+    unsigned int allocated;   ///< Number of allocated slots
+    Slot storage[N];          ///< Memory for the objects
+};
+
+/**
+ * A region allocator that allocates memory from a buffer by incrementing a
+ * pointer. Memory can't be freed individually, the whole arena is freed at
+ * once by calling reset(), which makes it suitable for objects sharing the
+ * same lifetime, such as those built while processing a request.
+ * Like ObjectPool, it can be used also from interrupt context.
+ */
+class Arena
+{
+public:
+    /**
+     * Constructor
+     * \param buffer memory from which objects are allocated. Its lifetime must
+     * be longer than the one of the arena
+     * \param size buffer size in bytes
+     */
+    Arena(void *buffer, unsigned int size)
+            : base(reinterpret_cast<char*>(buffer)), bufferSize(size), top(0) {}
+
+    /**
+     * Allocate memory
+     * \param size size in bytes
+     * \param alignment alignment of the returned pointer, must be a power of 2
+     * \return a pointer to the allocated memory, or nullptr if there's not
+     * enough free space in the arena
+     */
+    void *allocate(size_t size, size_t alignment=alignof(std::max_align_t))
+    {
+        FastInterruptDisableLock dLock;
+        return IRQallocate(size,alignment);
+    }
+
+    /**
+     * Same as allocate(), but can be called only with interrupts disabled or
+     * within an interrupt routine
+     * \param size size in bytes
+     * \param alignment alignment of the returned pointer, must be a power of 2
+     * \return a pointer to the allocated memory, or nullptr if there's not
+     * enough free space in the arena
+     */
+    void *IRQallocate(size_t size, size_t alignment=alignof(std::max_align_t))
+    {
+        uintptr_t start=reinterpret_cast<uintptr_t>(base)+top;
+        start=(start+alignment-1) & ~(alignment-1);
+        size_t offset=start-reinterpret_cast<uintptr_t>(base);
+        if(offset>bufferSize || size>bufferSize-offset) return nullptr;
+        top=offset+size;
+        return base+offset;
+    }
+
+    /**
+     * Free all the memory allocated from the arena. Objects allocated in the
+     * arena are not destroyed, so they must have a trivial destructor, or
+     * have been destroyed by the caller
+     */
+    void reset()
+    {
+        FastInterruptDisableLock dLock;
+        top=0;
+    }
+
+    /**
+     * \param p a pointer
+     * \return true if p points to memory belonging to this arena
+     */
+    bool contains(const void *p) const
+    {
+        const char *c=reinterpret_cast<const char*>(p);
+        return c>=base && c<base+bufferSize;
+    }
+
+    /**
+     * \return the number of bytes allocated, including alignment padding
+     */
+    unsigned int used() const { return top; }
+
+    /**
+     * \return the arena size in bytes
+     */
+    unsigned int capacity() const { return bufferSize; }
+
+private:
+    Arena(const Arena&);
+    Arena& operator= (const Arena&);
+
+    char *base;              ///< Arena buffer
+    unsigned int bufferSize; ///< Arena buffer size
+    unsigned int top;        ///< Offset of the first free byte
+};
+
+/**
+ * An arena that includes its own buffer of Size bytes
+ */
+template<unsigned int Size>
+class StaticArena : public Arena
+{
+public:
+    /**
+     * Constructor
+     */
+    StaticArena() : Arena(&buffer,Size) {}
+
+private:
+    typename std::aligned_storage<Size>::type buffer; ///< Arena buffer
+};
+
+/**
+ * An allocator for STL containers that allocates single objects, such as the
+ * nodes of std::list and std::map, from an ObjectPool of N objects, shared by
+ * all the containers using a PoolAllocator for the same type and N.
+ * When the pool is full, or more than one object is requested, memory is
+ * allocated from the heap, so containers keep working after N elements, but
+ * are allocation free and deterministic only up to N elements.
+ * \param T type of the objects
+ * \param N number of objects in the pool
+ */
+template<typename T, unsigned int N>
+class PoolAllocator
+{
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<typename U>
+    struct rebind
+    {
+        typedef PoolAllocator<U,N> other;
+    };
+
+    PoolAllocator() {}
+
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U,N>&) {}
+
+    /**
+     * Allocate memory for n objects
+     * \param n number of objects
+     * \return a pointer to the allocated memory
+     * \throws bad_alloc if the pool is full and the heap is full
+     */
+    T *allocate(size_t n)
+    {
+        if(n==1)
+        {
+            void *result=pool.allocate();
+            if(result) return reinterpret_cast<T*>(result);
+        }
+        return reinterpret_cast<T*>(::operator new(n*sizeof(T)));
+    }
+
+    /**
+     * Free memory allocated with allocate(). The number of objects, required
+     * by the Allocator interface, is not needed
+     * \param p pointer to the memory
+     */
+    void deallocate(T *p, size_t)
+    {
+        if(pool.contains(p)) pool.deallocate(p);
+        else ::operator delete(p);
+    }
+
+    template<typename U, typename... Args>
+    void construct(U *p, Args&&... args)
+    {
+        new (p) U(std::forward<Args>(args)...);
+    }
+
+    template<typename U>
+    void destroy(U *p) { p->~U(); }
+
+    size_t max_size() const { return static_cast<size_t>(-1)/sizeof(T); }
+
+    static ObjectPool<T,N> pool; ///< Pool shared by all containers
+};
+
+template<typename T, unsigned int N>
+ObjectPool<T,N> PoolAllocator<T,N>::pool;
+
+template<typename T, typename U, unsigned int N>
+bool operator==(const PoolAllocator<T,N>&, const PoolAllocator<U,N>&)
+{
+    return true;
+}
+
+template<typename T, typename U, unsigned int N>
+bool operator!=(const PoolAllocator<T,N>&, const PoolAllocator<U,N>&)
+{
+    return false;
+}
+
+/**
+ * An allocator for STL containers that allocates memory from an Arena.
+ * Freeing memory does nothing, it is only reclaimed when the arena is reset.
+ * When the arena is full memory is allocated from the heap, and that memory
+ * is freed normally.
+ * \param T type of the objects
+ */
+template<typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<typename U>
+    struct rebind
+    {
+        typedef ArenaAllocator<U> other;
+    };
+
+    /**
+     * Constructor
+     * \param arena arena from which memory is allocated. Its lifetime must be
+     * longer than the one of the containers using it
+     */
+    explicit ArenaAllocator(Arena& arena) : arena(&arena) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    /**
+     * Allocate memory for n objects
+     * \param n number of objects
+     * \return a pointer to the allocated memory
+     * \throws bad_alloc if the arena is full and the heap is full
+     */
+    T *allocate(size_t n)
+    {
+        void *result=arena->allocate(n*sizeof(T),alignof(T));
+        if(result) return reinterpret_cast<T*>(result);
+        return reinterpret_cast<T*>(::operator new(n*sizeof(T)));
+    }
+
+    /**
+     * Free memory allocated with allocate(). The number of objects, required
+     * by the Allocator interface, is not needed
+     * \param p pointer to the memory
+     */
+    void deallocate(T *p, size_t)
+    {
+        if(arena->contains(p)==false) ::operator delete(p);
+    }
+
+    template<typename U, typename... Args>
+    void construct(U *p, Args&&... args)
+    {
+        new (p) U(std::forward<Args>(args)...);
+    }
+
+    template<typename U>
+    void destroy(U *p) { p->~U(); }
+
+    size_t max_size() const { return static_cast<size_t>(-1)/sizeof(T); }
+
+private:
+    template<typename U>
+    friend class ArenaAllocator;
+    template<typename U, typename V>
+    friend bool operator==(const ArenaAllocator<U>&, const ArenaAllocator<V>&);
+
+    Arena *arena; ///< Arena from which memory is allocated
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+    return a.arena==b.arena;
+}
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+    return !(a==b);
+}
+
+} //namespace miosix
+
+#endif //OBJECT_POOL_H
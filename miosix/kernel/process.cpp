@@ -39,9 +39,13 @@
 #include <limits.h>
 
 #include "sync.h"
+#include "interfaces/atomic_ops.h"
 #include "process_pool.h"
 #include "process.h"
 #include "SystemMap.h"
+#include "elf_loader.h"
+#include "filesystem/ioctl.h"
+#include "filesystem/poll.h"
 
 using namespace std;
 
@@ -136,7 +140,7 @@ pid_t Process::getppid(pid_t proc)
     return it->second->ppid;
 }
 
-pid_t Process::waitpid(pid_t pid, int* exit, int options)
+pid_t Process::waitpid(pid_t pid, int* exit, int options, ProcessUsage *usage)
 {
     Processes& p=Processes::instance();
     Lock<Mutex> l(p.procMutex);
@@ -155,6 +159,9 @@ pid_t Process::waitpid(pid_t pid, int* exit, int options)
         p.processes.erase(joined->pid);
         if(joined->waitCount!=0) errorHandler(UNEXPECTED);
         if(exit!=0) *exit=joined->exitCode;
+        ProcessUsage joinedUsage=collectUsage(joined);
+        self->childUsage.add(joinedUsage);
+        if(usage!=0) *usage=joinedUsage;
         pid_t result=joined->pid;
         delete joined;
         return result;
@@ -180,6 +187,9 @@ pid_t Process::waitpid(pid_t pid, int* exit, int options)
         {
             result=joined->pid;
             if(exit!=0) *exit=joined->exitCode;
+            ProcessUsage joinedUsage=collectUsage(joined);
+            self->childUsage.add(joinedUsage);
+            if(usage!=0) *usage=joinedUsage;
             self->zombies.remove(joined);
             p.processes.erase(joined->pid);
             delete joined;
@@ -188,6 +198,20 @@ pid_t Process::waitpid(pid_t pid, int* exit, int options)
     }
 }
 
+int Process::getUsage(pid_t pid, ProcessUsage& usage, bool children)
+{
+    Processes& p=Processes::instance();
+    Lock<Mutex> l(p.procMutex);
+    map<pid_t,ProcessBase *>::iterator it=p.processes.find(pid);
+    if(it==p.processes.end()) return -ESRCH;
+    ProcessBase *self=Thread::getCurrentThread()->proc;
+    if(self->pid!=0 && pid!=self->pid && it->second->ppid!=self->pid)
+        return -EPERM;
+    if(children) usage=it->second->childUsage;
+    else usage=collectUsage(it->second);
+    return 0;
+}
+
 Process::~Process() {}
 
 Process::Process(const ElfProgram& program) : program(program), waitCount(0),
@@ -202,6 +226,15 @@ Process::Process(const ElfProgram& program) : program(program), waitCount(0),
     unsigned int roundedSize=elfSize;
     if(elfSize<ProcessPool::blockSize) roundedSize=ProcessPool::blockSize;
     roundedSize=MPUConfiguration::roundSizeForMPU(roundedSize);
+    intrusive_ref_ptr<ElfRamImage> ram=program.getRamImage();
+    if(ram)
+    {
+        //The elf is in RAM, in a block allocated to be an exact MPU region,
+        //so only the code of this program is made visible
+        mpu=MPUConfiguration(ram->getElfBase(),ram->getBlockSize(),
+                image.getProcessBasePointer(),image.getProcessImageSize());
+        return;
+    }
     //TODO: Till a flash file system that ensures proper alignment of the
     //programs loaded in flash is implemented, make the whole flash visible as
     //a big MPU region. This allows a program to read and execute parts of
@@ -270,6 +303,8 @@ void *Process::start(void *argv)
 
 bool Process::handleSvc(miosix_private::SyscallParameters sp)
 {
+    //Threads of the same process may be doing syscalls concurrently
+    atomicAdd(reinterpret_cast<volatile int*>(&usage.syscalls),1);
     try {
         switch(sp.getSyscallId())
         {
@@ -343,11 +378,16 @@ bool Process::handleSvc(miosix_private::SyscallParameters sp)
                 {
                     std::pair<const unsigned int*,unsigned int> res;
                     res=SystemMap::instance().getElfProgram(str);
-                    if(res.first==0 || res.second==0)
+                    intrusive_ref_ptr<ElfRamImage> ram;
+                    //Programs not linked with the kernel are looked up
+                    //in the filesystem
+                    if((res.first==0 || res.second==0) &&
+                       ElfLoader::instance().load(fileTable,str,ram)<0)
                     {
                         sp.setReturnValue(-1);
                     } else {
-                        ElfProgram program(res.first,res.second);
+                        ElfProgram program=ram ? ElfProgram(ram)
+                                : ElfProgram(res.first,res.second);
                         int ret=0;
                         pid_t child=Process::create(program);
                         Process::waitpid(child,&ret,0);
@@ -408,7 +448,14 @@ bool Process::handleSvc(miosix_private::SyscallParameters sp)
             }
             case SYS_IOCTL:
             {
-                //TODO: need a way to validate ARG
+                //TODO: need a way to validate ARG, for now only commands that
+                //take no argument are supported
+                int cmd=sp.getSecondParameter();
+                if(cmd==IOCTL_SYNC)
+                {
+                    int result=fileTable.ioctl(sp.getFirstParameter(),cmd,0);
+                    sp.setReturnValue(result);
+                } else sp.setReturnValue(-EFAULT);
                 break;
             }
             case SYS_GETDENTS:
@@ -491,6 +538,122 @@ bool Process::handleSvc(miosix_private::SyscallParameters sp)
                 } else sp.setReturnValue(-EFAULT);
                 break;
             }
+            case SYS_SHMMAP:
+            {
+                const char *str;
+                str=reinterpret_cast<const char*>(sp.getFirstParameter());
+                if(mpu.withinForReading(str))
+                {
+                    if(shm)
+                    {
+                        sp.setReturnValue(-EBUSY);
+                        break;
+                    }
+                    intrusive_ref_ptr<SharedMemory> obj;
+                    int result=SharedMemoryManager::instance().open(str,
+                        sp.getSecondParameter(),sp.getThirdParameter(),obj);
+                    if(result==0)
+                    {
+                        shm=obj;
+                        {
+                            //Not strictly required as the MPU configuration
+                            //is not used while the thread is in kernelspace,
+                            //but the region registers must be updated together
+                            FastInterruptDisableLock dLock;
+                            mpu.setSharedRegion(shm->getBase(),shm->getSize());
+                        }
+                        result=reinterpret_cast<int>(shm->getBase());
+                    }
+                    sp.setReturnValue(result);
+                } else sp.setReturnValue(-EFAULT);
+                break;
+            }
+            case SYS_SHMUNMAP:
+            {
+                if(shm)
+                {
+                    {
+                        FastInterruptDisableLock dLock;
+                        mpu.clearSharedRegion();
+                    }
+                    shm.reset();
+                    sp.setReturnValue(0);
+                } else sp.setReturnValue(-EINVAL);
+                break;
+            }
+            case SYS_SHMUNLINK:
+            {
+                const char *str;
+                str=reinterpret_cast<const char*>(sp.getFirstParameter());
+                if(mpu.withinForReading(str))
+                {
+                    int result=SharedMemoryManager::instance().unlink(str);
+                    sp.setReturnValue(result);
+                } else sp.setReturnValue(-EFAULT);
+                break;
+            }
+            case SYS_GETPROCUSAGE:
+            {
+                pid_t target=sp.getFirstParameter();
+                ProcessUsage *ptr;
+                ptr=reinterpret_cast<ProcessUsage*>(sp.getSecondParameter());
+                if(mpu.withinForWriting(ptr,sizeof(ProcessUsage)) && aligned(ptr))
+                {
+                    if(target==0) target=pid;
+                    //Copy through a kernel buffer so that a failed query
+                    //leaves the userspace struct untouched
+                    ProcessUsage result;
+                    int error=getUsage(target,result,sp.getThirdParameter()!=0);
+                    if(error==0) memcpy(ptr,&result,sizeof(ProcessUsage));
+                    sp.setReturnValue(error);
+                } else sp.setReturnValue(-EFAULT);
+                break;
+            }
+            case SYS_POLL:
+            {
+                pollfd *fds=reinterpret_cast<pollfd*>(sp.getFirstParameter());
+                nfds_t nfds=sp.getSecondParameter();
+                int timeout=sp.getThirdParameter();
+                //Check nfds first, as nfds*sizeof(pollfd) may overflow
+                if(nfds>MAX_OPEN_FILES) sp.setReturnValue(-EINVAL);
+                else if(mpu.withinForWriting(fds,nfds*sizeof(pollfd))
+                    && aligned(fds))
+                {
+                    int result=fileTable.poll(fds,nfds,timeout);
+                    sp.setReturnValue(result);
+                } else sp.setReturnValue(-EFAULT);
+                break;
+            }
+            case SYS_PIPE:
+            {
+                int *fds=reinterpret_cast<int*>(sp.getFirstParameter());
+                if(mpu.withinForWriting(fds,2*sizeof(int)) && aligned(fds))
+                {
+                    int result=fileTable.pipe(fds);
+                    sp.setReturnValue(result);
+                } else sp.setReturnValue(-EFAULT);
+                break;
+            }
+            case SYS_MKFIFO:
+            {
+                const char *str;
+                str=reinterpret_cast<const char*>(sp.getFirstParameter());
+                if(mpu.withinForReading(str))
+                {
+                    int result=fileTable.mkfifo(str,sp.getSecondParameter());
+                    sp.setReturnValue(result);
+                } else sp.setReturnValue(-EFAULT);
+                break;
+            }
+            case SYS_SPLICE:
+            {
+                int fdIn=sp.getFirstParameter();
+                int fdOut=sp.getSecondParameter();
+                size_t len=sp.getThirdParameter();
+                ssize_t result=fileTable.splice(fdIn,fdOut,len);
+                sp.setReturnValue(result);
+                break;
+            }
             default:
                 exitCode=SIGSYS; //Bad syscall
                 #ifdef WITH_ERRLOG
@@ -498,12 +661,25 @@ bool Process::handleSvc(miosix_private::SyscallParameters sp)
                 #endif //WITH_ERRLOG
                 return false;
         }
+    } catch(ElfFormatError&) {
+        sp.setReturnValue(-ENOEXEC);
     } catch(exception& e) {
         sp.setReturnValue(-ENOMEM);
     }
     return true;
 }
 
+ProcessUsage Process::collectUsage(ProcessBase *proc)
+{
+    ProcessUsage result=proc->usage;
+    result.bytesRead=proc->fileTable.getBytesRead();
+    result.bytesWritten=proc->fileTable.getBytesWritten();
+    //Only processes have an image, the kernel has pid 0
+    if(proc->pid!=0)
+        result.maxImageUsage=static_cast<Process*>(proc)->image.getPeakUsage();
+    return result;
+}
+
 pid_t Process::getNewPid()
 {
     Processes& p=Processes::instance();
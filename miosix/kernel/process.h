@@ -32,10 +32,13 @@
 #include <map>
 #include <list>
 #include <set>
+#include <cstring>
 #include <sys/types.h>
 #include "kernel.h"
 #include "sync.h"
 #include "elf_program.h"
+#include "shared_memory.h"
+#include "process_usage.h"
 #include "config/miosix_settings.h"
 #include "filesystem/file_access.h"
 
@@ -80,7 +83,34 @@ enum Syscalls
     SYS_MKDIR=19,
     SYS_RMDIR=20,
     SYS_UNLINK=21,
-    SYS_RENAME=22
+    SYS_RENAME=22,
+    
+    // Shared memory. A process can map at most one shared memory object at a
+    // time, as it is protected using an additional MPU region.
+    // SYS_SHMMAP takes the name, the size and the O_CREAT/O_EXCL flags, and
+    // returns the address of the mapping or a negative error code in the
+    // range -1..-4095 (as addresses may have the most significant bit set).
+    // SYS_SHMUNMAP takes no parameters, SYS_SHMUNLINK takes the name.
+    SYS_SHMMAP=23,
+    SYS_SHMUNMAP=24,
+    SYS_SHMUNLINK=25,
+    
+    // Resource usage. Takes a pid (0 for the calling process), a pointer to a
+    // ProcessUsage struct and a flag that if nonzero selects the usage of the
+    // terminated and waited for child processes instead of the process itself.
+    // Only the calling process and its children can be queried.
+    SYS_GETPROCUSAGE=26,
+    
+    // Readiness notification. Takes a pointer to an array of struct pollfd,
+    // the number of elements and a timeout in milliseconds, see poll.h
+    SYS_POLL=27,
+    
+    // Pipes. SYS_PIPE takes a pointer to an array of two ints where the file
+    // descriptors are stored, SYS_MKFIFO the name and the mode, SYS_SPLICE
+    // the input and output file descriptors and the number of bytes to move
+    SYS_PIPE=28,
+    SYS_MKFIFO=29,
+    SYS_SPLICE=30
 };
 
 //Forware decl
@@ -96,7 +126,11 @@ public:
     /**
      * Constructor
      */
-    ProcessBase() : pid(0), ppid(0) {}
+    ProcessBase() : pid(0), ppid(0)
+    {
+        memset(&usage,0,sizeof(usage));
+        memset(&childUsage,0,sizeof(childUsage));
+    }
     
     /**
      * \return the process' pid 
@@ -111,12 +145,18 @@ protected:
     std::list<Process *> childs;   ///<Living child processes are stored here
     std::list<Process *> zombies;  ///<Dead child processes are stored here
     FileDescriptorTable fileTable; ///<The file descriptor table
+    ///CPU time and syscall count of this process. Byte counters are kept by
+    ///the file descriptor table, image usage by the process image
+    ProcessUsage usage;
+    ProcessUsage childUsage; ///< Usage of terminated and waited for children
     
 private:
     ProcessBase(const ProcessBase&);
     ProcessBase& operator= (const ProcessBase&);
     
     friend class Process;
+    //Needs access to usage
+    friend bool IRQwakeThreads();
 };
 
 /**
@@ -156,11 +196,27 @@ public:
      * \param exit the process exit code will be returned here, if the pointer
      * is not null
      * \param options only 0 and WNOHANG are supported
+     * \param usage if not null, the resource usage of the terminated process
+     * is returned here, as with wait4()
      * \return the pid of the terminated process, or -1 in case of errors. In
      * case WNOHANG  is specified and the specified process has not terminated,
      * 0 is returned
      */
-    static pid_t waitpid(pid_t pid, int *exit, int options);
+    static pid_t waitpid(pid_t pid, int *exit, int options,
+                         ProcessUsage *usage=nullptr);
+    
+    /**
+     * Get the resource usage of a process. The kernel can query any process,
+     * including itself (pid 0), while a process can only query itself and its
+     * child processes
+     * \param pid pid of the process
+     * \param usage the resource usage is returned here
+     * \param children if true, return the summed usage of the terminated
+     * child processes that have been waited for, as with RUSAGE_CHILDREN
+     * \return 0 on success, -ESRCH if there is no such process, -EPERM if the
+     * caller can't query it
+     */
+    static int getUsage(pid_t pid, ProcessUsage& usage, bool children=false);
     
     /**
      * Destructor
@@ -196,10 +252,19 @@ private:
      */
     static pid_t getNewPid();
     
+    /**
+     * Collect the resource usage of a process. Must be called with procMutex
+     * locked
+     * \param proc process, can also be the kernel
+     * \return the resource usage of the process
+     */
+    static ProcessUsage collectUsage(ProcessBase *proc);
+    
     ElfProgram program; ///<The program that is running inside the process
     ProcessImage image; ///<The RAM image of a process
     miosix_private::FaultData fault; ///< Contains information about faults
     MPUConfiguration mpu; ///<Memory protection data
+    intrusive_ref_ptr<SharedMemory> shm; ///<Mapped shared memory, if any
     
     std::vector<Thread *> threads; ///<Threads that belong to the process
     
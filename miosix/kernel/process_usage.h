@@ -0,0 +1,70 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef PROCESS_USAGE_H
+#define PROCESS_USAGE_H
+
+// NOTE: this file is header-only and does not depend on the rest of the kernel
+// so that it can be included also by processes, that receive this struct from
+// the getprocusage() syscall
+
+namespace miosix {
+
+/**
+ * Resource usage statistics of a process, as returned by Process::getUsage()
+ * and Process::waitpid().
+ * CPU time is accounted statistically: at every tick, the whole tick is
+ * charged to the process whose thread was running at that time.
+ */
+struct ProcessUsage
+{
+    unsigned int userTicks;     ///< Ticks spent running in userspace
+    unsigned int systemTicks;   ///< Ticks spent running in the kernel
+    unsigned int syscalls;      ///< Number of syscalls issued
+    unsigned int maxImageUsage; ///< Peak number of bytes of the RAM image used
+    unsigned long long bytesRead;    ///< Bytes read through file descriptors
+    unsigned long long bytesWritten; ///< Bytes written through file descriptors
+
+    /**
+     * Add the usage of another process to this one. Used to account for the
+     * resources used by terminated child processes
+     * \param rhs usage to add
+     */
+    void add(const ProcessUsage& rhs)
+    {
+        userTicks+=rhs.userTicks;
+        systemTicks+=rhs.systemTicks;
+        syscalls+=rhs.syscalls;
+        if(rhs.maxImageUsage>maxImageUsage) maxImageUsage=rhs.maxImageUsage;
+        bytesRead+=rhs.bytesRead;
+        bytesWritten+=rhs.bytesWritten;
+    }
+};
+
+} //namespace miosix
+
+#endif //PROCESS_USAGE_H
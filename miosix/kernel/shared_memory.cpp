@@ -0,0 +1,104 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "shared_memory.h"
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include "process_pool.h"
+
+using namespace std;
+
+#ifdef WITH_PROCESSES
+
+namespace miosix {
+
+//
+// class SharedMemory
+//
+
+SharedMemory::SharedMemory(const string& name, unsigned int size)
+    : name(name), base(ProcessPool::instance().allocate(size)), size(size)
+{
+    memset(base,0,size);
+}
+
+SharedMemory::~SharedMemory()
+{
+    ProcessPool::instance().deallocate(base);
+}
+
+//
+// class SharedMemoryManager
+//
+
+SharedMemoryManager& SharedMemoryManager::instance()
+{
+    static SharedMemoryManager singleton;
+    return singleton;
+}
+
+int SharedMemoryManager::open(const char *name, unsigned int size, int flags,
+        intrusive_ref_ptr<SharedMemory>& result)
+{
+    if(name==0 || name[0]=='\0') return -EINVAL;
+    Lock<FastMutex> l(mutex);
+    auto it=objects.find(name);
+    if(it!=objects.end())
+    {
+        if((flags & O_CREAT) && (flags & O_EXCL)) return -EEXIST;
+        if(size>it->second->getSize()) return -EINVAL;
+        result=it->second;
+        return 0;
+    }
+    if((flags & O_CREAT)==0) return -ENOENT;
+    if(size==0) return -EINVAL;
+    if(size<ProcessPool::blockSize) size=ProcessPool::blockSize;
+    size=MPUConfiguration::roundSizeForMPU(size);
+    try {
+        intrusive_ref_ptr<SharedMemory> shm(new SharedMemory(name,size));
+        objects[name]=shm;
+        result=shm;
+    } catch(exception&) {
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+int SharedMemoryManager::unlink(const char *name)
+{
+    if(name==0) return -EINVAL;
+    Lock<FastMutex> l(mutex);
+    auto it=objects.find(name);
+    if(it==objects.end()) return -ENOENT;
+    objects.erase(it);
+    return 0;
+}
+
+} //namespace miosix
+
+#endif //WITH_PROCESSES
@@ -0,0 +1,136 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef SHARED_MEMORY_H
+#define SHARED_MEMORY_H
+
+#include <map>
+#include <string>
+#include "sync.h"
+#include "intrusive.h"
+#include "config/miosix_settings.h"
+
+#ifdef WITH_PROCESSES
+
+namespace miosix {
+
+/**
+ * A named shared memory object. The memory is allocated from the process pool
+ * so that it satisfies the alignment constraints of the MPU, and can thus be
+ * mapped as an additional region in more than one process at the same time.
+ * The memory is returned to the process pool when the last reference to the
+ * object is dropped.
+ */
+class SharedMemory : public IntrusiveRefCounted
+{
+public:
+    /**
+     * Constructor, allocates the memory and fills it with zeros
+     * \param name name of the shared memory object
+     * \param size size of the shared memory object, must be a power of two
+     * greater or equal to ProcessPool::blockSize
+     * \throws runtime_error or bad_alloc if the memory can't be allocated
+     */
+    SharedMemory(const std::string& name, unsigned int size);
+
+    /**
+     * \return the name of the shared memory object
+     */
+    const std::string& getName() const { return name; }
+
+    /**
+     * \return the base address of the shared memory object
+     */
+    unsigned int *getBase() const { return base; }
+
+    /**
+     * \return the size of the shared memory object
+     */
+    unsigned int getSize() const { return size; }
+
+    /**
+     * Destructor, returns the memory to the process pool
+     */
+    ~SharedMemory();
+
+private:
+    SharedMemory(const SharedMemory&);
+    SharedMemory& operator= (const SharedMemory&);
+
+    std::string name;   ///< Name of the shared memory object
+    unsigned int *base; ///< Base address, aligned to size
+    unsigned int size;  ///< Size, a power of two
+};
+
+/**
+ * This class keeps track of the named shared memory objects that exist in the
+ * system. Objects that are unlinked while still mapped by a process keep
+ * existing, but can't be opened again, as with POSIX shm_unlink()
+ */
+class SharedMemoryManager
+{
+public:
+    /**
+     * \return the instance of this class (singleton)
+     */
+    static SharedMemoryManager& instance();
+
+    /**
+     * Open a shared memory object
+     * \param name name of the shared memory object
+     * \param size requested size. If the object is created it is rounded up to
+     * the first size that can be protected by the MPU, if the object already
+     * exists it must be less or equal to its size. Zero means the size of the
+     * existing object.
+     * \param flags O_CREAT and O_EXCL have the same meaning as in open()
+     * \param result the shared memory object is returned here
+     * \return 0 on success, or a negative number on failure
+     */
+    int open(const char *name, unsigned int size, int flags,
+             intrusive_ref_ptr<SharedMemory>& result);
+
+    /**
+     * Remove the name of a shared memory object
+     * \param name name of the shared memory object
+     * \return 0 on success, or a negative number on failure
+     */
+    int unlink(const char *name);
+
+private:
+    SharedMemoryManager() {}
+    SharedMemoryManager(const SharedMemoryManager&);
+    SharedMemoryManager& operator= (const SharedMemoryManager&);
+
+    FastMutex mutex; ///< To guard access to objects
+    std::map<std::string,intrusive_ref_ptr<SharedMemory> > objects;
+};
+
+} //namespace miosix
+
+#endif //WITH_PROCESSES
+
+#endif //SHARED_MEMORY_H
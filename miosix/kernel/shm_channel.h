@@ -0,0 +1,261 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef SHM_CHANNEL_H
+#define SHM_CHANNEL_H
+
+#include <cstring>
+
+// NOTE: this file is header-only and does not depend on the rest of the kernel
+// so that it can be included also by processes, which use it to exchange
+// messages through a memory area obtained with shm_map()
+
+namespace miosix {
+
+/**
+ * Single producer, single consumer lock-free message channel that lives
+ * entirely inside a memory area shared between two processes, or between a
+ * process and the kernel. Messages are variable length and can be written and
+ * read in place, so the only copy is the one done by the producer when it
+ * fills the message, and no syscall is required to transfer data.
+ *
+ * The memory area starts with a small header containing the read and write
+ * offsets, followed by the message ring. Each message is prefixed by its
+ * length and padded to a multiple of four bytes. When a message does not fit
+ * in the space left before the end of the ring, a wrap marker is written and
+ * the message is stored at the beginning of the ring.
+ *
+ * The channel object itself only holds a pointer to the shared area, so each
+ * party constructs its own, one of them calling init() exactly once before
+ * the other one starts using the channel.
+ */
+class ShmChannel
+{
+public:
+    /**
+     * Constructor
+     * \param base base address of the shared area, must be four byte aligned
+     * \param size size of the shared area in bytes
+     */
+    ShmChannel(void *base, unsigned int size)
+        : h(reinterpret_cast<Header*>(base)),
+          ring(reinterpret_cast<unsigned char*>(base)+sizeof(Header)),
+          capacity((size-sizeof(Header)) & ~3u) {}
+
+    /**
+     * Initialize the shared area as an empty channel. Must be called by only
+     * one of the two parties, before any message is exchanged.
+     */
+    void init()
+    {
+        h->head=0;
+        h->tail=0;
+        __atomic_store_n(&h->magic,magicValue,__ATOMIC_RELEASE);
+    }
+
+    /**
+     * \return true if the shared area has been initialized by init()
+     */
+    bool valid() const
+    {
+        return __atomic_load_n(&h->magic,__ATOMIC_ACQUIRE)==magicValue;
+    }
+
+    /**
+     * Reserve space for a message. Can only be called by the producer.
+     * \param len size of the message
+     * \return a pointer where the message can be written, or nullptr if there
+     * is currently not enough space in the channel. The message is not
+     * visible to the consumer until commitWrite() is called.
+     */
+    void *beginWrite(unsigned int len)
+    {
+        unsigned int rec=recordSize(len);
+        unsigned int head=h->head; //Only the producer writes head
+        unsigned int tail=__atomic_load_n(&h->tail,__ATOMIC_ACQUIRE);
+        if(head>=tail)
+        {
+            //Free space is [head,capacity) plus [0,tail). Leaving head==tail
+            //after the write would make a full channel look empty
+            if(head+rec<capacity || (head+rec==capacity && tail!=0))
+                return ring+head+sizeof(unsigned int);
+            if(rec>=tail) return nullptr;
+            pendingWrap=true;
+            return ring+sizeof(unsigned int);
+        }
+        if(head+rec>=tail) return nullptr;
+        return ring+head+sizeof(unsigned int);
+    }
+
+    /**
+     * Make a message reserved with beginWrite() visible to the consumer.
+     * \param len size of the message, must be equal to the one passed to
+     * beginWrite()
+     */
+    void commitWrite(unsigned int len)
+    {
+        unsigned int rec=recordSize(len);
+        unsigned int head=h->head;
+        if(pendingWrap)
+        {
+            pendingWrap=false;
+            //A wrap marker is only needed if there is room for it
+            if(head<capacity) wordAt(head)=wrapMarker;
+            head=0;
+        }
+        wordAt(head)=len;
+        head+=rec;
+        if(head==capacity) head=0;
+        __atomic_store_n(&h->head,head,__ATOMIC_RELEASE);
+    }
+
+    /**
+     * Copy a message into the channel. Can only be called by the producer.
+     * \param data message to send
+     * \param len message size
+     * \return true on success, false if the channel is full
+     */
+    bool send(const void *data, unsigned int len)
+    {
+        void *dest=beginWrite(len);
+        if(dest==nullptr) return false;
+        memcpy(dest,data,len);
+        commitWrite(len);
+        return true;
+    }
+
+    /**
+     * Access the oldest message in the channel, in place. Can only be called
+     * by the consumer.
+     * \param len the size of the message is returned here
+     * \return a pointer to the message, or nullptr if the channel is empty.
+     * The pointer is valid until commitRead() is called.
+     */
+    const void *beginRead(unsigned int& len)
+    {
+        unsigned int tail=h->tail; //Only the consumer writes tail
+        unsigned int head=__atomic_load_n(&h->head,__ATOMIC_ACQUIRE);
+        if(tail==head) return nullptr;
+        if(wordAt(tail)==wrapMarker)
+        {
+            tail=0;
+            __atomic_store_n(&h->tail,tail,__ATOMIC_RELEASE);
+            if(tail==head) return nullptr;
+        }
+        len=wordAt(tail);
+        return ring+tail+sizeof(unsigned int);
+    }
+
+    /**
+     * Remove the message returned by beginRead() from the channel, making its
+     * space available again to the producer
+     */
+    void commitRead()
+    {
+        unsigned int tail=h->tail;
+        tail+=recordSize(wordAt(tail));
+        if(tail==capacity) tail=0;
+        __atomic_store_n(&h->tail,tail,__ATOMIC_RELEASE);
+    }
+
+    /**
+     * Copy the oldest message out of the channel. Can only be called by the
+     * consumer.
+     * \param data buffer where the message is copied
+     * \param maxLen buffer size. Messages longer than this are truncated
+     * \return the message size, or -1 if the channel is empty
+     */
+    int receive(void *data, unsigned int maxLen)
+    {
+        unsigned int len;
+        const void *src=beginRead(len);
+        if(src==nullptr) return -1;
+        memcpy(data,src,len<maxLen ? len : maxLen);
+        commitRead();
+        return len;
+    }
+
+    /**
+     * \return true if there are no messages in the channel
+     */
+    bool empty() const
+    {
+        return __atomic_load_n(&h->tail,__ATOMIC_ACQUIRE)
+            == __atomic_load_n(&h->head,__ATOMIC_ACQUIRE);
+    }
+
+    /**
+     * \return the maximum message size that the channel can hold
+     */
+    unsigned int maxMessageSize() const
+    {
+        return capacity<2*sizeof(unsigned int) ? 0 :
+               capacity-2*sizeof(unsigned int);
+    }
+
+private:
+    /**
+     * Layout of the beginning of the shared area
+     */
+    struct Header
+    {
+        unsigned int magic; ///< Set by init()
+        unsigned int head;  ///< Write offset, written only by the producer
+        unsigned int tail;  ///< Read offset, written only by the consumer
+        unsigned int pad;   ///< Keeps the ring eight byte aligned
+    };
+
+    /**
+     * \param len message length
+     * \return the space taken by a message in the ring, including its length
+     */
+    static unsigned int recordSize(unsigned int len)
+    {
+        return sizeof(unsigned int)+((len+3) & ~3u);
+    }
+
+    /**
+     * \param offset a four byte aligned offset within the ring
+     * \return the word at that offset
+     */
+    unsigned int& wordAt(unsigned int offset)
+    {
+        return *reinterpret_cast<unsigned int*>(ring+offset);
+    }
+
+    static const unsigned int magicValue=0x4d584348; ///< "MXCH"
+    static const unsigned int wrapMarker=0xffffffff;
+
+    Header *h;             ///< Header, in the shared area
+    unsigned char *ring;   ///< Message ring, in the shared area
+    unsigned int capacity; ///< Size of the ring, multiple of four bytes
+    bool pendingWrap=false;///< beginWrite() decided the message goes at 0
+};
+
+} //namespace miosix
+
+#endif //SHM_CHANNEL_H
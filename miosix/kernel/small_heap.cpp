@@ -0,0 +1,176 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "small_heap.h"
+#include <malloc.h>
+#include <reent.h>
+#include "kernel.h"
+#include "sync.h"
+
+namespace miosix {
+
+#ifdef WITH_SMALL_HEAP
+
+static const unsigned int numClasses=8;
+
+/// Size of each class, all multiple of 8 to keep objects 8 byte aligned
+static const unsigned short classSize[numClasses]={8,16,24,32,48,64,96,128};
+
+/// Size class to use for each size, indexed by (size+7)/8
+static const unsigned char sizeToClass[SmallHeap::maxSize/8+1]=
+{
+    0,0,1,2,3,4,4,5,5,6,6,6,6,7,7,7,7
+};
+
+static void *freeList[numClasses];      ///< Free objects of each class
+static unsigned int numUsed[numClasses]; ///< Allocated objects of each class
+static unsigned int numFree[numClasses]; ///< Free objects of each class
+static unsigned int numSlabs=0;          ///< Slabs taken from the heap
+
+/// One entry for each slabSize aligned block of the heap, that is 0 if the
+/// block is not a slab, or the size class of the slab plus one otherwise
+static unsigned char *slabClass=nullptr;
+static unsigned int firstSlab;           ///< Address of first block/slabSize
+static unsigned int slabRegistrySize;    ///< Number of entries in slabClass
+
+/**
+ * \param p a pointer
+ * \return the size class of the slab p is in, or -1 if p is not in a slab
+ */
+static int findClass(void *p)
+{
+    if(slabClass==nullptr) return -1;
+    unsigned int i=reinterpret_cast<unsigned int>(p)/SmallHeap::slabSize;
+    i-=firstSlab; //May wrap around if p is below the heap
+    if(i>=slabRegistrySize) return -1;
+    return static_cast<int>(slabClass[i])-1;
+}
+
+/**
+ * Allocate a slab and add its objects to a free list
+ * \param c size class
+ * \return false if the heap is full
+ */
+static bool refill(int c)
+{
+    //The C library allocator pauses the kernel, we do the same here to
+    //serialize refills, and to initialize the slab registry only once
+    PauseKernelLock pkLock;
+    struct _reent *r=__getreent();
+    if(slabClass==nullptr)
+    {
+        //These extern variables are defined in the linker script
+        extern char _end asm("_end");
+        extern char _heap_end asm("_heap_end");
+        firstSlab=reinterpret_cast<unsigned int>(&_end)/SmallHeap::slabSize;
+        unsigned int last=reinterpret_cast<unsigned int>(&_heap_end)
+                         /SmallHeap::slabSize;
+        slabRegistrySize=last-firstSlab+1;
+        unsigned char *registry;
+        registry=reinterpret_cast<unsigned char*>(
+            _calloc_r(r,slabRegistrySize,1));
+        if(registry==nullptr) return false;
+        slabClass=registry;
+    }
+    char *slab=reinterpret_cast<char*>(
+        _memalign_r(r,SmallHeap::slabSize,SmallHeap::slabSize));
+    if(slab==nullptr) return false;
+    //Link the objects in the slab, the last one points to the current list
+    unsigned int size=classSize[c];
+    unsigned int count=SmallHeap::slabSize/size;
+    for(unsigned int i=0;i<count-1;i++)
+        *reinterpret_cast<void**>(slab+i*size)=slab+(i+1)*size;
+    slabClass[reinterpret_cast<unsigned int>(slab)/SmallHeap::slabSize
+              -firstSlab]=c+1;
+    {
+        InterruptDisableLock dLock;
+        *reinterpret_cast<void**>(slab+(count-1)*size)=freeList[c];
+        freeList[c]=slab;
+        numFree[c]+=count;
+        numSlabs++;
+    }
+    return true;
+}
+
+//
+// class SmallHeap
+//
+
+void *SmallHeap::allocate(size_t size)
+{
+    if(size>maxSize) return nullptr;
+    int c=sizeToClass[(size+7)/8];
+    for(;;)
+    {
+        {
+            InterruptDisableLock dLock;
+            void *result=freeList[c];
+            if(result)
+            {
+                freeList[c]=*reinterpret_cast<void**>(result);
+                numFree[c]--;
+                numUsed[c]++;
+                return result;
+            }
+        }
+        if(refill(c)==false) return nullptr;
+    }
+}
+
+bool SmallHeap::deallocate(void *p)
+{
+    int c=findClass(p);
+    if(c<0) return false;
+    InterruptDisableLock dLock;
+    *reinterpret_cast<void**>(p)=freeList[c];
+    freeList[c]=p;
+    numUsed[c]--;
+    numFree[c]++;
+    return true;
+}
+
+unsigned int SmallHeap::objectSize(void *p)
+{
+    int c=findClass(p);
+    return c<0 ? 0 : classSize[c];
+}
+
+void SmallHeap::getStats(SmallHeapStats& stats)
+{
+    InterruptDisableLock dLock;
+    stats.slabs=numSlabs;
+    stats.usedBytes=stats.freeBytes=0;
+    for(unsigned int i=0;i<numClasses;i++)
+    {
+        stats.usedBytes+=numUsed[i]*classSize[i];
+        stats.freeBytes+=numFree[i]*classSize[i];
+    }
+}
+
+#endif //WITH_SMALL_HEAP
+
+} //namespace miosix
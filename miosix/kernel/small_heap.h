@@ -0,0 +1,108 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef SMALL_HEAP_H
+#define	SMALL_HEAP_H
+
+#include <cstddef>
+#include "config/miosix_settings.h"
+
+namespace miosix {
+
+#ifdef WITH_SMALL_HEAP
+
+/**
+ * Usage statistics of the small object heap
+ */
+struct SmallHeapStats
+{
+    unsigned int slabs;     ///< Number of slabs taken from the heap
+    unsigned int usedBytes; ///< Bytes in allocated objects
+    unsigned int freeBytes; ///< Bytes in free objects, ready to be reused
+};
+
+/**
+ * \internal
+ * An allocator for small objects, used by malloc() and operator new in front
+ * of the C library allocator. Objects are grouped in size classes, and each
+ * class has a free list, so allocating and freeing is O(1) and only requires
+ * disabling interrupts for a few instructions, instead of pausing the kernel
+ * for the whole search of the C library allocator. When a free list is empty
+ * it is refilled with a slab of slabSize bytes, allocated from the C library
+ * heap. Slabs are never returned to the heap, memory freed by small objects
+ * can only be reused by objects of the same size class.
+ * Like malloc(), it can't be used from interrupt context.
+ * Besides malloc(), free(), calloc() and realloc(), also reallocf(),
+ * reallocarray() and malloc_usable_size() know about small objects.
+ * Note that C library functions that reallocate or free a buffer passed by
+ * the caller, such as getline(), bypass malloc() and don't know about small
+ * objects, so such buffers should be allocated by the C library itself.
+ */
+class SmallHeap
+{
+public:
+    static const unsigned int maxSize=128;   ///< Largest size class
+    static const unsigned int slabSize=1024; ///< Must be a power of 2
+
+    /**
+     * Allocate a small object
+     * \param size object size
+     * \return a pointer to the object, or nullptr if size is larger than
+     * maxSize or the heap is full
+     */
+    static void *allocate(size_t size);
+
+    /**
+     * Free an object, if it was allocated by allocate()
+     * \param p pointer to the object
+     * \return true if the object was allocated by allocate(), and has been
+     * freed, false otherwise
+     */
+    static bool deallocate(void *p);
+
+    /**
+     * \param p a pointer allocated either by allocate() or by the C library
+     * \return the size class of the object if p was allocated by allocate(),
+     * or 0 otherwise
+     */
+    static unsigned int objectSize(void *p);
+
+    /**
+     * \param stats usage statistics are returned here
+     */
+    static void getStats(SmallHeapStats& stats);
+
+private:
+    //All member functions static, disallow creating instances
+    SmallHeap();
+};
+
+#endif //WITH_SMALL_HEAP
+
+} //namespace miosix
+
+#endif //SMALL_HEAP_H
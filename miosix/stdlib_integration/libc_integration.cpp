@@ -34,6 +34,7 @@
 #include <unistd.h>
 #include <dirent.h>
 #include <reent.h>
+#include <malloc.h>
 #include <sys/time.h>
 #include <sys/times.h>
 #include <sys/stat.h>
@@ -42,13 +43,23 @@
 #include "config/miosix_settings.h"
 //// Filesystem
 #include "filesystem/file_access.h"
+#include "filesystem/ioctl.h"
+#include "filesystem/poll.h"
+#include "filesystem/splice.h"
 //// Console
 #include "kernel/logging.h"
 //// kernel interface
 #include "kernel/kernel.h"
+#include "kernel/small_heap.h"
 #include "interfaces/bsp.h"
 #include "interfaces/delays.h"
 #include "board_settings.h"
+//// Processes
+#ifdef WITH_PROCESSES
+#include "kernel/process.h"
+#include "kernel/SystemMap.h"
+#include "kernel/elf_loader.h"
+#endif //WITH_PROCESSES
 
 using namespace std;
 
@@ -226,6 +237,78 @@ void __malloc_unlock()
     miosix::restartKernel();
 }
 
+#ifdef WITH_SMALL_HEAP
+
+//
+// malloc front end, serving small objects from the SmallHeap and the others
+// from the C library allocator, that pauses the kernel while searching
+//
+
+void *malloc(size_t size)
+{
+    if(void *result=miosix::SmallHeap::allocate(size)) return result;
+    return _malloc_r(miosix::getReent(),size);
+}
+
+void free(void *ptr)
+{
+    if(ptr==nullptr || miosix::SmallHeap::deallocate(ptr)) return;
+    _free_r(miosix::getReent(),ptr);
+}
+
+void *calloc(size_t num, size_t size)
+{
+    size_t total=num*size;
+    if(size!=0 && total/size!=num) return nullptr; //Overflow
+    void *result=malloc(total);
+    if(result) memset(result,0,total);
+    return result;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    if(ptr==nullptr) return malloc(size);
+    unsigned int oldSize=miosix::SmallHeap::objectSize(ptr);
+    if(oldSize==0) return _realloc_r(miosix::getReent(),ptr,size);
+    if(size==0)
+    {
+        free(ptr);
+        return nullptr;
+    }
+    if(size<=oldSize) return ptr; //Fits in the same size class
+    void *result=malloc(size);
+    if(result==nullptr) return nullptr;
+    memcpy(result,ptr,oldSize);
+    free(ptr);
+    return result;
+}
+
+//The C library implementations of these functions pass the pointer straight
+//to the C library allocator, so they have to be overridden as well
+
+void *reallocf(void *ptr, size_t size)
+{
+    void *result=realloc(ptr,size);
+    if(result==nullptr && size!=0) free(ptr); //If size is 0 realloc freed it
+    return result;
+}
+
+void *reallocarray(void *ptr, size_t num, size_t size)
+{
+    size_t total=num*size;
+    if(size!=0 && total/size!=num) return nullptr; //Overflow
+    return realloc(ptr,total);
+}
+
+size_t malloc_usable_size(void *ptr)
+{
+    if(ptr==nullptr) return 0;
+    if(unsigned int size=miosix::SmallHeap::objectSize(ptr)) return size;
+    return _malloc_usable_size_r(miosix::getReent(),ptr);
+}
+
+#endif //WITH_SMALL_HEAP
+
 /**
  * \internal
  * __getreent(), return the reentrancy structure of the current thread.
@@ -633,6 +716,70 @@ int ioctl(int fd, int cmd, void *arg)
     return _ioctl_r(miosix::getReent(),fd,cmd,arg);
 }
 
+/**
+ * fsync, write all buffered data of a file to the underlying device
+ */
+int fsync(int fd)
+{
+    return _ioctl_r(miosix::getReent(),fd,miosix::IOCTL_SYNC,0);
+}
+
+/**
+ * \internal
+ * _ftruncate_r, truncate or extend a file
+ */
+int _ftruncate_r(struct _reent *ptr, int fd, off_t length)
+{
+    #ifdef WITH_FILESYSTEM
+
+    #ifndef __NO_EXCEPTIONS
+    try {
+    #endif //__NO_EXCEPTIONS
+        int result=miosix::getFileDescriptorTable().ftruncate(fd,length);
+        if(result>=0) return result;
+        ptr->_errno=-result;
+        return -1;
+    #ifndef __NO_EXCEPTIONS
+    } catch(exception& e) {
+        ptr->_errno=ENOMEM;
+        return -1;
+    }
+    #endif //__NO_EXCEPTIONS
+    
+    #else //WITH_FILESYSTEM
+    ptr->_errno=EBADF;
+    return -1;
+    #endif //WITH_FILESYSTEM
+}
+
+int ftruncate(int fd, off_t length)
+{
+    return _ftruncate_r(miosix::getReent(),fd,length);
+}
+
+/**
+ * posix_fallocate, allocate storage for a byte range of a file.
+ * Unlike most functions, returns the error code instead of setting errno
+ */
+int posix_fallocate(int fd, off_t offset, off_t len)
+{
+    #ifdef WITH_FILESYSTEM
+
+    #ifndef __NO_EXCEPTIONS
+    try {
+    #endif //__NO_EXCEPTIONS
+        return -miosix::getFileDescriptorTable().fallocate(fd,offset,len);
+    #ifndef __NO_EXCEPTIONS
+    } catch(exception& e) {
+        return ENOMEM;
+    }
+    #endif //__NO_EXCEPTIONS
+    
+    #else //WITH_FILESYSTEM
+    return EBADF;
+    #endif //WITH_FILESYSTEM
+}
+
 /**
  * \internal
  * _getcwd_r, return current directory
@@ -874,6 +1021,126 @@ int getdents(unsigned int fd, struct dirent *dirp, unsigned int count)
     #endif //WITH_FILESYSTEM
 }
 
+/**
+ * poll, wait for one or more file descriptors to become ready for I/O
+ */
+int poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    #ifdef WITH_FILESYSTEM
+
+    #ifndef __NO_EXCEPTIONS
+    try {
+    #endif //__NO_EXCEPTIONS
+        int result=miosix::getFileDescriptorTable().poll(fds,nfds,timeout);
+        if(result>=0) return result;
+        miosix::getReent()->_errno=-result;
+        return -1;
+    #ifndef __NO_EXCEPTIONS
+    } catch(exception& e) {
+        miosix::getReent()->_errno=ENOMEM;
+        return -1;
+    }
+    #endif //__NO_EXCEPTIONS
+    
+    #else //WITH_FILESYSTEM
+    miosix::getReent()->_errno=ENOSYS;
+    return -1;
+    #endif //WITH_FILESYSTEM
+}
+
+/**
+ * \internal
+ * _mkfifo_r, create a FIFO special file
+ */
+int _mkfifo_r(struct _reent *ptr, const char *path, mode_t mode)
+{
+    #ifdef WITH_FILESYSTEM
+
+    #ifndef __NO_EXCEPTIONS
+    try {
+    #endif //__NO_EXCEPTIONS
+        int result=miosix::getFileDescriptorTable().mkfifo(path,mode);
+        if(result>=0) return result;
+        ptr->_errno=-result;
+        return -1;
+    #ifndef __NO_EXCEPTIONS
+    } catch(exception& e) {
+        ptr->_errno=ENOMEM;
+        return -1;
+    }
+    #endif //__NO_EXCEPTIONS
+    
+    #else //WITH_FILESYSTEM
+    ptr->_errno=ENOENT;
+    return -1;
+    #endif //WITH_FILESYSTEM
+}
+
+int mkfifo(const char *path, mode_t mode)
+{
+    return _mkfifo_r(miosix::getReent(),path,mode);
+}
+
+/**
+ * \internal
+ * _pipe_r, create an anonymous pipe
+ */
+int _pipe_r(struct _reent *ptr, int fds[2])
+{
+    #ifdef WITH_FILESYSTEM
+
+    #ifndef __NO_EXCEPTIONS
+    try {
+    #endif //__NO_EXCEPTIONS
+        int result=miosix::getFileDescriptorTable().pipe(fds);
+        if(result>=0) return result;
+        ptr->_errno=-result;
+        return -1;
+    #ifndef __NO_EXCEPTIONS
+    } catch(exception& e) {
+        ptr->_errno=ENOMEM;
+        return -1;
+    }
+    #endif //__NO_EXCEPTIONS
+    
+    #else //WITH_FILESYSTEM
+    ptr->_errno=ENFILE;
+    return -1;
+    #endif //WITH_FILESYSTEM
+}
+
+int pipe(int fds[2])
+{
+    return _pipe_r(miosix::getReent(),fds);
+}
+
+/**
+ * splice, move data between two file descriptors without a user buffer
+ */
+ssize_t splice(int fdIn, int fdOut, size_t len)
+{
+    #ifdef WITH_FILESYSTEM
+
+    #ifndef __NO_EXCEPTIONS
+    try {
+    #endif //__NO_EXCEPTIONS
+        ssize_t result=miosix::getFileDescriptorTable().splice(fdIn,fdOut,len);
+        if(result>=0) return result;
+        miosix::getReent()->_errno=-result;
+        return -1;
+    #ifndef __NO_EXCEPTIONS
+    } catch(exception& e) {
+        miosix::getReent()->_errno=ENOMEM;
+        return -1;
+    }
+    #endif //__NO_EXCEPTIONS
+    
+    #else //WITH_FILESYSTEM
+    miosix::getReent()->_errno=EBADF;
+    return -1;
+    #endif //WITH_FILESYSTEM
+}
+
 
 
 
@@ -1072,11 +1339,17 @@ int getpid()
 
 /**
  * \internal
- * _wait_r, unimpemented because processes are not supported in Miosix
+ * _wait_r, wait for the termination of a child process
  */
 int _wait_r(struct _reent *ptr, int *status)
 {
+    #ifdef WITH_PROCESSES
+    pid_t result=miosix::Process::wait(status);
+    if(result<0) ptr->_errno=ECHILD;
+    return result;
+    #else //WITH_PROCESSES
     return -1;
+    #endif //WITH_PROCESSES
 }
 
 int wait(int *status)
@@ -1101,12 +1374,42 @@ int execve(const char *path, char *const argv[], char *const env[])
 
 /**
  * \internal
- * _forkexecve_r, reserved for future use
+ * _forkexecve_r, spawn a process running the program at path, that can be
+ * either the name of a program in the SystemMap or an elf file in the
+ * filesystem. argv and env are currently ignored
  */
 pid_t _forkexecve_r(struct _reent *ptr, const char *path, char *const argv[],
         char *const env[])
 {
+    #ifdef WITH_PROCESSES
+    #ifndef __NO_EXCEPTIONS
+    try {
+    #endif //__NO_EXCEPTIONS
+        using namespace miosix;
+        std::pair<const unsigned int*,unsigned int> res;
+        res=SystemMap::instance().getElfProgram(path);
+        if(res.first!=0 && res.second!=0)
+            return Process::create(ElfProgram(res.first,res.second));
+        intrusive_ref_ptr<ElfRamImage> ram;
+        int result=ElfLoader::instance().load(getFileDescriptorTable(),path,ram);
+        if(result<0)
+        {
+            ptr->_errno=-result;
+            return -1;
+        }
+        return Process::create(ElfProgram(ram));
+    #ifndef __NO_EXCEPTIONS
+    } catch(std::bad_alloc&) {
+        ptr->_errno=ENOMEM;
+        return -1;
+    } catch(std::exception&) {
+        ptr->_errno=ENOEXEC;
+        return -1;
+    }
+    #endif //__NO_EXCEPTIONS
+    #else //WITH_PROCESSES
     return -1;
+    #endif //WITH_PROCESSES
 }
 
 pid_t forkexecve(const char *path, char *const argv[], char *const env[])
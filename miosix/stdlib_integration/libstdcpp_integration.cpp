@@ -247,6 +247,55 @@ union MiosixGuard
     unsigned int flag;
 };
 
+//guard->owner serves the double task of being the thread id of the thread
+//initializing the object, and being the flag to signal that the object is
+//initialized or not. If bit #0 of guard->flag is @ 1 the object is
+//initialized. If bit #1 is @ 1 the object is being initialized and other
+//threads are sleeping waiting for it. All this works on the assumption that
+//Thread* pointers are at least four byte aligned
+static const unsigned int guardInitialized=1;
+static const unsigned int guardHasWaiters=2;
+
+/// Number of times a thread yields waiting for another thread to initialize
+/// an object before going to sleep. Yielding is cheaper if the initializing
+/// thread has the same priority and is about to finish
+static const int guardYields=2;
+
+/**
+ * A thread sleeping because another thread is initializing a static object.
+ * Allocated on the stack of the sleeping thread
+ */
+struct GuardWaiter
+{
+    volatile MiosixGuard *guard; ///< Guard the thread is waiting for
+    miosix::Thread *thread;      ///< Sleeping thread
+    GuardWaiter *next;           ///< Next waiter in the list
+};
+
+/// List of all threads sleeping on a guard, only accessed with interrupts
+/// disabled. It is only non empty if threads are contending for a guard
+static GuardWaiter *guardWaiters=nullptr;
+
+/**
+ * Wake all threads sleeping on a guard, must be called with interrupts
+ * disabled. The threads remove themselves from the list
+ * \param guard guard struct
+ * \return true if one of the woken threads has a higher priority than the
+ * current thread
+ */
+static bool IRQwakeGuardWaiters(volatile MiosixGuard *guard)
+{
+    bool hppw=false;
+    miosix::Thread *cur=miosix::Thread::IRQgetCurrentThread();
+    for(GuardWaiter *w=guardWaiters;w;w=w->next)
+    {
+        if(w->guard!=guard) continue;
+        w->thread->IRQwakeup();
+        if(w->thread->IRQgetPriority()>cur->IRQgetPriority()) hppw=true;
+    }
+    return hppw;
+}
+
 namespace __cxxabiv1
 {
 /**
@@ -257,29 +306,29 @@ namespace __cxxabiv1
  */
 extern "C" int __cxa_guard_acquire(__guard *g)
 {
-    miosix::InterruptDisableLock dLock;
     volatile MiosixGuard *guard=reinterpret_cast<volatile MiosixGuard*>(g);
-    for(;;)
+    //Fast path, object already initialized. No need to disable interrupts as
+    //the guard is only written once the object is initialized
+    if(guard->flag==guardInitialized) return 0;
+
+    miosix::InterruptDisableLock dLock;
+    miosix::Thread *cur=miosix::Thread::IRQgetCurrentThread();
+    for(int i=0;;i++)
     {
-        if(guard->flag==1) return 0; //Object already initialized, good
+        if(guard->flag==guardInitialized) return 0; //Initialized meanwhile
         
         if(guard->flag==0)
         {
             //Object uninitialized, and no other thread trying to initialize it
-            guard->owner=miosix::Thread::IRQgetCurrentThread();
-
-            //guard->owner serves the double task of being the thread id of
-            //the thread initializing the object, and being the flag to signal
-            //that the object is initialized or not. If bit #0 of guard->owner
-            //is @ 1 the object is initialized. All this works on the assumption
-            //that Thread* pointers never have bit #0 @ 1, and this assetion
-            //checks that this condition really holds
-            if(guard->flag & 1) miosix::errorHandler(miosix::UNEXPECTED);
+            guard->owner=cur;
+            //Check the alignment assumption on Thread* pointers
+            if(guard->flag & (guardInitialized | guardHasWaiters))
+                miosix::errorHandler(miosix::UNEXPECTED);
             return 1;
         }
 
         //If we get here, the object is being initialized by another thread
-        if(guard->owner==miosix::Thread::IRQgetCurrentThread())
+        if((guard->flag & ~guardHasWaiters)==reinterpret_cast<unsigned int>(cur))
         {
             //Wait, the other thread initializing the object is this thread?!?
             //We have a recursive initialization error. Not throwing an
@@ -288,9 +337,31 @@ extern "C" int __cxa_guard_acquire(__guard *g)
             _exit(1);
         }
 
+        if(i<guardYields)
+        {
+            miosix::InterruptEnableLock eLock(dLock);
+            miosix::Thread::yield();
+            continue;
+        }
+
+        //Sleep till __cxa_guard_release() or __cxa_guard_abort() is called
+        //on this guard. Threads initializing other objects are not affected
+        GuardWaiter waiter;
+        waiter.guard=guard;
+        waiter.thread=cur;
+        waiter.next=guardWaiters;
+        guardWaiters=&waiter;
+        guard->flag|=guardHasWaiters;
+        miosix::Thread::IRQwait();
         {
             miosix::InterruptEnableLock eLock(dLock);
-            miosix::Thread::yield(); //Sort of a spinlock, a "yieldlock"...
+            miosix::Thread::yield();
+        }
+        for(GuardWaiter **w=&guardWaiters;*w;w=&(*w)->next)
+        {
+            if(*w!=&waiter) continue;
+            *w=waiter.next;
+            break;
         }
     }
 }
@@ -301,9 +372,16 @@ extern "C" int __cxa_guard_acquire(__guard *g)
  */
 extern "C" void __cxa_guard_release(__guard *g) noexcept
 {
-    miosix::InterruptDisableLock dLock;
-    MiosixGuard *guard=reinterpret_cast<MiosixGuard*>(g);
-    guard->flag=1;
+    volatile MiosixGuard *guard=reinterpret_cast<volatile MiosixGuard*>(g);
+    bool hppw=false;
+    {
+        miosix::InterruptDisableLock dLock;
+        bool waiters=guard->flag & guardHasWaiters;
+        guard->flag=guardInitialized;
+        if(waiters) hppw=IRQwakeGuardWaiters(guard);
+    }
+    //If the woken thread has higher priority than our priority, yield
+    if(hppw && miosix::areInterruptsEnabled()) miosix::Thread::yield();
 }
 
 /**
@@ -312,9 +390,16 @@ extern "C" void __cxa_guard_release(__guard *g) noexcept
  */
 extern "C" void __cxa_guard_abort(__guard *g) noexcept
 {
-    miosix::InterruptDisableLock dLock;
-    MiosixGuard *guard=reinterpret_cast<MiosixGuard*>(g);
-    guard->flag=0;
+    volatile MiosixGuard *guard=reinterpret_cast<volatile MiosixGuard*>(g);
+    bool hppw=false;
+    {
+        miosix::InterruptDisableLock dLock;
+        bool waiters=guard->flag & guardHasWaiters;
+        guard->flag=0;
+        //One of the waiting threads will retry initializing the object
+        if(waiters) hppw=IRQwakeGuardWaiters(guard);
+    }
+    if(hppw && miosix::areInterruptsEnabled()) miosix::Thread::yield();
 }
 
 } //namespace __cxxabiv1
@@ -8,9 +8,12 @@ namespace miosix {
  * Calculate the ccitt crc16 on a string of bytes
  * \param message string of bytes
  * \param length message length
+ * \param crc to compute the crc16 of a message in multiple parts, pass the
+ * value returned when processing the previous part
  * \return the crc16
  */
-unsigned short crc16(const void *message, unsigned int length);
+unsigned short crc16(const void *message, unsigned int length,
+                     unsigned short crc=0xffff);
 
 } //namespace miosix
 
@@ -0,0 +1,59 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef CRC32_H
+#define CRC32_H
+
+namespace miosix {
+
+/**
+ * Calculate the crc32 (IEEE 802.3, the one used by Ethernet, zlib and png) on
+ * a string of bytes
+ * \param message string of bytes
+ * \param length message length
+ * \param crc to compute the crc32 of a message in multiple parts, pass the
+ * value returned when processing the previous part
+ * \return the crc32
+ */
+unsigned int crc32(const void *message, unsigned int length,
+                   unsigned int crc=0);
+
+/**
+ * Calculate the crc32c (Castagnoli, the one used by iSCSI, ext4 and btrfs) on
+ * a string of bytes
+ * \param message string of bytes
+ * \param length message length
+ * \param crc to compute the crc32c of a message in multiple parts, pass the
+ * value returned when processing the previous part
+ * \return the crc32c
+ */
+unsigned int crc32c(const void *message, unsigned int length,
+                    unsigned int crc=0);
+
+} //namespace miosix
+
+#endif //CRC32_H
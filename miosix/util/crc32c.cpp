@@ -0,0 +1,44 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "crc32.h"
+#include "crc_slicing.h"
+
+namespace miosix {
+
+/// Lookup tables for the crc32c polynomial, each polynomial is in its own
+/// file so that only the tables that are used are linked
+static constexpr unsigned int crc32cTables[CRC32_SLICE_BYTES][256]=
+    CRC_TABLES(0x82f63b78);
+
+unsigned int crc32c(const void *message, unsigned int length, unsigned int crc)
+{
+    return crcSlicing(crc32cTables,
+        reinterpret_cast<const unsigned char*>(message),length,crc);
+}
+
+} //namespace miosix
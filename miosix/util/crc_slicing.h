@@ -0,0 +1,150 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef CRC_SLICING_H
+#define CRC_SLICING_H
+
+/*
+ * The crc is computed with the slicing algorithm, that processes
+ * CRC32_SLICE_BYTES bytes of the message per iteration using as many tables
+ * of 256 entries. Only slicing by 4 and by 8 are supported. Each table takes
+ * 1KByte of flash, and there is one set of tables for each polynomial.
+ * Slicing by 8 is faster than slicing by 4 on architectures with a cache, at
+ * the price of twice the tables size
+ */
+#ifndef CRC32_SLICE_BYTES
+#define CRC32_SLICE_BYTES 4
+#endif //CRC32_SLICE_BYTES
+
+namespace miosix {
+
+/**
+ * \internal
+ * \param poly polynomial, in reversed bit order
+ * \param c value to shift
+ * \param k number of bits still to shift
+ * \return c shifted by k bits through the crc register
+ */
+constexpr unsigned int crcShift(unsigned int poly, unsigned int c, int k=8)
+{
+    return k==0 ? c : crcShift(poly,c & 1 ? (c>>1) ^ poly : c>>1,k-1);
+}
+
+/**
+ * \internal
+ * \param poly polynomial, in reversed bit order
+ * \param c entry of the previous table
+ * \return the corresponding entry of the next table
+ */
+constexpr unsigned int crcNextEntry(unsigned int poly, unsigned int c)
+{
+    return (c>>8) ^ crcShift(poly,c & 0xff);
+}
+
+/**
+ * \internal
+ * Entry of the lookup tables for the slicing algorithm. Written as a recursive
+ * function, and not with loops, so as to be a valid C++11 constexpr function
+ * \param poly polynomial, in reversed bit order
+ * \param slice table number
+ * \param i index in the table
+ * \return the table entry
+ */
+constexpr unsigned int crcTableEntry(unsigned int poly, int slice,
+        unsigned int i)
+{
+    return slice==0 ? crcShift(poly,i)
+                    : crcNextEntry(poly,crcTableEntry(poly,slice-1,i));
+}
+
+/*
+ * Lookup tables for the slicing algorithm, computed at compile time.
+ * CRC_TABLES(poly) expands to the initializer of an array of type
+ * unsigned int [CRC32_SLICE_BYTES][256]
+ */
+#define CRC_T4(p,s,i) crcTableEntry(p,s,i), crcTableEntry(p,s,i+1), \
+                      crcTableEntry(p,s,i+2), crcTableEntry(p,s,i+3)
+#define CRC_T16(p,s,i) CRC_T4(p,s,i), CRC_T4(p,s,i+4), \
+                       CRC_T4(p,s,i+8), CRC_T4(p,s,i+12)
+#define CRC_T64(p,s,i) CRC_T16(p,s,i), CRC_T16(p,s,i+16), \
+                       CRC_T16(p,s,i+32), CRC_T16(p,s,i+48)
+#define CRC_T256(p,s) { CRC_T64(p,s,0), CRC_T64(p,s,64), \
+                        CRC_T64(p,s,128), CRC_T64(p,s,192) }
+#if CRC32_SLICE_BYTES==4
+#define CRC_TABLES(p) { CRC_T256(p,0), CRC_T256(p,1), \
+                        CRC_T256(p,2), CRC_T256(p,3) }
+#elif CRC32_SLICE_BYTES==8
+#define CRC_TABLES(p) { CRC_T256(p,0), CRC_T256(p,1), \
+                        CRC_T256(p,2), CRC_T256(p,3), \
+                        CRC_T256(p,4), CRC_T256(p,5), \
+                        CRC_T256(p,6), CRC_T256(p,7) }
+#else
+#error CRC32_SLICE_BYTES must be 4 or 8
+#endif
+
+/**
+ * \internal
+ * Slicing algorithm
+ * \param t lookup tables
+ * \param m message
+ * \param length message length
+ * \param crc previous crc value
+ * \return the crc
+ */
+template<int N>
+inline unsigned int crcSlicing(const unsigned int (&t)[N][256],
+        const unsigned char *m, unsigned int length, unsigned int crc)
+{
+    crc=~crc;
+    //Process bytes till the message is word aligned, for the word accesses
+    for(;length>0 && (reinterpret_cast<unsigned long>(m) & 0x3);length--)
+        crc=(crc>>8) ^ t[0][(crc ^ *m++) & 0xff];
+    for(;length>=N;length-=N)
+    {
+        unsigned int r=0;
+        for(int i=0;i<N;i+=4)
+        {
+            unsigned int w;
+            #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            w=*reinterpret_cast<const unsigned int*>(m+i);
+            #else
+            w=m[i] | m[i+1]<<8 | m[i+2]<<16 | m[i+3]<<24;
+            #endif
+            if(i==0) w^=crc;
+            r^=t[N-1-i][w & 0xff] ^ t[N-2-i][(w>>8) & 0xff]
+             ^ t[N-3-i][(w>>16) & 0xff] ^ t[N-4-i][w>>24];
+        }
+        crc=r;
+        m+=N;
+    }
+    for(;length>0;length--) crc=(crc>>8) ^ t[0][(crc ^ *m++) & 0xff];
+    return ~crc;
+}
+
+} //namespace miosix
+
+#endif //CRC_SLICING_H
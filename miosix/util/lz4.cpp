@@ -0,0 +1,98 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "lz4.h"
+#include <cstring>
+
+namespace miosix {
+
+/**
+ * Read an LZ4 variable length field, that is a sequence of bytes which are
+ * added to the length until a byte different from 255 is found
+ * \param ip pointer to the current input position, incremented
+ * \param end end of the input
+ * \param len length, incremented
+ * \return false if the input ended before the field
+ */
+static inline bool readLength(const unsigned char *& ip,
+        const unsigned char *end, unsigned int& len)
+{
+    unsigned char b;
+    do {
+        if(ip>=end) return false;
+        b=*ip++;
+        len+=b;
+    } while(b==255);
+    return true;
+}
+
+int lz4Decompress(const void *src, unsigned int srcSize,
+                  void *dst, unsigned int dstSize)
+{
+    const unsigned char *ip=reinterpret_cast<const unsigned char*>(src);
+    const unsigned char *const ipEnd=ip+srcSize;
+    unsigned char *op=reinterpret_cast<unsigned char*>(dst);
+    unsigned char *const opStart=op;
+    unsigned char *const opEnd=op+dstSize;
+    while(ip<ipEnd)
+    {
+        //Each sequence starts with a token, the high nibble is the number of
+        //literals, the low nibble is the match length minus 4
+        unsigned int token=*ip++;
+        unsigned int literals=token>>4;
+        if(literals==15 && readLength(ip,ipEnd,literals)==false) return -1;
+        if(literals>static_cast<unsigned int>(ipEnd-ip)) return -1;
+        if(literals>static_cast<unsigned int>(opEnd-op)) return -1;
+        memcpy(op,ip,literals);
+        op+=literals;
+        ip+=literals;
+        if(ip==ipEnd) break; //The last sequence has no match part
+        
+        if(ipEnd-ip<2) return -1;
+        unsigned int offset=ip[0] | ip[1]<<8;
+        ip+=2;
+        if(offset==0 || offset>static_cast<unsigned int>(op-opStart))
+            return -1;
+        unsigned int matchLen=token & 0xf;
+        if(matchLen==15 && readLength(ip,ipEnd,matchLen)==false) return -1;
+        matchLen+=4;
+        if(matchLen>static_cast<unsigned int>(opEnd-op)) return -1;
+        //Matches can overlap the output being written, so memcpy can't be used
+        //for short offsets. Longer ones are common and worth the fast path
+        const unsigned char *match=op-offset;
+        if(offset>=matchLen)
+        {
+            memcpy(op,match,matchLen);
+            op+=matchLen;
+        } else {
+            for(unsigned int i=0;i<matchLen;i++) *op++=*match++;
+        }
+    }
+    return op-opStart;
+}
+
+} //namespace miosix
@@ -0,0 +1,50 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by the Miosix contributors                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef LZ4_H
+#define LZ4_H
+
+namespace miosix {
+
+/**
+ * Decompress a buffer in the LZ4 block format. Only the block format is
+ * supported, not the frame format, as the size of the decompressed data is
+ * expected to be known by the caller. The input is fully bounds-checked, so
+ * a corrupted buffer can't cause writes outside of the destination.
+ * \param src compressed data
+ * \param srcSize size of the compressed data
+ * \param dst buffer where the data is decompressed
+ * \param dstSize size of the destination buffer
+ * \return the size of the decompressed data, or -1 if the compressed data is
+ * malformed or does not fit in the destination buffer
+ */
+int lz4Decompress(const void *src, unsigned int srcSize,
+                  void *dst, unsigned int dstSize);
+
+} //namespace miosix
+
+#endif //LZ4_H
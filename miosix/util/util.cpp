@@ -33,6 +33,7 @@
 #include <malloc.h>
 #include "util.h"
 #include "kernel/kernel.h"
+#include "kernel/small_heap.h"
 #include "stdlib_integration/libc_integration.h"
 #include "config/miosix_settings.h"
 #include "arch_settings.h" //For WATERMARK_FILL and STACK_FILL
@@ -66,6 +67,19 @@ void MemoryProfiling::print()
             curFreeStack,absFreeStack,
             heapSize,heapSize-curFreeHeap,heapSize-absFreeHeap,
             curFreeHeap,absFreeHeap);
+    #ifdef WITH_SMALL_HEAP
+    SmallHeapStats stats;
+    SmallHeap::getStats(stats);
+    unsigned int slabBytes=stats.slabs*SmallHeap::slabSize;
+    //Slack is the memory at the end of slabs too small for an object
+    iprintf("Small object heap statistics.\n"
+            "Slabs: %u (%u bytes)\n"
+            "Used: %u\n"
+            "Free: %u\n"
+            "Slack: %u\n",
+            stats.slabs,slabBytes,stats.usedBytes,stats.freeBytes,
+            slabBytes-stats.usedBytes-stats.freeBytes);
+    #endif //WITH_SMALL_HEAP
 }
 
 unsigned int MemoryProfiling::getStackSize()
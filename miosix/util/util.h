@@ -49,7 +49,10 @@ class MemoryProfiling
 public:
 
     /**
-     * Prints a summary of the information that can be gathered from this class.
+     * Prints a summary of the information that can be gathered from this class,
+     * including, if WITH_SMALL_HEAP is defined, the memory held by the small
+     * object heap, used and free, and the memory lost to fragmentation in its
+     * slabs.
      */
     static void print();
 